@@ -21,15 +21,23 @@ LOCAL_SRC_FILES := \
     src/dec/vp8.c \
     src/dec/vp8l.c \
     src/dec/webp.c \
+    src/dsp/blend.c \
+    src/dsp/blend_sse2.c \
     src/dsp/cpu.c \
     src/dsp/dec.c \
     src/dsp/dec_sse2.c \
+    src/dsp/filters.c \
+    src/dsp/filters_sse2.c \
     src/dsp/enc.c \
     src/dsp/enc_sse2.c \
     src/dsp/lossless.c \
+    src/dsp/lossless_sse2.c \
+    src/dsp/rescaler.c \
+    src/dsp/rescaler_sse2.c \
     src/dsp/upsampling.c \
     src/dsp/upsampling_sse2.c \
     src/dsp/yuv.c \
+    src/dsp/yuv_sse2.c \
     src/enc/alpha.c \
     src/enc/analysis.c \
     src/enc/backward_references.c \
@@ -38,6 +46,7 @@ LOCAL_SRC_FILES := \
     src/enc/filter.c \
     src/enc/frame.c \
     src/enc/histogram.c \
+    src/enc/ienc.c \
     src/enc/iterator.c \
     src/enc/layer.c \
     src/enc/picture.c \
@@ -71,9 +80,14 @@ ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
   # Setting LOCAL_ARM_NEON will enable -mfpu=neon which may cause illegal
   # instructions to be generated for armv7a code. Instead target the neon code
   # specifically.
+  LOCAL_SRC_FILES += src/dsp/blend_neon.c.neon
   LOCAL_SRC_FILES += src/dsp/dec_neon.c.neon
+  LOCAL_SRC_FILES += src/dsp/filters_neon.c.neon
   LOCAL_SRC_FILES += src/dsp/upsampling_neon.c.neon
   LOCAL_SRC_FILES += src/dsp/enc_neon.c.neon
+  LOCAL_SRC_FILES += src/dsp/lossless_neon.c.neon
+  LOCAL_SRC_FILES += src/dsp/rescaler_neon.c.neon
+  LOCAL_SRC_FILES += src/dsp/yuv_neon.c.neon
 endif
 LOCAL_STATIC_LIBRARIES := cpufeatures
 
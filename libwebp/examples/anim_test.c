@@ -0,0 +1,316 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Animation decoder tests, run on a synthetic animation mixing the blend and
+//  dispose methods: the canvases of WebPAnimDecoder are compared against a
+//  plain compositing of the frames, for sequential decodings and after seeks.
+//
+// Usage: anim_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "webp/decode.h"
+#include "webp/demux.h"
+#include "webp/encode.h"
+#include "webp/mux.h"
+#include "dsp/dsp.h"      // for WebPBlendPixelRowNonPremult_C()
+
+#define CANVAS_WIDTH 64
+#define CANVAS_HEIGHT 48
+#define CANVAS_SIZE (CANVAS_WIDTH * CANVAS_HEIGHT * 4)
+
+typedef struct {
+  int x_offset, y_offset, width, height;
+  WebPMuxAnimBlend blend_method;
+  WebPMuxAnimDispose dispose_method;
+  int lossless;
+  int opaque;
+  int is_key_frame;   // expected: the frame doesn't depend on the previous ones
+} FrameSpec;
+
+#define B WEBP_MUX_BLEND
+#define NB WEBP_MUX_NO_BLEND
+#define N WEBP_MUX_DISPOSE_NONE
+#define BG WEBP_MUX_DISPOSE_BACKGROUND
+
+static const FrameSpec kFrames[] = {
+  {  0,  0, 64, 48, B,  N,  1, 0, 1 },
+  {  8,  6, 32, 24, B,  N,  0, 0, 0 },
+  { 20, 10, 40, 30, NB, BG, 1, 0, 0 },
+  {  0,  0, 24, 48, B,  N,  0, 0, 0 },
+  {  0,  0, 64, 48, NB, BG, 1, 0, 1 },   // full frame, not blended
+  { 10,  4, 30, 20, B,  BG, 1, 0, 1 },   // previous one disposed, and full
+  { 30, 20, 34, 28, B,  N,  0, 0, 1 },   // previous one disposed, key-frame
+  {  2,  2, 20, 20, B,  BG, 1, 0, 0 },
+  {  0,  0, 64, 48, B,  N,  0, 1, 1 },   // full frame without alpha
+  { 16, 16, 16, 16, B,  BG, 1, 0, 0 },
+  { 40,  0, 24, 24, B,  N,  1, 0, 0 },   // previous one disposed, not key
+  {  0, 24, 64, 24, NB, N,  0, 0, 0 }
+};
+
+#undef B
+#undef NB
+#undef N
+#undef BG
+
+#define NUM_FRAMES ((int)(sizeof(kFrames) / sizeof(kFrames[0])))
+
+typedef struct {
+  WebPData data;                  // the assembled animation
+  uint8_t* canvases;              // expected canvas after each frame
+  int timestamps[NUM_FRAMES];     // expected end timestamp of each frame
+} Animation;
+
+//------------------------------------------------------------------------------
+// Helpers
+
+// Frame 'n' with a varying alpha (including fully transparent and opaque
+// pixels) unless it's opaque.
+static int EncodeFrame(int n, WebPMemoryWriter* const writer) {
+  const FrameSpec* const spec = &kFrames[n];
+  const int width = spec->width, height = spec->height;
+  uint8_t* const rgba = (uint8_t*)malloc(width * height * 4);
+  WebPConfig config;
+  WebPPicture pic;
+  int ok = (rgba != NULL) && WebPConfigInit(&config) && WebPPictureInit(&pic);
+  int x, y;
+  WebPMemoryWriterInit(writer);
+  if (!ok) {
+    free(rgba);
+    return 0;
+  }
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; ++x) {
+      uint8_t* const dst = rgba + 4 * (y * width + x);
+      const int a = (x + 2 * y + 3 * n) % 5;
+      dst[0] = (uint8_t)(x * 7 + n * 31);
+      dst[1] = (uint8_t)(y * 5 + n * 17);
+      dst[2] = (uint8_t)((x + y) * 3 + n * 50);
+      dst[3] = spec->opaque ? 0xff : (uint8_t)((a == 0) ? 0 :
+                                               (a == 1) ? 0xff : 40 * a + n);
+    }
+  }
+  config.quality = 90;
+  config.lossless = spec->lossless;
+  pic.use_argb = spec->lossless;
+  pic.width = width;
+  pic.height = height;
+  pic.writer = WebPMemoryWrite;
+  pic.custom_ptr = writer;
+  ok = WebPPictureImportRGBA(&pic, rgba, width * 4) &&
+       WebPEncode(&config, &pic);
+  WebPPictureFree(&pic);
+  free(rgba);
+  return ok;
+}
+
+// Composites the frame 'n', decoded from 'writer', on 'canvas' as described
+// by the format: key-frames start from a transparent canvas, and the others
+// are blended over the previous canvas if needed.
+static int CompositeFrame(int n, const WebPMemoryWriter* const writer,
+                          uint8_t* const canvas) {
+  const FrameSpec* const spec = &kFrames[n];
+  const int stride = CANVAS_WIDTH * 4;
+  uint8_t* const rgba = WebPDecodeRGBA(writer->mem, writer->size, NULL, NULL);
+  int y;
+  if (rgba == NULL) return 0;
+  if (spec->is_key_frame) memset(canvas, 0, CANVAS_SIZE);
+  for (y = 0; y < spec->height; ++y) {
+    uint8_t* const src = rgba + y * spec->width * 4;
+    uint8_t* const dst = canvas + (spec->y_offset + y) * stride +
+                         spec->x_offset * 4;
+    if (!spec->is_key_frame && spec->blend_method == WEBP_MUX_BLEND) {
+      WebPBlendPixelRowNonPremult_C(src, dst, spec->width);
+    }
+    memcpy(dst, src, spec->width * 4);
+  }
+  free(rgba);
+  return 1;
+}
+
+// Disposes the frame 'n' on 'canvas'.
+static void DisposeFrame(int n, uint8_t* const canvas) {
+  const FrameSpec* const spec = &kFrames[n];
+  int y;
+  if (spec->dispose_method != WEBP_MUX_DISPOSE_BACKGROUND) return;
+  for (y = 0; y < spec->height; ++y) {
+    memset(canvas + (spec->y_offset + y) * CANVAS_WIDTH * 4 +
+           spec->x_offset * 4, 0, spec->width * 4);
+  }
+}
+
+static int MakeAnimation(Animation* const anim) {
+  WebPMux* const mux = WebPMuxNew();
+  WebPMuxAnimParams params;
+  uint8_t canvas[CANVAS_SIZE];
+  int timestamp = 0;
+  int ok = (mux != NULL);
+  int n;
+  WebPDataInit(&anim->data);
+  anim->canvases = (uint8_t*)malloc(NUM_FRAMES * CANVAS_SIZE);
+  ok = ok && (anim->canvases != NULL);
+  memset(canvas, 0, sizeof(canvas));
+  for (n = 0; ok && n < NUM_FRAMES; ++n) {
+    const FrameSpec* const spec = &kFrames[n];
+    WebPMemoryWriter writer;
+    WebPMuxFrameInfo frame;
+    ok = EncodeFrame(n, &writer) && CompositeFrame(n, &writer, canvas);
+    if (ok) {
+      memset(&frame, 0, sizeof(frame));
+      frame.bitstream.bytes = writer.mem;
+      frame.bitstream.size = writer.size;
+      frame.x_offset = spec->x_offset;
+      frame.y_offset = spec->y_offset;
+      frame.duration = 10 + 10 * n;
+      frame.id = WEBP_CHUNK_ANMF;
+      frame.dispose_method = spec->dispose_method;
+      frame.blend_method = spec->blend_method;
+      ok = (WebPMuxPushFrame(mux, &frame, 1) == WEBP_MUX_OK);
+      timestamp += frame.duration;
+      anim->timestamps[n] = timestamp;
+      memcpy(anim->canvases + n * CANVAS_SIZE, canvas, CANVAS_SIZE);
+      DisposeFrame(n, canvas);
+    }
+    free(writer.mem);
+  }
+  params.bgcolor = 0xffffffffu;   // only a hint, ignored by the decoder
+  params.loop_count = 0;
+  ok = ok && (WebPMuxSetAnimationParams(mux, &params) == WEBP_MUX_OK) &&
+       (WebPMuxAssemble(mux, &anim->data) == WEBP_MUX_OK);
+  WebPMuxDelete(mux);
+  return ok;
+}
+
+static WebPAnimDecoder* NewDecoder(const Animation* const anim,
+                                   int max_cached_canvases, int use_threads) {
+  WebPAnimDecoderOptions options;
+  if (!WebPAnimDecoderOptionsInit(&options)) return NULL;
+  options.color_mode = MODE_RGBA;
+  options.use_threads = use_threads;
+  options.max_cached_canvases = max_cached_canvases;
+  return WebPAnimDecoderNew(&anim->data, &options);
+}
+
+// Decodes the next frame of 'dec', and checks that it is the frame 'n'.
+static int CheckNextFrame(WebPAnimDecoder* const dec,
+                          const Animation* const anim, int n,
+                          const char* const what) {
+  uint8_t* canvas;
+  int timestamp;
+  if (!WebPAnimDecoderGetNext(dec, &canvas, &timestamp)) {
+    fprintf(stderr, "%s: could not decode frame %d\n", what, n + 1);
+    return 0;
+  }
+  if (timestamp != anim->timestamps[n] ||
+      memcmp(canvas, anim->canvases + n * CANVAS_SIZE, CANVAS_SIZE)) {
+    fprintf(stderr, "%s: mismatch for frame %d\n", what, n + 1);
+    return 0;
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+
+static int TestSequentialDecoding(const Animation* const anim) {
+  int max_cached;
+  for (max_cached = 0; max_cached <= 4; max_cached += 4) {
+    WebPAnimDecoder* const dec = NewDecoder(anim, max_cached, 0);
+    WebPAnimInfo info;
+    int ok = (dec != NULL) && WebPAnimDecoderGetInfo(dec, &info) &&
+             info.canvas_width == CANVAS_WIDTH &&
+             info.canvas_height == CANVAS_HEIGHT &&
+             info.frame_count == (uint32_t)NUM_FRAMES;
+    int n;
+    for (n = 0; ok && n < NUM_FRAMES; ++n) {
+      ok = CheckNextFrame(dec, anim, n, "sequential");
+    }
+    ok = ok && !WebPAnimDecoderHasMoreFrames(dec);
+    // Rewinding restarts from a transparent canvas.
+    if (ok) WebPAnimDecoderReset(dec);
+    for (n = 0; ok && n < NUM_FRAMES; ++n) {
+      ok = CheckNextFrame(dec, anim, n, "after reset");
+    }
+    WebPAnimDecoderDelete(dec);
+    if (!ok) return 0;
+  }
+  return 1;
+}
+
+// Backward and forward seeks, landing on and after key-frames, and on frames
+// with a cached canvas or not depending on the cache size.
+static int TestSeeking(const Animation* const anim) {
+  static const int kSeeks[] = { 12, 1, 8, 4, 11, 7, 3, 10, 2, 9, 6, 5, 12, 3 };
+  const int num_seeks = (int)(sizeof(kSeeks) / sizeof(kSeeks[0]));
+  int max_cached, use_threads;
+  for (use_threads = 0; use_threads <= 1; ++use_threads) {
+    for (max_cached = 0; max_cached <= 3; ++max_cached) {
+      WebPAnimDecoder* const dec = NewDecoder(anim, max_cached, use_threads);
+      int ok = (dec != NULL);
+      int i, n;
+      // Fill the cache with a first sequential pass, on half of the runs.
+      for (n = 0; ok && (max_cached & 1) && n < NUM_FRAMES; ++n) {
+        ok = CheckNextFrame(dec, anim, n, "first pass");
+      }
+      for (i = 0; ok && i < num_seeks; ++i) {
+        const int frame_num = kSeeks[i];
+        ok = WebPAnimDecoderSeek(dec, frame_num) &&
+             CheckNextFrame(dec, anim, frame_num - 1, "seek");
+        // Then continue a bit from there.
+        if (ok && frame_num < NUM_FRAMES) {
+          ok = CheckNextFrame(dec, anim, frame_num, "after seek");
+        }
+      }
+      ok = ok && !WebPAnimDecoderSeek(dec, 0) &&
+           !WebPAnimDecoderSeek(dec, NUM_FRAMES + 1);
+      WebPAnimDecoderDelete(dec);
+      if (!ok) {
+        fprintf(stderr, "seeking failed with %d cached canvases%s\n",
+                max_cached, use_threads ? " and threads" : "");
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+
+typedef struct {
+  const char* name;
+  int (*test)(const Animation* const anim);
+} AnimTest;
+
+static const AnimTest kTests[] = {
+  { "sequential decoding", TestSequentialDecoding },
+  { "seeking", TestSeeking }
+};
+
+int main(void) {
+  const int num_tests = (int)(sizeof(kTests) / sizeof(kTests[0]));
+  Animation anim;
+  int num_failed = 0;
+  int i;
+  if (!MakeAnimation(&anim)) {
+    fprintf(stderr, "Could not create the test animation.\n");
+    WebPDataClear(&anim.data);
+    free(anim.canvases);
+    return 1;
+  }
+  for (i = 0; i < num_tests; ++i) {
+    const int ok = kTests[i].test(&anim);
+    printf("%-28s %s\n", kTests[i].name, ok ? "OK" : "FAILED");
+    if (!ok) ++num_failed;
+  }
+  WebPDataClear(&anim.data);
+  free(anim.canvases);
+  return (num_failed == 0) ? 0 : 1;
+}
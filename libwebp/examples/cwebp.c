@@ -582,6 +582,8 @@ static void HelpLong(void) {
   printf("  -partition_limit <int> . limit quality to fit the 512k limit on\n");
   printf("                           "
          "the first partition (0=no degradation ... 100=full)\n");
+  printf("  -partitions <int> ...... "
+         "log2 of the number of token partitions (0..3)\n");
   printf("  -pass <int> ............ analysis pass number (1..10)\n");
   printf("  -crop <x> <y> <w> <h> .. crop picture with the given rectangle\n");
   printf("  -resize <w> <h> ........ resize picture (after any cropping)\n");
@@ -607,6 +609,7 @@ static void HelpLong(void) {
   printf("  -lossless .............. Encode image losslessly.\n");
   printf("  -hint <string> ......... Specify image characteristics hint.\n");
   printf("                           One of: photo, picture or graph\n");
+  printf("  -lsearch <int> ......... lossless match search effort (1..100)\n");
 
   printf("\n");
   printf("  -metadata <string> ..... comma separated list of metadata to\n");
@@ -751,6 +754,8 @@ int main(int argc, const char *argv[]) {
       keep_alpha = 0;
     } else if (!strcmp(argv[c], "-lossless")) {
       config.lossless = 1;
+    } else if (!strcmp(argv[c], "-lsearch") && c < argc - 1) {
+      config.lossless_search = strtol(argv[++c], NULL, 0);
     } else if (!strcmp(argv[c], "-hint") && c < argc - 1) {
       ++c;
       if (!strcmp(argv[c], "photo")) {
@@ -793,6 +798,8 @@ int main(int argc, const char *argv[]) {
       config.segments = strtol(argv[++c], NULL, 0);
     } else if (!strcmp(argv[c], "-partition_limit") && c < argc - 1) {
       config.partition_limit = strtol(argv[++c], NULL, 0);
+    } else if (!strcmp(argv[c], "-partitions") && c < argc - 1) {
+      config.partitions = strtol(argv[++c], NULL, 0);
     } else if (!strcmp(argv[c], "-map") && c < argc - 1) {
       picture.extra_info_type = strtol(argv[++c], NULL, 0);
 #ifdef WEBP_EXPERIMENTAL_FEATURES
@@ -0,0 +1,557 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Decoder regression tests, run on a synthetic lossy picture through the
+//  public API: cropped and scaled decodings are compared against reference
+//  decodings of the same area, incremental decodings against plain ones.
+//
+// Usage: dec_test
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "webp/decode.h"
+#include "webp/encode.h"
+#include "dec/webpi.h"    // for the WebPDecoderContext internals
+
+#define PICTURE_WIDTH 400
+#define PICTURE_HEIGHT 96
+
+//------------------------------------------------------------------------------
+// Helpers
+
+// Smooth picture with a varying alpha, so that the chroma and alpha planes
+// matter in the RGBA output. Lossy ones use 1 << 'partitions' token
+// partitions.
+static int MakePicture(WebPMemoryWriter* const writer, int width, int height,
+                       int lossless, int partitions, float quality) {
+  uint8_t* const rgba = (uint8_t*)malloc(width * height * 4);
+  WebPConfig config;
+  WebPPicture pic;
+  int ok = (rgba != NULL) && WebPConfigInit(&config) && WebPPictureInit(&pic);
+  int x, y;
+  WebPMemoryWriterInit(writer);
+  if (!ok) {
+    free(rgba);
+    return 0;
+  }
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; ++x) {
+      uint8_t* const dst = rgba + 4 * (y * width + x);
+      dst[0] = (uint8_t)(128 + 100 * sin(x / 23.) * cos(y / 17.));
+      dst[1] = (uint8_t)(x * 255 / width);
+      dst[2] = (uint8_t)(255 - y * 255 / height);
+      dst[3] = (uint8_t)(((x / 40 + y / 24) & 1) ? 255 : 64 + x / 4);
+    }
+  }
+  config.quality = quality;
+  config.lossless = lossless;
+  config.partitions = partitions;
+  pic.width = width;
+  pic.height = height;
+  pic.writer = WebPMemoryWrite;
+  pic.custom_ptr = writer;
+  ok = WebPPictureImportRGBA(&pic, rgba, width * 4) &&
+       WebPEncode(&config, &pic);
+  WebPPictureFree(&pic);
+  free(rgba);
+  return ok;
+}
+
+// Decodes the 'crop_*' area of 'data' to RGBA, scaled to 'scaled_width' x
+// 'scaled_height' if they are not zero. Returns NULL in case of error.
+static uint8_t* DecodeArea(const WebPMemoryWriter* const data,
+                           int crop_left, int crop_top,
+                           int crop_width, int crop_height,
+                           int scaled_width, int scaled_height,
+                           int fast_downscaling, int no_fancy_upsampling) {
+  WebPDecoderConfig config;
+  if (!WebPInitDecoderConfig(&config)) return NULL;
+  config.options.use_cropping = 1;
+  config.options.crop_left = crop_left;
+  config.options.crop_top = crop_top;
+  config.options.crop_width = crop_width;
+  config.options.crop_height = crop_height;
+  config.options.use_scaling = (scaled_width > 0);
+  config.options.scaled_width = scaled_width;
+  config.options.scaled_height = scaled_height;
+  config.options.use_fast_downscaling = fast_downscaling;
+  config.options.no_fancy_upsampling = no_fancy_upsampling;
+  config.output.colorspace = MODE_RGBA;
+  if (WebPDecode(data->mem, data->size, &config) != VP8_STATUS_OK) {
+    return NULL;
+  }
+  return config.output.u.RGBA.rgba;
+}
+
+// Decodes 'data' to RGBA with 'options'. Returns NULL in case of error.
+static uint8_t* DecodeWithOptions(const WebPMemoryWriter* const data,
+                                  const WebPDecoderOptions* const options) {
+  WebPDecoderConfig config;
+  if (!WebPInitDecoderConfig(&config)) return NULL;
+  config.options = *options;
+  config.output.colorspace = MODE_RGBA;
+  if (WebPDecode(data->mem, data->size, &config) != VP8_STATUS_OK) {
+    return NULL;
+  }
+  return config.output.u.RGBA.rgba;
+}
+
+static double GetPSNR(const uint8_t* const a, const uint8_t* const b,
+                      int size) {
+  double sse = 0.;
+  int i;
+  for (i = 0; i < size; ++i) {
+    const int d = a[i] - b[i];
+    sse += d * d;
+  }
+  return (sse > 0.) ? 10. * log10(255. * 255. * size / sse) : 99.;
+}
+
+//------------------------------------------------------------------------------
+// Cropping and scaling
+
+// Rescaling a cropped area to its own size must give about the same samples
+// as the plain (non-fancy upsampled) cropped decoding, whatever the parity
+// of its height.
+static int TestScaledCropHeights(const WebPMemoryWriter* const data) {
+  int crop_top, crop_height;
+  for (crop_top = 0; crop_top <= 8; crop_top += 8) {
+    for (crop_height = 1; crop_height <= 40; ++crop_height) {
+      const int crop_width = 30;
+      uint8_t* const ref = DecodeArea(data, 4, crop_top, crop_width,
+                                      crop_height, 0, 0, 0, 1);
+      uint8_t* const out = DecodeArea(data, 4, crop_top, crop_width,
+                                      crop_height, crop_width, crop_height,
+                                      0, 0);
+      const double psnr = (ref != NULL && out != NULL) ?
+          GetPSNR(ref, out, crop_width * crop_height * 4) : 0.;
+      free(ref);
+      free(out);
+      if (psnr < 30.) {
+        fprintf(stderr, "scaled crop: %.2f dB for height %d at row %d\n",
+                psnr, crop_height, crop_top);
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// The fast downscaling must stay close to the exact one, for all the crop
+// heights, with aligned and unaligned crop origins, and all reductions. The
+// larger reductions only reconstruct the DC coefficients, hence the lower
+// bounds.
+static int TestFastDownscalingCropHeights(const WebPMemoryWriter* const data) {
+  static const int kCropTops[4] = { 0, 8, 16, 17 };
+  static const double kMinPSNR[3] = { 36., 30., 26. };   // for 1/2, 1/4, 1/8
+  int k, shift, crop_height;
+  for (k = 0; k < 4; ++k) {
+    const int crop_top = kCropTops[k];
+    for (shift = 1; shift <= 3; ++shift) {
+      const int factor = 1 << shift;
+      for (crop_height = 1; crop_top + crop_height <= PICTURE_HEIGHT &&
+                            crop_height <= 72; ++crop_height) {
+        const int crop_width = 386;
+        const int scaled_width = crop_width / factor;
+        const int scaled_height =
+            (crop_height >= factor) ? crop_height / factor : 1;
+        uint8_t* const ref =
+            DecodeArea(data, 0, crop_top, crop_width, crop_height,
+                       scaled_width, scaled_height, 0, 0);
+        uint8_t* const out =
+            DecodeArea(data, 0, crop_top, crop_width, crop_height,
+                       scaled_width, scaled_height, 1, 0);
+        const double psnr = (ref != NULL && out != NULL) ?
+            GetPSNR(ref, out, scaled_width * scaled_height * 4) : 0.;
+        free(ref);
+        free(out);
+        if (psnr < kMinPSNR[shift - 1]) {
+          fprintf(stderr, "fast downscaling: %.2f dB for 1/%d, crop height "
+                  "%d at row %d\n", psnr, factor, crop_height, crop_top);
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+// Downscaling to RGB must keep the mean color of the area. The half-resolution
+// U/V planes of odd heights used to be scaled by h / (h + 1).
+static int TestScaledMeanColors(const WebPMemoryWriter* const data) {
+  int crop_height;
+  for (crop_height = 1; crop_height <= 33; crop_height += 2) {
+    const int crop_width = 64;
+    const int scaled_width = crop_width / 2;
+    const int scaled_height = (crop_height + 1) / 2;
+    uint8_t* const ref = DecodeArea(data, 128, 32, crop_width, crop_height,
+                                    0, 0, 0, 1);
+    uint8_t* const out = DecodeArea(data, 128, 32, crop_width, crop_height,
+                                    scaled_width, scaled_height, 0, 0);
+    int ok = (ref != NULL && out != NULL);
+    int c, i;
+    for (c = 0; ok && c < 4; ++c) {
+      double ref_mean = 0., out_mean = 0.;
+      for (i = 0; i < crop_width * crop_height; ++i) ref_mean += ref[4 * i + c];
+      for (i = 0; i < scaled_width * scaled_height; ++i) {
+        out_mean += out[4 * i + c];
+      }
+      ref_mean /= crop_width * crop_height;
+      out_mean /= scaled_width * scaled_height;
+      if (fabs(ref_mean - out_mean) > 2.) {
+        fprintf(stderr, "scaled mean: channel %d is %.2f instead of %.2f for "
+                "height %d\n", c, out_mean, ref_mean, crop_height);
+        ok = 0;
+      }
+    }
+    free(ref);
+    free(out);
+    if (!ok) return 0;
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Incremental decoding from segments
+
+// Returns true if 'idec' has fully decoded the RGBA picture 'ref'.
+static int IsDecoded(const WebPIDecoder* const idec, const uint8_t* const ref,
+                     int width, int height) {
+  int last_y, w, h, stride, y;
+  const uint8_t* const rgba = WebPIDecGetRGB(idec, &last_y, &w, &h, &stride);
+  if (rgba == NULL || last_y != height || w != width || h != height) {
+    return 0;
+  }
+  for (y = 0; y < height; ++y) {
+    if (memcmp(rgba + y * stride, ref + y * width * 4, width * 4)) return 0;
+  }
+  return 1;
+}
+
+// Decodes 'data' with WebPIAppendSegment(), cutting it into segments of the
+// 'sizes[]' sizes in turn. The segments are laid out apart from each other,
+// with garbage in-between, so that any read past a segment's end shows.
+static int DecodeSegments(const WebPMemoryWriter* const data,
+                          const size_t sizes[3], const uint8_t* const ref,
+                          int width, int height) {
+  const size_t kGap = 16;
+  uint8_t* const tmp = (uint8_t*)malloc(data->size + kGap * (data->size + 1));
+  WebPIDecoder* const idec = WebPINewRGB(MODE_RGBA, NULL, 0, 0);
+  VP8StatusCode status = VP8_STATUS_SUSPENDED;
+  size_t pos = 0;
+  uint8_t* seg = tmp;
+  int ok = (tmp != NULL && idec != NULL);
+  int k;
+  for (k = 0; ok && pos < data->size; ++k) {
+    size_t size = sizes[k % 3];
+    if (size > data->size - pos) size = data->size - pos;
+    memcpy(seg, data->mem + pos, size);
+    memset(seg + size, 0xa5, kGap);
+    status = WebPIAppendSegment(idec, seg, size);
+    ok = (status == VP8_STATUS_SUSPENDED || status == VP8_STATUS_OK);
+    pos += size;
+    seg += size + kGap;
+  }
+  ok = ok && (status == VP8_STATUS_OK) && IsDecoded(idec, ref, width, height);
+  WebPIDelete(idec);
+  free(tmp);
+  return ok;
+}
+
+// Returns true if the token data is read from the segments in place: the
+// decoding stalls at the end of the first segment, which is then scrambled
+// before the remainder is appended.
+static int IsReadInPlace(const WebPMemoryWriter* const data, size_t split,
+                         const uint8_t* const ref, int width, int height) {
+  uint8_t* const tmp = (uint8_t*)malloc(data->size);
+  WebPIDecoder* const idec = WebPINewRGB(MODE_RGBA, NULL, 0, 0);
+  int in_place = 0;
+  if (tmp != NULL && idec != NULL) {
+    size_t i;
+    memcpy(tmp, data->mem, data->size);
+    if (WebPIAppendSegment(idec, tmp, split) == VP8_STATUS_SUSPENDED) {
+      for (i = 0; i < split; ++i) tmp[i] ^= 0x5a;
+      WebPIAppendSegment(idec, tmp + split, data->size - split);
+      in_place = !IsDecoded(idec, ref, width, height);
+    }
+  }
+  WebPIDelete(idec);
+  free(tmp);
+  return in_place;
+}
+
+// All the segment layouts must give the plain decoding, for lossy pictures
+// with one or four token partitions and for lossless ones.
+static int TestSegmentedInput(const WebPMemoryWriter* const data) {
+  static const size_t kSizes[6][3] = {
+    { 1, 1, 1 }, { 7, 7, 7 }, { 1000, 1000, 1000 }, { 0, 5, 300 },
+    { 3, 4096, 1 }, { 1 << 20, 1 << 20, 1 << 20 }
+  };
+  WebPMemoryWriter pictures[3];
+  WebPIDecoder* const idec = WebPINewRGB(MODE_RGBA, NULL, 0, 0);
+  int ok, n, k;
+  // The segments can't be mixed with WebPIAppend()'s data.
+  ok = (idec != NULL) &&
+       WebPIAppendSegment(idec, data->mem, 16) == VP8_STATUS_SUSPENDED &&
+       WebPIAppend(idec, data->mem + 16, 16) == VP8_STATUS_INVALID_PARAM;
+  WebPIDelete(idec);
+  pictures[0] = *data;
+  ok = MakePicture(&pictures[1], PICTURE_WIDTH, PICTURE_HEIGHT,
+                   0, 2, 95.f) && ok;
+  ok = MakePicture(&pictures[2], PICTURE_WIDTH, PICTURE_HEIGHT,
+                   1, 0, 95.f) && ok;
+  for (n = 0; ok && n < 3; ++n) {
+    int width, height, in_place = 0;
+    uint8_t* const ref = WebPDecodeRGBA(pictures[n].mem, pictures[n].size,
+                                        &width, &height);
+    ok = (ref != NULL);
+    for (k = 0; ok && k < 6; ++k) {
+      ok = DecodeSegments(&pictures[n], kSizes[k], ref, width, height);
+      if (!ok) {
+        fprintf(stderr, "segments: picture #%d, layout #%d\n", n, k);
+      }
+    }
+    // Some of the splits in the token data might fall where the bit reader
+    // has already loaded the last bytes.
+    if (ok && n < 2) {
+      for (k = 4; k < 8; ++k) {
+        in_place |= IsReadInPlace(&pictures[n], pictures[n].size * k / 8,
+                                  ref, width, height);
+      }
+      if (!in_place) {
+        fprintf(stderr, "segments: token data copied (picture #%d)\n", n);
+        ok = 0;
+      }
+    }
+    free(ref);
+  }
+  free(pictures[1].mem);
+  free(pictures[2].mem);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Decoding contexts
+
+// Decodes 'data' to RGBA through 'context' and compares the result with
+// 'ref'.
+static int DecodeWithContext(WebPDecoderContext* const context,
+                             const WebPMemoryWriter* const data,
+                             const uint8_t* const ref, int use_threads) {
+  WebPDecoderConfig config;
+  int ok = WebPInitDecoderConfig(&config);
+  config.output.colorspace = MODE_RGBA;
+  config.options.use_threads = use_threads;
+  ok = ok && (WebPDecodeWithContext(context, data->mem, data->size,
+                                    &config) == VP8_STATUS_OK);
+  ok = ok && !memcmp(config.output.u.RGBA.rgba, ref,
+                     config.output.width * config.output.height * 4);
+  WebPFreeDecBuffer(&config.output);
+  return ok;
+}
+
+// Lossy, lossless and lossy pictures again must decode the same through a
+// context as without. After each picture, its decoder must be kept only if
+// it fits in 'max_memory' (1 byte never does).
+static int TestDecoderContexts(const WebPMemoryWriter* const data) {
+  static const size_t kMaxMemory[3] = { 0, 1, 1 << 30 };
+  WebPMemoryWriter pictures[3];
+  uint8_t* refs[3] = { NULL, NULL, NULL };
+  int ok, n, m, use_threads;
+  pictures[0] = *data;
+  ok = MakePicture(&pictures[1], PICTURE_WIDTH, PICTURE_HEIGHT, 1, 0, 95.f);
+  ok = MakePicture(&pictures[2], PICTURE_WIDTH, PICTURE_HEIGHT,
+                   0, 2, 95.f) && ok;
+  for (n = 0; ok && n < 3; ++n) {
+    refs[n] = WebPDecodeRGBA(pictures[n].mem, pictures[n].size, NULL, NULL);
+    ok = (refs[n] != NULL);
+  }
+  for (m = 0; ok && m < 3; ++m) {
+    WebPDecoderContext* const context = WebPNewDecoderContext(kMaxMemory[m]);
+    ok = (context != NULL);
+    for (use_threads = 0; ok && use_threads <= 1; ++use_threads) {
+      for (n = 0; ok && n < 3; ++n) {
+        int kept;
+        ok = DecodeWithContext(context, &pictures[n], refs[n], use_threads);
+        kept = (n == 1) ? (context->vp8l_ != NULL) : (context->vp8_ != NULL);
+        if (!ok) {
+          fprintf(stderr, "context: picture #%d differs (max_memory %d, "
+                  "threads %d)\n", n, (int)kMaxMemory[m], use_threads);
+        } else if (kept != (kMaxMemory[m] != 1)) {
+          fprintf(stderr, "context: decoder #%d %s (max_memory %d)\n",
+                  n, kept ? "kept" : "released", (int)kMaxMemory[m]);
+          ok = 0;
+        }
+      }
+    }
+    WebPDeleteDecoderContext(context);
+  }
+  for (n = 0; n < 3; ++n) free(refs[n]);
+  free(pictures[1].mem);
+  free(pictures[2].mem);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Multi-threading
+
+// Decodes 'data' with 'options' and 'num_threads' threads to the 'width' x
+// 'height' RGBA buffer 'out', and compares the result with 'ref'. 'out' is
+// cleared first, so that the rows the decoder misses can't come from a
+// previous decoding.
+static int DecodeWithThreads(const WebPMemoryWriter* const data,
+                             const WebPDecoderOptions* const options,
+                             int num_threads, const uint8_t* const ref,
+                             uint8_t* const out, int width, int height) {
+  const size_t size = (size_t)width * height * 4;
+  WebPDecoderConfig config;
+  if (!WebPInitDecoderConfig(&config)) return 0;
+  config.options = *options;
+  config.options.use_threads = 1;
+  config.options.num_threads = num_threads;
+  config.output.colorspace = MODE_RGBA;
+  config.output.is_external_memory = 1;
+  config.output.u.RGBA.rgba = out;
+  config.output.u.RGBA.stride = width * 4;
+  config.output.u.RGBA.size = size;
+  memset(out, 0, size);
+  return (WebPDecode(data->mem, data->size, &config) == VP8_STATUS_OK) &&
+         !memcmp(out, ref, size);
+}
+
+// The parallel parsing of the 8 token partitions must give the sequential
+// decoding, whatever the number of threads, with and without cropping or
+// loop filtering. The picture is wide enough for the decoder to use threads
+// (see MIN_WIDTH_FOR_THREADS).
+static int TestParallelDecoding(const WebPMemoryWriter* const data) {
+  static const int kNumThreads[4] = { 1, 2, 3, 8 };
+  static const int kCrops[3][4] = {   // left, top, width, height
+    { 0, 0, 0, 0 }, { 38, 50, 521, 157 }, { 0, 250, 640, 134 }
+  };
+  const int width = 640, height = 384;
+  uint8_t* const out = (uint8_t*)malloc(width * height * 4);
+  WebPMemoryWriter picture;
+  int ok, crop, bypass_filtering, n;
+  (void)data;
+  ok = MakePicture(&picture, width, height, 0, 3, 95.f) && (out != NULL);
+  for (crop = 0; ok && crop < 3; ++crop) {
+    for (bypass_filtering = 0; ok && bypass_filtering <= 1;
+         ++bypass_filtering) {
+      WebPDecoderOptions options;
+      const int* const area = kCrops[crop];
+      uint8_t* ref;
+      memset(&options, 0, sizeof(options));
+      options.use_cropping = (area[2] > 0);
+      options.crop_left = area[0];
+      options.crop_top = area[1];
+      options.crop_width = area[2];
+      options.crop_height = area[3];
+      options.bypass_filtering = bypass_filtering;
+      ref = DecodeWithOptions(&picture, &options);
+      ok = (ref != NULL);
+      for (n = 0; ok && n < 4; ++n) {
+        ok = DecodeWithThreads(&picture, &options, kNumThreads[n], ref, out,
+                               (area[2] > 0) ? area[2] : width,
+                               (area[2] > 0) ? area[3] : height);
+        if (!ok) {
+          fprintf(stderr, "parallel decoding: %d threads differ (crop #%d, "
+                  "bypass_filtering %d)\n", kNumThreads[n], crop,
+                  bypass_filtering);
+        }
+      }
+      free(ref);
+    }
+  }
+  free(out);
+  free(picture.mem);
+  return ok;
+}
+
+// Multi-threaded lossless decoding must give the same samples as the plain
+// one, with and without scaling or cropping. The picture is large enough for
+// its rows to be decoded through a sliding window, which the worker thread
+// must be done with before it slides.
+static int TestLosslessThreads(const WebPMemoryWriter* const data) {
+  static const int kAreas[4][6] = {   // crop left, top, width, height, scaled
+    { 0, 0, 0, 0, 0, 0 }, { 0, 0, 0, 0, 1024, 800 },
+    { 100, 900, 1500, 650, 0, 0 }, { 100, 900, 1500, 650, 500, 217 }
+  };
+  const int width = 2048, height = 1600;
+  uint8_t* const out = (uint8_t*)malloc(width * height * 4);
+  WebPMemoryWriter picture;
+  int ok, n;
+  (void)data;
+  // The fastest lossless compression is good enough here.
+  ok = MakePicture(&picture, width, height, 1, 0, 0.f) && (out != NULL);
+  for (n = 0; ok && n < 4; ++n) {
+    const int* const area = kAreas[n];
+    WebPDecoderOptions options;
+    uint8_t* ref;
+    memset(&options, 0, sizeof(options));
+    options.use_cropping = (area[2] > 0);
+    options.crop_left = area[0];
+    options.crop_top = area[1];
+    options.crop_width = area[2];
+    options.crop_height = area[3];
+    options.use_scaling = (area[4] > 0);
+    options.scaled_width = area[4];
+    options.scaled_height = area[5];
+    ref = DecodeWithOptions(&picture, &options);
+    ok = (ref != NULL) &&
+         DecodeWithThreads(&picture, &options, 0, ref, out,
+                           (area[4] > 0) ? area[4] :
+                           (area[2] > 0) ? area[2] : width,
+                           (area[4] > 0) ? area[5] :
+                           (area[2] > 0) ? area[3] : height);
+    if (!ok) fprintf(stderr, "lossless threads: area #%d differs\n", n);
+    free(ref);
+  }
+  free(out);
+  free(picture.mem);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+
+typedef struct {
+  const char* name;
+  int (*test)(const WebPMemoryWriter* const data);
+} DecTest;
+
+static const DecTest kTests[] = {
+  { "scaled crop heights", TestScaledCropHeights },
+  { "fast downscaling crops", TestFastDownscalingCropHeights },
+  { "scaled mean colors", TestScaledMeanColors },
+  { "segmented input", TestSegmentedInput },
+  { "decoder contexts", TestDecoderContexts },
+  { "parallel decoding", TestParallelDecoding },
+  { "lossless threads", TestLosslessThreads }
+};
+
+int main(void) {
+  const int num_tests = (int)(sizeof(kTests) / sizeof(kTests[0]));
+  WebPMemoryWriter data;
+  int num_failed = 0;
+  int i;
+  if (!MakePicture(&data, PICTURE_WIDTH, PICTURE_HEIGHT, 0, 0, 95.f)) {
+    fprintf(stderr, "Could not encode the test picture.\n");
+    free(data.mem);
+    return 1;
+  }
+  for (i = 0; i < num_tests; ++i) {
+    const int ok = kTests[i].test(&data);
+    printf("%-28s %s\n", kTests[i].name, ok ? "OK" : "FAILED");
+    if (!ok) ++num_failed;
+  }
+  free(data.mem);
+  return (num_failed == 0) ? 0 : 1;
+}
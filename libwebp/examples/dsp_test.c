@@ -0,0 +1,683 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Checks that the SSE2 / NEON versions of the dsp functions give exactly the
+//  same results as the plain-C ones, and that the multi-threaded encoder
+//  searches give the same results as the single-threaded ones.
+//
+//  Each dsp module is initialized twice: once with VP8GetCPUInfo set to NULL,
+//  which selects the C functions, and once with the detected CPU features.
+//  Both sets of function pointers are then run on the same random inputs.
+//  On a CPU without SIMD support the C code is simply compared to itself.
+//
+// Usage: dsp_test [seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsp/dsp.h"
+#include "dsp/lossless.h"
+#include "dsp/yuv.h"
+#include "enc/cost.h"
+#include "utils/rescaler.h"
+
+static VP8CPUInfo cpu_info;
+
+// Runs 'init' with the C (use_simd = 0) or the SIMD (use_simd = 1) functions.
+static void InitDsp(void (*init)(void), int use_simd) {
+  VP8GetCPUInfo = use_simd ? cpu_info : NULL;
+  init();
+}
+
+//------------------------------------------------------------------------------
+// Random inputs
+
+static uint32_t seed = 0x2f6e2b1u;
+
+static uint32_t Random32(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+// Byte biased towards the extremes, which is where the saturating and
+// rounding arithmetic of the SIMD versions is most likely to differ.
+static uint8_t RandomByte(void) {
+  const uint32_t r = Random32();
+  switch (r & 7) {
+    case 0: return 0;
+    case 1: return 255;
+    case 2: return (uint8_t)(128 + ((r >> 8) & 3) - 2);
+    default: return (uint8_t)(r >> 16);
+  }
+}
+
+static uint32_t RandomPixel(void) {
+  return ((uint32_t)RandomByte() << 24) | ((uint32_t)RandomByte() << 16) |
+         ((uint32_t)RandomByte() << 8) | RandomByte();
+}
+
+static void RandomPixels(uint32_t* const argb, int num_pixels) {
+  int i;
+  for (i = 0; i < num_pixels; ++i) argb[i] = RandomPixel();
+}
+
+static int CheckSame(const char* const name, int size,
+                     const void* const ref, const void* const out, int len) {
+  if (memcmp(ref, out, len)) {
+    fprintf(stderr, "%s: mismatch for size %d\n", name, size);
+    return 0;
+  }
+  return 1;
+}
+
+// Large enough to hold all the residual and leftover code paths.
+#define MAX_PIXELS 67
+
+//------------------------------------------------------------------------------
+// Lossless
+
+static int TestLosslessPredictors(void) {
+  VP8LPredClampedAddSubFunc full[2], half[2];
+  VP8LPredSelectFunc select[2];
+  int i, n;
+  for (i = 0; i < 2; ++i) {
+    InitDsp(VP8LDspInit, i);
+    full[i] = VP8LClampedAddSubtractFull;
+    half[i] = VP8LClampedAddSubtractHalf;
+    select[i] = VP8LSelect;
+  }
+  for (n = 0; n < 100000; ++n) {
+    const uint32_t c0 = RandomPixel();
+    const uint32_t c1 = RandomPixel();
+    const uint32_t c2 = RandomPixel();
+    if (full[0](c0, c1, c2) != full[1](c0, c1, c2) ||
+        half[0](c0, c1, c2) != half[1](c0, c1, c2) ||
+        select[0](c0, c1, c2) != select[1](c0, c1, c2)) {
+      fprintf(stderr, "predictors: mismatch for %.8x %.8x %.8x\n", c0, c1, c2);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int TestLosslessTransforms(void) {
+  VP8LSubtractGreenFromBlueAndRedFunc subtract_green[2];
+  VP8LAddGreenToBlueAndRedFunc add_green[2];
+  VP8LTransformColorFunc transform[2], inverse[2];
+  uint32_t src[MAX_PIXELS], ref[MAX_PIXELS], out[MAX_PIXELS];
+  const int len = (int)sizeof(ref);
+  int i, n, size;
+  for (i = 0; i < 2; ++i) {
+    InitDsp(VP8LDspInit, i);
+    subtract_green[i] = VP8LSubtractGreenFromBlueAndRed;
+    add_green[i] = VP8LAddGreenToBlueAndRed;
+    transform[i] = VP8LTransformColor;
+    inverse[i] = VP8LTransformColorInverse;
+  }
+  for (n = 0; n < 20; ++n) {
+    for (size = 0; size <= MAX_PIXELS; ++size) {
+      VP8LMultipliers m;
+      m.green_to_red_ = RandomByte();
+      m.green_to_blue_ = RandomByte();
+      m.red_to_blue_ = RandomByte();
+      RandomPixels(src, MAX_PIXELS);
+
+      memcpy(ref, src, len);
+      memcpy(out, src, len);
+      subtract_green[0](ref, size);
+      subtract_green[1](out, size);
+      if (!CheckSame("subtract green", size, ref, out, len)) return 0;
+
+      memcpy(ref, src, len);
+      memcpy(out, src, len);
+      add_green[0](ref, ref + size);
+      add_green[1](out, out + size);
+      if (!CheckSame("add green", size, ref, out, len)) return 0;
+
+      memcpy(ref, src, len);
+      memcpy(out, src, len);
+      transform[0](&m, ref, size);
+      transform[1](&m, out, size);
+      if (!CheckSame("transform color", size, ref, out, len)) return 0;
+
+      memcpy(ref, src, len);
+      memcpy(out, src, len);
+      inverse[0](&m, ref, size);
+      inverse[1](&m, out, size);
+      if (!CheckSame("inverse color", size, ref, out, len)) return 0;
+    }
+  }
+  return 1;
+}
+
+static int TestLosslessConverters(void) {
+  VP8LConvertFunc convert[5][2];
+  static const char* const kNames[5] = {
+    "BGRA to RGB", "BGRA to RGBA", "BGRA to RGBA4444", "BGRA to RGB565",
+    "BGRA to BGR"
+  };
+  uint32_t src[MAX_PIXELS];
+  uint8_t ref[4 * MAX_PIXELS + 1], out[4 * MAX_PIXELS + 1];
+  int i, k, n, size;
+  for (i = 0; i < 2; ++i) {
+    InitDsp(VP8LDspInit, i);
+    convert[0][i] = VP8LConvertBGRAToRGB;
+    convert[1][i] = VP8LConvertBGRAToRGBA;
+    convert[2][i] = VP8LConvertBGRAToRGBA4444;
+    convert[3][i] = VP8LConvertBGRAToRGB565;
+    convert[4][i] = VP8LConvertBGRAToBGR;
+  }
+  for (n = 0; n < 20; ++n) {
+    for (size = 0; size <= MAX_PIXELS; ++size) {
+      RandomPixels(src, size);
+      for (k = 0; k < 5; ++k) {
+        // Unaligned destination, canary bytes check for overwrites.
+        memset(ref, 0xa5, sizeof(ref));
+        memset(out, 0xa5, sizeof(out));
+        convert[k][0](src, size, ref + 1);
+        convert[k][1](src, size, out + 1);
+        if (!CheckSame(kNames[k], size, ref, out, sizeof(ref))) return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static int TestLosslessAddVector(void) {
+  VP8LAddVectorFunc add_vector[2];
+  int a[MAX_PIXELS], b[MAX_PIXELS], ref[MAX_PIXELS], out[MAX_PIXELS];
+  int i, size;
+  for (i = 0; i < 2; ++i) {
+    InitDsp(VP8LDspInit, i);
+    add_vector[i] = VP8LAddVector;
+  }
+  for (size = 0; size <= MAX_PIXELS; ++size) {
+    for (i = 0; i < MAX_PIXELS; ++i) {
+      a[i] = (int)(Random32() >> 8);
+      b[i] = (int)(Random32() >> 8);
+    }
+    memcpy(ref, a, sizeof(a));
+    memcpy(out, a, sizeof(a));
+    add_vector[0](a, b, ref, size);
+    add_vector[1](a, b, out, size);
+    if (!CheckSame("add vector", size, ref, out, sizeof(ref))) return 0;
+    // In-place use, as done when merging histograms.
+    memcpy(ref, a, sizeof(a));
+    memcpy(out, a, sizeof(a));
+    add_vector[0](ref, b, ref, size);
+    add_vector[1](out, b, out, size);
+    if (!CheckSame("add vector in-place", size, ref, out, sizeof(ref))) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Image with flat areas, gradients and noise, so that the searches don't
+// always pick the same candidates.
+static void RandomImage(uint32_t* const argb, int width, int height) {
+  int x, y;
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; ++x) {
+      const uint32_t r = Random32();
+      uint32_t v;
+      if (((x >> 3) + (y >> 2)) % 3 == 0) {
+        v = 0xff204060u;
+      } else if ((r & 3) == 0) {
+        v = RandomPixel();
+      } else {
+        v = 0xff000000u | (((x + y) & 0xff) << 16) | ((x * 3 & 0xff) << 8) |
+            ((y * 5) & 0xff);
+        v += (r >> 8) & 0x030303;
+      }
+      argb[y * width + x] = v;
+    }
+  }
+}
+
+static int TestLosslessSearchThreads(void) {
+  static const int kNumThreads[3] = { 2, 3, 16 };
+  int n;
+  InitDsp(VP8LDspInit, 1);
+  for (n = 0; n < 24; ++n) {
+    const int width = 1 + Random32() % 150;
+    const int height = 1 + Random32() % 100;
+    const int bits = 2 + n % 4;
+    const int step = 8 << (n % 3);
+    const int tile_size = 1 << bits;
+    const int num_pixels = width * height;
+    const int num_tiles =
+        VP8LSubSampleSize(width, bits) * VP8LSubSampleSize(height, bits);
+    uint32_t* const src = (uint32_t*)malloc(num_pixels * sizeof(*src));
+    uint32_t* const ref = (uint32_t*)malloc(num_pixels * sizeof(*ref));
+    uint32_t* const out = (uint32_t*)malloc(num_pixels * sizeof(*out));
+    uint32_t* const scratch =
+        (uint32_t*)malloc((tile_size + 1) * width * sizeof(*scratch));
+    uint32_t* const ref_image =
+        (uint32_t*)malloc(num_tiles * sizeof(*ref_image));
+    uint32_t* const out_image =
+        (uint32_t*)malloc(num_tiles * sizeof(*out_image));
+    int ok = (src != NULL && ref != NULL && out != NULL && scratch != NULL &&
+              ref_image != NULL && out_image != NULL);
+    int k;
+    if (ok) RandomImage(src, width, height);
+    for (k = 0; ok && k < 3; ++k) {
+      const int num_threads = kNumThreads[k];
+      memcpy(ref, src, num_pixels * sizeof(*src));
+      memcpy(out, src, num_pixels * sizeof(*src));
+      ok = VP8LResidualImage(width, height, bits, ref, scratch, ref_image, 1) &&
+           VP8LResidualImage(width, height, bits, out, scratch, out_image,
+                             num_threads);
+      ok = ok &&
+           CheckSame("residual image", num_pixels, ref, out,
+                     num_pixels * sizeof(*src)) &&
+           CheckSame("predictor modes", num_tiles, ref_image, out_image,
+                     num_tiles * sizeof(*src));
+      memcpy(ref, src, num_pixels * sizeof(*src));
+      memcpy(out, src, num_pixels * sizeof(*src));
+      ok = ok &&
+           VP8LColorSpaceTransform(width, height, bits, step, ref, ref_image,
+                                   1) &&
+           VP8LColorSpaceTransform(width, height, bits, step, out, out_image,
+                                   num_threads);
+      ok = ok &&
+           CheckSame("cross-color image", num_pixels, ref, out,
+                     num_pixels * sizeof(*src)) &&
+           CheckSame("cross-color multipliers", num_tiles, ref_image,
+                     out_image, num_tiles * sizeof(*src));
+    }
+    free(src);
+    free(ref);
+    free(out);
+    free(scratch);
+    free(ref_image);
+    free(out_image);
+    if (!ok) return 0;
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// RGB -> YUV
+
+static int TestRGBToY(void) {
+  WebPConvertRGBToYFunc convert[2];
+  uint8_t src[4 * MAX_PIXELS];
+  uint8_t ref[MAX_PIXELS + 1], out[MAX_PIXELS + 1];
+  int i, n, step, size;
+  for (i = 0; i < 2; ++i) {
+    InitDsp(WebPInitConvertRGBToYUV, i);
+    convert[i] = WebPConvertRGBToY;
+  }
+  for (n = 0; n < 20; ++n) {
+    for (step = 3; step <= 4; ++step) {
+      for (size = 0; size <= MAX_PIXELS; ++size) {
+        for (i = 0; i < step * size; ++i) src[i] = RandomByte();
+        for (i = 0; i < 2; ++i) {   // RGB and BGR orders
+          const uint8_t* const r = src + 2 * i;
+          const uint8_t* const b = src + 2 - 2 * i;
+          memset(ref, 0xa5, sizeof(ref));
+          memset(out, 0xa5, sizeof(out));
+          convert[0](r, src + 1, b, step, ref + 1, size);
+          convert[1](r, src + 1, b, step, out + 1, size);
+          if (!CheckSame("rgb to y", size, ref, out, sizeof(ref))) return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+static int TestRGBToUV(void) {
+  WebPConvertRGBToUVFunc convert[2];
+  uint16_t rgb[3][MAX_PIXELS];
+  uint8_t ref_u[MAX_PIXELS + 1], out_u[MAX_PIXELS + 1];
+  uint8_t ref_v[MAX_PIXELS + 1], out_v[MAX_PIXELS + 1];
+  int i, k, n, size;
+  for (i = 0; i < 2; ++i) {
+    InitDsp(WebPInitConvertRGBToYUV, i);
+    convert[i] = WebPConvertRGBToUV;
+  }
+  for (n = 0; n < 20; ++n) {
+    for (size = 0; size <= MAX_PIXELS; ++size) {
+      // Sums of four samples, in [0..1020].
+      for (k = 0; k < 3; ++k) {
+        for (i = 0; i < size; ++i) {
+          rgb[k][i] = RandomByte() + RandomByte() + RandomByte() + RandomByte();
+        }
+      }
+      memset(ref_u, 0xa5, sizeof(ref_u));
+      memset(out_u, 0xa5, sizeof(out_u));
+      memset(ref_v, 0x5a, sizeof(ref_v));
+      memset(out_v, 0x5a, sizeof(out_v));
+      convert[0](rgb[0], rgb[1], rgb[2], ref_u + 1, ref_v + 1, size);
+      convert[1](rgb[0], rgb[1], rgb[2], out_u + 1, out_v + 1, size);
+      if (!CheckSame("rgb to u", size, ref_u, out_u, sizeof(ref_u)) ||
+          !CheckSame("rgb to v", size, ref_v, out_v, sizeof(ref_v))) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+#undef MAX_PIXELS
+
+//------------------------------------------------------------------------------
+// Rescaler
+
+// Rescales the whole 'src' picture into 'dst' with the current dsp functions,
+// the way the decoder and WebPPictureRescale() do.
+static int Rescale(const uint8_t* const src, int src_width, int src_height,
+                   uint8_t* const dst, int dst_width, int dst_height,
+                   int num_channels) {
+  const int src_stride = src_width * num_channels;
+  const int dst_stride = dst_width * num_channels;
+  int32_t* const work = (int32_t*)calloc(2 * dst_stride, sizeof(*work));
+  WebPRescaler rescaler;
+  int y = 0;
+  if (work == NULL) return 0;
+  WebPRescalerInit(&rescaler, src_width, src_height,
+                   dst, dst_width, dst_height, dst_stride, num_channels,
+                   src_width, dst_width, src_height, dst_height, work);
+  while (y < src_height) {
+    y += WebPRescalerImport(&rescaler, src_height - y,
+                            src + y * src_stride, src_stride);
+    WebPRescalerExport(&rescaler);
+  }
+  free(work);
+  return 1;
+}
+
+static int TestRescaler(void) {
+  // Strong downscales, to exercise the large accumulated sums.
+  static const int kSizes[][4] = {
+    { 600, 3, 5, 1 }, { 3, 500, 17, 301 }, { 1, 1, 64, 64 }, { 64, 64, 1, 1 }
+  };
+  const int num_sizes = (int)(sizeof(kSizes) / sizeof(kSizes[0]));
+  int n;
+  for (n = 0; n < 200; ++n) {
+    const int num_channels = (n & 1) ? 4 : 1;
+    const int src_width = (n < num_sizes) ? kSizes[n][0]
+                                          : 1 + (int)(Random32() % 90);
+    const int src_height = (n < num_sizes) ? kSizes[n][1]
+                                           : 1 + (int)(Random32() % 40);
+    const int dst_width = (n < num_sizes) ? kSizes[n][2]
+                                          : 1 + (int)(Random32() % 180);
+    const int dst_height = (n < num_sizes) ? kSizes[n][3]
+                                           : 1 + (int)(Random32() % 80);
+    const int src_size = src_width * src_height * num_channels;
+    const int dst_size = dst_width * dst_height * num_channels;
+    uint8_t* const src = (uint8_t*)malloc(src_size);
+    uint8_t* const ref = (uint8_t*)malloc(dst_size);
+    uint8_t* const out = (uint8_t*)malloc(dst_size);
+    int ok = (src != NULL && ref != NULL && out != NULL);
+    int i;
+    for (i = 0; ok && i < src_size; ++i) src[i] = RandomByte();
+    if (ok) {
+      memset(ref, 0xa5, dst_size);
+      memset(out, 0x5a, dst_size);
+      InitDsp(WebPRescalerDspInit, 0);
+      ok = Rescale(src, src_width, src_height, ref, dst_width, dst_height,
+                   num_channels);
+      InitDsp(WebPRescalerDspInit, 1);
+      ok = ok && Rescale(src, src_width, src_height, out,
+                         dst_width, dst_height, num_channels);
+      if (ok && memcmp(ref, out, dst_size)) {
+        fprintf(stderr, "rescaler: mismatch for %dx%d -> %dx%d (%d channels)\n",
+                src_width, src_height, dst_width, dst_height, num_channels);
+        ok = 0;
+      }
+    }
+    free(src);
+    free(ref);
+    free(out);
+    if (!ok) return 0;
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Alpha blending
+
+// Random pixels in 4-byte RGBA order. With 'mostly_opaque', runs of opaque
+// and transparent pixels are frequent, to exercise the SIMD shortcuts.
+static void RandomRGBA(uint8_t* const rgba, int num_pixels, int mostly_opaque,
+                       int premultiplied) {
+  int i, k;
+  for (i = 0; i < num_pixels; ++i) {
+    uint8_t* const p = rgba + 4 * i;
+    const uint32_t r = Random32();
+    p[3] = (mostly_opaque && (r & 3) != 0) ? ((r & 4) ? 0xff : 0x00)
+                                           : RandomByte();
+    for (k = 0; k < 3; ++k) {
+      p[k] = premultiplied ? (uint8_t)(RandomByte() * p[3] / 255)
+                           : RandomByte();
+    }
+  }
+}
+
+#define MAX_BLEND_PIXELS 35
+
+static int TestBlend(void) {
+  WebPBlendPixelRowFunc blend[2][2];   // [premultiplied][simd]
+  uint8_t src[4 * MAX_BLEND_PIXELS + 4];
+  uint8_t dst[4 * MAX_BLEND_PIXELS];
+  uint8_t ref[4 * MAX_BLEND_PIXELS + 4], out[4 * MAX_BLEND_PIXELS + 4];
+  int i, n, premult, size;
+  for (i = 0; i < 2; ++i) {
+    InitDsp(WebPInitAlphaBlending, i);
+    blend[0][i] = WebPBlendPixelRowNonPremult;
+    blend[1][i] = WebPBlendPixelRowPremult;
+  }
+  for (n = 0; n < 200; ++n) {
+    for (premult = 0; premult < 2; ++premult) {
+      for (size = 0; size <= MAX_BLEND_PIXELS; ++size) {
+        RandomRGBA(src, size, n & 1, premult);
+        RandomRGBA(dst, size, 0, premult);
+        memset(src + 4 * size, 0xa5, 4);   // canary
+        memcpy(ref, src, sizeof(src));
+        memcpy(out, src, sizeof(src));
+        blend[premult][0](ref, dst, size);
+        blend[premult][1](out, dst, size);
+        if (!CheckSame(premult ? "blend premultiplied" : "blend", size,
+                       ref, out, 4 * size + 4)) {
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+#undef MAX_BLEND_PIXELS
+
+//------------------------------------------------------------------------------
+// Alpha filters
+
+#define MAX_FILTER_WIDTH 37
+#define MAX_FILTER_HEIGHT 9
+#define FILTER_STRIDE (MAX_FILTER_WIDTH + 3)
+#define FILTER_SIZE (FILTER_STRIDE * MAX_FILTER_HEIGHT)
+
+// Random alpha plane, with smooth and noisy areas so that the gradient
+// predictor is clipped on both sides.
+static void RandomAlpha(uint8_t* const alpha, int size) {
+  int i;
+  int v = RandomByte();
+  for (i = 0; i < size; ++i) {
+    const uint32_t r = Random32();
+    v = (r & 1) ? RandomByte() : (v + (int)(r >> 8 & 7) - 3) & 0xff;
+    alpha[i] = (uint8_t)v;
+  }
+}
+
+static int TestFilters(void) {
+  WebPFilterFunc filter[WEBP_FILTER_LAST][2];
+  WebPUnfilterFunc unfilter[WEBP_FILTER_LAST][2];
+  uint8_t src[FILTER_SIZE];
+  uint8_t ref[FILTER_SIZE], out[FILTER_SIZE];
+  int i, n, f, width, height;
+  for (i = 0; i < 2; ++i) {
+    InitDsp(VP8FiltersInit, i);
+    for (f = WEBP_FILTER_HORIZONTAL; f < WEBP_FILTER_LAST; ++f) {
+      filter[f][i] = WebPFilters[f];
+      unfilter[f][i] = WebPUnfilters[f];
+    }
+  }
+  for (n = 0; n < 10; ++n) {
+    for (f = WEBP_FILTER_HORIZONTAL; f < WEBP_FILTER_LAST; ++f) {
+      for (width = 1; width <= MAX_FILTER_WIDTH; ++width) {
+        for (height = 1; height <= MAX_FILTER_HEIGHT; ++height) {
+          const int stride = width + (n % 4);
+          int row, num_rows;
+          RandomAlpha(src, sizeof(src));
+          memset(ref, 0xa5, sizeof(ref));
+          memset(out, 0xa5, sizeof(out));
+          filter[f][0](src, width, height, stride, ref);
+          filter[f][1](src, width, height, stride, out);
+          if (!CheckSame("filter", width, ref, out, sizeof(ref))) return 0;
+          // In-place reconstruction, by bands of random heights.
+          for (row = 0; row < height; row += num_rows) {
+            num_rows = 1 + (int)(Random32() % (height - row));
+            unfilter[f][0](width, height, stride, row, num_rows, ref);
+            unfilter[f][1](width, height, stride, row, num_rows, out);
+          }
+          if (!CheckSame("unfilter", width, ref, out, sizeof(ref))) return 0;
+          for (row = 0; row < height; ++row) {
+            if (memcmp(out + row * stride, src + row * stride, width)) {
+              fprintf(stderr, "unfilter: no round trip for %dx%d, filter "
+                      "%d\n", width, height, f);
+              return 0;
+            }
+          }
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+#undef FILTER_SIZE
+#undef FILTER_STRIDE
+#undef MAX_FILTER_HEIGHT
+#undef MAX_FILTER_WIDTH
+
+//------------------------------------------------------------------------------
+// Residual cost
+
+// Mostly small levels, with some large ones up to MAX_LEVEL and a random run
+// of trailing zeros.
+static void RandomCoeffs(int16_t coeffs[16]) {
+  const int num_zeros = (int)(Random32() % 17);
+  int i;
+  for (i = 0; i < 16; ++i) {
+    const uint32_t r = Random32();
+    int v;
+    switch (r & 3) {
+      case 0: v = 0; break;
+      case 1: v = 1; break;
+      case 2: v = (int)((r >> 8) % (MAX_VARIABLE_LEVEL + 16)); break;
+      default: v = (int)((r >> 8) % (MAX_LEVEL + 1)); break;
+    }
+    if (i >= 16 - num_zeros) v = 0;
+    coeffs[i] = (int16_t)((r & 4) ? -v : v);
+  }
+}
+
+static int TestResidualCost(void) {
+  static VP8Proba proba;
+  VP8SetResidualCoeffsFunc set_coeffs[2];
+  VP8GetResidualCostFunc get_cost[2];
+  int16_t coeffs[16];
+  int i, n, type, ctx0;
+  for (i = 0; i < 2; ++i) {
+    InitDsp(VP8EncDspInit, i);
+    set_coeffs[i] = VP8SetResidualCoeffs;
+    get_cost[i] = VP8GetResidualCost;
+  }
+  for (n = 0; n < 100; ++n) {
+    uint8_t* const probas = &proba.coeffs_[0][0][0][0];
+    for (i = 0; i < (int)sizeof(proba.coeffs_); ++i) probas[i] = RandomByte();
+    proba.dirty_ = 1;
+    VP8CalculateLevelCosts(&proba);
+    for (i = 0; i < 100; ++i) {
+      RandomCoeffs(coeffs);
+      for (type = 0; type < NUM_TYPES; ++type) {
+        for (ctx0 = 0; ctx0 < NUM_CTX; ++ctx0) {
+          VP8Residual res[2];
+          int k, cost[2];
+          for (k = 0; k < 2; ++k) {
+            memset(&res[k], 0, sizeof(res[k]));
+            res[k].first = (type == 0) ? 1 : 0;
+            res[k].coeff_type = type;
+            res[k].prob = proba.coeffs_[type];
+            res[k].costs = proba.remapped_costs_[type];
+            set_coeffs[k](coeffs, &res[k]);
+            cost[k] = get_cost[k](ctx0, &res[k]);
+          }
+          if (res[0].last != res[1].last || cost[0] != cost[1]) {
+            fprintf(stderr, "residual cost: mismatch for type %d, context %d "
+                    "(last %d / %d, cost %d / %d)\n", type, ctx0,
+                    res[0].last, res[1].last, cost[0], cost[1]);
+            return 0;
+          }
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+
+typedef struct {
+  const char* name;
+  int (*test)(void);
+} DspTest;
+
+static const DspTest kTests[] = {
+  { "lossless predictors", TestLosslessPredictors },
+  { "lossless transforms", TestLosslessTransforms },
+  { "lossless converters", TestLosslessConverters },
+  { "lossless add vector", TestLosslessAddVector },
+  { "lossless search threads", TestLosslessSearchThreads },
+  { "rgb to y", TestRGBToY },
+  { "rgb to uv", TestRGBToUV },
+  { "rescaler", TestRescaler },
+  { "blend", TestBlend },
+  { "alpha filters", TestFilters },
+  { "residual cost", TestResidualCost }
+};
+
+int main(int argc, const char* argv[]) {
+  const int num_tests = (int)(sizeof(kTests) / sizeof(kTests[0]));
+  const char* simd = "none";
+  int num_failed = 0;
+  int i;
+
+  if (argc > 1) seed = (uint32_t)strtoul(argv[1], NULL, 0) | 1;
+  cpu_info = VP8GetCPUInfo;
+  if (cpu_info != NULL) {
+    if (cpu_info(kSSE2)) simd = "SSE2";
+    if (cpu_info(kNEON)) simd = "NEON";
+  }
+  printf("Comparing C and SIMD (%s) dsp functions.\n", simd);
+
+  for (i = 0; i < num_tests; ++i) {
+    const int ok = kTests[i].test();
+    printf("%-28s %s\n", kTests[i].name, ok ? "OK" : "FAILED");
+    if (!ok) ++num_failed;
+  }
+  VP8GetCPUInfo = cpu_info;
+  return (num_failed == 0) ? 0 : 1;
+}
@@ -558,10 +558,15 @@ static void Help(void) {
          "  -nodither .... disable dithering.\n"
          "  -dither <d> .. dithering strength (in 0..100)\n"
          "  -mt .......... use multi-threading\n"
+         "  -threads <n> . use multi-threading, with up to <n> threads\n"
+         "                 parsing the token partitions of lossy images\n"
          "  -crop <x> <y> <w> <h> ... crop output with the given rectangle\n"
          "  -scale <w> <h> .......... scale the output (*after* any cropping)\n"
+         "  -fastscale ... faster, approximate downscaling of lossy pictures\n"
          "  -alpha ....... only save the alpha plane.\n"
          "  -incremental . use incremental decoding (useful for tests)\n"
+         "  -bench <n> ... decode <n> times and report the average time\n"
+         "                 (with -scale, also compared to no scaling)\n"
          "  -h     ....... this help message.\n"
          "  -v     ....... verbose (e.g. print encoding/decoding times)\n"
 #ifndef WEBP_DLL
@@ -570,6 +575,67 @@ static void Help(void) {
         );
 }
 
+// Decodes the picture 'num_loops' times with 'config' and sets 'time' to the
+// average decoding time, in seconds.
+static VP8StatusCode TimeDecode(const uint8_t* const data, size_t data_size,
+                                WebPDecoderConfig* const config, int num_loops,
+                                double* const time) {
+  VP8StatusCode status = VP8_STATUS_OK;
+  double total_time = 0.;
+  int n;
+  for (n = 0; n < num_loops && status == VP8_STATUS_OK; ++n) {
+    Stopwatch stop_watch;
+    WebPFreeDecBuffer(&config->output);   // keep only the last picture
+    StopwatchReset(&stop_watch);
+    status = WebPDecode(data, data_size, config);
+    total_time += StopwatchReadAndReset(&stop_watch);
+  }
+  *time = total_time / num_loops;
+  return status;
+}
+
+// Decodes the picture 'num_loops' times and reports the average timing. When
+// scaling, the throughput of the scaled decoding is also given in input pixels,
+// and compared to the decoding of the same area without scaling. The rescaler
+// can't be timed on its own from here: the difference also includes the
+// upsampling and color conversion, done at the output size instead of the
+// input one.
+static VP8StatusCode BenchmarkDecode(const uint8_t* const data,
+                                     size_t data_size,
+                                     WebPDecoderConfig* const config,
+                                     int num_loops) {
+  const WebPDecoderOptions* const options = &config->options;
+  const WebPDecBuffer* const output = &config->output;
+  double time, unscaled_time = 0.;
+  VP8StatusCode status = VP8_STATUS_OK;
+  if (options->use_scaling) {
+    WebPDecoderConfig unscaled = *config;
+    unscaled.options.use_scaling = 0;
+    status = TimeDecode(data, data_size, &unscaled, num_loops, &unscaled_time);
+    WebPFreeDecBuffer(&unscaled.output);
+  }
+  if (status == VP8_STATUS_OK) {
+    status = TimeDecode(data, data_size, config, num_loops, &time);
+  }
+  if (status == VP8_STATUS_OK) {
+    const double out_pixels = (double)output->width * output->height;
+    fprintf(stderr, "Decoded %d times: %.3f ms per picture (%.2f MPix/s)\n",
+            num_loops, 1000. * time, out_pixels / time / 1e6);
+    if (options->use_scaling) {
+      const int in_width = options->use_cropping ? options->crop_width
+                                                 : config->input.width;
+      const int in_height = options->use_cropping ? options->crop_height
+                                                  : config->input.height;
+      fprintf(stderr, "Scaled decoding %d x %d -> %d x %d: %.2f MPix/s input, "
+              "%+.3f ms per picture vs. no scaling\n",
+              in_width, in_height, output->width, output->height,
+              (double)in_width * in_height / time / 1e6,
+              1000. * (time - unscaled_time));
+    }
+  }
+  return status;
+}
+
 static const char* const kStatusMessages[] = {
   "OK", "OUT_OF_MEMORY", "INVALID_PARAM", "BITSTREAM_ERROR",
   "UNSUPPORTED_FEATURE", "SUSPENDED", "USER_ABORT", "NOT_ENOUGH_DATA"
@@ -589,6 +655,7 @@ int main(int argc, const char *argv[]) {
   WebPBitstreamFeatures* const bitstream = &config.input;
   OutputFileFormat format = PNG;
   int incremental = 0;
+  int bench_loops = 0;
   int c;
 
   if (!WebPInitDecoderConfig(&config)) {
@@ -627,6 +694,9 @@ int main(int argc, const char *argv[]) {
       format = YUV;
     } else if (!strcmp(argv[c], "-mt")) {
       config.options.use_threads = 1;
+    } else if (!strcmp(argv[c], "-threads") && c < argc - 1) {
+      config.options.use_threads = 1;
+      config.options.num_threads = strtol(argv[++c], NULL, 0);
     } else if (!strcmp(argv[c], "-nodither")) {
       config.options.dithering_strength = 0;
     } else if (!strcmp(argv[c], "-dither") && c < argc - 1) {
@@ -641,6 +711,8 @@ int main(int argc, const char *argv[]) {
       config.options.use_scaling = 1;
       config.options.scaled_width  = strtol(argv[++c], NULL, 0);
       config.options.scaled_height = strtol(argv[++c], NULL, 0);
+    } else if (!strcmp(argv[c], "-fastscale")) {
+      config.options.use_fast_downscaling = 1;
     } else if (!strcmp(argv[c], "-v")) {
       verbose = 1;
 #ifndef WEBP_DLL
@@ -649,6 +721,8 @@ int main(int argc, const char *argv[]) {
 #endif
     } else if (!strcmp(argv[c], "-incremental")) {
       incremental = 1;
+    } else if (!strcmp(argv[c], "-bench") && c < argc - 1) {
+      bench_loops = strtol(argv[++c], NULL, 0);
     } else if (!strcmp(argv[c], "--")) {
       if (c < argc - 1) in_file = argv[++c];
       break;
@@ -725,7 +799,9 @@ int main(int argc, const char *argv[]) {
     }
 
     // Decoding call.
-    if (!incremental) {
+    if (bench_loops > 0) {
+      status = BenchmarkDecode(data, data_size, &config, bench_loops);
+    } else if (!incremental) {
       status = WebPDecode(data, data_size, &config);
     } else {
       WebPIDecoder* const idec = WebPIDecode(data, data_size, &config);
@@ -0,0 +1,321 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Encoder regression tests, run on synthetic pictures through the public
+//  API: lossless pictures must decode back to the source pixels, and the
+//  encoder must give the same bitstream whichever way it is fed.
+//
+// Usage: enc_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "webp/decode.h"
+#include "webp/encode.h"
+
+//------------------------------------------------------------------------------
+// Helpers
+
+// Encodes the 'width' x 'height' RGBA samples with 'config'. Returns false in
+// case of error. The output must be released with free(writer->mem).
+static int EncodeRGBA(const WebPConfig* const config,
+                      const uint8_t* const rgba, int width, int height,
+                      WebPMemoryWriter* const writer) {
+  WebPPicture pic;
+  int ok;
+  if (!WebPPictureInit(&pic)) return 0;
+  pic.use_argb = config->lossless;
+  pic.width = width;
+  pic.height = height;
+  WebPMemoryWriterInit(writer);
+  pic.writer = WebPMemoryWrite;
+  pic.custom_ptr = writer;
+  ok = WebPPictureImportRGBA(&pic, rgba, width * 4) &&
+       WebPEncode(config, &pic);
+  WebPPictureFree(&pic);
+  if (!ok) {
+    free(writer->mem);
+    writer->mem = NULL;
+  }
+  return ok;
+}
+
+// Same as EncodeRGBA(), but using the incremental encoder with chunks of
+// 'chunk_rows' rows.
+static int EncodeRGBAIncremental(const WebPConfig* const config,
+                                 const uint8_t* const rgba,
+                                 int width, int height, int chunk_rows,
+                                 WebPMemoryWriter* const writer) {
+  WebPPicture pic;
+  WebPIEncoder* ienc;
+  int ok = 0;
+  int y;
+  if (!WebPPictureInit(&pic)) return 0;
+  pic.width = width;
+  pic.height = height;
+  WebPMemoryWriterInit(writer);
+  pic.writer = WebPMemoryWrite;
+  pic.custom_ptr = writer;
+  ienc = WebPINewEncoder(config, &pic);
+  if (ienc != NULL) {
+    ok = 1;
+    for (y = 0; ok && y < height; y += chunk_rows) {
+      const int num_rows =
+          (y + chunk_rows > height) ? height - y : chunk_rows;
+      ok = WebPIEncodeRGBA(ienc, rgba + y * width * 4, width * 4, num_rows);
+    }
+    ok = ok && WebPIEncodeFinish(ienc);
+    WebPIEncoderDelete(ienc);
+  }
+  WebPPictureFree(&pic);
+  if (!ok) {
+    free(writer->mem);
+    writer->mem = NULL;
+  }
+  return ok;
+}
+
+// Encodes 'rgba' losslessly and checks that it decodes back to the same
+// samples.
+static int CheckLosslessRoundTrip(const char* const name,
+                                  const WebPConfig* const config,
+                                  const uint8_t* const rgba,
+                                  int width, int height) {
+  WebPMemoryWriter writer;
+  uint8_t* decoded = NULL;
+  int w, h;
+  int ok = EncodeRGBA(config, rgba, width, height, &writer);
+  if (ok) {
+    decoded = WebPDecodeRGBA(writer.mem, writer.size, &w, &h);
+    ok = (decoded != NULL && w == width && h == height &&
+          !memcmp(decoded, rgba, (size_t)width * height * 4));
+  }
+  if (!ok) {
+    fprintf(stderr, "%s: lossless round trip failed (quality %.0f, "
+            "method %d)\n", name, config->quality, config->method);
+  }
+  free(decoded);
+  free(writer.mem);
+  return ok;
+}
+
+// Fills 'rgba' with smooth gradients and some noise, so that all the lossy
+// coding modes are exercised.
+static void MakePicture(uint8_t* const rgba, int width, int height,
+                        uint32_t seed) {
+  int x, y;
+  for (y = 0; y < height; ++y) {
+    for (x = 0; x < width; ++x) {
+      uint8_t* const dst = rgba + 4 * (y * width + x);
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      dst[0] = (uint8_t)(x * 3 + y + (seed & 15));
+      dst[1] = (uint8_t)(((x / 8 + y / 8) & 1) ? 200 : 40 + (seed >> 8 & 7));
+      dst[2] = (uint8_t)(y * 2 - x + (seed >> 16 & 31));
+      dst[3] = 0xff;
+    }
+  }
+}
+
+// Returns true if both encodings succeed and give the same bitstream, which
+// must also be decodable.
+static int CheckSameEncoding(const char* const name,
+                             const WebPConfig* const config1,
+                             const WebPConfig* const config2,
+                             const uint8_t* const rgba,
+                             int width, int height) {
+  WebPMemoryWriter out1, out2;
+  int w, h;
+  int ok = EncodeRGBA(config1, rgba, width, height, &out1);
+  if (ok) {
+    ok = EncodeRGBA(config2, rgba, width, height, &out2);
+    if (ok) {
+      uint8_t* decoded;
+      ok = (out1.size == out2.size && !memcmp(out1.mem, out2.mem, out1.size));
+      decoded = ok ? WebPDecodeRGBA(out1.mem, out1.size, &w, &h) : NULL;
+      ok = (decoded != NULL && w == width && h == height);
+      free(decoded);
+      free(out2.mem);
+    }
+    free(out1.mem);
+  }
+  if (!ok) {
+    fprintf(stderr, "%s: %dx%d encodings differ (method %d)\n",
+            name, width, height, config1->method);
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Lossy
+
+// The token partitions are coded in parallel with 'thread_level'.
+static int TestLossyPartitionThreads(void) {
+  const int width = 203, height = 171;
+  uint8_t* const rgba = (uint8_t*)malloc(width * height * 4);
+  int ok = (rgba != NULL);
+  int method, parts;
+  if (ok) MakePicture(rgba, width, height, 0x1234u);
+  for (method = 0; ok && method <= 6; method += 2) {
+    for (parts = 0; ok && parts <= 3; ++parts) {
+      WebPConfig config1, config2;
+      ok = WebPConfigInit(&config1);
+      config1.method = method;
+      config1.partitions = parts;
+      config2 = config1;
+      config2.thread_level = 1;
+      ok = ok && CheckSameEncoding("partitions", &config1, &config2,
+                                   rgba, width, height);
+    }
+  }
+  free(rgba);
+  return ok;
+}
+
+// Narrow and tall pictures don't have enough macroblocks in their first rows
+// for the fast probe of methods 0 and 3. The output must not depend on how
+// the rows are fed.
+static int TestLossyIncrementalChunks(void) {
+  static const int kWidths[2] = { 37, 48 };
+  static const int kChunkRows[5] = { 1, 7, 16, 33, 255 };
+  const int height = 1500;
+  uint8_t* const rgba = (uint8_t*)malloc(48 * height * 4);
+  int ok = (rgba != NULL);
+  int i, k, method;
+  for (i = 0; ok && i < 2; ++i) {
+    const int width = kWidths[i];
+    MakePicture(rgba, width, height, 0x4321u + i);
+    for (method = 0; ok && method <= 3; method += 3) {
+      WebPConfig config;
+      WebPMemoryWriter ref;
+      ok = WebPConfigInit(&config);
+      config.method = method;
+      ok = ok && EncodeRGBAIncremental(&config, rgba, width, height, height,
+                                       &ref);
+      for (k = 0; ok && k < 5; ++k) {
+        WebPMemoryWriter out;
+        ok = EncodeRGBAIncremental(&config, rgba, width, height,
+                                   kChunkRows[k], &out);
+        ok = ok && out.size == ref.size &&
+             !memcmp(out.mem, ref.mem, ref.size);
+        if (!ok) {
+          fprintf(stderr, "incremental: %dx%d, %d-row chunks differ "
+                  "(method %d)\n", width, height, kChunkRows[k], method);
+        }
+        free(out.mem);
+      }
+      if (ok) {
+        int w, h;
+        uint8_t* const decoded = WebPDecodeRGBA(ref.mem, ref.size, &w, &h);
+        ok = (decoded != NULL && w == width && h == height);
+        free(decoded);
+      }
+      free(ref.mem);
+    }
+  }
+  free(rgba);
+  return ok;
+}
+
+// Pictures with fewer macroblocks than the fast probes of methods 0 and 3,
+// with and without the token buffer and the size search, must still encode.
+static int TestLossySmallPictures(void) {
+  static const int kSizes[3][2] = { { 1, 1 }, { 33, 17 }, { 16, 16 } };
+  uint8_t* const rgba = (uint8_t*)malloc(33 * 17 * 4);
+  int ok = (rgba != NULL);
+  int i, k;
+  for (i = 0; ok && i < 3; ++i) {
+    const int width = kSizes[i][0], height = kSizes[i][1];
+    MakePicture(rgba, width, height, 0x5678u + i);
+    for (k = 0; ok && k < 6; ++k) {
+      WebPConfig config;
+      WebPMemoryWriter out;
+      ok = WebPConfigInit(&config);
+      config.method = (k & 1) ? 3 : 0;
+      config.low_memory = (k >> 1) & 1;
+      if (k >= 4) {   // size search
+        config.target_size = 100;
+        config.pass = 6;
+      }
+      ok = ok && EncodeRGBA(&config, rgba, width, height, &out);
+      if (ok) {
+        int w, h;
+        uint8_t* const decoded = WebPDecodeRGBA(out.mem, out.size, &w, &h);
+        ok = (decoded != NULL && w == width && h == height);
+        free(decoded);
+        free(out.mem);
+      }
+      if (!ok) {
+        fprintf(stderr, "small pictures: %dx%d failed (method %d, "
+                "low_memory %d, target_size %d)\n", width, height,
+                config.method, config.low_memory, config.target_size);
+      }
+    }
+  }
+  free(rgba);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Lossless
+
+// A short periodic pattern followed by a long run: the long copy of the run
+// is skipped over by the cost search, which must still fill the costs of the
+// pixels that follow it.
+static int TestLosslessLongCopy(void) {
+  const int width = 3000 + 8190;
+  uint8_t* const rgba = (uint8_t*)calloc(width * 4, 1);
+  int ok = (rgba != NULL);
+  int x, q;
+  for (x = 0; ok && x < width; ++x) {
+    if (x < 3000) {
+      rgba[4 * x + 0] = (x % 7) * 30;
+      rgba[4 * x + 1] = (x % 5) * 50;
+      rgba[4 * x + 2] = (x % 3) * 80;
+    }
+    rgba[4 * x + 3] = 0xff;
+  }
+  for (q = 0; ok && q <= 100; q += 25) {
+    WebPConfig config;
+    ok = WebPConfigInit(&config);
+    config.lossless = 1;
+    config.quality = (float)q;
+    ok = ok && CheckLosslessRoundTrip("long copy", &config, rgba, width, 1);
+  }
+  free(rgba);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+
+typedef struct {
+  const char* name;
+  int (*test)(void);
+} EncTest;
+
+static const EncTest kTests[] = {
+  { "lossy partition threads", TestLossyPartitionThreads },
+  { "lossy incremental chunks", TestLossyIncrementalChunks },
+  { "lossy small pictures", TestLossySmallPictures },
+  { "lossless long copy", TestLosslessLongCopy }
+};
+
+int main(void) {
+  const int num_tests = (int)(sizeof(kTests) / sizeof(kTests[0]));
+  int num_failed = 0;
+  int i;
+  for (i = 0; i < num_tests; ++i) {
+    const int ok = kTests[i].test();
+    printf("%-28s %s\n", kTests[i].name, ok ? "OK" : "FAILED");
+    if (!ok) ++num_failed;
+  }
+  return (num_failed == 0) ? 0 : 1;
+}
@@ -411,7 +411,8 @@ int main(int argc, const char *argv[]) {
   if (!WebPPictureAlloc(&frame)) goto End;
 
   // Initialize cache
-  cache = WebPFrameCacheNew(frame.width, frame.height, kmin, kmax, allow_mixed);
+  cache = WebPFrameCacheNew(frame.width, frame.height, kmin, kmax, allow_mixed,
+                            config.thread_level > 0);
   if (cache == NULL) goto End;
 
   mux = WebPMuxNew();
@@ -14,10 +14,12 @@
 #include <stdio.h>
 
 #include "webp/encode.h"
+#include "utils/thread.h"
 #include "./gif2webp_util.h"
 
 #define DELTA_INFINITY      1ULL << 32
 #define KEYFRAME_NONE       -1
+#define MAX_WORKERS         16
 
 //------------------------------------------------------------------------------
 // Helper utilities.
@@ -234,18 +236,51 @@ static void ConvertToKeyFrame(const WebPPicture* const prev,
 //------------------------------------------------------------------------------
 // Encoded frame.
 
+// Copy of the pixels of a frame candidate, waiting to be compressed. Both
+// lossless and lossy compression may be tried, on slightly different pixels.
+typedef struct {
+  int try_lossless;
+  int try_lossy;
+  WebPPicture lossless_pic;
+  WebPPicture lossy_pic;
+} FramePixels;
+
+typedef enum {
+  FRAME_KEY,         // Encoded as a key frame only.
+  FRAME_SUB,         // Encoded as a frame rectangle only.
+  FRAME_CANDIDATES   // Both encoded; one of the two will be chosen later.
+} FrameType;
+
 // Used to store two candidates of encoded data for an animation frame. One of
 // the two will be chosen later.
 typedef struct {
   WebPMuxFrameInfo sub_frame;  // Encoded frame rectangle.
   WebPMuxFrameInfo key_frame;  // Encoded frame if it was converted to keyframe.
+
+  FrameType type;
+  int is_last_candidate;       // True if the frame is 'kmax' frames away from
+                               // the previous key frame.
+  // Compression job, run by one of the workers.
+  WebPConfig config;
+  FramePixels sub_pixels;      // Pixels of 'sub_frame' to compress.
+  FramePixels key_pixels;      // Pixels of 'key_frame' to compress.
+  int is_encoded;              // True once the job is over.
+  int encode_ok;               // False if the compression failed.
 } EncodedFrame;
 
+static void FramePixelsRelease(FramePixels* const pixels) {
+  WebPPictureFree(&pixels->lossless_pic);
+  WebPPictureFree(&pixels->lossy_pic);
+  memset(pixels, 0, sizeof(*pixels));
+}
+
 // Release the data contained by 'encoded_frame'.
 static void FrameRelease(EncodedFrame* const encoded_frame) {
   if (encoded_frame != NULL) {
     WebPDataClear(&encoded_frame->sub_frame.bitstream);
     WebPDataClear(&encoded_frame->key_frame.bitstream);
+    FramePixelsRelease(&encoded_frame->sub_pixels);
+    FramePixelsRelease(&encoded_frame->key_pixels);
     memset(encoded_frame, 0, sizeof(*encoded_frame));
   }
 }
@@ -254,11 +289,16 @@ static void FrameRelease(EncodedFrame* const encoded_frame) {
 // Frame cache.
 
 // Used to store encoded frames that haven't been output yet.
+// The frames are analyzed in order by the caller's thread, and their
+// compression is then handed to a pool of workers. Once compressed, they are
+// considered again in order to pick the key frames and flush them.
 struct WebPFrameCache {
-  EncodedFrame* encoded_frames;  // Array of encoded frames.
+  EncodedFrame* encoded_frames;  // Circular buffer of encoded frames.
   size_t size;               // Number of allocated data elements.
   size_t start;              // Start index.
   size_t count;              // Number of valid data elements.
+  size_t num_pending;        // Number of frames after the 'count' ones, that
+                             // are waiting for their compression to be over.
   int flush_count;           // If >0, ‘flush_count’ frames starting from
                              // 'start' are ready to be added to mux.
   int64_t best_delta;        // min(canvas size - frame size) over the frames.
@@ -274,12 +314,16 @@ struct WebPFrameCache {
   WebPPicture curr_canvas;   // Current canvas (temporary buffer).
   int is_first_frame;        // True if no frames have been added to the cache
                              // since WebPFrameCacheNew().
+
+  WebPWorker workers[MAX_WORKERS];
+  int num_workers;
+  int use_threads;           // If false, the jobs are run synchronously.
+  int next_worker;           // Worker for the next job, in round-robin.
 };
 
 // Reset the counters in the cache struct. Doesn't touch 'cache->encoded_frames'
-// and 'cache->size'.
+// and 'cache->size', nor the pending frames.
 static void CacheReset(WebPFrameCache* const cache) {
-  cache->start = 0;
   cache->count = 0;
   cache->flush_count = 0;
   cache->best_delta = DELTA_INFINITY;
@@ -287,12 +331,17 @@ static void CacheReset(WebPFrameCache* const cache) {
 }
 
 WebPFrameCache* WebPFrameCacheNew(int width, int height,
-                                  size_t kmin, size_t kmax, int allow_mixed) {
+                                  size_t kmin, size_t kmax, int allow_mixed,
+                                  int use_threads) {
+  int i;
   WebPFrameCache* cache = (WebPFrameCache*)malloc(sizeof(*cache));
   if (cache == NULL) return NULL;
   CacheReset(cache);
+  cache->start = 0;
+  cache->num_pending = 0;
   // sanity init, so we can call WebPFrameCacheDelete():
   cache->encoded_frames = NULL;
+  cache->num_workers = 0;
 
   cache->is_first_frame = 1;
 
@@ -315,8 +364,27 @@ WebPFrameCache* WebPFrameCacheNew(int width, int height,
   cache->kmin = kmin;
   cache->kmax = kmax;
   cache->count_since_key_frame = 0;
+
+  // Workers. Each one compresses a frame while the next ones are analyzed.
+  // When several frames are compressed in parallel, the encoder itself is
+  // kept single-threaded.
+  cache->use_threads = use_threads;
+  cache->num_workers = use_threads ? WebPGetNumCores() : 1;
+  if (cache->num_workers > MAX_WORKERS) cache->num_workers = MAX_WORKERS;
+  cache->next_worker = 0;
+  for (i = 0; i < cache->num_workers; ++i) {
+    WebPWorkerInit(&cache->workers[i]);
+    if (use_threads && !WebPWorkerReset(&cache->workers[i])) {
+      cache->num_workers = i;
+      goto Err;
+    }
+  }
+
+  // Room for 'kmax - kmin' frames waiting for a key frame to be chosen, plus
+  // the ones being compressed.
   assert(kmax > kmin);
-  cache->size = kmax - kmin;
+  cache->size = kmax - kmin + cache->num_workers;
+  if (cache->size < kmax - kmin) goto Err;   // overflow
   cache->encoded_frames =
       (EncodedFrame*)calloc(cache->size, sizeof(*cache->encoded_frames));
   if (cache->encoded_frames == NULL) goto Err;
@@ -330,8 +398,11 @@ WebPFrameCache* WebPFrameCacheNew(int width, int height,
 
 void WebPFrameCacheDelete(WebPFrameCache* const cache) {
   if (cache != NULL) {
+    size_t i;
+    for (i = 0; i < (size_t)cache->num_workers; ++i) {
+      WebPWorkerEnd(&cache->workers[i]);
+    }
     if (cache->encoded_frames != NULL) {
-      size_t i;
       for (i = 0; i < cache->size; ++i) {
         FrameRelease(&cache->encoded_frames[i]);
       }
@@ -415,44 +486,33 @@ static int GetColorCount(const WebPPicture* const pic) {
 #undef HASH_SIZE
 #undef HASH_RIGHT_SHIFT
 
+// Decides how 'sub_frame' should be compressed and takes a copy of the
+// pixels, so that the compression can be done later on.
 static int SetFrame(const WebPConfig* const config, int allow_mixed,
                     int is_key_frame, const WebPPicture* const prev_canvas,
                     WebPPicture* const frame, const WebPFrameRect* const rect,
                     const WebPMuxFrameInfo* const info,
                     WebPPicture* const sub_frame, EncodedFrame* encoded_frame) {
-  int try_lossless;
-  int try_lossy;
-  int try_both;
-  WebPMemoryWriter mem1, mem2;
-  WebPData* encoded_data;
   WebPMuxFrameInfo* const dst =
       is_key_frame ? &encoded_frame->key_frame : &encoded_frame->sub_frame;
+  FramePixels* const pixels =
+      is_key_frame ? &encoded_frame->key_pixels : &encoded_frame->sub_pixels;
   *dst = *info;
-  encoded_data = &dst->bitstream;
-  WebPMemoryWriterInit(&mem1);
-  WebPMemoryWriterInit(&mem2);
 
   if (!allow_mixed) {
-    try_lossless = config->lossless;
-    try_lossy = !try_lossless;
+    pixels->try_lossless = config->lossless;
+    pixels->try_lossy = !pixels->try_lossless;
   } else {  // Use a heuristic for trying lossless and/or lossy compression.
     const int num_colors = GetColorCount(sub_frame);
-    try_lossless = (num_colors < MAX_COLORS_LOSSLESS);
-    try_lossy = (num_colors >= MIN_COLORS_LOSSY);
+    pixels->try_lossless = (num_colors < MAX_COLORS_LOSSLESS);
+    pixels->try_lossy = (num_colors >= MIN_COLORS_LOSSY);
   }
-  try_both = try_lossless && try_lossy;
 
-  if (try_lossless) {
-    WebPConfig config_ll = *config;
-    config_ll.lossless = 1;
-    if (!EncodeFrame(&config_ll, sub_frame, &mem1)) {
-      goto Err;
-    }
+  if (pixels->try_lossless) {
+    if (!WebPPictureCopy(sub_frame, &pixels->lossless_pic)) return 0;
   }
 
-  if (try_lossy) {
-    WebPConfig config_lossy = *config;
-    config_lossy.lossless = 0;
+  if (pixels->try_lossy) {
     if (!is_key_frame) {
       // For lossy compression of a frame, it's better to replace transparent
       // pixels of 'curr' with actual RGB values, whenever possible.
@@ -460,8 +520,35 @@ static int SetFrame(const WebPConfig* const config, int allow_mixed,
       // TODO(later): Investigate if this helps lossless compression as well.
       FlattenSimilarBlocks(prev_canvas, rect, frame);
     }
-    if (!EncodeFrame(&config_lossy, sub_frame, &mem2)) {
-      goto Err;
+    if (!WebPPictureCopy(sub_frame, &pixels->lossy_pic)) return 0;
+  }
+  return 1;
+}
+
+// Compresses 'pixels' as prepared by SetFrame() and stores the result in
+// 'encoded_data'. The pictures are released.
+static int EncodePixels(const WebPConfig* const config,
+                        FramePixels* const pixels,
+                        WebPData* const encoded_data) {
+  int ok = 0;
+  const int try_both = pixels->try_lossless && pixels->try_lossy;
+  WebPMemoryWriter mem1, mem2;
+  WebPMemoryWriterInit(&mem1);
+  WebPMemoryWriterInit(&mem2);
+
+  if (pixels->try_lossless) {
+    WebPConfig config_ll = *config;
+    config_ll.lossless = 1;
+    if (!EncodeFrame(&config_ll, &pixels->lossless_pic, &mem1)) {
+      goto End;
+    }
+  }
+
+  if (pixels->try_lossy) {
+    WebPConfig config_lossy = *config;
+    config_lossy.lossless = 0;
+    if (!EncodeFrame(&config_lossy, &pixels->lossy_pic, &mem2)) {
+      goto End;
     }
   }
 
@@ -475,15 +562,33 @@ static int SetFrame(const WebPConfig* const config, int allow_mixed,
       free(mem1.mem);
       GetEncodedData(&mem2, encoded_data);
     }
-  } else {
-    GetEncodedData(try_lossless ? &mem1 : &mem2, encoded_data);
+  } else if (pixels->try_lossless) {
+    GetEncodedData(&mem1, encoded_data);
+  } else if (pixels->try_lossy) {
+    GetEncodedData(&mem2, encoded_data);
   }
-  return 1;
+  ok = 1;
 
- Err:
-  free(mem1.mem);
-  free(mem2.mem);
-  return 0;
+ End:
+  if (!ok) {
+    free(mem1.mem);
+    free(mem2.mem);
+  }
+  FramePixelsRelease(pixels);
+  return ok;
+}
+
+// Worker hook: compresses the candidate(s) of a frame.
+static int EncodeFrameJob(void* arg1, void* arg2) {
+  EncodedFrame* const encoded_frame = (EncodedFrame*)arg1;
+  const WebPConfig* const config = &encoded_frame->config;
+  (void)arg2;
+  encoded_frame->encode_ok =
+      EncodePixels(config, &encoded_frame->sub_pixels,
+                   &encoded_frame->sub_frame.bitstream) &&
+      EncodePixels(config, &encoded_frame->key_pixels,
+                   &encoded_frame->key_frame.bitstream);
+  return encoded_frame->encode_ok;
 }
 
 #undef MIN_COLORS_LOSSY
@@ -492,8 +597,8 @@ static int SetFrame(const WebPConfig* const config, int allow_mixed,
 // Returns cached frame at given 'position' index.
 static EncodedFrame* CacheGetFrame(const WebPFrameCache* const cache,
                                    size_t position) {
-  assert(cache->start + position < cache->size);
-  return &cache->encoded_frames[cache->start + position];
+  assert(position < cache->size);
+  return &cache->encoded_frames[(cache->start + position) % cache->size];
 }
 
 // Calculate the penalty incurred if we encode given frame as a key frame
@@ -512,6 +617,17 @@ static void DisposeFrame(WebPMuxAnimDispose dispose_method,
   }
 }
 
+// Waits for the job of 'worker', if any, to be over.
+static void SyncWorker(const WebPFrameCache* const cache,
+                       WebPWorker* const worker) {
+  EncodedFrame* const encoded_frame = (EncodedFrame*)worker->data1;
+  if (encoded_frame != NULL) {
+    if (cache->use_threads) WebPWorkerSync(worker);
+    encoded_frame->is_encoded = 1;
+    worker->data1 = NULL;
+  }
+}
+
 int WebPFrameCacheAddFrame(WebPFrameCache* const cache,
                            const WebPConfig* const config,
                            const WebPFrameRect* const orig_rect,
@@ -521,10 +637,10 @@ int WebPFrameCacheAddFrame(WebPFrameCache* const cache,
   WebPFrameRect rect = *orig_rect;
   WebPPicture sub_image;  // View extracted from 'frame' with rectangle 'rect'.
   WebPPicture* const prev_canvas = &cache->prev_canvas;
-  const size_t position = cache->count;
+  const size_t position = cache->count + cache->num_pending;
   const int allow_mixed = cache->allow_mixed;
+  WebPWorker* const worker = &cache->workers[cache->next_worker];
   EncodedFrame* const encoded_frame = CacheGetFrame(cache, position);
-  assert(position < cache->size);
 
   // Snap to even offsets (and adjust dimensions if needed).
   rect.width += (rect.x_offset & 1);
@@ -539,7 +655,10 @@ int WebPFrameCacheAddFrame(WebPFrameCache* const cache,
   info->x_offset = rect.x_offset;
   info->y_offset = rect.y_offset;
 
-  ++cache->count;
+  encoded_frame->config = *config;
+  if (cache->num_workers > 1) encoded_frame->config.thread_level = 0;
+  encoded_frame->is_encoded = 0;
+  encoded_frame->is_last_candidate = 0;
 
   if (cache->is_first_frame || IsKeyFrame(frame, &rect, prev_canvas)) {
     // Add this as a key frame.
@@ -547,8 +666,7 @@ int WebPFrameCacheAddFrame(WebPFrameCache* const cache,
                   encoded_frame)) {
       goto End;
     }
-    cache->keyframe = position;
-    cache->flush_count = cache->count;
+    encoded_frame->type = FRAME_KEY;
     cache->count_since_key_frame = 0;
     // Update prev_canvas by simply copying from 'curr'.
     CopyPixels(frame, prev_canvas);
@@ -560,14 +678,13 @@ int WebPFrameCacheAddFrame(WebPFrameCache* const cache,
                     &sub_image, encoded_frame)) {
         goto End;
       }
-      cache->flush_count = cache->count;
+      encoded_frame->type = FRAME_SUB;
       // Update prev_canvas by blending 'curr' into it.
       BlendPixels(frame, orig_rect, prev_canvas);
     } else {
       WebPPicture full_image;
       WebPMuxFrameInfo full_image_info;
       int frame_added;
-      int64_t curr_delta;
 
       // Add frame rectangle to cache.
       if (!SetFrame(config, allow_mixed, 0, prev_canvas, frame, &rect, info,
@@ -592,15 +709,10 @@ int WebPFrameCacheAddFrame(WebPFrameCache* const cache,
       WebPPictureFree(&full_image);
       if (!frame_added) goto End;
 
-      // Analyze size difference of the two variants.
-      curr_delta = KeyFramePenalty(encoded_frame);
-      if (curr_delta <= cache->best_delta) {  // Pick this as keyframe.
-        cache->keyframe = position;
-        cache->best_delta = curr_delta;
-        cache->flush_count = cache->count - 1;  // We can flush previous frames.
-      }
+      // The choice between the two is made once they are encoded.
+      encoded_frame->type = FRAME_CANDIDATES;
       if (cache->count_since_key_frame == cache->kmax) {
-        cache->flush_count = cache->count;
+        encoded_frame->is_last_candidate = 1;
         cache->count_since_key_frame = 0;
       }
 
@@ -618,13 +730,55 @@ int WebPFrameCacheAddFrame(WebPFrameCache* const cache,
   WebPPictureFree(&sub_image);
   if (!ok) {
     FrameRelease(encoded_frame);
-    --cache->count;  // We reset the count, as the frame addition failed.
+    return 0;
   }
-  return ok;
+
+  // Hand the compression over to the next worker, once it's available.
+  SyncWorker(cache, worker);
+  worker->hook = EncodeFrameJob;
+  worker->data1 = encoded_frame;
+  worker->data2 = NULL;
+  if (cache->use_threads) {
+    WebPWorkerLaunch(worker);
+  } else {
+    WebPWorkerExecute(worker);
+    SyncWorker(cache, worker);
+  }
+  ++cache->num_pending;
+  cache->next_worker = (cache->next_worker + 1) % cache->num_workers;
+  return 1;
 }
 
-WebPMuxError WebPFrameCacheFlush(WebPFrameCache* const cache, int verbose,
-                                 WebPMux* const mux) {
+// Now that the frame following the 'count' ones is encoded, updates the
+// choice of key frame and the number of frames ready to be flushed.
+static void SelectFrame(WebPFrameCache* const cache) {
+  const size_t position = cache->count;
+  const EncodedFrame* const encoded_frame = CacheGetFrame(cache, position);
+  ++cache->count;
+  --cache->num_pending;
+
+  if (encoded_frame->type == FRAME_KEY) {
+    cache->keyframe = position;
+    cache->flush_count = cache->count;
+  } else if (encoded_frame->type == FRAME_SUB) {
+    cache->flush_count = cache->count;
+  } else {
+    // Analyze size difference of the two variants.
+    const int64_t curr_delta = KeyFramePenalty(encoded_frame);
+    if (curr_delta <= cache->best_delta) {  // Pick this as keyframe.
+      cache->keyframe = position;
+      cache->best_delta = curr_delta;
+      cache->flush_count = cache->count - 1;  // We can flush previous frames.
+    }
+    if (encoded_frame->is_last_candidate) {
+      cache->flush_count = cache->count;
+    }
+  }
+}
+
+// Adds the 'flush_count' first frames to 'mux'.
+static WebPMuxError FlushFrames(WebPFrameCache* const cache, int verbose,
+                                WebPMux* const mux) {
   while (cache->flush_count > 0) {
     WebPMuxFrameInfo* info;
     WebPMuxError err;
@@ -648,7 +802,7 @@ WebPMuxError WebPFrameCacheFlush(WebPFrameCache* const cache, int verbose,
              info->dispose_method, info->blend_method);
     }
     FrameRelease(curr);
-    ++cache->start;
+    cache->start = (cache->start + 1) % cache->size;
     --cache->flush_count;
     --cache->count;
     if (cache->keyframe != KEYFRAME_NONE) --cache->keyframe;
@@ -658,10 +812,31 @@ WebPMuxError WebPFrameCacheFlush(WebPFrameCache* const cache, int verbose,
   return WEBP_MUX_OK;
 }
 
+WebPMuxError WebPFrameCacheFlush(WebPFrameCache* const cache, int verbose,
+                                 WebPMux* const mux) {
+  while (cache->num_pending > 0) {
+    const EncodedFrame* const next = CacheGetFrame(cache, cache->count);
+    WebPMuxError err;
+    if (!next->is_encoded) break;   // Not ready yet.
+    if (!next->encode_ok) return WEBP_MUX_BAD_DATA;
+    SelectFrame(cache);
+    err = FlushFrames(cache, verbose, mux);
+    if (err != WEBP_MUX_OK) return err;
+  }
+  return WEBP_MUX_OK;
+}
+
 WebPMuxError WebPFrameCacheFlushAll(WebPFrameCache* const cache, int verbose,
                                     WebPMux* const mux) {
+  WebPMuxError err;
+  int i;
+  for (i = 0; i < cache->num_workers; ++i) {
+    SyncWorker(cache, &cache->workers[i]);
+  }
+  err = WebPFrameCacheFlush(cache, verbose, mux);
+  if (err != WEBP_MUX_OK) return err;
   cache->flush_count = cache->count;  // Force flushing of all frames.
-  return WebPFrameCacheFlush(cache, verbose, mux);
+  return FlushFrames(cache, verbose, mux);
 }
 
 //------------------------------------------------------------------------------
@@ -46,15 +46,19 @@ typedef struct WebPFrameCache WebPFrameCache;
 // between key frames 'kmax', returns an appropriately allocated cache object.
 // If 'allow_mixed' is true, the subsequent calls to WebPFrameCacheAddFrame()
 // will heuristically pick lossy or lossless compression for each frame.
+// If 'use_threads' is true, frames are compressed in parallel, in background
+// threads (one per core).
 // Use WebPFrameCacheDelete() to deallocate the 'cache'.
 WebPFrameCache* WebPFrameCacheNew(int width, int height,
-                                  size_t kmin, size_t kmax, int allow_mixed);
+                                  size_t kmin, size_t kmax, int allow_mixed,
+                                  int use_threads);
 
 // Release all the frame data from 'cache' and free 'cache'.
 void WebPFrameCacheDelete(WebPFrameCache* const cache);
 
 // Given an image described by 'frame', 'info' and 'orig_rect', optimize it for
-// WebP, encode it and add it to 'cache'.
+// WebP and add it to 'cache'. The encoding itself may still be in progress
+// when the function returns: 'frame' can be modified right away though.
 // This takes care of frame disposal too, according to 'info->dispose_method'.
 int WebPFrameCacheAddFrame(WebPFrameCache* const cache,
                            const WebPConfig* const config,
@@ -63,11 +67,13 @@ int WebPFrameCacheAddFrame(WebPFrameCache* const cache,
                            WebPMuxFrameInfo* const info);
 
 // Flush the *ready* frames from cache and add them to 'mux'. If 'verbose' is
-// true, prints the information about these frames.
+// true, prints the information about these frames. Frames are added in order,
+// and only once they are encoded.
 WebPMuxError WebPFrameCacheFlush(WebPFrameCache* const cache, int verbose,
                                  WebPMux* const mux);
 
-// Similar to 'WebPFrameCacheFlushFrames()', but flushes *all* the frames.
+// Similar to 'WebPFrameCacheFlushFrames()', but flushes *all* the frames,
+// waiting for their encoding to be over.
 WebPMuxError WebPFrameCacheFlushAll(WebPFrameCache* const cache, int verbose,
                                     WebPMux* const mux);
 
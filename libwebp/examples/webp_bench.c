@@ -0,0 +1,422 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Throughput benchmark for the WebP encoder and decoder.
+//
+//  Every input WebP file is decoded once, then re-encoded and decoded back
+//  from memory for each combination of method / lossless / threading given
+//  on the command line. Timings are printed as CSV on stdout, one line per
+//  stage, for easy post-processing.
+//
+// Usage: webp_bench [options] in_file.webp [in_file2.webp ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "webp/decode.h"
+#include "webp/encode.h"
+#include "./example_util.h"
+#include "./stopwatch.h"
+
+#define MAX_VALUES 16    // maximum number of entries in a value list
+
+typedef struct {
+  int values[MAX_VALUES];
+  int size;
+} ValueList;
+
+typedef struct {
+  int num_loops;
+  float quality;
+  ValueList methods;
+  ValueList lossless;
+  ValueList threads;
+  int use_scaling, scaled_width, scaled_height;
+  int use_cropping, crop_left, crop_top, crop_width, crop_height;
+} BenchParams;
+
+// Per-stage timing samples, in seconds.
+typedef struct {
+  double* times;
+  int size;
+} Samples;
+
+//------------------------------------------------------------------------------
+
+static void Help(void) {
+  printf("Usage: webp_bench [options] in_file.webp [in_file2.webp ...]\n\n"
+         "Decodes each input once, then re-encodes and decodes it back from\n"
+         "memory for every combination of the settings below. Results are\n"
+         "printed as CSV (times in milliseconds, throughput in MPix/s).\n\n"
+         "  -n <int> ............ number of iterations per stage (default 10)\n"
+         "  -q <float> .......... quality factor (0:small..100:big)\n"
+         "  -m <list> ........... compression methods, e.g. '0,4,6'\n"
+         "  -lossless <list> .... lossy(0) and/or lossless(1), e.g. '0,1'\n"
+         "  -mt <list> .......... threading off(0) and/or on(1), e.g. '0,1'.\n"
+         "                        Values above 1 also set the number of\n"
+         "                        threads parsing lossy pictures.\n"
+         "  -crop <x> <y> <w> <h> ... also time a cropped decode\n"
+         "  -scale <w> <h> .......... also time a scaled decode\n"
+         "  -h / -help .......... this help message\n"
+         "\n"
+         "Output columns:\n"
+         "  file,stage,method,lossless,threads,width,height,bytes,iterations,\n"
+         "  mps,min_ms,p50_ms,p90_ms,max_ms\n"
+         "'width' and 'height' are the dimensions of the produced picture.\n"
+         "Encoding throughput is given in source pixels.\n"
+        );
+}
+
+// Parses a comma-separated list of integers in [min_value, max_value].
+// Returns false on error.
+static int ParseList(const char* str, int min_value, int max_value,
+                     ValueList* const list) {
+  list->size = 0;
+  while (*str != '\0') {
+    char* end;
+    const long value = strtol(str, &end, 0);
+    if (end == str || value < min_value || value > max_value ||
+        list->size == MAX_VALUES) {
+      return 0;
+    }
+    list->values[list->size++] = (int)value;
+    if (*end == ',') ++end;
+    else if (*end != '\0') return 0;
+    str = end;
+  }
+  return (list->size > 0);
+}
+
+static void SetList(ValueList* const list, int value) {
+  list->values[0] = value;
+  list->size = 1;
+}
+
+//------------------------------------------------------------------------------
+// Statistics
+
+static int CompareTimes(const void* a, const void* b) {
+  const double ta = *(const double*)a;
+  const double tb = *(const double*)b;
+  return (ta < tb) ? -1 : (ta > tb) ? 1 : 0;
+}
+
+// Nearest-rank percentile of sorted samples.
+static double Percentile(const Samples* const s, int percent) {
+  int idx = (percent * s->size + 99) / 100 - 1;
+  if (idx < 0) idx = 0;
+  if (idx >= s->size) idx = s->size - 1;
+  return s->times[idx];
+}
+
+static void PrintHeader(void) {
+  printf("file,stage,method,lossless,threads,width,height,bytes,iterations,"
+         "mps,min_ms,p50_ms,p90_ms,max_ms\n");
+}
+
+// Sorts the samples and prints one CSV line. 'num_pixels' is the number of
+// pixels processed per iteration, used for the throughput figure.
+static void PrintStage(const char* const file, const char* const stage,
+                       int method, int lossless, int threads,
+                       int width, int height, size_t bytes,
+                       double num_pixels, Samples* const s) {
+  double median;
+  qsort(s->times, s->size, sizeof(*s->times), CompareTimes);
+  median = Percentile(s, 50);
+  printf("%s,%s,%d,%d,%d,%d,%d,%d,%d,%.2f,%.3f,%.3f,%.3f,%.3f\n",
+         file, stage, method, lossless, threads, width, height, (int)bytes,
+         s->size, (median > 0.) ? num_pixels / median / 1e6 : 0.,
+         1000. * s->times[0], 1000. * median, 1000. * Percentile(s, 90),
+         1000. * s->times[s->size - 1]);
+}
+
+//------------------------------------------------------------------------------
+// Stages
+
+// Decodes 'data' into RGBA, keeping the output of the last iteration in
+// 'config->output'. 'config->options' is set up by the caller.
+static int TimeDecode(const uint8_t* const data, size_t data_size,
+                      WebPDecoderConfig* const config,
+                      Samples* const s) {
+  int n;
+  config->output.colorspace = MODE_RGBA;
+  for (n = 0; n < s->size; ++n) {
+    Stopwatch stop_watch;
+    VP8StatusCode status;
+    WebPFreeDecBuffer(&config->output);
+    StopwatchReset(&stop_watch);
+    status = WebPDecode(data, data_size, config);
+    s->times[n] = StopwatchReadAndReset(&stop_watch);
+    if (status != VP8_STATUS_OK) {
+      fprintf(stderr, "Decoding failed (status: %d)\n", status);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Encodes 'src' with 'config'. The encoded bitstream of the last iteration is
+// returned in 'writer', which must be cleared by the caller.
+static int TimeEncode(const WebPPicture* const src,
+                      const WebPConfig* const config,
+                      WebPMemoryWriter* const writer,
+                      Samples* const s) {
+  int n;
+  for (n = 0; n < s->size; ++n) {
+    WebPPicture pic;
+    Stopwatch stop_watch;
+    int ok;
+    // The encoder may convert the picture in place, so work on a fresh copy
+    // and leave it out of the timing.
+    if (!WebPPictureInit(&pic) || !WebPPictureCopy(src, &pic)) {
+      fprintf(stderr, "Error! Cannot copy the source picture.\n");
+      return 0;
+    }
+    free(writer->mem);
+    WebPMemoryWriterInit(writer);
+    pic.writer = WebPMemoryWrite;
+    pic.custom_ptr = (void*)writer;
+    StopwatchReset(&stop_watch);
+    ok = WebPEncode(config, &pic);
+    s->times[n] = StopwatchReadAndReset(&stop_watch);
+    if (!ok) {
+      fprintf(stderr, "Encoding failed (error code: %d)\n", pic.error_code);
+    }
+    WebPPictureFree(&pic);
+    if (!ok) return 0;
+  }
+  return 1;
+}
+
+static int RunDecodeStage(const char* const file, const char* const stage,
+                          const uint8_t* const data, size_t data_size,
+                          WebPDecoderConfig* const config,
+                          int method, int lossless, int threads,
+                          Samples* const s) {
+  const WebPDecBuffer* const output = &config->output;
+  const int ok = TimeDecode(data, data_size, config, s);
+  if (ok) {
+    PrintStage(file, stage, method, lossless, threads,
+               output->width, output->height, data_size,
+               (double)output->width * output->height, s);
+  }
+  WebPFreeDecBuffer(&config->output);
+  return ok;
+}
+
+static int BenchConfig(const char* const file, const WebPPicture* const src,
+                       const BenchParams* const params,
+                       int method, int lossless, int threads,
+                       Samples* const s) {
+  int ok = 0;
+  WebPConfig config;
+  WebPDecoderConfig dec_config;
+  WebPMemoryWriter writer;
+
+  WebPMemoryWriterInit(&writer);
+  if (!WebPConfigInit(&config) || !WebPInitDecoderConfig(&dec_config)) {
+    fprintf(stderr, "Library version mismatch!\n");
+    return 0;
+  }
+  config.quality = params->quality;
+  config.method = method;
+  config.lossless = lossless;
+  config.thread_level = (threads > 0);
+  if (!WebPValidateConfig(&config)) {
+    fprintf(stderr, "Error! Invalid configuration.\n");
+    return 0;
+  }
+
+  if (!TimeEncode(src, &config, &writer, s)) goto End;
+  PrintStage(file, "encode", method, lossless, threads,
+             src->width, src->height, writer.size,
+             (double)src->width * src->height, s);
+
+  dec_config.options.use_threads = (threads > 0);
+  dec_config.options.num_threads = threads;
+  if (!RunDecodeStage(file, "decode", writer.mem, writer.size, &dec_config,
+                      method, lossless, threads, s)) {
+    goto End;
+  }
+  if (params->use_cropping &&
+      (params->crop_left + params->crop_width > src->width ||
+       params->crop_top + params->crop_height > src->height)) {
+    // The crop area is given once for the whole corpus: skip the pictures
+    // it doesn't fit in rather than failing.
+    fprintf(stderr, "Skipping decode_crop for '%s' (%d x %d picture).\n",
+            file, src->width, src->height);
+  } else if (params->use_cropping) {
+    dec_config.options.use_cropping = 1;
+    dec_config.options.crop_left   = params->crop_left;
+    dec_config.options.crop_top    = params->crop_top;
+    dec_config.options.crop_width  = params->crop_width;
+    dec_config.options.crop_height = params->crop_height;
+    if (!RunDecodeStage(file, "decode_crop", writer.mem, writer.size,
+                        &dec_config, method, lossless, threads, s)) {
+      goto End;
+    }
+    dec_config.options.use_cropping = 0;
+  }
+  if (params->use_scaling) {
+    dec_config.options.use_scaling = 1;
+    dec_config.options.scaled_width  = params->scaled_width;
+    dec_config.options.scaled_height = params->scaled_height;
+    if (!RunDecodeStage(file, "decode_scale", writer.mem, writer.size,
+                        &dec_config, method, lossless, threads, s)) {
+      goto End;
+    }
+  }
+  ok = 1;
+
+ End:
+  free(writer.mem);
+  return ok;
+}
+
+// Decodes the source file and runs all the configurations on it.
+static int BenchFile(const char* const file, const BenchParams* const params,
+                     Samples* const s) {
+  int ok = 0;
+  const uint8_t* data = NULL;
+  size_t data_size = 0;
+  uint8_t* rgba = NULL;
+  int width, height;
+  WebPPicture src;
+  int m, l, t;
+
+  if (!WebPPictureInit(&src)) {
+    fprintf(stderr, "Library version mismatch!\n");
+    return 0;
+  }
+  if (!ExUtilReadFile(file, &data, &data_size)) return 0;
+  rgba = WebPDecodeRGBA(data, data_size, &width, &height);
+  if (rgba == NULL) {
+    fprintf(stderr, "Error! Could not decode WebP file '%s'.\n", file);
+    goto End;
+  }
+  src.use_argb = 1;
+  src.width = width;
+  src.height = height;
+  if (!WebPPictureImportRGBA(&src, rgba, 4 * width)) {
+    fprintf(stderr, "Error! Cannot import picture '%s'.\n", file);
+    goto End;
+  }
+
+  for (m = 0; m < params->methods.size; ++m) {
+    for (l = 0; l < params->lossless.size; ++l) {
+      for (t = 0; t < params->threads.size; ++t) {
+        if (!BenchConfig(file, &src, params, params->methods.values[m],
+                         params->lossless.values[l],
+                         params->threads.values[t], s)) {
+          fprintf(stderr, "Error while processing '%s'.\n", file);
+          goto End;
+        }
+        fflush(stdout);
+      }
+    }
+  }
+  ok = 1;
+
+ End:
+  WebPPictureFree(&src);
+  free(rgba);
+  free((void*)data);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, const char *argv[]) {
+  int ok = 1;
+  int num_files = 0;
+  int c;
+  BenchParams params;
+  Samples samples;
+
+  memset(&params, 0, sizeof(params));
+  params.num_loops = 10;
+  params.quality = 75.f;
+  SetList(&params.methods, 4);
+  SetList(&params.lossless, 0);
+  SetList(&params.threads, 0);
+
+  for (c = 1; c < argc; ++c) {
+    int parse_error = 0;
+    if (!strcmp(argv[c], "-h") || !strcmp(argv[c], "-help")) {
+      Help();
+      return 0;
+    } else if (!strcmp(argv[c], "-n") && c < argc - 1) {
+      params.num_loops = strtol(argv[++c], NULL, 0);
+      parse_error = (params.num_loops <= 0);
+    } else if (!strcmp(argv[c], "-q") && c < argc - 1) {
+      params.quality = (float)strtod(argv[++c], NULL);
+    } else if (!strcmp(argv[c], "-m") && c < argc - 1) {
+      parse_error = !ParseList(argv[++c], 0, 6, &params.methods);
+    } else if (!strcmp(argv[c], "-lossless") && c < argc - 1) {
+      parse_error = !ParseList(argv[++c], 0, 1, &params.lossless);
+    } else if (!strcmp(argv[c], "-mt") && c < argc - 1) {
+      parse_error = !ParseList(argv[++c], 0, 8, &params.threads);
+    } else if (!strcmp(argv[c], "-crop") && c < argc - 4) {
+      params.use_cropping = 1;
+      params.crop_left   = strtol(argv[++c], NULL, 0);
+      params.crop_top    = strtol(argv[++c], NULL, 0);
+      params.crop_width  = strtol(argv[++c], NULL, 0);
+      params.crop_height = strtol(argv[++c], NULL, 0);
+    } else if (!strcmp(argv[c], "-scale") && c < argc - 2) {
+      params.use_scaling = 1;
+      params.scaled_width  = strtol(argv[++c], NULL, 0);
+      params.scaled_height = strtol(argv[++c], NULL, 0);
+    } else if (argv[c][0] == '-') {
+      fprintf(stderr, "Unknown option '%s'\n", argv[c]);
+      Help();
+      return -1;
+    } else {
+      ++num_files;
+    }
+    if (parse_error) {
+      fprintf(stderr, "Error! Invalid value for option '%s'.\n", argv[c - 1]);
+      return -1;
+    }
+  }
+
+  if (num_files == 0) {
+    fprintf(stderr, "No input file specified!\n");
+    Help();
+    return -1;
+  }
+
+  samples.size = params.num_loops;
+  samples.times = (double*)malloc(samples.size * sizeof(*samples.times));
+  if (samples.times == NULL) {
+    fprintf(stderr, "Error! Memory allocation failed.\n");
+    return -1;
+  }
+
+  PrintHeader();
+  for (c = 1; ok && c < argc; ++c) {
+    if (argv[c][0] != '-') {
+      ok = BenchFile(argv[c], &params, &samples);
+    } else if (!strcmp(argv[c], "-crop")) {
+      c += 4;
+    } else if (!strcmp(argv[c], "-scale")) {
+      c += 2;
+    } else {
+      ++c;   // all the other options take a single argument
+    }
+  }
+  free(samples.times);
+  return ok ? 0 : -1;
+}
+
+//------------------------------------------------------------------------------
@@ -410,17 +410,47 @@ static int WriteData(const char* filename, const WebPData* const webpdata) {
   return ok;
 }
 
+// Output file for WebPMuxAssembleToWriter().
+typedef struct {
+  const char* filename;
+  FILE* fout;      // opened upon the first write
+  size_t size;     // number of bytes written so far
+} FileWriter;
+
+static int FileWrite(const uint8_t* data, size_t data_size, void* user_data) {
+  FileWriter* const writer = (FileWriter*)user_data;
+  if (writer->fout == NULL) {
+    writer->fout =
+        strcmp(writer->filename, "-") ? fopen(writer->filename, "wb") : stdout;
+    if (writer->fout == NULL) {
+      fprintf(stderr, "Error opening output WebP file %s!\n",
+              writer->filename);
+      return 0;
+    }
+  }
+  if (fwrite(data, data_size, 1, writer->fout) != 1) {
+    fprintf(stderr, "Error writing file %s!\n", writer->filename);
+    return 0;
+  }
+  writer->size += data_size;
+  return 1;
+}
+
 static int WriteWebP(WebPMux* const mux, const char* filename) {
-  int ok;
-  WebPData webp_data;
-  const WebPMuxError err = WebPMuxAssemble(mux, &webp_data);
+  WebPMuxError err;
+  FileWriter writer;
+  writer.filename = filename;
+  writer.fout = NULL;
+  writer.size = 0;
+  // Stream the chunks to the file, rather than assembling them in memory.
+  err = WebPMuxAssembleToWriter(mux, FileWrite, &writer);
+  if (writer.fout != NULL && writer.fout != stdout) fclose(writer.fout);
   if (err != WEBP_MUX_OK) {
     fprintf(stderr, "Error (%s) assembling the WebP file.\n", ErrorString(err));
     return 0;
   }
-  ok = WriteData(filename, &webp_data);
-  WebPDataClear(&webp_data);
-  return ok;
+  fprintf(stderr, "Saved file %s (%d bytes)\n", filename, (int)writer.size);
+  return 1;
 }
 
 static int ParseFrameArgs(const char* args, WebPMuxFrameInfo* const info) {
@@ -37,6 +37,19 @@ void ALPHDelete(ALPHDecoder* const dec) {
 //------------------------------------------------------------------------------
 // Decoding.
 
+// Maximum number of rows requested at once by VP8DecompressAlphaRows()'s
+// callers: a macroblock row, plus the rows delayed by the loop-filter.
+#define MAX_ALPHA_ROWS (16 + 8)
+
+int VP8AlphaPlaneRows(int width, int height) {
+  // The row above the requested ones is needed by the unfilter, and a
+  // lossless backward copy may have decoded some rows past them (with up to
+  // 8 alpha values per pixel when they are color-indexed).
+  const int num_rows =
+      1 + MAX_ALPHA_ROWS + (8 * MAX_COPY_LENGTH + width - 1) / width;
+  return (num_rows < height) ? num_rows : height;
+}
+
 // Initialize alpha decoding by parsing the alpha header and decoding the image
 // header for alpha data stored using lossless compression.
 // Returns false in case of error in alpha header (data too short, invalid
@@ -53,6 +66,10 @@ static int ALPHInit(ALPHDecoder* const dec, const uint8_t* data,
 
   dec->width_ = width;
   dec->height_ = height;
+  dec->output_ = output;
+  dec->output_row_ = 0;
+  dec->output_rows_ = VP8AlphaPlaneRows(width, height);
+  VP8FiltersInit();
 
   if (data_size <= ALPHA_HEADER_LEN) {
     return 0;
@@ -75,11 +92,22 @@ static int ALPHInit(ALPHDecoder* const dec, const uint8_t* data,
     ok = (alpha_data_size >= alpha_decoded_size);
   } else {
     assert(dec->method_ == ALPHA_LOSSLESS_COMPRESSION);
-    ok = VP8LDecodeAlphaHeader(dec, alpha_data, alpha_data_size, output);
+    ok = VP8LDecodeAlphaHeader(dec, alpha_data, alpha_data_size);
   }
   return ok;
 }
 
+// Drops the rows of the output window that precede row 'row - 1', the only
+// previous one still needed by the unfilter.
+static void SlideOutput(ALPHDecoder* const dec, int row) {
+  const int num_rows = row - 1 - dec->output_row_;
+  if (num_rows > 0 && dec->output_rows_ < dec->height_) {
+    memmove(dec->output_, dec->output_ + num_rows * dec->width_,
+            (dec->output_rows_ - num_rows) * dec->width_);
+    dec->output_row_ += num_rows;
+  }
+}
+
 // Decodes, unfilters and dequantizes *at least* 'num_rows' rows of alpha
 // starting from row number 'row'. It assumes that rows up to (row - 1) have
 // already been decoded.
@@ -87,14 +115,18 @@ static int ALPHInit(ALPHDecoder* const dec, const uint8_t* data,
 static int ALPHDecode(VP8Decoder* const dec, int row, int num_rows) {
   ALPHDecoder* const alph_dec = dec->alph_dec_;
   const int width = alph_dec->width_;
-  const int height = alph_dec->height_;
   WebPUnfilterFunc unfilter_func = WebPUnfilters[alph_dec->filter_];
-  uint8_t* const output = dec->alpha_plane_;
+  uint8_t* const output = alph_dec->output_;
+  int height, out_row;   // relative to the output window
+  SlideOutput(alph_dec, row);
+  height = alph_dec->height_ - alph_dec->output_row_;
+  out_row = row - alph_dec->output_row_;
+  assert(out_row + num_rows <= alph_dec->output_rows_);
   if (alph_dec->method_ == ALPHA_NO_COMPRESSION) {
     const size_t offset = row * width;
     const size_t num_pixels = num_rows * width;
     assert(dec->alpha_data_size_ >= ALPHA_HEADER_LEN + offset + num_pixels);
-    memcpy(dec->alpha_plane_ + offset,
+    memcpy(output + out_row * width,
            dec->alpha_data_ + ALPHA_HEADER_LEN + offset, num_pixels);
   } else {  // alph_dec->method_ == ALPHA_LOSSLESS_COMPRESSION
     assert(alph_dec->vp8l_dec_ != NULL);
@@ -104,11 +136,11 @@ static int ALPHDecode(VP8Decoder* const dec, int row, int num_rows) {
   }
 
   if (unfilter_func != NULL) {
-    unfilter_func(width, height, width, row, num_rows, output);
+    unfilter_func(width, height, width, out_row, num_rows, output);
   }
 
   if (alph_dec->pre_processing_ == ALPHA_PREPROCESSED_LEVELS) {
-    if (!DequantizeLevels(output, width, height, row, num_rows)) {
+    if (!DequantizeLevels(output, width, height, out_row, num_rows)) {
       return 0;
     }
   }
@@ -126,8 +158,10 @@ const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
                                       int row, int num_rows) {
   const int width = dec->pic_hdr_.width_;
   const int height = dec->pic_hdr_.height_;
+  const uint8_t* alpha = NULL;
 
-  if (row < 0 || num_rows <= 0 || row + num_rows > height) {
+  if (row < 0 || num_rows <= 0 || num_rows > MAX_ALPHA_ROWS ||
+      row + num_rows > height) {
     return NULL;    // sanity check.
   }
 
@@ -144,18 +178,20 @@ const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
     }
   }
 
+  // Rows must be requested in sequence: only a few of them are kept.
   if (!dec->is_alpha_decoded_) {
     int ok = 0;
     assert(dec->alph_dec_ != NULL);
     ok = ALPHDecode(dec, row, num_rows);
+    if (ok) {
+      // Pointer to the current decoded row.
+      alpha = dec->alpha_plane_ + (row - dec->alph_dec_->output_row_) * width;
+    }
     if (!ok || dec->is_alpha_decoded_) {
       ALPHDelete(dec->alph_dec_);
       dec->alph_dec_ = NULL;
     }
-    if (!ok) return NULL;  // Error.
   }
-
-  // Return a pointer to the current decoded row.
-  return dec->alpha_plane_ + row * width;
+  return alpha;
 }
 
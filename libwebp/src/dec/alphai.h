@@ -32,6 +32,9 @@ struct ALPHDecoder {
   int pre_processing_;
   struct VP8LDecoder* vp8l_dec_;
   VP8Io io_;
+  uint8_t* output_;   // window of 'output_rows_' alpha rows, the first one of
+  int output_row_;    // which is row number 'output_row_'.
+  int output_rows_;
   int use_8b_decode;  // Although alpha channel requires only 1 byte per
                       // pixel, sometimes VP8LDecoder may need to allocate
                       // 4 bytes per pixel internally during decode.
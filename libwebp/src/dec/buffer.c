@@ -62,9 +62,12 @@ static VP8StatusCode CheckDecBuffer(const WebPDecBuffer* const buffer) {
     }
   } else {    // RGB checks
     const WebPRGBABuffer* const buf = &buffer->u.RGBA;
-    const uint64_t size = (uint64_t)buf->stride * height;
+    const int row_size = width * kModeBpp[mode];
+    // The last row doesn't need to extend to the full stride, so that a
+    // sub-rectangle of a larger picture can be decoded in place.
+    const uint64_t size = (uint64_t)buf->stride * (height - 1) + row_size;
     ok &= (size <= buf->size);
-    ok &= (buf->stride >= width * kModeBpp[mode]);
+    ok &= (buf->stride >= row_size);
     ok &= (buf->rgba != NULL);
   }
   return ok ? VP8_STATUS_OK : VP8_STATUS_INVALID_PARAM;
@@ -101,6 +101,11 @@ struct VP8Io {
   int use_scaling;
   int scaled_width, scaled_height;
 
+  // If not zero, the samples are reconstructed (approximately) and emitted at
+  // a resolution reduced by a factor (1 << reduce_shift). 'mb_w', 'mb_h' and
+  // 'mb_y' are then expressed in reduced units, but the crop_* values are not.
+  int reduce_shift;
+
   // If non NULL, pointer to the alpha data (if present) corresponding to the
   // start of the current row (That is: it is pre-offset by mb_y and takes
   // cropping into account).
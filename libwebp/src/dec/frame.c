@@ -17,8 +17,16 @@
 
 #define ALIGN_MASK (32 - 1)
 
+static void ReconstructMBs(const VP8Decoder* const dec, int mb_y,
+                           int cache_id, const VP8MBData* const mb_data,
+                           uint8_t* const yuv_b,
+                           int mb_x_start, int mb_x_end);  // TODO(skal): remove
+
 static void ReconstructRow(const VP8Decoder* const dec,
-                           const VP8ThreadContext* ctx);  // TODO(skal): remove
+                           const VP8ThreadContext* ctx) {
+  ReconstructMBs(dec, ctx->mb_y_, ctx->id_, ctx->mb_data_, dec->yuv_b_,
+                 0, dec->mb_w_);
+}
 
 //------------------------------------------------------------------------------
 // Filtering
@@ -220,6 +228,57 @@ static void DitherRow(VP8Decoder* const dec) {
   }
 }
 
+//------------------------------------------------------------------------------
+// Reduced-resolution output
+
+// Average each (1 << shift) x (1 << shift) block of the 'width' x 'height'
+// area at 'src' into one sample of 'dst'. Partial blocks on the right and
+// bottom borders are averaged over the available samples only.
+static void ReduceSamples(const uint8_t* src, int src_stride,
+                          int width, int height, int shift,
+                          uint8_t* dst, int dst_stride) {
+  const int step = 1 << shift;
+  int x, y;
+  for (y = 0; y < height; y += step) {
+    const int h = (height - y < step) ? height - y : step;
+    for (x = 0; x < width; x += step) {
+      const int w = (width - x < step) ? width - x : step;
+      const int n = w * h;
+      int sum = n >> 1;
+      int i, j;
+      for (j = 0; j < h; ++j) {
+        for (i = 0; i < w; ++i) {
+          sum += src[x + i + j * src_stride];
+        }
+      }
+      dst[x >> shift] = (n == step * step) ? (sum >> (2 * shift)) : (sum / n);
+    }
+    src += step * src_stride;
+    dst += dst_stride;
+  }
+}
+
+// Same as ReduceSamples() for a whole 'size' x 'size' block of yuv_b_. Meant
+// to be inlined with constant 'size' and 'shift'.
+static WEBP_INLINE void ReduceBlock(const uint8_t* src, int size, int shift,
+                                    uint8_t* dst, int dst_stride) {
+  const int step = 1 << shift;
+  int x, y, i, j;
+  for (y = 0; y < size; y += step) {
+    for (x = 0; x < size; x += step) {
+      int sum = (step * step) >> 1;
+      for (j = 0; j < step; ++j) {
+        for (i = 0; i < step; ++i) {
+          sum += src[x + i + j * BPS];
+        }
+      }
+      dst[x >> shift] = sum >> (2 * shift);
+    }
+    src += step * BPS;
+    dst += dst_stride;
+  }
+}
+
 //------------------------------------------------------------------------------
 // This function is called after a row of macroblocks is finished decoding.
 // It also takes into account the following restrictions:
@@ -233,6 +292,52 @@ static void DitherRow(VP8Decoder* const dec) {
 
 #define MACROBLOCK_VPOS(mb_y)  ((mb_y) * 16)    // vertical position of a MB
 
+// Emit the reduced-resolution samples of the current row. Since the loop filter
+// is off, there's no delay line and the whole macroblock row is transmitted.
+static int PutReducedRow(VP8Decoder* const dec, VP8Io* const io) {
+  const VP8ThreadContext* const ctx = &dec->thread_ctx_;
+  const int shift = dec->reduce_shift_;
+  const int round = (1 << shift) - 1;
+  const int mb_start = MACROBLOCK_VPOS(ctx->mb_y_);
+  const int y_start = (mb_start < io->crop_top) ? io->crop_top : mb_start;
+  int y_end = MACROBLOCK_VPOS(ctx->mb_y_ + 1);
+  if (y_end > io->crop_bottom) {
+    y_end = io->crop_bottom;    // make sure we don't overflow on last row.
+  }
+  io->a = NULL;
+  if (dec->alpha_data_ != NULL && mb_start < y_end) {
+    // Alpha rows must be decompressed in sequence, at full resolution.
+    const uint8_t* const alpha =
+        VP8DecompressAlphaRows(dec, mb_start, y_end - mb_start);
+    if (alpha == NULL) {
+      return VP8SetError(dec, VP8_STATUS_BITSTREAM_ERROR,
+                         "Could not decode alpha data.");
+    }
+    if (y_start < y_end) {
+      ReduceSamples(alpha + (y_start - mb_start) * io->width, io->width,
+                    io->width, y_end - y_start, shift,
+                    dec->reduced_alpha_, io->width);
+      io->a = dec->reduced_alpha_ + (io->crop_left >> shift);
+    }
+  }
+  if (y_start < y_end) {
+    // The crop_top/crop_left values are multiples of (2 << shift).
+    const int dy = (y_start - mb_start) >> shift;
+    const int dx = io->crop_left >> shift;
+    io->y = dec->cache_y_ + ctx->id_ * 16 * dec->cache_y_stride_
+          + dy * dec->cache_y_stride_ + dx;
+    io->u = dec->cache_u_ + ctx->id_ * 8 * dec->cache_uv_stride_
+          + (dy >> 1) * dec->cache_uv_stride_ + (dx >> 1);
+    io->v = dec->cache_v_ + ctx->id_ * 8 * dec->cache_uv_stride_
+          + (dy >> 1) * dec->cache_uv_stride_ + (dx >> 1);
+    io->mb_y = (y_start - io->crop_top) >> shift;
+    io->mb_w = ((io->crop_right + round) >> shift) - dx;
+    io->mb_h = ((y_end + round) >> shift) - (y_start >> shift);
+    return io->put(io);
+  }
+  return 1;
+}
+
 // Finalize and transmit a complete row. Return false in case of user-abort.
 static int FinishRow(VP8Decoder* const dec, VP8Io* const io) {
   int ok = 1;
@@ -262,7 +367,9 @@ static int FinishRow(VP8Decoder* const dec, VP8Io* const io) {
     DitherRow(dec);
   }
 
-  if (io->put != NULL) {
+  if (io->put != NULL && dec->reduce_shift_ > 0) {
+    ok = PutReducedRow(dec, io);
+  } else if (io->put != NULL) {
     int y_start = MACROBLOCK_VPOS(mb_y);
     int y_end = MACROBLOCK_VPOS(mb_y + 1);
     if (!is_first_row) {
@@ -376,6 +483,136 @@ int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io) {
   return ok;
 }
 
+//------------------------------------------------------------------------------
+// Parallel parsing of the token partitions (mt_method_ = 3).
+//
+// The rows are dealt to the parsing threads in turn, so that each thread reads
+// its own token partition. A row can't get ahead of the row above though: its
+// top token contexts come from it, and so do the top samples of the intra
+// predictions, up to one macroblock on the right. So the rows are split into
+// a few ranges of macroblocks and processed as a wavefront: at each step,
+// every busy thread decodes and reconstructs one range of its row, lagging
+// WAVEFRONT_LAG ranges behind the row above. Meanwhile, the main thread parses
+// the intra modes of the next row from the first partition. Completed rows are
+// filtered and emitted in order by dec->worker_, as for mt_method_ = 1.
+
+#define WAVEFRONT_LAG 2
+
+// Returns the number of ranges per row. With num_parse_threads_ times
+// WAVEFRONT_LAG ranges, a thread is done with a row right when it must start
+// the next one. Each range has at least one macroblock.
+static int GetNumRanges(const VP8Decoder* const dec) {
+  const int num_ranges = dec->num_parse_threads_ * WAVEFRONT_LAG;
+  return (num_ranges < dec->mb_w_) ? num_ranges : dec->mb_w_;
+}
+
+// Hook of the parsing threads.
+static int DecodeAndReconstruct(const VP8Decoder* const dec,
+                                VP8ParseContext* const ctx) {
+  if (!VP8DecodeTokens(dec, ctx)) return 0;
+  ReconstructMBs(dec, ctx->mb_y_, ctx->id_, ctx->mb_data_, ctx->yuv_b_,
+                 ctx->mb_x_, ctx->mb_x_end_);
+  return 1;
+}
+
+// Hand row 'mb_y' over to its parsing thread. Its intra modes are taken from
+// dec->mb_data_, which gets a free buffer in exchange.
+static void StartRow(VP8Decoder* const dec, int mb_y) {
+  VP8ParseContext* const ctx =
+      &dec->parse_ctx_[mb_y % dec->num_parse_threads_];
+  VP8MBData* const tmp = ctx->mb_data_;
+  ctx->mb_data_ = dec->mb_data_;
+  dec->mb_data_ = tmp;
+  ctx->mb_y_ = mb_y;
+  ctx->id_ = mb_y % dec->num_caches_;
+  ctx->left_.nz_ = 0;
+  ctx->left_.nz_dc_ = 0;
+  ctx->token_br_ = &dec->parts_[mb_y & (dec->num_parts_ - 1)];
+}
+
+// Spawn the filtering/output job of the completed row of 'ctx'.
+static int LaunchFinishRow(VP8Decoder* const dec, VP8Io* const io,
+                           VP8ParseContext* const ctx) {
+  VP8ThreadContext* const tctx = &dec->thread_ctx_;
+  WebPWorker* const worker = &dec->worker_;
+  const int filter_row =
+      (dec->filter_type_ > 0) &&
+      (ctx->mb_y_ >= dec->tl_mb_y_) && (ctx->mb_y_ <= dec->br_mb_y_);
+  // Finish previous job *before* updating context
+  if (!WebPWorkerSync(worker)) return 0;
+  tctx->io_ = *io;
+  tctx->id_ = ctx->id_;
+  tctx->mb_y_ = ctx->mb_y_;
+  tctx->filter_row_ = filter_row;
+  {   // swap macroblock data
+    VP8MBData* const tmp = tctx->mb_data_;
+    tctx->mb_data_ = ctx->mb_data_;
+    ctx->mb_data_ = tmp;
+  }
+  if (filter_row) {   // swap filter info
+    VP8FInfo* const tmp = tctx->f_info_;
+    tctx->f_info_ = ctx->f_info_;
+    ctx->f_info_ = tmp;
+  }
+  WebPWorkerLaunch(worker);
+  return 1;
+}
+
+int VP8ParallelDecode(VP8Decoder* const dec, VP8Io* const io) {
+  const int num_threads = dec->num_parse_threads_;
+  const int num_rows = dec->br_mb_y_;
+  const int num_ranges = GetNumRanges(dec);
+  const int num_steps = WAVEFRONT_LAG * (num_rows - 1) + num_ranges;
+  int step;
+
+  assert(dec->mt_method_ == 3 && num_threads > 1);
+  if (!VP8ParseIntraModeRow(dec)) {
+    return VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
+                       "Premature end-of-file encountered.");
+  }
+  for (step = 0; step < num_steps; ++step) {
+    // Rows having a range to process at this step.
+    const int first_row =
+        (step < num_ranges) ? 0 : (step - num_ranges) / WAVEFRONT_LAG + 1;
+    const int last_row = (step / WAVEFRONT_LAG < num_rows) ?
+                         step / WAVEFRONT_LAG : num_rows - 1;
+    const int new_row =
+        (step % WAVEFRONT_LAG == 0) ? step / WAVEFRONT_LAG : -1;
+    int ok = 1;
+    int mb_y;
+    if (new_row >= 0 && new_row < num_rows) {
+      StartRow(dec, new_row);
+    }
+    for (mb_y = first_row; mb_y <= last_row; ++mb_y) {
+      VP8ParseContext* const ctx = &dec->parse_ctx_[mb_y % num_threads];
+      const int range = step - WAVEFRONT_LAG * mb_y;
+      ctx->mb_x_ = range * dec->mb_w_ / num_ranges;
+      ctx->mb_x_end_ = (range + 1) * dec->mb_w_ / num_ranges;
+      WebPWorkerLaunch(&dec->parse_workers_[mb_y % num_threads]);
+    }
+    if (new_row >= 0 && new_row + 1 < num_rows) {
+      ok = VP8ParseIntraModeRow(dec);   // next row's modes, in the meantime
+    }
+    for (mb_y = first_row; mb_y <= last_row; ++mb_y) {
+      ok &= WebPWorkerSync(&dec->parse_workers_[mb_y % num_threads]);
+    }
+    if (!ok) {
+      return VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
+                         "Premature end-of-file encountered.");
+    }
+    // Only the first row can be complete.
+    if (step - WAVEFRONT_LAG * first_row == num_ranges - 1) {
+      VP8ParseContext* const ctx = &dec->parse_ctx_[first_row % num_threads];
+      if (!LaunchFinishRow(dec, io, ctx)) {
+        return VP8SetError(dec, VP8_STATUS_USER_ABORT, "Output aborted.");
+      }
+    }
+  }
+  return 1;
+}
+
+#undef WAVEFRONT_LAG
+
 //------------------------------------------------------------------------------
 // Finish setting up the decoding parameter once user's setup() is called.
 
@@ -391,6 +628,12 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
   if (io->bypass_filtering) {
     dec->filter_type_ = 0;
   }
+  // Reduced-resolution reconstruction is never filtered nor dithered.
+  dec->reduce_shift_ = io->reduce_shift;
+  if (dec->reduce_shift_ > 0) {
+    dec->filter_type_ = 0;
+    dec->dither_ = 0;
+  }
   // TODO(skal): filter type / strength / sharpness forcing
 
   // Define the area where we can skip in-loop filtering, in case of cropping.
@@ -434,6 +677,16 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io) {
   return VP8_STATUS_OK;
 }
 
+int VP8NumMBToReconstruct(const VP8Decoder* const dec, int mb_y) {
+  // A macroblock can only influence the next rows through its right neighbor:
+  // the top-right samples used by the intra4x4 predictions. Hence, one more
+  // macroblock is needed per row remaining before br_mb_y_. Macroblock
+  // br_mb_x_ itself is kept too, since the bilinear upscaler can read one
+  // sample past crop_right.
+  const int num_mb = dec->br_mb_x_ + 1 + (dec->br_mb_y_ - 1 - mb_y);
+  return (num_mb < dec->mb_w_) ? num_mb : dec->mb_w_;
+}
+
 int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io) {
   int ok = 1;
   if (dec->mt_method_ > 0) {
@@ -487,6 +740,21 @@ static int InitThreadContext(VP8Decoder* const dec) {
     worker->hook = (WebPWorkerHook)FinishRow;
     dec->num_caches_ =
       (dec->filter_type_ > 0) ? MT_CACHE_LINES : MT_CACHE_LINES - 1;
+    if (dec->mt_method_ == 3) {
+      int i;
+      for (i = 0; i < dec->num_parse_threads_; ++i) {
+        WebPWorker* const parse_worker = &dec->parse_workers_[i];
+        if (!WebPWorkerReset(parse_worker)) {
+          return VP8SetError(dec, VP8_STATUS_OUT_OF_MEMORY,
+                             "thread initialization failed.");
+        }
+        parse_worker->data1 = dec;
+        parse_worker->data2 = (void*)&dec->parse_ctx_[i];
+        parse_worker->hook = (WebPWorkerHook)DecodeAndReconstruct;
+      }
+      // one more cache row for each additional row being reconstructed.
+      dec->num_caches_ += dec->num_parse_threads_ - 1;
+    }
   } else {
     dec->num_caches_ = ST_CACHE_LINES;
   }
@@ -502,7 +770,7 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
   (void)headers;
   (void)width;
   (void)height;
-  assert(!headers->is_lossless);
+  assert(headers == NULL || !headers->is_lossless);
 #if defined(WEBP_USE_THREAD)
   if (width < MIN_WIDTH_FOR_THREADS) return 0;
   // TODO(skal): tune the heuristic further
@@ -515,6 +783,21 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
 #endif
 }
 
+void VP8InitParseThreads(const WebPDecoderOptions* const options,
+                         VP8Decoder* const dec) {
+  assert(dec != NULL);
+  dec->num_parse_threads_ = 0;
+  // Each thread needs its own token partition.
+  if (options != NULL && dec->mt_method_ > 0 && dec->num_parts_ > 1) {
+    const int num_threads = (options->num_threads < dec->num_parts_) ?
+                            options->num_threads : dec->num_parts_;
+    if (num_threads > 1) {
+      dec->mt_method_ = 3;
+      dec->num_parse_threads_ = num_threads;
+    }
+  }
+}
+
 #undef MT_CACHE_LINES
 #undef ST_CACHE_LINES
 
@@ -523,6 +806,7 @@ int VP8GetThreadMethod(const WebPDecoderOptions* const options,
 
 static int AllocateMemory(VP8Decoder* const dec) {
   const int num_caches = dec->num_caches_;
+  const int num_parse_threads = dec->num_parse_threads_;
   const int mb_w = dec->mb_w_;
   // Note: we use 'size_t' when there's no overflow risk, uint64_t otherwise.
   const size_t intra_pred_mode_size = 4 * mb_w * sizeof(uint8_t);
@@ -530,22 +814,34 @@ static int AllocateMemory(VP8Decoder* const dec) {
   const size_t mb_info_size = (mb_w + 1) * sizeof(VP8MB);
   const size_t f_info_size =
       (dec->filter_type_ > 0) ?
-          mb_w * (dec->mt_method_ > 0 ? 2 : 1) * sizeof(VP8FInfo)
+          mb_w * ((dec->mt_method_ > 0 ? 2 : 1) + num_parse_threads)
+               * sizeof(VP8FInfo)
         : 0;
-  const size_t yuv_size = YUV_SIZE * sizeof(*dec->yuv_b_);
+  // one work area per parsing thread, if any.
+  const size_t yuv_size = (num_parse_threads > 0 ? num_parse_threads : 1)
+                        * YUV_SIZE * sizeof(*dec->yuv_b_);
   const size_t mb_data_size =
-      (dec->mt_method_ == 2 ? 2 : 1) * mb_w * sizeof(*dec->mb_data_);
+      ((dec->mt_method_ >= 2 ? 2 : 1) + num_parse_threads)
+          * mb_w * sizeof(*dec->mb_data_);
   const size_t cache_height = (16 * num_caches
                             + kFilterExtraRows[dec->filter_type_]) * 3 / 2;
   const size_t cache_size = top_size * cache_height;
-  // alpha_size is the only one that scales as width x height.
+  // alpha_size only covers a window of rows, see VP8AlphaPlaneRows().
   const uint64_t alpha_size = (dec->alpha_data_ != NULL) ?
-      (uint64_t)dec->pic_hdr_.width_ * dec->pic_hdr_.height_ : 0ULL;
+      (uint64_t)dec->pic_hdr_.width_ *
+          VP8AlphaPlaneRows(dec->pic_hdr_.width_, dec->pic_hdr_.height_) :
+      0ULL;
+  // one row of 16 pixels, reduced, for emitting the alpha samples.
+  const size_t reduced_alpha_size =
+      (dec->alpha_data_ != NULL && dec->reduce_shift_ > 0) ?
+          dec->pic_hdr_.width_ * (16 >> dec->reduce_shift_) : 0;
   const uint64_t needed = (uint64_t)intra_pred_mode_size
                         + top_size + mb_info_size + f_info_size
                         + yuv_size + mb_data_size
-                        + cache_size + alpha_size + ALIGN_MASK;
+                        + cache_size + alpha_size + reduced_alpha_size
+                        + ALIGN_MASK;
   uint8_t* mem;
+  int i;
 
   if (needed != (size_t)needed) return 0;  // check for overflow
   if (needed > dec->mem_size_) {
@@ -588,11 +884,20 @@ static int AllocateMemory(VP8Decoder* const dec) {
 
   dec->mb_data_ = (VP8MBData*)mem;
   dec->thread_ctx_.mb_data_ = (VP8MBData*)mem;
-  if (dec->mt_method_ == 2) {
+  if (dec->mt_method_ >= 2) {
     dec->thread_ctx_.mb_data_ += mb_w;
   }
   mem += mb_data_size;
 
+  // the parsing threads' buffers follow the ones of thread_ctx_.
+  for (i = 0; i < num_parse_threads; ++i) {
+    VP8ParseContext* const ctx = &dec->parse_ctx_[i];
+    ctx->mb_data_ = dec->thread_ctx_.mb_data_ + (i + 1) * mb_w;
+    ctx->f_info_ = (dec->f_info_ != NULL) ?
+        dec->thread_ctx_.f_info_ + (i + 1) * mb_w : NULL;
+    ctx->yuv_b_ = dec->yuv_b_ + i * YUV_SIZE;
+  }
+
   dec->cache_y_stride_ = 16 * mb_w;
   dec->cache_uv_stride_ = 8 * mb_w;
   {
@@ -611,6 +916,8 @@ static int AllocateMemory(VP8Decoder* const dec) {
   // alpha plane
   dec->alpha_plane_ = alpha_size ? (uint8_t*)mem : NULL;
   mem += alpha_size;
+  dec->reduced_alpha_ = reduced_alpha_size ? (uint8_t*)mem : NULL;
+  mem += reduced_alpha_size;
   assert(mem <= (uint8_t*)dec->mem_ + dec->mem_size_);
 
   // note: left/top-info is initialized once for all.
@@ -684,28 +991,67 @@ static WEBP_INLINE void DoTransform(uint32_t bits, const int16_t* const src,
   }
 }
 
+// At reduced resolution, the residuals of the 4x4 blocks that don't serve
+// as prediction source for other blocks only need to be right on average
+// over 2x2 (shift = 1) or 4x4 samples. Their lowest frequencies are enough.
+static WEBP_INLINE void DoReducedTransform(uint32_t bits,
+                                           const int16_t* const src,
+                                           uint8_t* const dst, int shift) {
+  if (bits >> 30) {
+    if (shift == 1 && (bits >> 31)) {
+      VP8TransformAC3(src, dst);
+    } else {
+      VP8TransformDC(src, dst);
+    }
+  }
+}
+
+// Only the inner 4x4 luma blocks of i16 macroblocks are not used as
+// prediction source (for the next 4x4 blocks or the neighboring macroblocks).
+#define IS_INNER_BLOCK(n) ((n) < 12 && ((n) & 3) != 3)
+
 static void DoUVTransform(uint32_t bits, const int16_t* const src,
-                          uint8_t* const dst) {
+                          uint8_t* const dst, int shift) {
   if (bits & 0xff) {    // any non-zero coeff at all?
     if (bits & 0xaa) {  // any non-zero AC coefficient?
-      VP8TransformUV(src, dst);   // note we don't use the AC3 variant for U/V
+      if (shift == 0) {
+        VP8TransformUV(src, dst);   // note we don't use the AC3 variant for U/V
+      } else {
+        // only the top-left block is not used as prediction source
+        DoReducedTransform(bits << 24, src, dst, shift);
+        VP8Transform(src + 1 * 16, dst + 4, 0);
+        VP8Transform(src + 2 * 16, dst + 4 * BPS, 1);
+      }
     } else {
       VP8TransformDCUV(src, dst);
     }
   }
 }
 
-static void ReconstructRow(const VP8Decoder* const dec,
-                           const VP8ThreadContext* ctx) {
+// Reconstruct the macroblocks [mb_x_start, mb_x_end) of row 'mb_y' into the
+// cache row 'cache_id', using 'yuv_b' as work area. The left samples are
+// carried over in 'yuv_b' from one call to the next, so a row must be
+// processed from left to right with the same work area.
+static void ReconstructMBs(const VP8Decoder* const dec, int mb_y,
+                           int cache_id, const VP8MBData* const mb_data,
+                           uint8_t* const yuv_b,
+                           int mb_x_start, int mb_x_end) {
   int j;
   int mb_x;
-  const int mb_y = ctx->mb_y_;
-  const int cache_id = ctx->id_;
-  uint8_t* const y_dst = dec->yuv_b_ + Y_OFF;
-  uint8_t* const u_dst = dec->yuv_b_ + U_OFF;
-  uint8_t* const v_dst = dec->yuv_b_ + V_OFF;
-  for (mb_x = 0; mb_x < dec->mb_w_; ++mb_x) {
-    const VP8MBData* const block = ctx->mb_data_ + mb_x;
+  const int shift = dec->reduce_shift_;
+  // Without loop filtering, only the macroblocks in [tl_mb_x_, br_mb_x_] are
+  // read back from the cache (for dithering or output), and the rows above
+  // tl_mb_y_ are not output.
+  const int cache_x_start = (dec->filter_type_ > 0) ? 0 : dec->tl_mb_x_;
+  const int use_cache = (dec->filter_type_ > 0) || dec->dither_ ||
+                        (mb_y >= dec->tl_mb_y_);
+  uint8_t* const y_dst = yuv_b + Y_OFF;
+  uint8_t* const u_dst = yuv_b + U_OFF;
+  uint8_t* const v_dst = yuv_b + V_OFF;
+  const int num_mb = VP8NumMBToReconstruct(dec, mb_y);
+  if (mb_x_end > num_mb) mb_x_end = num_mb;
+  for (mb_x = mb_x_start; mb_x < mb_x_end; ++mb_x) {
+    const VP8MBData* const block = mb_data + mb_x;
 
     // Rotate in the left samples from previously decoded block. We move four
     // pixels at a time for alignment reason, and because of in-loop filter.
@@ -775,7 +1121,12 @@ static void ReconstructRow(const VP8Decoder* const dec,
         VP8PredLuma16[pred_func](y_dst);
         if (bits != 0) {
           for (n = 0; n < 16; ++n, bits <<= 2) {
-            DoTransform(bits, coeffs + n * 16, y_dst + kScan[n]);
+            if (shift > 0 && IS_INNER_BLOCK(n)) {
+              DoReducedTransform(bits, coeffs + n * 16, y_dst + kScan[n],
+                                 shift);
+            } else {
+              DoTransform(bits, coeffs + n * 16, y_dst + kScan[n]);
+            }
           }
         }
       }
@@ -785,8 +1136,8 @@ static void ReconstructRow(const VP8Decoder* const dec,
         const int pred_func = CheckMode(mb_x, mb_y, block->uvmode_);
         VP8PredChroma8[pred_func](u_dst);
         VP8PredChroma8[pred_func](v_dst);
-        DoUVTransform(bits_uv >> 0, coeffs + 16 * 16, u_dst);
-        DoUVTransform(bits_uv >> 8, coeffs + 20 * 16, v_dst);
+        DoUVTransform(bits_uv >> 0, coeffs + 16 * 16, u_dst, shift);
+        DoUVTransform(bits_uv >> 8, coeffs + 20 * 16, v_dst, shift);
       }
 
       // stash away top samples for next block
@@ -796,23 +1147,42 @@ static void ReconstructRow(const VP8Decoder* const dec,
         memcpy(top_yuv[0].v, v_dst +  7 * BPS,  8);
       }
     }
+    if (!use_cache || mb_x < cache_x_start || mb_x > dec->br_mb_x_) {
+      continue;
+    }
     // Transfer reconstructed samples from yuv_b_ cache to final destination.
     {
       const int y_offset = cache_id * 16 * dec->cache_y_stride_;
       const int uv_offset = cache_id * 8 * dec->cache_uv_stride_;
-      uint8_t* const y_out = dec->cache_y_ + mb_x * 16 + y_offset;
-      uint8_t* const u_out = dec->cache_u_ + mb_x * 8 + uv_offset;
-      uint8_t* const v_out = dec->cache_v_ + mb_x * 8 + uv_offset;
-      for (j = 0; j < 16; ++j) {
-        memcpy(y_out + j * dec->cache_y_stride_, y_dst + j * BPS, 16);
-      }
-      for (j = 0; j < 8; ++j) {
-        memcpy(u_out + j * dec->cache_uv_stride_, u_dst + j * BPS, 8);
-        memcpy(v_out + j * dec->cache_uv_stride_, v_dst + j * BPS, 8);
+      uint8_t* const y_out = dec->cache_y_ + mb_x * (16 >> shift) + y_offset;
+      uint8_t* const u_out = dec->cache_u_ + mb_x * (8 >> shift) + uv_offset;
+      uint8_t* const v_out = dec->cache_v_ + mb_x * (8 >> shift) + uv_offset;
+      if (shift == 1) {
+        ReduceBlock(y_dst, 16, 1, y_out, dec->cache_y_stride_);
+        ReduceBlock(u_dst, 8, 1, u_out, dec->cache_uv_stride_);
+        ReduceBlock(v_dst, 8, 1, v_out, dec->cache_uv_stride_);
+      } else if (shift == 2) {
+        ReduceBlock(y_dst, 16, 2, y_out, dec->cache_y_stride_);
+        ReduceBlock(u_dst, 8, 2, u_out, dec->cache_uv_stride_);
+        ReduceBlock(v_dst, 8, 2, v_out, dec->cache_uv_stride_);
+      } else if (shift == 3) {
+        ReduceBlock(y_dst, 16, 3, y_out, dec->cache_y_stride_);
+        ReduceBlock(u_dst, 8, 3, u_out, dec->cache_uv_stride_);
+        ReduceBlock(v_dst, 8, 3, v_out, dec->cache_uv_stride_);
+      } else {
+        for (j = 0; j < 16; ++j) {
+          memcpy(y_out + j * dec->cache_y_stride_, y_dst + j * BPS, 16);
+        }
+        for (j = 0; j < 8; ++j) {
+          memcpy(u_out + j * dec->cache_uv_stride_, u_dst + j * BPS, 8);
+          memcpy(v_out + j * dec->cache_uv_stride_, v_dst + j * BPS, 8);
+        }
       }
     }
   }
 }
 
+#undef IS_INNER_BLOCK
+
 //------------------------------------------------------------------------------
 
@@ -24,6 +24,8 @@
 // Needs to be a power of 2.
 #define CHUNK_SIZE 4096
 #define MAX_MB_SIZE 4096
+// In segments mode, the WebP headers are first looked for in this many bytes.
+#define HEADERS_GATHER_SIZE 64
 
 //------------------------------------------------------------------------------
 // Data structures for memory and states
@@ -47,7 +49,8 @@ typedef enum {
 typedef enum {
   MEM_MODE_NONE = 0,
   MEM_MODE_APPEND,
-  MEM_MODE_MAP
+  MEM_MODE_MAP,
+  MEM_MODE_SEGMENTS
 } MemBufferMode;
 
 // storage for partition #0 and partial data (in a rolling fashion)
@@ -60,6 +63,16 @@ typedef struct {
 
   size_t part0_size_;         // size of partition #0
   const uint8_t* part0_buf_;  // buffer to store partition #0
+
+  // Segments mode: the caller's segments. Their beginning is gathered into
+  // buf_ as in append mode, up to the token partitions which are read in place.
+  VP8InputSegment* segs_;
+  int num_segs_;
+  int segs_size_;       // allocated size of segs_[]
+  size_t total_size_;   // total size of the segments
+  size_t gathered_;     // number of bytes gathered into buf_ so far
+  int gather_seg_;      // segment holding the next byte to gather...
+  size_t gather_pos_;   // ... and its position in that segment
 } MemBuffer;
 
 struct WebPIDecoder {
@@ -173,7 +186,7 @@ static int AppendToMemBuffer(WebPIDecoder* const idec,
   const uint8_t* const old_start = mem->buf_ + mem->start_;
   const uint8_t* const old_base =
       need_compressed_alpha ? dec->alpha_data_ : old_start;
-  assert(mem->mode_ == MEM_MODE_APPEND);
+  assert(mem->mode_ == MEM_MODE_APPEND || mem->mode_ == MEM_MODE_SEGMENTS);
   if (data_size > MAX_CHUNK_PAYLOAD) {
     // security safeguard: trying to allocate more than what the format
     // allows for a chunk should be considered a smoke smell.
@@ -183,7 +196,11 @@ static int AppendToMemBuffer(WebPIDecoder* const idec,
   if (mem->end_ + data_size > mem->buf_size_) {  // Need some free memory
     const size_t new_mem_start = old_start - old_base;
     const size_t current_size = MemDataSize(mem) + new_mem_start;
-    const uint64_t new_size = (uint64_t)current_size + data_size;
+    // Leave some room for the next calls, so that the total amount of data
+    // moved around stays linear in the input size when the decoder doesn't
+    // consume the data as it arrives (lossless, multiple partitions, ...).
+    const uint64_t min_size = (uint64_t)current_size + data_size;
+    const uint64_t new_size = min_size + (min_size >> 1);
     const uint64_t extra_size = (new_size + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
     uint8_t* const new_buf =
         (uint8_t*)WebPSafeMalloc(extra_size, sizeof(*new_buf));
@@ -220,20 +237,128 @@ static int RemapMemBuffer(WebPIDecoder* const idec,
   return 1;
 }
 
+// Adds a segment to the chain, and makes it visible to the token partitions'
+// bit readers that were already set up.
+static int AddSegment(WebPIDecoder* const idec,
+                      const uint8_t* const data, size_t data_size) {
+  MemBuffer* const mem = &idec->mem_;
+  assert(mem->mode_ == MEM_MODE_SEGMENTS);
+  if (data_size > MAX_CHUNK_PAYLOAD ||
+      mem->total_size_ + data_size > MAX_CHUNK_PAYLOAD) {
+    return 0;   // same safeguard as in AppendToMemBuffer()
+  }
+  if (mem->num_segs_ == mem->segs_size_) {
+    const int new_size = (mem->segs_size_ == 0) ? 16 : 2 * mem->segs_size_;
+    VP8InputSegment* const new_segs =
+        (VP8InputSegment*)WebPSafeMalloc(new_size, sizeof(*new_segs));
+    if (new_segs == NULL) return 0;
+    if (mem->num_segs_ > 0) {
+      memcpy(new_segs, mem->segs_, mem->num_segs_ * sizeof(*new_segs));
+    }
+    free(mem->segs_);
+    mem->segs_ = new_segs;
+    mem->segs_size_ = new_size;
+  }
+  mem->segs_[mem->num_segs_].buf_ = data;
+  mem->segs_[mem->num_segs_].size_ = data_size;
+  ++mem->num_segs_;
+  mem->total_size_ += data_size;
+
+  if (idec->dec_ != NULL && !idec->is_lossless_) {
+    VP8Decoder* const dec = (VP8Decoder*)idec->dec_;
+    int p;
+    for (p = 0; p < dec->num_parts_; ++p) {
+      VP8BitReader* const br = &dec->parts_[p];
+      if (br->segs_ != NULL) {
+        br->segs_ = mem->segs_;
+        br->num_segs_ = mem->num_segs_;
+      }
+    }
+  }
+  return 1;
+}
+
+// Copies the segments' data into buf_, up to byte 'end' of the input (or less
+// if not available yet).
+static int GatherSegments(WebPIDecoder* const idec, size_t end) {
+  MemBuffer* const mem = &idec->mem_;
+  if (end > mem->total_size_) end = mem->total_size_;
+  while (mem->gathered_ < end) {
+    const VP8InputSegment* const seg = &mem->segs_[mem->gather_seg_];
+    size_t size = seg->size_ - mem->gather_pos_;
+    if (size > end - mem->gathered_) size = end - mem->gathered_;
+    if (size > 0 && !AppendToMemBuffer(idec, seg->buf_ + mem->gather_pos_,
+                                       size)) {
+      return 0;
+    }
+    mem->gathered_ += size;
+    mem->gather_pos_ += size;
+    if (mem->gather_pos_ == seg->size_) {
+      ++mem->gather_seg_;
+      mem->gather_pos_ = 0;
+    }
+  }
+  return 1;
+}
+
+// Gathers what the current decoding state needs to find in buf_. The token
+// partitions are never gathered, and neither is partition #0 after it's
+// parsed: buf_ is not moved around anymore from then on.
+static int GatherForState(WebPIDecoder* const idec) {
+  MemBuffer* const mem = &idec->mem_;
+  // input position of buf_[start_]
+  const size_t start = mem->gathered_ - MemDataSize(mem);
+  size_t end = mem->total_size_;   // by default, everything available
+  switch (idec->state_) {
+    case STATE_WEBP_HEADER:
+      // The headers are parsed again from a prefix twice as large till they
+      // fit. The size of raw VP8/VP8L bitstreams (without RIFF container) is
+      // deduced from the data available though, so those are fully gathered.
+      if (!GatherSegments(idec, TAG_SIZE)) return 0;
+      if (mem->gathered_ >= TAG_SIZE && !memcmp(mem->buf_, "RIFF", TAG_SIZE)) {
+        end = (2 * mem->gathered_ < HEADERS_GATHER_SIZE) ? HEADERS_GATHER_SIZE
+                                                        : 2 * mem->gathered_;
+      }
+      break;
+    case STATE_VP8_HEADER:
+      end = start + VP8_FRAME_HEADER_SIZE;
+      break;
+    case STATE_VP8_PARTS0:
+      // partition #0 and the token partitions' size table.
+      end = start + mem->part0_size_ + 3 * (MAX_NUM_PARTITIONS - 1);
+      break;
+    case STATE_VP8_DATA:
+    case STATE_DONE:
+    case STATE_ERROR:
+      return 1;
+    default:   // lossless: the whole VP8L chunk is needed anyway.
+      break;
+  }
+  return GatherSegments(idec, end);
+}
+
 static void InitMemBuffer(MemBuffer* const mem) {
   mem->mode_       = MEM_MODE_NONE;
   mem->buf_        = NULL;
   mem->buf_size_   = 0;
   mem->part0_buf_  = NULL;
   mem->part0_size_ = 0;
+  mem->segs_       = NULL;
+  mem->num_segs_   = 0;
+  mem->segs_size_  = 0;
+  mem->total_size_ = 0;
+  mem->gathered_   = 0;
+  mem->gather_seg_ = 0;
+  mem->gather_pos_ = 0;
 }
 
 static void ClearMemBuffer(MemBuffer* const mem) {
   assert(mem);
-  if (mem->mode_ == MEM_MODE_APPEND) {
+  if (mem->mode_ == MEM_MODE_APPEND || mem->mode_ == MEM_MODE_SEGMENTS) {
     free(mem->buf_);
     free((void*)mem->part0_buf_);
   }
+  free(mem->segs_);
 }
 
 static int CheckMemBufferMode(MemBuffer* const mem, MemBufferMode expected) {
@@ -325,6 +450,7 @@ static VP8StatusCode DecodeWebPHeaders(WebPIDecoder* const idec) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
     idec->dec_ = dec;
+    dec->defer_parts_ = (idec->mem_.mode_ == MEM_MODE_SEGMENTS);
     dec->alpha_data_ = headers.alpha_data;
     dec->alpha_data_size_ = headers.alpha_data_size;
     ChangeState(idec, STATE_VP8_HEADER, headers.offset);
@@ -384,11 +510,60 @@ static int CopyParts0Data(WebPIDecoder* const idec) {
     br->buf_end_ = part0_buf + psize;
   } else {
     // Else: just keep pointers to the partition #0's data in dec_->br_.
+    // (in segments mode, buf_ doesn't move anymore past this point).
   }
   mem->start_ += psize;
   return 1;
 }
 
+// Segments mode: sets the token partitions' bit readers up to read from the
+// caller's segments directly. Returns false if the last partition hasn't
+// started yet, like ParsePartitions() would.
+static int SetupSegmentParts(WebPIDecoder* const idec) {
+  VP8Decoder* const dec = (VP8Decoder*)idec->dec_;
+  MemBuffer* const mem = &idec->mem_;
+  const int last_part = dec->num_parts_ - 1;
+  // the partitions' sizes follow partition #0 (VP8GetHeaders() checked them)
+  const uint8_t* const sz = mem->buf_ + mem->start_ + mem->part0_size_;
+  const size_t parts_start =
+      mem->gathered_ - MemDataSize(mem) + mem->part0_size_ + 3 * last_part;
+  size_t offset = parts_start;
+  int p;
+  for (p = 0; p < last_part; ++p) {
+    offset += sz[3 * p + 0] | (sz[3 * p + 1] << 8) | (sz[3 * p + 2] << 16);
+  }
+  if (offset >= mem->total_size_) return 0;
+
+  offset = parts_start;
+  for (p = 0; p < last_part; ++p) {
+    const size_t psize =
+        sz[3 * p + 0] | (sz[3 * p + 1] << 8) | (sz[3 * p + 2] << 16);
+    VP8InitBitReaderSegments(dec->parts_ + p, mem->segs_, mem->num_segs_,
+                             offset, psize);
+    offset += psize;
+  }
+  // The last partition runs till the end of the data.
+  VP8InitBitReaderSegments(dec->parts_ + last_part, mem->segs_, mem->num_segs_,
+                           offset, ~(size_t)0);
+  return 1;
+}
+
+// Number of bytes available to 'br' (only counted up to MAX_MB_SIZE or so in
+// segments mode).
+static size_t TokenDataSize(const WebPIDecoder* const idec,
+                            const VP8BitReader* const br) {
+  if (br->segs_ != NULL) {
+    size_t size = 0;
+    int i;
+    for (i = br->next_seg_; i < br->num_segs_ && size <= MAX_MB_SIZE; ++i) {
+      size += br->segs_[i].size_;
+    }
+    if (size > br->left_) size = br->left_;
+    return (br->buf_end_ - br->buf_) + size;
+  }
+  return MemDataSize(&idec->mem_);
+}
+
 static VP8StatusCode DecodePartition0(WebPIDecoder* const idec) {
   VP8Decoder* const dec = (VP8Decoder*)idec->dec_;
   VP8Io* const io = &idec->io_;
@@ -409,6 +584,9 @@ static VP8StatusCode DecodePartition0(WebPIDecoder* const idec) {
     }
     return IDecError(idec, status);
   }
+  if (idec->mem_.mode_ == MEM_MODE_SEGMENTS && !SetupSegmentParts(idec)) {
+    return VP8_STATUS_SUSPENDED;
+  }
 
   // Allocate/Verify output buffer now
   dec->status_ = WebPAllocateDecBuffer(io->width, io->height, params->options,
@@ -453,13 +631,15 @@ static VP8StatusCode DecodeRemaining(WebPIDecoder* const idec) {
       if (!VP8DecodeMB(dec, token_br)) {
         RestoreContext(&context, dec, token_br);
         // We shouldn't fail when MAX_MB data was available
-        if (dec->num_parts_ == 1 && MemDataSize(&idec->mem_) > MAX_MB_SIZE) {
+        if (dec->num_parts_ == 1 &&
+            TokenDataSize(idec, token_br) > MAX_MB_SIZE) {
           return IDecError(idec, VP8_STATUS_BITSTREAM_ERROR);
         }
         return VP8_STATUS_SUSPENDED;
       }
       // Release buffer only if there is only one partition
-      if (dec->num_parts_ == 1) {
+      // (the segments belong to the caller).
+      if (dec->num_parts_ == 1 && idec->mem_.mode_ != MEM_MODE_SEGMENTS) {
         idec->mem_.start_ = token_br->buf_ - idec->mem_.buf_;
         assert(idec->mem_.start_ <= idec->mem_.end_);
       }
@@ -564,6 +744,23 @@ static VP8StatusCode IDecode(WebPIDecoder* idec) {
   return status;
 }
 
+// Segments mode: the data needed contiguous by each state is gathered before
+// running it, till the decoding stalls.
+static VP8StatusCode IDecodeSegments(WebPIDecoder* const idec) {
+  VP8StatusCode status;
+  for (;;) {
+    const DecState state = idec->state_;
+    const size_t gathered = idec->mem_.gathered_;
+    if (!GatherForState(idec)) {
+      return VP8_STATUS_OUT_OF_MEMORY;
+    }
+    status = IDecode(idec);
+    if (status != VP8_STATUS_SUSPENDED) break;
+    if (idec->state_ == state && idec->mem_.gathered_ == gathered) break;
+  }
+  return status;
+}
+
 //------------------------------------------------------------------------------
 // Public functions
 
@@ -762,6 +959,25 @@ VP8StatusCode WebPIUpdate(WebPIDecoder* idec,
   return IDecode(idec);
 }
 
+VP8StatusCode WebPIAppendSegment(WebPIDecoder* idec,
+                                 const uint8_t* data, size_t data_size) {
+  VP8StatusCode status;
+  if (idec == NULL || data == NULL) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  status = IDecCheckStatus(idec);
+  if (status != VP8_STATUS_SUSPENDED) {
+    return status;
+  }
+  if (!CheckMemBufferMode(&idec->mem_, MEM_MODE_SEGMENTS)) {
+    return VP8_STATUS_INVALID_PARAM;
+  }
+  if (!AddSegment(idec, data, data_size)) {
+    return VP8_STATUS_OUT_OF_MEMORY;
+  }
+  return IDecodeSegments(idec);
+}
+
 //------------------------------------------------------------------------------
 
 static const WebPDecBuffer* GetOutputBuffer(const WebPIDecoder* const idec) {
@@ -311,6 +311,15 @@ static int InitYUVRescaler(const VP8Io* const io, WebPDecParams* const p) {
   const int uv_out_height = (out_height + 1) >> 1;
   const int uv_in_width  = (io->mb_w + 1) >> 1;
   const int uv_in_height = (io->mb_h + 1) >> 1;
+  // The rescaling ratios are those of the cropped area: with a reduced
+  // resolution, each input sample stands for (1 << reduce_shift) of its
+  // samples, and the partial ones of the right and bottom borders only
+  // contribute to the output in proportion.
+  const int shift = io->reduce_shift;
+  const int src_width  = io->crop_right - io->crop_left;
+  const int src_height = io->crop_bottom - io->crop_top;
+  const int uv_src_width  = (src_width + 1) >> 1;
+  const int uv_src_height = (src_height + 1) >> 1;
   const size_t work_size = 2 * out_width;   // scratch memory for luma rescaler
   const size_t uv_work_size = 2 * uv_out_width;  // and for each u/v ones
   size_t tmp_size;
@@ -327,24 +336,26 @@ static int InitYUVRescaler(const VP8Io* const io, WebPDecParams* const p) {
   work = (int32_t*)p->memory;
   WebPRescalerInit(&p->scaler_y, io->mb_w, io->mb_h,
                    buf->y, out_width, out_height, buf->y_stride, 1,
-                   io->mb_w, out_width, io->mb_h, out_height,
+                   src_width, out_width << shift,
+                   src_height, out_height << shift,
                    work);
   WebPRescalerInit(&p->scaler_u, uv_in_width, uv_in_height,
                    buf->u, uv_out_width, uv_out_height, buf->u_stride, 1,
-                   uv_in_width, uv_out_width,
-                   uv_in_height, uv_out_height,
+                   uv_src_width, uv_out_width << shift,
+                   uv_src_height, uv_out_height << shift,
                    work + work_size);
   WebPRescalerInit(&p->scaler_v, uv_in_width, uv_in_height,
                    buf->v, uv_out_width, uv_out_height, buf->v_stride, 1,
-                   uv_in_width, uv_out_width,
-                   uv_in_height, uv_out_height,
+                   uv_src_width, uv_out_width << shift,
+                   uv_src_height, uv_out_height << shift,
                    work + work_size + uv_work_size);
   p->emit = EmitRescaledYUV;
 
   if (has_alpha) {
     WebPRescalerInit(&p->scaler_a, io->mb_w, io->mb_h,
                      buf->a, out_width, out_height, buf->a_stride, 1,
-                     io->mb_w, out_width, io->mb_h, out_height,
+                     src_width, out_width << shift,
+                     src_height, out_height << shift,
                      work + work_size + 2 * uv_work_size);
     p->emit_alpha = EmitRescaledAlphaYUV;
   }
@@ -481,6 +492,11 @@ static int InitRGBRescaler(const VP8Io* const io, WebPDecParams* const p) {
   const int out_height = io->scaled_height;
   const int uv_in_width  = (io->mb_w + 1) >> 1;
   const int uv_in_height = (io->mb_h + 1) >> 1;
+  // Same rescaling ratios as in InitYUVRescaler(). The U/V planes use the Y
+  // plane's ones, with twice bigger samples.
+  const int shift = io->reduce_shift;
+  const int src_width  = io->crop_right - io->crop_left;
+  const int src_height = io->crop_bottom - io->crop_top;
   const size_t work_size = 2 * out_width;   // scratch memory for one rescaler
   int32_t* work;  // rescalers work area
   uint8_t* tmp;   // tmp storage for scaled YUV444 samples before RGB conversion
@@ -500,22 +516,26 @@ static int InitRGBRescaler(const VP8Io* const io, WebPDecParams* const p) {
   tmp = (uint8_t*)(work + tmp_size1);
   WebPRescalerInit(&p->scaler_y, io->mb_w, io->mb_h,
                    tmp + 0 * out_width, out_width, out_height, 0, 1,
-                   io->mb_w, out_width, io->mb_h, out_height,
+                   src_width, out_width << shift,
+                   src_height, out_height << shift,
                    work + 0 * work_size);
   WebPRescalerInit(&p->scaler_u, uv_in_width, uv_in_height,
                    tmp + 1 * out_width, out_width, out_height, 0, 1,
-                   io->mb_w, 2 * out_width, io->mb_h, 2 * out_height,
+                   src_width, 2 * out_width << shift,
+                   src_height, 2 * out_height << shift,
                    work + 1 * work_size);
   WebPRescalerInit(&p->scaler_v, uv_in_width, uv_in_height,
                    tmp + 2 * out_width, out_width, out_height, 0, 1,
-                   io->mb_w, 2 * out_width, io->mb_h, 2 * out_height,
+                   src_width, 2 * out_width << shift,
+                   src_height, 2 * out_height << shift,
                    work + 2 * work_size);
   p->emit = EmitRescaledRGB;
 
   if (has_alpha) {
     WebPRescalerInit(&p->scaler_a, io->mb_w, io->mb_h,
                      tmp + 3 * out_width, out_width, out_height, 0, 1,
-                     io->mb_w, out_width, io->mb_h, out_height,
+                     src_width, out_width << shift,
+                     src_height, out_height << shift,
                      work + 3 * work_size);
     p->emit_alpha = EmitRescaledAlphaRGB;
     if (p->output->colorspace == MODE_RGBA_4444 ||
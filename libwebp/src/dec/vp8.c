@@ -46,8 +46,12 @@ int VP8InitIoInternal(VP8Io* const io, int version) {
 VP8Decoder* VP8New(void) {
   VP8Decoder* const dec = (VP8Decoder*)calloc(1, sizeof(*dec));
   if (dec != NULL) {
+    int i;
     SetOk(dec);
     WebPWorkerInit(&dec->worker_);
+    for (i = 0; i < MAX_NUM_PARTITIONS; ++i) {
+      WebPWorkerInit(&dec->parse_workers_[i]);
+    }
     dec->ready_ = 0;
     dec->num_parts_ = 1;
   }
@@ -65,6 +69,26 @@ const char* VP8StatusMessage(VP8Decoder* const dec) {
   return dec->error_msg_;
 }
 
+void VP8Reset(VP8Decoder* const dec) {
+  void* const mem = dec->mem_;
+  const size_t mem_size = dec->mem_size_;
+  WebPWorker worker;
+  WebPWorker parse_workers[MAX_NUM_PARTITIONS];
+  ALPHDelete(dec->alph_dec_);
+  // The workers are idle between two pictures: they're put back in place
+  // untouched.
+  memcpy(&worker, &dec->worker_, sizeof(worker));
+  memcpy(parse_workers, dec->parse_workers_, sizeof(parse_workers));
+  memset(dec, 0, sizeof(*dec));
+  memcpy(&dec->worker_, &worker, sizeof(worker));
+  memcpy(dec->parse_workers_, parse_workers, sizeof(parse_workers));
+  dec->mem_ = mem;
+  dec->mem_size_ = mem_size;
+  SetOk(dec);
+  dec->ready_ = 0;
+  dec->num_parts_ = 1;
+}
+
 void VP8Delete(VP8Decoder* const dec) {
   if (dec != NULL) {
     VP8Clear(dec);
@@ -211,7 +235,7 @@ static VP8StatusCode ParsePartitions(VP8Decoder* const dec,
     sz += 3;
   }
   VP8InitBitReader(dec->parts_ + last_part, part_start, buf_end);
-  return (part_start < buf_end) ? VP8_STATUS_OK :
+  return (part_start < buf_end || dec->defer_parts_) ? VP8_STATUS_OK :
            VP8_STATUS_SUSPENDED;   // Init is ok, but there's not enough data
 }
 
@@ -307,6 +331,7 @@ int VP8GetHeaders(VP8Decoder* const dec, VP8Io* const io) {
     io->width = pic_hdr->width_;
     io->height = pic_hdr->height_;
     io->use_scaling  = 0;
+    io->reduce_shift = 0;
     io->use_cropping = 0;
     io->crop_top  = 0;
     io->crop_left = 0;
@@ -475,14 +500,16 @@ static WEBP_INLINE uint32_t NzCodeBits(uint32_t nz_coeffs, int nz, int dc_nz) {
   return nz_coeffs;
 }
 
-static int ParseResiduals(VP8Decoder* const dec,
-                          VP8MB* const mb, VP8BitReader* const token_br) {
-  VP8BandProbas (* const bands)[NUM_BANDS] = dec->proba_.bands_;
+// If 'parse_only' is true, the macroblock won't be reconstructed: the
+// coefficients are only decoded to keep the bitstream and contexts in sync.
+static int ParseResiduals(const VP8Decoder* const dec,
+                          VP8MB* const mb, VP8MB* const left_mb,
+                          VP8MBData* const block,
+                          VP8BitReader* const token_br, int parse_only) {
+  const VP8BandProbas (* const bands)[NUM_BANDS] = dec->proba_.bands_;
   const VP8BandProbas* ac_proba;
-  const VP8QuantMatrix* const q = &dec->dqm_[dec->segment_];
-  VP8MBData* const block = dec->mb_data_ + dec->mb_x_;
+  const VP8QuantMatrix* const q = &dec->dqm_[block->segment_];
   int16_t* dst = block->coeffs_;
-  VP8MB* const left_mb = dec->mb_info_ - 1;
   uint8_t tnz, lnz;
   uint32_t non_zero_y = 0;
   uint32_t non_zero_uv = 0;
@@ -490,18 +517,22 @@ static int ParseResiduals(VP8Decoder* const dec,
   uint32_t out_t_nz, out_l_nz;
   int first;
 
-  memset(dst, 0, 384 * sizeof(*dst));
+  if (!parse_only) {
+    memset(dst, 0, 384 * sizeof(*dst));
+  }
   if (!block->is_i4x4_) {    // parse DC
     int16_t dc[16] = { 0 };
     const int ctx = mb->nz_dc_ + left_mb->nz_dc_;
     const int nz = GetCoeffs(token_br, bands[1], ctx, q->y2_mat_, 0, dc);
     mb->nz_dc_ = left_mb->nz_dc_ = (nz > 0);
-    if (nz > 1) {   // more than just the DC -> perform the full transform
-      VP8TransformWHT(dc, dst);
-    } else {        // only DC is non-zero -> inlined simplified transform
-      int i;
-      const int dc0 = (dc[0] + 3) >> 3;
-      for (i = 0; i < 16 * 16; i += 16) dst[i] = dc0;
+    if (!parse_only) {
+      if (nz > 1) {   // more than just the DC -> perform the full transform
+        VP8TransformWHT(dc, dst);
+      } else {        // only DC is non-zero -> inlined simplified transform
+        int i;
+        const int dc0 = (dc[0] + 3) >> 3;
+        for (i = 0; i < 16 * 16; i += 16) dst[i] = dc0;
+      }
     }
     first = 1;
     ac_proba = bands[0];
@@ -569,12 +600,11 @@ static int ParseResiduals(VP8Decoder* const dec,
 //------------------------------------------------------------------------------
 // Main loop
 
-int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
+// Parse the segment, skip flag and intra modes of the current macroblock from
+// the first partition.
+static int ParseModes(VP8Decoder* const dec) {
   VP8BitReader* const br = &dec->br_;
-  VP8MB* const left = dec->mb_info_ - 1;
-  VP8MB* const mb = dec->mb_info_ + dec->mb_x_;
   VP8MBData* const block = dec->mb_data_ + dec->mb_x_;
-  int skip;
 
   // Note: we don't save segment map (yet), as we don't expect
   // to decode more than 1 keyframe.
@@ -584,15 +614,22 @@ int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
         VP8GetBit(br, dec->proba_.segments_[1]) :
         2 + VP8GetBit(br, dec->proba_.segments_[2]);
   }
-  skip = dec->use_skip_proba_ ? VP8GetBit(br, dec->skip_p_) : 0;
+  block->segment_ = dec->segment_;
+  block->skip_ = dec->use_skip_proba_ ? VP8GetBit(br, dec->skip_p_) : 0;
 
   VP8ParseIntraMode(br, dec);
-  if (br->eof_) {
-    return 0;
-  }
+  return !br->eof_;
+}
 
+// Parse the residuals of 'block' using the top and left contexts 'mb' and
+// 'left', and store its filter strength in 'finfo' if filtering is on.
+static int DecodeTokens(const VP8Decoder* const dec,
+                        VP8MB* const mb, VP8MB* const left,
+                        VP8MBData* const block, VP8FInfo* const finfo,
+                        VP8BitReader* const token_br, int parse_only) {
+  int skip = block->skip_;
   if (!skip) {
-    skip = ParseResiduals(dec, mb, token_br);
+    skip = ParseResiduals(dec, mb, left, block, token_br, parse_only);
   } else {
     left->nz_ = mb->nz_ = 0;
     if (!block->is_i4x4_) {
@@ -603,14 +640,50 @@ int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
   }
 
   if (dec->filter_type_ > 0) {  // store filter info
-    VP8FInfo* const finfo = dec->f_info_ + dec->mb_x_;
-    *finfo = dec->fstrengths_[dec->segment_][block->is_i4x4_];
+    *finfo = dec->fstrengths_[block->segment_][block->is_i4x4_];
     finfo->f_inner_ |= !skip;
   }
 
   return !token_br->eof_;
 }
 
+int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br) {
+  const int parse_only = (dec->mb_x_ >= VP8NumMBToReconstruct(dec, dec->mb_y_));
+  if (!ParseModes(dec)) {
+    return 0;
+  }
+  return DecodeTokens(dec, dec->mb_info_ + dec->mb_x_, dec->mb_info_ - 1,
+                      dec->mb_data_ + dec->mb_x_,
+                      (dec->filter_type_ > 0) ? dec->f_info_ + dec->mb_x_
+                                              : NULL,
+                      token_br, parse_only);
+}
+
+int VP8ParseIntraModeRow(VP8Decoder* const dec) {
+  for (; dec->mb_x_ < dec->mb_w_; ++dec->mb_x_) {
+    if (!ParseModes(dec)) {
+      return 0;
+    }
+  }
+  VP8InitScanline(dec);   // Prepare for next scanline
+  return 1;
+}
+
+int VP8DecodeTokens(const VP8Decoder* const dec, VP8ParseContext* const ctx) {
+  const int num_mb_to_reconstruct = VP8NumMBToReconstruct(dec, ctx->mb_y_);
+  int mb_x;
+  for (mb_x = ctx->mb_x_; mb_x < ctx->mb_x_end_; ++mb_x) {
+    VP8FInfo* const finfo =
+        (dec->filter_type_ > 0) ? ctx->f_info_ + mb_x : NULL;
+    if (!DecodeTokens(dec, dec->mb_info_ + mb_x, &ctx->left_,
+                      ctx->mb_data_ + mb_x, finfo, ctx->token_br_,
+                      mb_x >= num_mb_to_reconstruct)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
 void VP8InitScanline(VP8Decoder* const dec) {
   VP8MB* const left = dec->mb_info_ - 1;
   left->nz_ = 0;
@@ -620,21 +693,25 @@ void VP8InitScanline(VP8Decoder* const dec) {
 }
 
 static int ParseFrame(VP8Decoder* const dec, VP8Io* io) {
-  for (dec->mb_y_ = 0; dec->mb_y_ < dec->br_mb_y_; ++dec->mb_y_) {
-    // Parse bitstream for this row.
-    VP8BitReader* const token_br =
-        &dec->parts_[dec->mb_y_ & (dec->num_parts_ - 1)];
-    for (; dec->mb_x_ < dec->mb_w_; ++dec->mb_x_) {
-      if (!VP8DecodeMB(dec, token_br)) {
-        return VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
-                           "Premature end-of-file encountered.");
+  if (dec->mt_method_ == 3) {
+    if (!VP8ParallelDecode(dec, io)) return 0;
+  } else {
+    for (dec->mb_y_ = 0; dec->mb_y_ < dec->br_mb_y_; ++dec->mb_y_) {
+      // Parse bitstream for this row.
+      VP8BitReader* const token_br =
+          &dec->parts_[dec->mb_y_ & (dec->num_parts_ - 1)];
+      for (; dec->mb_x_ < dec->mb_w_; ++dec->mb_x_) {
+        if (!VP8DecodeMB(dec, token_br)) {
+          return VP8SetError(dec, VP8_STATUS_NOT_ENOUGH_DATA,
+                             "Premature end-of-file encountered.");
+        }
       }
-    }
-    VP8InitScanline(dec);   // Prepare for next scanline
+      VP8InitScanline(dec);   // Prepare for next scanline
 
-    // Reconstruct, filter and emit the row.
-    if (!VP8ProcessRow(dec, io)) {
-      return VP8SetError(dec, VP8_STATUS_USER_ABORT, "Output aborted.");
+      // Reconstruct, filter and emit the row.
+      if (!VP8ProcessRow(dec, io)) {
+        return VP8SetError(dec, VP8_STATUS_USER_ABORT, "Output aborted.");
+      }
     }
   }
   if (dec->mt_method_ > 0) {
@@ -694,11 +771,15 @@ int VP8Decode(VP8Decoder* const dec, VP8Io* const io) {
 }
 
 void VP8Clear(VP8Decoder* const dec) {
+  int i;
   if (dec == NULL) {
     return;
   }
-  if (dec->mt_method_ > 0) {
-    WebPWorkerEnd(&dec->worker_);
+  // The workers might have been started for a previous picture, see
+  // VP8Reset().
+  WebPWorkerEnd(&dec->worker_);
+  for (i = 0; i < MAX_NUM_PARTITIONS; ++i) {
+    WebPWorkerEnd(&dec->parse_workers_[i]);
   }
   ALPHDelete(dec->alph_dec_);
   dec->alph_dec_ = NULL;
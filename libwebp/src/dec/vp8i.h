@@ -102,6 +102,9 @@ enum { MB_FEATURE_TREE_PROBS = 3,
 // minimal width under which lossy multi-threading is always disabled
 #define MIN_WIDTH_FOR_THREADS 512
 
+// Largest reduction (1/8) for the approximate reduced-resolution decoding.
+#define MAX_REDUCE_SHIFT 3
+
 //------------------------------------------------------------------------------
 // Headers
 
@@ -195,6 +198,8 @@ typedef struct {
   uint32_t non_zero_y_;
   uint32_t non_zero_uv_;
   uint8_t dither_;      // local dithering strength (deduced from non_zero_*)
+  uint8_t segment_;     // segment of the macroblock
+  uint8_t skip_;        // true if the macroblock has no coefficients
 } VP8MBData;
 
 // Persistent information needed by the parallel processing
@@ -207,6 +212,20 @@ typedef struct {
   VP8Io io_;            // copy of the VP8Io to pass to put()
 } VP8ThreadContext;
 
+// Context of a thread parsing the rows of one token partition, with
+// mt_method_ = 3. The rows are decoded and reconstructed a range of
+// macroblocks at a time, behind the row above (see VP8ParallelDecode()).
+typedef struct {
+  int mb_y_;                // row being decoded
+  int id_;                  // cache row to reconstruct into
+  int mb_x_, mb_x_end_;     // range of macroblocks to process in the next job
+  VP8MB left_;              // left token contexts
+  VP8BitReader* token_br_;  // token partition of the row
+  VP8MBData* mb_data_;      // intra modes and coefficients of the row
+  VP8FInfo* f_info_;        // filter strengths of the row
+  uint8_t* yuv_b_;          // reconstruction work area (size = YUV_SIZE)
+} VP8ParseContext;
+
 // Saved top samples, per macroblock. Fits into a cache-line.
 typedef struct {
   uint8_t y[16], u[8], v[8];
@@ -233,10 +252,16 @@ struct VP8Decoder {
   WebPWorker worker_;
   int mt_method_;      // multi-thread method: 0=off, 1=[parse+recon][filter]
                        // 2=[parse][recon+filter]
+                       // 3=[modes][parse+recon]xN[filter]
   int cache_id_;       // current cache row
   int num_caches_;     // number of cached rows of 16 pixels (1, 2 or 3)
   VP8ThreadContext thread_ctx_;  // Thread context
 
+  // Threads parsing the token partitions in parallel (mt_method_ = 3)
+  int num_parse_threads_;
+  WebPWorker parse_workers_[MAX_NUM_PARTITIONS];
+  VP8ParseContext parse_ctx_[MAX_NUM_PARTITIONS];
+
   // dimension, in macroblock units.
   int mb_w_, mb_h_;
 
@@ -248,11 +273,18 @@ struct VP8Decoder {
   int num_parts_;
   // per-partition boolean decoders.
   VP8BitReader parts_[MAX_NUM_PARTITIONS];
+  // If true, VP8GetHeaders() only needs the partitions' sizes, not their data:
+  // the caller sets up parts_[] itself (incremental decoding from segments).
+  int defer_parts_;
 
   // Dithering strength, deduced from decoding options
   int dither_;                // whether to use dithering or not
   VP8Random dithering_rg_;    // random generator for dithering
 
+  // Reduced-resolution reconstruction, deduced from io->reduce_shift
+  int reduce_shift_;          // log2 of the reduction factor (0=off)
+  uint8_t* reduced_alpha_;    // alpha rows of the current output, reduced
+
   // dequantization (one set of DC/AC dequant factor per segment)
   VP8QuantMatrix dqm_[NUM_MB_SEGMENTS];
 
@@ -295,7 +327,7 @@ struct VP8Decoder {
   const uint8_t* alpha_data_;     // compressed alpha data (if present)
   size_t alpha_data_size_;
   int is_alpha_decoded_;  // true if alpha_data_ is decoded in alpha_plane_
-  uint8_t* alpha_plane_;        // output. Persistent, contains the whole data.
+  uint8_t* alpha_plane_;        // output: window of the last decoded rows
 
   // extensions
   int layer_colorspace_;
@@ -309,6 +341,17 @@ struct VP8Decoder {
 // in vp8.c
 int VP8SetError(VP8Decoder* const dec,
                 VP8StatusCode error, const char* const msg);
+// Resets the decoder for a new picture, as if returned by VP8New(), except
+// that the memory and the worker thread allocated so far are kept for reuse.
+void VP8Reset(VP8Decoder* const dec);
+
+// Parse the intra modes of a whole row from the first partition, into
+// dec->mb_data_. Returns false if there is not enough data.
+int VP8ParseIntraModeRow(VP8Decoder* const dec);
+// Decode the tokens of the macroblocks [ctx->mb_x_, ctx->mb_x_end_) of the
+// row, whose intra modes are already parsed. Returns false if there is not
+// enough data.
+int VP8DecodeTokens(const VP8Decoder* const dec, VP8ParseContext* const ctx);
 
 // in tree.c
 void VP8ResetProba(VP8Proba* const proba);
@@ -328,22 +371,38 @@ VP8StatusCode VP8EnterCritical(VP8Decoder* const dec, VP8Io* const io);
 // Must always be called in pair with VP8EnterCritical().
 // Returns false in case of error.
 int VP8ExitCritical(VP8Decoder* const dec, VP8Io* const io);
+// Return the number of macroblocks of row 'mb_y' (starting from the left) that
+// need to be reconstructed, given the br_mb_x_/br_mb_y_ limits set by
+// VP8EnterCritical(). The remaining ones on the right are only parsed.
+int VP8NumMBToReconstruct(const VP8Decoder* const dec, int mb_y);
 // Return the multi-threading method to use (0=off), depending
 // on options and bitstream size. Only for lossy decoding.
 int VP8GetThreadMethod(const WebPDecoderOptions* const options,
                        const WebPHeaderStructure* const headers,
                        int width, int height);
+// Switch to the parallel parsing of the token partitions (mt_method_ 3) if
+// requested by the options and if the bitstream has several partitions.
+// Must be called after VP8GetHeaders() and VP8GetThreadMethod().
+void VP8InitParseThreads(const WebPDecoderOptions* const options,
+                         VP8Decoder* const dec);
 // Initialize dithering post-process if needed.
 void VP8InitDithering(const WebPDecoderOptions* const options,
                       VP8Decoder* const dec);
 // Process the last decoded row (filtering + output).
 int VP8ProcessRow(VP8Decoder* const dec, VP8Io* const io);
+// Decode, reconstruct and emit all the rows with the parsing threads
+// (mt_method_ 3). Returns false in case of error.
+int VP8ParallelDecode(VP8Decoder* const dec, VP8Io* const io);
 // To be called at the start of a new scanline, to initialize predictors.
 void VP8InitScanline(VP8Decoder* const dec);
 // Decode one macroblock. Returns false if there is not enough data.
 int VP8DecodeMB(VP8Decoder* const dec, VP8BitReader* const token_br);
 
 // in alpha.c
+// Returns the number of rows of the alpha_plane_ window.
+int VP8AlphaPlaneRows(int width, int height);
+// Returns the 'num_rows' rows of alpha starting at 'row', which must follow
+// the ones of the previous call. Returns NULL in case of error.
 const uint8_t* VP8DecompressAlphaRows(VP8Decoder* const dec,
                                       int row, int num_rows);
 
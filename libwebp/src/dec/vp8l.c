@@ -153,29 +153,43 @@ static WEBP_INLINE int PlaneCodeToDistance(int xsize, int plane_code) {
 // to ReadSymbol, in order to pre-fetch enough bits.
 static WEBP_INLINE int ReadSymbol(const HuffmanTree* tree,
                                   VP8LBitReader* const br) {
-  const HuffmanTreeNode* node = tree->root_;
-  uint32_t bits = VP8LPrefetchBits(br);
-  int bitpos = br->bit_pos_;
-  // Check if we find the bit combination from the Huffman lookup table.
-  const int lut_ix = bits & (HUFF_LUT - 1);
-  const int lut_bits = tree->lut_bits_[lut_ix];
-  if (lut_bits <= HUFF_LUT_BITS) {
-    VP8LSetBitPos(br, bitpos + lut_bits);
-    return tree->lut_symbol_[lut_ix];
+  const HuffmanCode* table = tree->table_;
+  uint32_t val = VP8LPrefetchBits(br);
+  int nbits;
+  table += val & HUFFMAN_TABLE_MASK;
+  nbits = table->bits_ - HUFFMAN_TABLE_BITS;
+  if (nbits > 0) {   // Long code: look-up the rest in the second-level table.
+    VP8LSetBitPos(br, br->bit_pos_ + HUFFMAN_TABLE_BITS);
+    val = VP8LPrefetchBits(br);
+    table += table->value_;
+    table += val & ((1 << nbits) - 1);
+  }
+  VP8LSetBitPos(br, br->bit_pos_ + table->bits_);
+  return table->value_;
+}
+
+// Marks a packed-table entry holding a non-literal green symbol.
+#define BITS_SPECIAL_MARKER 0x100
+// Returned by ReadPackedSymbols() when a whole literal was decoded.
+#define PACKED_NON_LITERAL_CODE 0
+
+// Decodes a whole ARGB literal in one look-up and stores it into 'dst', or
+// returns the (non-literal) green symbol if that's what was read.
+static WEBP_INLINE int ReadPackedSymbols(const HTreeGroup* const group,
+                                         VP8LBitReader* const br,
+                                         uint32_t* const dst) {
+  const uint32_t val = VP8LPrefetchBits(br) & (HUFFMAN_PACKED_TABLE_SIZE - 1);
+  const HuffmanPackedCode code = group->packed_table_[val];
+  assert(group->use_packed_table_);
+  if (code.bits_ < BITS_SPECIAL_MARKER) {
+    VP8LSetBitPos(br, br->bit_pos_ + code.bits_);
+    *dst = code.value_;
+    return PACKED_NON_LITERAL_CODE;
+  } else {
+    VP8LSetBitPos(br, br->bit_pos_ + code.bits_ - BITS_SPECIAL_MARKER);
+    assert(code.value_ >= NUM_LITERAL_CODES);
+    return code.value_;
   }
-  node += tree->lut_jump_[lut_ix];
-  bitpos += HUFF_LUT_BITS;
-  bits >>= HUFF_LUT_BITS;
-
-  // Decode the value from a binary tree.
-  assert(node != NULL);
-  do {
-    node = HuffmanTreeNextNode(node, bits & 1);
-    bits >>= 1;
-    ++bitpos;
-  } while (HuffmanTreeNodeIsNotLeaf(node));
-  VP8LSetBitPos(br, bitpos);
-  return node->symbol_;
 }
 
 static int ReadHuffmanCodeLengths(
@@ -308,6 +322,58 @@ static void DeleteHtreeGroups(HTreeGroup* htree_groups, int num_htree_groups) {
   }
 }
 
+// Accumulates into 'huff' the symbol of 'tree' coded by the leading 'bits',
+// shifted by 'shift'. Returns the length of its code.
+static int AccumulateHCode(const HuffmanTree* const tree, uint32_t bits,
+                           int shift, HuffmanPackedCode* const huff) {
+  const HuffmanCode hcode = tree->table_[bits & HUFFMAN_TABLE_MASK];
+  assert(hcode.bits_ <= HUFFMAN_TABLE_BITS);
+  huff->bits_ += hcode.bits_;
+  huff->value_ |= (uint32_t)hcode.value_ << shift;
+  return hcode.bits_;
+}
+
+static void BuildPackedTable(HTreeGroup* const htree_group) {
+  const HuffmanTree* const htrees = htree_group->htrees_;
+  uint32_t code;
+  for (code = 0; code < HUFFMAN_PACKED_TABLE_SIZE; ++code) {
+    uint32_t bits = code;
+    HuffmanPackedCode* const huff = &htree_group->packed_table_[bits];
+    const HuffmanCode hcode = htrees[GREEN].table_[bits];
+    if (hcode.value_ >= NUM_LITERAL_CODES) {
+      huff->bits_ = hcode.bits_ + BITS_SPECIAL_MARKER;
+      huff->value_ = hcode.value_;
+    } else {
+      huff->bits_ = 0;
+      huff->value_ = 0;
+      bits >>= AccumulateHCode(&htrees[GREEN], bits, 8, huff);
+      bits >>= AccumulateHCode(&htrees[RED], bits, 16, huff);
+      bits >>= AccumulateHCode(&htrees[BLUE], bits, 0, huff);
+      bits >>= AccumulateHCode(&htrees[ALPHA], bits, 24, huff);
+      (void)bits;
+    }
+  }
+}
+
+// Sets up the literal shortcuts of a freshly read group of Huffman codes.
+static void SetupHtreeGroup(HTreeGroup* const htree_group) {
+  const HuffmanTree* const htrees = htree_group->htrees_;
+  const int red = HuffmanTreeGetTrivialSymbol(&htrees[RED]);
+  const int blue = HuffmanTreeGetTrivialSymbol(&htrees[BLUE]);
+  const int alpha = HuffmanTreeGetTrivialSymbol(&htrees[ALPHA]);
+  const int max_bits = htrees[GREEN].max_code_length_ +
+                       htrees[RED].max_code_length_ +
+                       htrees[BLUE].max_code_length_ +
+                       htrees[ALPHA].max_code_length_;
+  htree_group->is_trivial_literal_ = (red >= 0 && blue >= 0 && alpha >= 0);
+  htree_group->literal_arb_ = htree_group->is_trivial_literal_ ?
+      ((uint32_t)alpha << 24) | (red << 16) | blue : 0;
+  // A packed look-up fetches HUFFMAN_PACKED_BITS bits, which must cover the
+  // four literal codes.
+  htree_group->use_packed_table_ = (max_bits < HUFFMAN_PACKED_BITS);
+  if (htree_group->use_packed_table_) BuildPackedTable(htree_group);
+}
+
 static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
                             int color_cache_bits, int allow_recursion) {
   int i, j;
@@ -359,6 +425,7 @@ static int ReadHuffmanCodes(VP8LDecoder* const dec, int xsize, int ysize,
       }
       if (!ReadHuffmanCode(alphabet_size, dec, htrees + j)) goto Error;
     }
+    SetupHtreeGroup(&htree_groups[i]);
   }
 
   // All OK. Finalize pointers and return.
@@ -650,7 +717,9 @@ static void ApplyInverseTransformsAlpha(VP8LDecoder* const dec, int num_rows,
   const int start_row = dec->last_row_;
   const int end_row = start_row + num_rows;
   const uint8_t* rows_in = rows;
-  uint8_t* rows_out = (uint8_t*)dec->io_->opaque + dec->io_->width * start_row;
+  const ALPHDecoder* const alph_dec = (const ALPHDecoder*)dec->io_->opaque;
+  uint8_t* const rows_out =
+      alph_dec->output_ + dec->io_->width * (start_row - alph_dec->output_row_);
   VP8LTransform* const transform = &dec->transforms_[0];
   assert(dec->next_transform_ == 1);
   assert(transform->type_ == COLOR_INDEXING_TRANSFORM);
@@ -661,7 +730,8 @@ static void ApplyInverseTransformsAlpha(VP8LDecoder* const dec, int num_rows,
 // Processes (transforms, scales & color-converts) the rows decoded after the
 // last call.
 static void ProcessRows(VP8LDecoder* const dec, int row) {
-  const uint32_t* const rows = dec->pixels_ + dec->width_ * dec->last_row_;
+  const uint32_t* const rows =
+      dec->pixels_ + dec->width_ * (dec->last_row_ - dec->window_start_);
   const int num_rows = row - dec->last_row_;
 
   if (num_rows <= 0) return;  // Nothing to be done.
@@ -700,6 +770,25 @@ static void ProcessRows(VP8LDecoder* const dec, int row) {
   assert(dec->last_row_ <= dec->height_);
 }
 
+// Worker hook: processes the rows up to dec->proc_row_.
+static int ProcessRowsHook(void* arg1, void* arg2) {
+  VP8LDecoder* const dec = (VP8LDecoder*)arg1;
+  (void)arg2;
+  ProcessRows(dec, dec->proc_row_);
+  return 1;
+}
+
+// Multi-threaded version of ProcessRows(): hands the rows decoded since the
+// last call over to the worker, once it's done with the previous ones. The
+// worker only reads these rows, which the decoding loop won't overwrite
+// unless the window is slid.
+static void ProcessRowsMT(VP8LDecoder* const dec, int row) {
+  WebPWorker* const worker = &dec->worker_;
+  WebPWorkerSync(worker);
+  dec->proc_row_ = row;
+  WebPWorkerLaunch(worker);
+}
+
 // Row-processing for the special case when alpha data contains only one
 // transform (color indexing), and trivial non-green literals.
 static int Is8bOptimizable(const VP8LMetadata* const hdr) {
@@ -709,23 +798,61 @@ static int Is8bOptimizable(const VP8LMetadata* const hdr) {
   // call to ReadSymbol() for red/blue/alpha channels.
   for (i = 0; i < hdr->num_htree_groups_; ++i) {
     const HuffmanTree* const htrees = hdr->htree_groups_[i].htrees_;
-    if (htrees[RED].num_nodes_ > 1) return 0;
-    if (htrees[BLUE].num_nodes_ > 1) return 0;
-    if (htrees[ALPHA].num_nodes_ > 1) return 0;
+    if (htrees[RED].num_symbols_ > 1) return 0;
+    if (htrees[BLUE].num_symbols_ > 1) return 0;
+    if (htrees[ALPHA].num_symbols_ > 1) return 0;
   }
   return 1;
 }
 
 static void ExtractPalettedAlphaRows(VP8LDecoder* const dec, int row) {
   const int num_rows = row - dec->last_row_;
-  const uint8_t* const in =
-      (uint8_t*)dec->pixels_ + dec->width_ * dec->last_row_;
+  const uint8_t* const in = (uint8_t*)dec->pixels_ +
+                            dec->width_ * (dec->last_row_ - dec->window_start_);
   if (num_rows > 0) {
     ApplyInverseTransformsAlpha(dec, num_rows, in);
   }
   dec->last_row_ = dec->last_out_row_ = row;
 }
 
+// Returns the number of rows preceding the current one that a backward
+// reference can reach.
+static WEBP_INLINE int GetHistoryRows(int width) {
+  // Plane codes reach at most 7 rows and 8 pixels back.
+  return (MAX_COPY_DISTANCE > 7 * width + 8) ?
+      (MAX_COPY_DISTANCE + width - 1) / width : 8;
+}
+
+// Returns the number of pixels of the rows before 'last_row' that fit in
+// dec->pixels_, which starts at row 'dec->window_start_'.
+static int GetWindowEnd(const VP8LDecoder* const dec, int width,
+                        int last_row) {
+  int num_rows = last_row - dec->window_start_;
+  if (dec->window_rows_ > 0 && num_rows > dec->window_rows_) {
+    num_rows = dec->window_rows_;
+  }
+  return width * num_rows;
+}
+
+// Drops the rows of the sliding window that are already processed and out of
+// reach of any backward reference, and moves the 'num_pixels' - dropped ones
+// left to the start of the window. Returns the number of pixels dropped.
+static int SlideWindow(VP8LDecoder* const dec, int num_pixels,
+                       size_t pixel_size) {
+  int num_rows, num_dropped;
+  uint8_t* const pixels = (uint8_t*)dec->pixels_;
+  // The worker (if any) must be done with the rows being moved. This also
+  // makes 'last_row_' up-to-date.
+  WebPWorkerSync(&dec->worker_);
+  num_rows = dec->last_row_ - GetHistoryRows(dec->width_) - dec->window_start_;
+  num_dropped = num_rows * dec->width_;
+  if (num_rows <= 0) return 0;
+  memmove(pixels, pixels + num_dropped * pixel_size,
+          (num_pixels - num_dropped) * pixel_size);
+  dec->window_start_ += num_rows;
+  return num_dropped;
+}
+
 static int DecodeAlphaData(VP8LDecoder* const dec, uint8_t* const data,
                            int width, int height, int last_row) {
   int ok = 1;
@@ -734,9 +861,15 @@ static int DecodeAlphaData(VP8LDecoder* const dec, uint8_t* const data,
   VP8LBitReader* const br = &dec->br_;
   VP8LMetadata* const hdr = &dec->hdr_;
   const HTreeGroup* htree_group = GetHtreeGroupForPos(hdr, col, row);
-  int pos = dec->last_pixel_;         // current position
-  const int end = width * height;     // End of data
-  const int last = width * last_row;  // Last pixel to decode
+  // current position in 'data'
+  int pos = dec->last_pixel_ - dec->window_start_ * width;
+  int end = GetWindowEnd(dec, width, height);     // End of data
+  int last = GetWindowEnd(dec, width, last_row);  // Last pixel to decode
+  // In windowed mode, the window is slid whenever less than this number of
+  // pixels is left: enough for the next row-block and a maximal copy.
+  const int window_margin =
+      (dec->window_rows_ > 0) ? NUM_ARGB_CACHE_ROWS * width + MAX_COPY_LENGTH
+                              : 0;
   const int len_code_limit = NUM_LITERAL_CODES + NUM_LENGTH_CODES;
   const int mask = hdr->huffman_mask_;
   assert(htree_group != NULL);
@@ -760,6 +893,11 @@ static int DecodeAlphaData(VP8LDecoder* const dec, uint8_t* const data,
         ++row;
         if (row % NUM_ARGB_CACHE_ROWS == 0) {
           ExtractPalettedAlphaRows(dec, row);
+          if (end - pos < window_margin) {
+            pos -= SlideWindow(dec, pos, sizeof(*data));
+            end = GetWindowEnd(dec, width, height);
+            last = GetWindowEnd(dec, width, last_row);
+          }
         }
       }
     } else if (code < len_code_limit) {  // Backward reference
@@ -784,6 +922,11 @@ static int DecodeAlphaData(VP8LDecoder* const dec, uint8_t* const data,
         ++row;
         if (row % NUM_ARGB_CACHE_ROWS == 0) {
           ExtractPalettedAlphaRows(dec, row);
+          if (end - pos < window_margin) {
+            pos -= SlideWindow(dec, pos, sizeof(*data));
+            end = GetWindowEnd(dec, width, height);
+            last = GetWindowEnd(dec, width, last_row);
+          }
         }
       }
       if (pos < last && (col & mask)) {
@@ -805,8 +948,8 @@ static int DecodeAlphaData(VP8LDecoder* const dec, uint8_t* const data,
     dec->status_ = br->eos_ ? VP8_STATUS_SUSPENDED
                             : VP8_STATUS_BITSTREAM_ERROR;
   } else {
-    dec->last_pixel_ = (int)pos;
-    if (pos == end) dec->state_ = READ_DATA;
+    dec->last_pixel_ = pos + dec->window_start_ * width;
+    if (dec->last_pixel_ == width * height) dec->state_ = READ_DATA;
   }
   return ok;
 }
@@ -820,10 +963,15 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
   VP8LBitReader* const br = &dec->br_;
   VP8LMetadata* const hdr = &dec->hdr_;
   HTreeGroup* htree_group = GetHtreeGroupForPos(hdr, col, row);
-  uint32_t* src = data + dec->last_pixel_;
+  uint32_t* src = data + dec->last_pixel_ - dec->window_start_ * width;
   uint32_t* last_cached = src;
-  uint32_t* const src_end = data + width * height;     // End of data
-  uint32_t* const src_last = data + width * last_row;  // Last pixel to decode
+  uint32_t* src_end = data + GetWindowEnd(dec, width, height);   // End of data
+  uint32_t* src_last = data + GetWindowEnd(dec, width, last_row);  // Last pixel
+  // In windowed mode, the window is slid whenever less than this number of
+  // pixels is left: enough for the next row-block and a maximal copy.
+  const ptrdiff_t window_margin =
+      (dec->window_rows_ > 0) ? NUM_ARGB_CACHE_ROWS * width + MAX_COPY_LENGTH
+                              : 0;
   const int len_code_limit = NUM_LITERAL_CODES + NUM_LENGTH_CODES;
   const int color_cache_limit = len_code_limit + hdr->color_cache_size_;
   VP8LColorCache* const color_cache =
@@ -841,15 +989,24 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
       htree_group = GetHtreeGroupForPos(hdr, col, row);
     }
     VP8LFillBitWindow(br);
-    code = ReadSymbol(&htree_group->htrees_[GREEN], br);
+    if (htree_group->use_packed_table_) {
+      code = ReadPackedSymbols(htree_group, br, src);
+      if (code == PACKED_NON_LITERAL_CODE) goto AdvanceByOne;
+    } else {
+      code = ReadSymbol(&htree_group->htrees_[GREEN], br);
+    }
     if (code < NUM_LITERAL_CODES) {  // Literal
-      int red, green, blue, alpha;
-      red = ReadSymbol(&htree_group->htrees_[RED], br);
-      green = code;
-      VP8LFillBitWindow(br);
-      blue = ReadSymbol(&htree_group->htrees_[BLUE], br);
-      alpha = ReadSymbol(&htree_group->htrees_[ALPHA], br);
-      *src = (alpha << 24) | (red << 16) | (green << 8) | blue;
+      if (htree_group->is_trivial_literal_) {
+        *src = htree_group->literal_arb_ | (code << 8);
+      } else {
+        int red, green, blue, alpha;
+        red = ReadSymbol(&htree_group->htrees_[RED], br);
+        green = code;
+        VP8LFillBitWindow(br);
+        blue = ReadSymbol(&htree_group->htrees_[BLUE], br);
+        alpha = ReadSymbol(&htree_group->htrees_[ALPHA], br);
+        *src = (alpha << 24) | (red << 16) | (green << 8) | blue;
+      }
     AdvanceByOne:
       ++src;
       ++col;
@@ -858,6 +1015,14 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
         ++row;
         if ((row % NUM_ARGB_CACHE_ROWS == 0) && (process_func != NULL)) {
           process_func(dec, row);
+          if (src_end - src < window_margin) {
+            const int num_dropped =
+                SlideWindow(dec, (int)(src - data), sizeof(*data));
+            src -= num_dropped;
+            last_cached -= num_dropped;
+            src_end = data + GetWindowEnd(dec, width, height);
+            src_last = data + GetWindowEnd(dec, width, last_row);
+          }
         }
         if (color_cache != NULL) {
           while (last_cached < src) {
@@ -887,6 +1052,14 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
         ++row;
         if ((row % NUM_ARGB_CACHE_ROWS == 0) && (process_func != NULL)) {
           process_func(dec, row);
+          if (src_end - src < window_margin) {
+            const int num_dropped =
+                SlideWindow(dec, (int)(src - data), sizeof(*data));
+            src -= num_dropped;
+            last_cached -= num_dropped;
+            src_end = data + GetWindowEnd(dec, width, height);
+            src_last = data + GetWindowEnd(dec, width, last_row);
+          }
         }
       }
       if (src < src_last) {
@@ -921,8 +1094,8 @@ static int DecodeImageData(VP8LDecoder* const dec, uint32_t* const data,
     dec->status_ = br->eos_ ? VP8_STATUS_SUSPENDED
                             : VP8_STATUS_BITSTREAM_ERROR;
   } else {
-    dec->last_pixel_ = (int)(src - data);
-    if (src == src_end) dec->state_ = READ_DATA;
+    dec->last_pixel_ = (int)(src - data) + dec->window_start_ * width;
+    if (dec->last_pixel_ == width * height) dec->state_ = READ_DATA;
   }
   return ok;
 }
@@ -1040,6 +1213,7 @@ VP8LDecoder* VP8LNew(void) {
   dec->status_ = VP8_STATUS_OK;
   dec->action_ = READ_DIM;
   dec->state_ = READ_DIM;
+  WebPWorkerInit(&dec->worker_);
 
   VP8LDspInit();  // Init critical function pointers.
 
@@ -1051,8 +1225,6 @@ void VP8LClear(VP8LDecoder* const dec) {
   if (dec == NULL) return;
   ClearMetadata(&dec->hdr_);
 
-  free(dec->pixels_);
-  dec->pixels_ = NULL;
   for (i = 0; i < dec->next_transform_; ++i) {
     ClearTransform(&dec->transforms_[i]);
   }
@@ -1065,9 +1237,27 @@ void VP8LClear(VP8LDecoder* const dec) {
   dec->output_ = NULL;   // leave no trace behind
 }
 
+void VP8LReset(VP8LDecoder* const dec) {
+  uint32_t* const pixels = dec->pixels_;
+  const size_t pixels_size = dec->pixels_size_;
+  WebPWorker worker;
+  VP8LClear(dec);
+  // The worker is idle between two pictures, and can be kept as is.
+  memcpy(&worker, &dec->worker_, sizeof(worker));
+  memset(dec, 0, sizeof(*dec));
+  memcpy(&dec->worker_, &worker, sizeof(worker));
+  dec->pixels_ = pixels;
+  dec->pixels_size_ = pixels_size;
+  dec->status_ = VP8_STATUS_OK;
+  dec->action_ = READ_DIM;
+  dec->state_ = READ_DIM;
+}
+
 void VP8LDelete(VP8LDecoder* const dec) {
   if (dec != NULL) {
     VP8LClear(dec);
+    WebPWorkerEnd(&dec->worker_);
+    free(dec->pixels_);
     free(dec);
   }
 }
@@ -1178,9 +1368,40 @@ static int DecodeImageStream(int xsize, int ysize,
 }
 
 //------------------------------------------------------------------------------
+// Returns the number of rows of the sliding window used to decode the main
+// image, or 0 if the whole image is not larger than such a window.
+static int GetWindowRows(int width, int height) {
+  const int history = GetHistoryRows(width);
+  // Twice the history, so that the window is slid at most once per
+  // 'history' rows decoded.
+  const int num_rows = 2 * history + NUM_ARGB_CACHE_ROWS +
+                       (MAX_COPY_LENGTH + width - 1) / width + 2;
+  return (num_rows < height) ? num_rows : 0;
+}
+
+// Makes dec->pixels_ hold at least 'num_pixels' samples of 'pixel_size' bytes,
+// reusing the buffer of the previous picture if it's large enough.
+static int AllocatePixels(VP8LDecoder* const dec, uint64_t num_pixels,
+                          size_t pixel_size) {
+  if (num_pixels * pixel_size > dec->pixels_size_) {
+    free(dec->pixels_);
+    dec->pixels_size_ = 0;
+    dec->pixels_ = (uint32_t*)WebPSafeMalloc(num_pixels, pixel_size);
+    if (dec->pixels_ == NULL) {
+      dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
+      return 0;
+    }
+    // down-cast is ok, thanks to WebPSafeMalloc() above.
+    dec->pixels_size_ = (size_t)(num_pixels * pixel_size);
+  }
+  return 1;
+}
+
 // Allocate internal buffers dec->pixels_ and dec->argb_cache_.
 static int AllocateInternalBuffers32b(VP8LDecoder* const dec, int final_width) {
-  const uint64_t num_pixels = (uint64_t)dec->width_ * dec->height_;
+  const int num_rows = (dec->window_rows_ > 0) ? dec->window_rows_
+                                               : dec->height_;
+  const uint64_t num_pixels = (uint64_t)dec->width_ * num_rows;
   // Scratch buffer corresponding to top-prediction row for transforming the
   // first row in the row-blocks. Not needed for paletted alpha.
   const uint64_t cache_top_pixels = (uint16_t)final_width;
@@ -1190,25 +1411,33 @@ static int AllocateInternalBuffers32b(VP8LDecoder* const dec, int final_width) {
       num_pixels + cache_top_pixels + cache_pixels;
 
   assert(dec->width_ <= final_width);
-  dec->pixels_ = (uint32_t*)WebPSafeMalloc(total_num_pixels, sizeof(uint32_t));
-  if (dec->pixels_ == NULL) {
+  if (!AllocatePixels(dec, total_num_pixels, sizeof(uint32_t))) {
     dec->argb_cache_ = NULL;    // for sanity check
-    dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
     return 0;
   }
   dec->argb_cache_ = dec->pixels_ + num_pixels + cache_top_pixels;
   return 1;
 }
 
+// Returns true if the decoded rows should be processed in a separate thread.
+static int UseThreads(const WebPDecoderOptions* const options, int height) {
+#if defined(WEBP_USE_THREAD)
+  // With a single row-block, there's nothing to overlap.
+  return (options != NULL && options->use_threads &&
+          height > NUM_ARGB_CACHE_ROWS);
+#else
+  (void)options;
+  (void)height;
+  return 0;
+#endif
+}
+
 static int AllocateInternalBuffers8b(VP8LDecoder* const dec) {
-  const uint64_t total_num_pixels = (uint64_t)dec->width_ * dec->height_;
+  const int num_rows = (dec->window_rows_ > 0) ? dec->window_rows_
+                                               : dec->height_;
+  const uint64_t total_num_pixels = (uint64_t)dec->width_ * num_rows;
   dec->argb_cache_ = NULL;    // for sanity check
-  dec->pixels_ = (uint32_t*)WebPSafeMalloc(total_num_pixels, sizeof(uint8_t));
-  if (dec->pixels_ == NULL) {
-    dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
-    return 0;
-  }
-  return 1;
+  return AllocatePixels(dec, total_num_pixels, sizeof(uint8_t));
 }
 
 //------------------------------------------------------------------------------
@@ -1216,16 +1445,19 @@ static int AllocateInternalBuffers8b(VP8LDecoder* const dec) {
 // Special row-processing that only stores the alpha data.
 static void ExtractAlphaRows(VP8LDecoder* const dec, int row) {
   const int num_rows = row - dec->last_row_;
-  const uint32_t* const in = dec->pixels_ + dec->width_ * dec->last_row_;
+  const uint32_t* const in =
+      dec->pixels_ + dec->width_ * (dec->last_row_ - dec->window_start_);
 
   if (num_rows <= 0) return;  // Nothing to be done.
   ApplyInverseTransforms(dec, num_rows, in);
 
   // Extract alpha (which is stored in the green plane).
   {
+    const ALPHDecoder* const alph_dec = (const ALPHDecoder*)dec->io_->opaque;
     const int width = dec->io_->width;      // the final width (!= dec->width_)
     const int cache_pixs = width * num_rows;
-    uint8_t* const dst = (uint8_t*)dec->io_->opaque + width * dec->last_row_;
+    uint8_t* const dst =
+        alph_dec->output_ + width * (dec->last_row_ - alph_dec->output_row_);
     const uint32_t* const src = dec->argb_cache_;
     int i;
     for (i = 0; i < cache_pixs; ++i) dst[i] = (src[i] >> 8) & 0xff;
@@ -1234,8 +1466,7 @@ static void ExtractAlphaRows(VP8LDecoder* const dec, int row) {
 }
 
 int VP8LDecodeAlphaHeader(ALPHDecoder* const alph_dec,
-                          const uint8_t* const data, size_t data_size,
-                          uint8_t* const output) {
+                          const uint8_t* const data, size_t data_size) {
   int ok = 0;
   VP8LDecoder* dec;
   VP8Io* io;
@@ -1251,7 +1482,7 @@ int VP8LDecodeAlphaHeader(ALPHDecoder* const alph_dec,
 
   VP8InitIo(io);
   WebPInitCustomIo(NULL, io);  // Just a sanity Init. io won't be used.
-  io->opaque = output;
+  io->opaque = alph_dec;     // for the output rows
   io->width = alph_dec->width_;
   io->height = alph_dec->height_;
 
@@ -1263,6 +1494,9 @@ int VP8LDecodeAlphaHeader(ALPHDecoder* const alph_dec,
     goto Err;
   }
 
+  // As for the main image, only keep the rows that can still be referenced.
+  dec->window_rows_ = GetWindowRows(dec->width_, dec->height_);
+
   // Special case: if alpha data uses only the color indexing transform and
   // doesn't use color cache (a frequent case), we will use DecodeAlphaData()
   // method that only needs allocation of 1 byte per pixel (alpha channel).
@@ -1337,6 +1571,7 @@ int VP8LDecodeHeader(VP8LDecoder* const dec, VP8Io* const io) {
 int VP8LDecodeImage(VP8LDecoder* const dec) {
   VP8Io* io = NULL;
   WebPDecParams* params = NULL;
+  ProcessRowsFunc process_func = ProcessRows;
 
   // Sanity checks.
   if (dec == NULL) return 0;
@@ -1354,16 +1589,33 @@ int VP8LDecodeImage(VP8LDecoder* const dec) {
     goto Err;
   }
 
+  // Only keep the rows that can still be referenced, instead of the whole
+  // image: the memory needed then grows with the width only.
+  dec->window_rows_ = GetWindowRows(dec->width_, dec->height_);
+  dec->window_start_ = 0;
   if (!AllocateInternalBuffers32b(dec, io->width)) goto Err;
 
   if (io->use_scaling && !AllocateAndInitRescaler(dec, io)) goto Err;
 
+  if (UseThreads(params->options, dec->height_)) {
+    WebPWorker* const worker = &dec->worker_;
+    if (!WebPWorkerReset(worker)) {
+      dec->status_ = VP8_STATUS_OUT_OF_MEMORY;
+      goto Err;
+    }
+    worker->hook = ProcessRowsHook;
+    worker->data1 = dec;
+    worker->data2 = NULL;
+    process_func = ProcessRowsMT;
+  }
+
   // Decode.
   dec->action_ = READ_DATA;
   if (!DecodeImageData(dec, dec->pixels_, dec->width_, dec->height_,
-                       dec->height_, ProcessRows)) {
+                       dec->height_, process_func)) {
     goto Err;
   }
+  WebPWorkerSync(&dec->worker_);  // Wait for the last rows.
 
   // Cleanup.
   params->last_y = dec->last_out_row_;
@@ -1371,6 +1623,7 @@ int VP8LDecodeImage(VP8LDecoder* const dec) {
   return 1;
 
  Err:
+  WebPWorkerSync(&dec->worker_);  // The worker may still use the buffers.
   VP8LClear(dec);
   assert(dec->status_ != VP8_STATUS_OK);
   return 0;
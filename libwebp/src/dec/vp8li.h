@@ -20,12 +20,18 @@
 #include "../utils/bit_reader.h"
 #include "../utils/color_cache.h"
 #include "../utils/huffman.h"
+#include "../utils/thread.h"
 #include "../webp/format_constants.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Largest copy length and distance (in pixels) that can be coded with the
+// backward references.
+#define MAX_COPY_LENGTH     4096
+#define MAX_COPY_DISTANCE   ((1 << 20) - 120)
+
 typedef enum {
   READ_DATA = 0,
   READ_HDR = 1,
@@ -41,8 +47,23 @@ struct VP8LTransform {
   uint32_t              *data_;   // transform data.
 };
 
+// Packed ARGB literal (or green non-literal symbol) read in a single look-up.
+#define HUFFMAN_PACKED_BITS 6
+#define HUFFMAN_PACKED_TABLE_SIZE (1u << HUFFMAN_PACKED_BITS)
+typedef struct {
+  int      bits_;   // number of bits used, or BITS_SPECIAL_MARKER + green bits
+                    // if 'value_' is a non-literal green symbol.
+  uint32_t value_;  // ARGB value of the literal, or the green symbol.
+} HuffmanPackedCode;
+
 typedef struct {
   HuffmanTree htrees_[HUFFMAN_CODES_PER_META_CODE];
+  int      is_trivial_literal_;  // True if red, blue & alpha codes are trivial.
+  uint32_t literal_arb_;         // If is_trivial_literal_, the A/R/B values
+                                 // already shifted in place.
+  int      use_packed_table_;    // True if all the literal codes are short
+                                 // enough to use the packed_table_.
+  HuffmanPackedCode packed_table_[HUFFMAN_PACKED_TABLE_SIZE];
 } HTreeGroup;
 
 typedef struct {
@@ -68,6 +89,7 @@ struct VP8LDecoder {
 
   uint32_t        *pixels_;        // Internal data: either uint8_t* for alpha
                                    // or uint32_t* for BGRA.
+  size_t           pixels_size_;   // allocated size of pixels_, in bytes.
   uint32_t        *argb_cache_;    // Scratch buffer for temporary BGRA storage.
 
   VP8LBitReader    br_;
@@ -79,6 +101,10 @@ struct VP8LDecoder {
                                    // not be transformed, scaled and
                                    // color-converted yet.
   int              last_out_row_;  // last row output so far.
+  int              window_rows_;   // If not zero, pixels_ only holds a sliding
+                                   // window of that many rows, large enough
+                                   // for the longest backward reference.
+  int              window_start_;  // first row currently held in pixels_.
 
   VP8LMetadata     hdr_;
 
@@ -89,6 +115,11 @@ struct VP8LDecoder {
 
   uint8_t         *rescaler_memory;  // Working memory for rescaling work.
   WebPRescaler    *rescaler;         // Common rescaler for all channels.
+
+  // With 'use_threads', the decoded rows are transformed, scaled and
+  // color-converted by 'worker_' while the next ones are being decoded.
+  WebPWorker       worker_;
+  int              proc_row_;      // end row of the rows handed to 'worker_'.
 };
 
 //------------------------------------------------------------------------------
@@ -99,14 +130,15 @@ struct ALPHDecoder;  // Defined in dec/alphai.h.
 // in vp8l.c
 
 // Decodes image header for alpha data stored using lossless compression.
+// The alpha rows will be written to alph_dec->output_.
 // Returns false in case of error.
 int VP8LDecodeAlphaHeader(struct ALPHDecoder* const alph_dec,
-                          const uint8_t* const data, size_t data_size,
-                          uint8_t* const output);
+                          const uint8_t* const data, size_t data_size);
 
 // Decodes *at least* 'last_row' rows of alpha. If some of the initial rows are
 // already decoded in previous call(s), it will resume decoding from where it
-// was paused.
+// was paused. The rows covered by a copy of up to MAX_COPY_LENGTH pixels past
+// 'last_row' may be output too.
 // Returns false in case of bitstream error.
 int VP8LDecodeAlphaImageStream(struct ALPHDecoder* const alph_dec,
                                int last_row);
@@ -121,10 +153,15 @@ int VP8LDecodeHeader(VP8LDecoder* const dec, VP8Io* const io);
 // this function. Returns false in case of error, with updated dec->status_.
 int VP8LDecodeImage(VP8LDecoder* const dec);
 
-// Resets the decoder in its initial state, reclaiming memory.
+// Resets the decoder in its initial state, reclaiming memory. The pixels_
+// buffer is kept, to be reused by the next picture.
 // Preserves the dec->status_ value.
 void VP8LClear(VP8LDecoder* const dec);
 
+// Resets the decoder for a new picture, as if returned by VP8LNew(), except
+// that the pixels_ buffer and the worker thread are kept for reuse.
+void VP8LReset(VP8LDecoder* const dec);
+
 // Clears and deallocate a lossless decoder instance.
 void VP8LDelete(VP8LDecoder* const dec);
 
@@ -443,9 +443,53 @@ void WebPResetDecParams(WebPDecParams* const params) {
 //------------------------------------------------------------------------------
 // "Into" decoding variants
 
-// Main flow
+static VP8Decoder* GetVP8Decoder(WebPDecoderContext* const context) {
+  if (context == NULL) return VP8New();
+  if (context->vp8_ == NULL) {
+    context->vp8_ = VP8New();
+  } else {
+    VP8Reset(context->vp8_);
+  }
+  return context->vp8_;
+}
+
+static void ReleaseVP8Decoder(WebPDecoderContext* const context,
+                              VP8Decoder* const dec) {
+  if (context == NULL) {
+    VP8Delete(dec);
+  } else if (context->max_memory_ > 0 &&
+             dec->mem_size_ > context->max_memory_) {
+    VP8Delete(dec);
+    context->vp8_ = NULL;
+  }
+}
+
+static VP8LDecoder* GetVP8LDecoder(WebPDecoderContext* const context) {
+  if (context == NULL) return VP8LNew();
+  if (context->vp8l_ == NULL) {
+    context->vp8l_ = VP8LNew();
+  } else {
+    VP8LReset(context->vp8l_);
+  }
+  return context->vp8l_;
+}
+
+static void ReleaseVP8LDecoder(WebPDecoderContext* const context,
+                               VP8LDecoder* const dec) {
+  if (context == NULL) {
+    VP8LDelete(dec);
+  } else if (context->max_memory_ > 0 &&
+             dec->pixels_size_ > context->max_memory_) {
+    VP8LDelete(dec);
+    context->vp8l_ = NULL;
+  }
+}
+
+// Main flow. 'context' can be NULL, in which case the decoder is deleted
+// after use.
 static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
-                                WebPDecParams* const params) {
+                                WebPDecParams* const params,
+                                WebPDecoderContext* const context) {
   VP8StatusCode status;
   VP8Io io;
   WebPHeaderStructure headers;
@@ -464,7 +508,7 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
   WebPInitCustomIo(params, &io);  // Plug the I/O functions.
 
   if (!headers.is_lossless) {
-    VP8Decoder* const dec = VP8New();
+    VP8Decoder* const dec = GetVP8Decoder(context);
     if (dec == NULL) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
@@ -482,15 +526,16 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
         // This change must be done before calling VP8Decode()
         dec->mt_method_ = VP8GetThreadMethod(params->options, &headers,
                                              io.width, io.height);
+        VP8InitParseThreads(params->options, dec);
         VP8InitDithering(params->options, dec);
         if (!VP8Decode(dec, &io)) {
           status = dec->status_;
         }
       }
     }
-    VP8Delete(dec);
+    ReleaseVP8Decoder(context, dec);
   } else {
-    VP8LDecoder* const dec = VP8LNew();
+    VP8LDecoder* const dec = GetVP8LDecoder(context);
     if (dec == NULL) {
       return VP8_STATUS_OUT_OF_MEMORY;
     }
@@ -506,7 +551,7 @@ static VP8StatusCode DecodeInto(const uint8_t* const data, size_t data_size,
         }
       }
     }
-    VP8LDelete(dec);
+    ReleaseVP8LDecoder(context, dec);
   }
 
   if (status != VP8_STATUS_OK) {
@@ -534,7 +579,7 @@ static uint8_t* DecodeIntoRGBABuffer(WEBP_CSP_MODE colorspace,
   buf.u.RGBA.stride = stride;
   buf.u.RGBA.size   = size;
   buf.is_external_memory = 1;
-  if (DecodeInto(data, data_size, &params) != VP8_STATUS_OK) {
+  if (DecodeInto(data, data_size, &params, NULL) != VP8_STATUS_OK) {
     return NULL;
   }
   return rgba;
@@ -586,7 +631,7 @@ uint8_t* WebPDecodeYUVInto(const uint8_t* data, size_t data_size,
   output.u.YUVA.v_stride = v_stride;
   output.u.YUVA.v_size   = v_size;
   output.is_external_memory = 1;
-  if (DecodeInto(data, data_size, &params) != VP8_STATUS_OK) {
+  if (DecodeInto(data, data_size, &params, NULL) != VP8_STATUS_OK) {
     return NULL;
   }
   return luma;
@@ -613,7 +658,7 @@ static uint8_t* Decode(WEBP_CSP_MODE mode, const uint8_t* const data,
   if (height != NULL) *height = output.height;
 
   // Decode
-  if (DecodeInto(data, data_size, &params) != VP8_STATUS_OK) {
+  if (DecodeInto(data, data_size, &params, NULL) != VP8_STATUS_OK) {
     return NULL;
   }
   if (keep_info != NULL) {    // keep track of the side-info
@@ -737,6 +782,32 @@ VP8StatusCode WebPGetFeaturesInternal(const uint8_t* data, size_t data_size,
 
 VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
                          WebPDecoderConfig* config) {
+  return WebPDecodeWithContext(NULL, data, data_size, config);
+}
+
+//------------------------------------------------------------------------------
+// Decoding contexts
+
+WebPDecoderContext* WebPNewDecoderContext(size_t max_memory) {
+  WebPDecoderContext* const context =
+      (WebPDecoderContext*)calloc(1, sizeof(*context));
+  if (context != NULL) {
+    context->max_memory_ = max_memory;
+  }
+  return context;
+}
+
+void WebPDeleteDecoderContext(WebPDecoderContext* context) {
+  if (context != NULL) {
+    VP8Delete(context->vp8_);
+    VP8LDelete(context->vp8l_);
+    free(context);
+  }
+}
+
+VP8StatusCode WebPDecodeWithContext(WebPDecoderContext* context,
+                                    const uint8_t* data, size_t data_size,
+                                    WebPDecoderConfig* config) {
   WebPDecParams params;
   VP8StatusCode status;
 
@@ -755,7 +826,7 @@ VP8StatusCode WebPDecode(const uint8_t* data, size_t data_size,
   WebPResetDecParams(&params);
   params.output = &config->output;
   params.options = &config->options;
-  status = DecodeInto(data, data_size, &params);
+  status = DecodeInto(data, data_size, &params, context);
 
   return status;
 }
@@ -815,6 +886,30 @@ int WebPIoInitFromOptions(const WebPDecoderOptions* const options,
                            (io->scaled_height < H * 3 / 4);
     io->fancy_upsampling = 0;
   }
+
+  // Reduced-resolution reconstruction (lossy only, for downscaling by at
+  // least a factor 2). The requested crop origin, before its snapping to even
+  // values, must fall on a reduced chroma sample.
+  io->reduce_shift = 0;
+  if (io->use_scaling && options->use_fast_downscaling &&
+      !WebPIsRGBMode(src_colorspace)) {
+    const int x0 = io->use_cropping ? options->crop_left : 0;
+    const int y0 = io->use_cropping ? options->crop_top : 0;
+    int shift = 0;
+    while (shift < MAX_REDUCE_SHIFT &&
+           (w >> (shift + 1)) >= io->scaled_width &&
+           (h >> (shift + 1)) >= io->scaled_height &&
+           !(x0 & ((4 << shift) - 1)) && !(y0 & ((4 << shift) - 1))) {
+      ++shift;
+    }
+    if (shift > 0) {
+      const int round = (1 << shift) - 1;
+      io->reduce_shift = shift;
+      io->mb_w = ((x + w + round) >> shift) - (x >> shift);
+      io->mb_h = ((y + h + round) >> shift) - (y >> shift);
+      io->bypass_filtering = 1;
+    }
+  }
   return 1;
 }
 
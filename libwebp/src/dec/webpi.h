@@ -47,6 +47,15 @@ struct WebPDecParams {
 // Should be called first, before any use of the WebPDecParams object.
 void WebPResetDecParams(WebPDecParams* const params);
 
+//------------------------------------------------------------------------------
+// WebPDecoderContext: decoders, possibly kept between pictures (see webp.c).
+
+struct WebPDecoderContext {
+  size_t max_memory_;   // if not 0, larger decoders are released after use.
+  VP8Decoder* vp8_;     // lossy decoder kept from the previous picture, or NULL
+  struct VP8LDecoder* vp8l_;   // lossless decoder kept from the last picture.
+};
+
 //------------------------------------------------------------------------------
 // Header parsing helpers
 
@@ -0,0 +1,481 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+//  Animation decoder: composites the frames of a WebP file on the canvas.
+//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dsp/dsp.h"
+#include "../utils/utils.h"
+#include "../webp/decode.h"
+#include "../webp/demux.h"
+
+#define NUM_CHANNELS 4
+
+// Canvas saved after a frame was decoded and disposed of. Decoding can resume
+// from it at the next frame, as if it were a key-frame.
+typedef struct {
+  int frame_num_;         // Frame after which the canvas was saved.
+  int timestamp_;         // End timestamp of this frame.
+  int is_key_frame_;      // True if this frame was a key-frame.
+  uint8_t* canvas_;
+} CachedCanvas;
+
+struct WebPAnimDecoder {
+  WebPDemuxer* demux_;              // Demuxer created from the WebP bitstream.
+  WebPDecoderConfig config_;        // Decoder config, for the current frame.
+  WebPDecoderContext* context_;     // Decoding memory, reused between frames.
+  WebPBlendPixelRowFunc blend_func_;  // Row blending function for the mode.
+  WebPAnimInfo info_;               // Global info about the animation.
+  uint8_t* curr_frame_;             // Current canvas (not disposed).
+  uint8_t* prev_frame_disposed_;    // Previous canvas (properly disposed).
+  int prev_frame_timestamp_;        // Previous frame timestamp (milliseconds).
+  WebPIterator prev_iter_;          // Iterator object for previous frame.
+  int prev_frame_was_key_frame_;    // True if previous frame was a key-frame.
+  int next_frame_;                  // Index of the next frame to be decoded
+                                    // (starting from 1).
+  CachedCanvas* cache_;             // Canvases cached for seeking, sorted by
+                                    // increasing frame number.
+  int num_cached_;                  // Number of valid entries in cache_[].
+  int max_cached_;                  // Size of cache_[].
+  int cache_interval_;              // Minimum number of frames between two
+                                    // cached canvases.
+};
+
+static void DefaultDecoderOptions(WebPAnimDecoderOptions* const dec_options) {
+  dec_options->color_mode = MODE_RGBA;
+  dec_options->use_threads = 0;
+  dec_options->max_cached_canvases = 0;
+}
+
+int WebPAnimDecoderOptionsInitInternal(WebPAnimDecoderOptions* dec_options,
+                                       int abi_version) {
+  if (dec_options == NULL ||
+      WEBP_ABI_IS_INCOMPATIBLE(abi_version, WEBP_DEMUX_ABI_VERSION)) {
+    return 0;
+  }
+  memset(dec_options, 0, sizeof(*dec_options));
+  DefaultDecoderOptions(dec_options);
+  return 1;
+}
+
+static int ApplyDecoderOptions(const WebPAnimDecoderOptions* const dec_options,
+                               WebPAnimDecoder* const dec) {
+  const WEBP_CSP_MODE mode = dec_options->color_mode;
+  WebPDecoderConfig* const config = &dec->config_;
+  if (mode != MODE_RGBA && mode != MODE_BGRA &&
+      mode != MODE_rgbA && mode != MODE_bgrA) {
+    return 0;
+  }
+  if (dec_options->max_cached_canvases < 0) return 0;
+  WebPInitAlphaBlending();
+  dec->blend_func_ = (mode == MODE_RGBA || mode == MODE_BGRA) ?
+      WebPBlendPixelRowNonPremult : WebPBlendPixelRowPremult;
+  dec->max_cached_ = dec_options->max_cached_canvases;
+  WebPInitDecoderConfig(config);
+  config->output.colorspace = mode;
+  config->output.is_external_memory = 1;
+  config->options.use_threads = dec_options->use_threads;
+  // Note: config->output.u.RGBA is set at the time of decoding each frame.
+  return 1;
+}
+
+WebPAnimDecoder* WebPAnimDecoderNewInternal(
+    const WebPData* webp_data, const WebPAnimDecoderOptions* dec_options,
+    int abi_version) {
+  WebPAnimDecoderOptions options;
+  WebPAnimDecoder* dec = NULL;
+  if (webp_data == NULL ||
+      WEBP_ABI_IS_INCOMPATIBLE(abi_version, WEBP_DEMUX_ABI_VERSION)) {
+    return NULL;
+  }
+
+  // Note: calloc() so that the pointer members are initialized to NULL.
+  dec = (WebPAnimDecoder*)calloc(1, sizeof(*dec));
+  if (dec == NULL) goto Error;
+
+  if (dec_options != NULL) {
+    options = *dec_options;
+  } else {
+    DefaultDecoderOptions(&options);
+  }
+  if (!ApplyDecoderOptions(&options, dec)) goto Error;
+
+  dec->demux_ = WebPDemux(webp_data);
+  if (dec->demux_ == NULL) goto Error;
+
+  dec->info_.canvas_width = WebPDemuxGetI(dec->demux_, WEBP_FF_CANVAS_WIDTH);
+  dec->info_.canvas_height = WebPDemuxGetI(dec->demux_, WEBP_FF_CANVAS_HEIGHT);
+  dec->info_.loop_count = WebPDemuxGetI(dec->demux_, WEBP_FF_LOOP_COUNT);
+  dec->info_.bgcolor = WebPDemuxGetI(dec->demux_, WEBP_FF_BACKGROUND_COLOR);
+  dec->info_.frame_count = WebPDemuxGetI(dec->demux_, WEBP_FF_FRAME_COUNT);
+
+  // Note: calloc() because we fill frame with zeroes as well.
+  dec->curr_frame_ = (uint8_t*)WebPSafeCalloc(
+      dec->info_.canvas_width * NUM_CHANNELS, dec->info_.canvas_height);
+  if (dec->curr_frame_ == NULL) goto Error;
+  dec->prev_frame_disposed_ = (uint8_t*)WebPSafeCalloc(
+      dec->info_.canvas_width * NUM_CHANNELS, dec->info_.canvas_height);
+  if (dec->prev_frame_disposed_ == NULL) goto Error;
+
+  if (dec->max_cached_ > 0) {
+    // The canvases themselves are only allocated when needed.
+    dec->cache_ = (CachedCanvas*)WebPSafeCalloc(dec->max_cached_,
+                                                sizeof(*dec->cache_));
+    if (dec->cache_ == NULL) goto Error;
+  }
+  dec->cache_interval_ = 1;
+
+  dec->context_ = WebPNewDecoderContext(0);
+  if (dec->context_ == NULL) goto Error;
+
+  WebPAnimDecoderReset(dec);
+  return dec;
+
+ Error:
+  WebPAnimDecoderDelete(dec);
+  return NULL;
+}
+
+int WebPAnimDecoderGetInfo(const WebPAnimDecoder* dec, WebPAnimInfo* info) {
+  if (dec == NULL || info == NULL) return 0;
+  *info = dec->info_;
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Frame compositing
+
+// Returns true if the frame covers the full canvas.
+static int IsFullFrame(int width, int height, int canvas_width,
+                       int canvas_height) {
+  return (width == canvas_width && height == canvas_height);
+}
+
+// Returns true if the current frame doesn't depend on the previous canvas.
+// Only the frames' properties are used, not their pixels.
+static int IsKeyFrame(const WebPIterator* const curr,
+                      const WebPIterator* const prev,
+                      int prev_frame_was_key_frame,
+                      int canvas_width, int canvas_height) {
+  if (curr->frame_num == 1) {
+    return 1;
+  } else if ((!curr->has_alpha || curr->blend_method == WEBP_MUX_NO_BLEND) &&
+             IsFullFrame(curr->width, curr->height,
+                         canvas_width, canvas_height)) {
+    return 1;
+  } else {
+    return (prev->dispose_method == WEBP_MUX_DISPOSE_BACKGROUND) &&
+           (IsFullFrame(prev->width, prev->height, canvas_width,
+                        canvas_height) ||
+            prev_frame_was_key_frame);
+  }
+}
+
+// Clear the canvas to transparent.
+static void ZeroFillCanvas(uint8_t* buf, uint32_t canvas_width,
+                           uint32_t canvas_height) {
+  const size_t size =
+      (size_t)canvas_width * canvas_height * NUM_CHANNELS * sizeof(*buf);
+  memset(buf, 0, size);
+}
+
+// Clear given frame rectangle to transparent.
+static void ZeroFillFrameRect(uint8_t* buf, int buf_stride, int x_offset,
+                              int y_offset, int width, int height) {
+  int j;
+  assert(width * NUM_CHANNELS <= buf_stride);
+  buf += y_offset * buf_stride + x_offset * NUM_CHANNELS;
+  for (j = 0; j < height; ++j) {
+    memset(buf, 0, width * NUM_CHANNELS);
+    buf += buf_stride;
+  }
+}
+
+// Copy width * height pixels from 'src' to 'dst'.
+static void CopyCanvas(const uint8_t* src, uint8_t* dst,
+                       uint32_t width, uint32_t height) {
+  const size_t size = (size_t)width * height * NUM_CHANNELS;
+  assert(src != NULL && dst != NULL);
+  memcpy(dst, src, size);
+}
+
+// Decodes frame 'dec->next_frame_' on dec->curr_frame_, and updates the
+// decoder's state for the next one.
+static int DecodeFrame(WebPAnimDecoder* const dec) {
+  const int width = dec->info_.canvas_width;
+  const int height = dec->info_.canvas_height;
+  const size_t stride = (size_t)width * NUM_CHANNELS;
+  WebPDecoderConfig* const config = &dec->config_;
+  WebPRGBABuffer* const buf = &config->output.u.RGBA;
+  WebPIterator iter;
+  int is_key_frame;
+
+  if (!WebPDemuxGetFrame(dec->demux_, dec->next_frame_, &iter)) return 0;
+  if (iter.num_fragments != 1) goto Error;   // fragments aren't supported.
+
+  is_key_frame = IsKeyFrame(&iter, &dec->prev_iter_,
+                            dec->prev_frame_was_key_frame_, width, height);
+
+  // Initialize.
+  if (is_key_frame) {
+    ZeroFillCanvas(dec->curr_frame_, width, height);
+  } else {
+    CopyCanvas(dec->prev_frame_disposed_, dec->curr_frame_, width, height);
+  }
+
+  // Decode, directly at the frame's place in the canvas.
+  buf->stride = (int)stride;
+  buf->size = stride * (iter.height - 1) + iter.width * NUM_CHANNELS;
+  buf->rgba = dec->curr_frame_ +
+              iter.y_offset * stride + iter.x_offset * NUM_CHANNELS;
+  if (WebPDecodeWithContext(dec->context_, iter.fragment.bytes,
+                            iter.fragment.size, config) != VP8_STATUS_OK) {
+    goto Error;
+  }
+
+  // During the decoding of the current frame, we may have set some pixels to
+  // be transparent (i.e. alpha < 255). However, the value of each of these
+  // pixels should have been determined by blending it against the value of
+  // that pixel in the previous frame if blending method is WEBP_MUX_BLEND.
+  if (iter.frame_num > 1 && iter.blend_method == WEBP_MUX_BLEND &&
+      !is_key_frame) {
+    int y;
+    for (y = 0; y < iter.height; ++y) {
+      const size_t offset =
+          (iter.y_offset + y) * stride + iter.x_offset * NUM_CHANNELS;
+      dec->blend_func_(dec->curr_frame_ + offset,
+                       dec->prev_frame_disposed_ + offset, iter.width);
+    }
+  }
+
+  // Update info of the previous frame and dispose it for the next iteration.
+  dec->prev_frame_timestamp_ += iter.duration;
+  WebPDemuxReleaseIterator(&dec->prev_iter_);
+  dec->prev_iter_ = iter;
+  dec->prev_frame_was_key_frame_ = is_key_frame;
+  CopyCanvas(dec->curr_frame_, dec->prev_frame_disposed_, width, height);
+  if (dec->prev_iter_.dispose_method == WEBP_MUX_DISPOSE_BACKGROUND) {
+    ZeroFillFrameRect(dec->prev_frame_disposed_, (int)stride,
+                      dec->prev_iter_.x_offset, dec->prev_iter_.y_offset,
+                      dec->prev_iter_.width, dec->prev_iter_.height);
+  }
+  ++dec->next_frame_;
+  return 1;
+
+ Error:
+  WebPDemuxReleaseIterator(&iter);
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Canvas cache
+
+// Saves the disposed canvas of the frame just decoded, if it's far enough
+// from the last one cached. When the cache is full, every other entry is
+// dropped and the interval doubled, so that the cached canvases stay evenly
+// spread over the frames decoded so far.
+static void CacheCanvas(WebPAnimDecoder* const dec) {
+  const int frame_num = dec->next_frame_ - 1;
+  const int last_cached =
+      (dec->num_cached_ > 0) ? dec->cache_[dec->num_cached_ - 1].frame_num_ : 0;
+  CachedCanvas* entry;
+
+  if (dec->max_cached_ == 0) return;
+  // Decoding never resumes after the last frame.
+  if (frame_num >= (int)dec->info_.frame_count) return;
+  if (frame_num < last_cached + dec->cache_interval_) return;
+
+  if (dec->num_cached_ == dec->max_cached_) {
+    int i;
+    // Keep the odd entries, and move the canvases of the others to the end
+    // of the array to be reused.
+    for (i = 1; i < dec->num_cached_; i += 2) {
+      const CachedCanvas tmp = dec->cache_[i / 2];
+      dec->cache_[i / 2] = dec->cache_[i];
+      dec->cache_[i] = tmp;
+    }
+    dec->num_cached_ /= 2;
+    dec->cache_interval_ *= 2;
+    if (dec->num_cached_ > 0 &&
+        frame_num < dec->cache_[dec->num_cached_ - 1].frame_num_ +
+                    dec->cache_interval_) {
+      return;
+    }
+  }
+
+  entry = &dec->cache_[dec->num_cached_];
+  if (entry->canvas_ == NULL) {
+    entry->canvas_ = (uint8_t*)WebPSafeMalloc(
+        dec->info_.canvas_width * NUM_CHANNELS, dec->info_.canvas_height);
+    // The cache is only a speed-up: simply don't use it if out of memory.
+    if (entry->canvas_ == NULL) return;
+  }
+  CopyCanvas(dec->prev_frame_disposed_, entry->canvas_,
+             dec->info_.canvas_width, dec->info_.canvas_height);
+  entry->frame_num_ = frame_num;
+  entry->timestamp_ = dec->prev_frame_timestamp_;
+  entry->is_key_frame_ = dec->prev_frame_was_key_frame_;
+  ++dec->num_cached_;
+}
+
+// Restores the state of the decoder after 'entry->frame_num_' was decoded.
+static int RestoreCanvas(WebPAnimDecoder* const dec,
+                         const CachedCanvas* const entry) {
+  WebPIterator iter;
+  if (!WebPDemuxGetFrame(dec->demux_, entry->frame_num_, &iter)) return 0;
+  CopyCanvas(entry->canvas_, dec->prev_frame_disposed_,
+             dec->info_.canvas_width, dec->info_.canvas_height);
+  WebPDemuxReleaseIterator(&dec->prev_iter_);
+  dec->prev_iter_ = iter;
+  dec->prev_frame_timestamp_ = entry->timestamp_;
+  dec->prev_frame_was_key_frame_ = entry->is_key_frame_;
+  dec->next_frame_ = entry->frame_num_ + 1;
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Seeking
+
+// State of the decoder before decoding a given frame, as needed for a
+// key-frame: the content of the previous canvas doesn't matter then.
+typedef struct {
+  int frame_num_;
+  WebPIterator prev_iter_;
+  int prev_frame_was_key_frame_;
+  int prev_frame_timestamp_;
+} KeyFrameState;
+
+// Finds the last key-frame at or before 'frame_num'. Only the frames'
+// properties are read for that, not their pixels.
+static int FindKeyFrame(const WebPAnimDecoder* const dec, int frame_num,
+                        KeyFrameState* const key_frame) {
+  const int width = dec->info_.canvas_width;
+  const int height = dec->info_.canvas_height;
+  WebPIterator prev, curr;
+  int prev_was_key_frame = 0;
+  int timestamp = 0;
+
+  memset(&prev, 0, sizeof(prev));
+  memset(key_frame, 0, sizeof(*key_frame));
+  if (!WebPDemuxGetFrame(dec->demux_, 1, &curr)) return 0;
+  while (1) {
+    const int is_key_frame =
+        IsKeyFrame(&curr, &prev, prev_was_key_frame, width, height);
+    if (is_key_frame) {
+      key_frame->frame_num_ = curr.frame_num;
+      key_frame->prev_iter_ = prev;
+      key_frame->prev_frame_was_key_frame_ = prev_was_key_frame;
+      key_frame->prev_frame_timestamp_ = timestamp;
+    }
+    if (curr.frame_num == frame_num) break;
+    timestamp += curr.duration;
+    prev_was_key_frame = is_key_frame;
+    prev = curr;
+    if (!WebPDemuxNextFrame(&curr)) {
+      WebPDemuxReleaseIterator(&curr);
+      return 0;
+    }
+  }
+  WebPDemuxReleaseIterator(&curr);
+  return 1;
+}
+
+int WebPAnimDecoderSeek(WebPAnimDecoder* dec, int frame_num) {
+  const CachedCanvas* cached = NULL;
+  KeyFrameState key_frame;
+  int start;   // first frame that will have to be decoded
+  int i;
+  if (dec == NULL) return 0;
+  if (frame_num < 1 || frame_num > (int)dec->info_.frame_count) return 0;
+
+  // Candidates: the current position, the closest cached canvas before
+  // 'frame_num' and the last key-frame, whichever leaves the fewest frames to
+  // decode.
+  start = (dec->next_frame_ <= frame_num) ? dec->next_frame_ : 0;
+  for (i = dec->num_cached_ - 1; i >= 0; --i) {
+    if (dec->cache_[i].frame_num_ < frame_num) {
+      if (dec->cache_[i].frame_num_ + 1 > start) {
+        cached = &dec->cache_[i];
+        start = cached->frame_num_ + 1;
+      }
+      break;
+    }
+  }
+  if (!FindKeyFrame(dec, frame_num, &key_frame)) return 0;
+
+  if (key_frame.frame_num_ > start) {
+    WebPDemuxReleaseIterator(&dec->prev_iter_);
+    dec->prev_iter_ = key_frame.prev_iter_;
+    dec->prev_frame_was_key_frame_ = key_frame.prev_frame_was_key_frame_;
+    dec->prev_frame_timestamp_ = key_frame.prev_frame_timestamp_;
+    dec->next_frame_ = key_frame.frame_num_;
+  } else if (cached != NULL) {
+    if (!RestoreCanvas(dec, cached)) return 0;
+  }
+
+  while (dec->next_frame_ < frame_num) {
+    if (!DecodeFrame(dec)) return 0;
+    CacheCanvas(dec);
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+
+int WebPAnimDecoderGetNext(WebPAnimDecoder* dec,
+                           uint8_t** buf_ptr, int* timestamp_ptr) {
+  if (dec == NULL || buf_ptr == NULL || timestamp_ptr == NULL) return 0;
+  if (!WebPAnimDecoderHasMoreFrames(dec)) return 0;
+  if (!DecodeFrame(dec)) return 0;
+  CacheCanvas(dec);
+  *buf_ptr = dec->curr_frame_;
+  *timestamp_ptr = dec->prev_frame_timestamp_;
+  return 1;
+}
+
+int WebPAnimDecoderHasMoreFrames(const WebPAnimDecoder* dec) {
+  if (dec == NULL) return 0;
+  return (dec->next_frame_ <= (int)dec->info_.frame_count);
+}
+
+void WebPAnimDecoderReset(WebPAnimDecoder* dec) {
+  if (dec != NULL) {
+    dec->prev_frame_timestamp_ = 0;
+    WebPDemuxReleaseIterator(&dec->prev_iter_);
+    memset(&dec->prev_iter_, 0, sizeof(dec->prev_iter_));
+    dec->prev_frame_was_key_frame_ = 0;
+    dec->next_frame_ = 1;
+  }
+}
+
+void WebPAnimDecoderDelete(WebPAnimDecoder* dec) {
+  if (dec != NULL) {
+    int i;
+    WebPDemuxReleaseIterator(&dec->prev_iter_);
+    WebPDemuxDelete(dec->demux_);
+    WebPDeleteDecoderContext(dec->context_);
+    if (dec->cache_ != NULL) {
+      for (i = 0; i < dec->max_cached_; ++i) {
+        free(dec->cache_[i].canvas_);
+      }
+      free(dec->cache_);
+    }
+    free(dec->curr_frame_);
+    free(dec->prev_frame_disposed_);
+    free(dec);
+  }
+}
@@ -59,6 +59,14 @@ typedef struct Chunk {
   struct Chunk* next_;
 } Chunk;
 
+// The chunks sharing a given fourcc, in file order.
+typedef struct {
+  uint8_t fourcc_[TAG_SIZE];
+  int num_chunks_;
+  int max_chunks_;        // allocated size of 'chunks_'
+  const Chunk** chunks_;
+} ChunkIndex;
+
 struct WebPDemuxer {
   MemBuffer mem_;
   WebPDemuxState state_;
@@ -72,6 +80,13 @@ struct WebPDemuxer {
   Frame** frames_tail_;
   Chunk* chunks_;  // non-image chunks
   Chunk** chunks_tail_;
+  // Direct access to the frames and chunks, maintained as they are parsed.
+  const Frame** frame_index_;  // first frame/fragment of frame #n is at [n-1]
+  int frame_index_size_;
+  int frame_index_max_;        // allocated size of 'frame_index_'
+  ChunkIndex* chunk_index_;    // one entry per fourcc
+  int num_chunk_index_;
+  int chunk_index_max_;        // allocated size of 'chunk_index_'
 };
 
 typedef enum {
@@ -175,6 +190,64 @@ static WEBP_INLINE uint32_t ReadLE32(MemBuffer* const mem) {
 // -----------------------------------------------------------------------------
 // Secondary chunk parsing
 
+// Returns 'array' (of '*max_count' elements of size 'elem_size') enlarged to
+// hold at least 'count' elements, or NULL in case of memory error. 'array' is
+// released if a new one is returned, and left untouched otherwise.
+static void* GrowArray(void* const array, int* const max_count, int count,
+                       size_t elem_size) {
+  void* new_array;
+  int new_max_count;
+  if (count <= *max_count) return array;
+  new_max_count = (count < 8) ? 8 : 2 * count;
+  new_array = WebPSafeMalloc(new_max_count, elem_size);
+  if (new_array == NULL) return NULL;
+  if (array != NULL) {
+    memcpy(new_array, array, *max_count * elem_size);
+    free(array);
+  }
+  *max_count = new_max_count;
+  return new_array;
+}
+
+// Returns the index of the chunks with the given 'fourcc', or NULL if there
+// are none.
+static ChunkIndex* FindChunkIndex(const WebPDemuxer* const dmux,
+                                  const uint8_t fourcc[TAG_SIZE]) {
+  int i;
+  for (i = 0; i < dmux->num_chunk_index_; ++i) {
+    if (!memcmp(dmux->chunk_index_[i].fourcc_, fourcc, TAG_SIZE)) {
+      return &dmux->chunk_index_[i];
+    }
+  }
+  return NULL;
+}
+
+// Appends 'chunk' to the index of its fourcc, creating the latter if needed.
+// Returns false in case of memory error.
+static int IndexChunk(WebPDemuxer* const dmux, const Chunk* const chunk) {
+  const uint8_t* const fourcc = dmux->mem_.buf_ + chunk->data_.offset_;
+  ChunkIndex* index = FindChunkIndex(dmux, fourcc);
+  const Chunk** chunks;
+  if (index == NULL) {
+    ChunkIndex* const chunk_index = (ChunkIndex*)GrowArray(
+        dmux->chunk_index_, &dmux->chunk_index_max_,
+        dmux->num_chunk_index_ + 1, sizeof(*chunk_index));
+    if (chunk_index == NULL) return 0;
+    dmux->chunk_index_ = chunk_index;
+    index = &chunk_index[dmux->num_chunk_index_++];
+    memcpy(index->fourcc_, fourcc, TAG_SIZE);
+    index->num_chunks_ = 0;
+    index->max_chunks_ = 0;
+    index->chunks_ = NULL;
+  }
+  chunks = (const Chunk**)GrowArray(index->chunks_, &index->max_chunks_,
+                                    index->num_chunks_ + 1, sizeof(*chunks));
+  if (chunks == NULL) return 0;
+  index->chunks_ = chunks;
+  chunks[index->num_chunks_++] = chunk;
+  return 1;
+}
+
 static void AddChunk(WebPDemuxer* const dmux, Chunk* const chunk) {
   *dmux->chunks_tail_ = chunk;
   chunk->next_ = NULL;
@@ -187,6 +260,18 @@ static int AddFrame(WebPDemuxer* const dmux, Frame* const frame) {
   const Frame* const last_frame = *dmux->frames_tail_;
   if (last_frame != NULL && !last_frame->complete_) return 0;
 
+  // Frame numbers are consecutive: index the first frame/fragment of each.
+  if (frame->frame_num_ > dmux->frame_index_size_) {
+    const Frame** index;
+    assert(frame->frame_num_ == dmux->frame_index_size_ + 1);
+    index = (const Frame**)GrowArray(dmux->frame_index_,
+                                     &dmux->frame_index_max_,
+                                     frame->frame_num_, sizeof(*index));
+    if (index == NULL) return 0;
+    dmux->frame_index_ = index;
+    index[dmux->frame_index_size_++] = frame;
+  }
+
   *dmux->frames_tail_ = frame;
   frame->next_ = NULL;
   dmux->frames_tail_ = &frame->next_;
@@ -384,6 +469,10 @@ static int StoreChunk(WebPDemuxer* const dmux,
 
   chunk->data_.offset_ = start_offset;
   chunk->data_.size_ = size;
+  if (!IndexChunk(dmux, chunk)) {
+    free(chunk);
+    return 0;
+  }
   AddChunk(dmux, chunk);
   return 1;
 }
@@ -756,6 +845,7 @@ WebPDemuxer* WebPDemuxInternal(const WebPData* data, int allow_partial,
 void WebPDemuxDelete(WebPDemuxer* dmux) {
   Chunk* c;
   Frame* f;
+  int i;
   if (dmux == NULL) return;
 
   for (f = dmux->frames_; f != NULL;) {
@@ -768,6 +858,11 @@ void WebPDemuxDelete(WebPDemuxer* dmux) {
     c = c->next_;
     free(cur_chunk);
   }
+  for (i = 0; i < dmux->num_chunk_index_; ++i) {
+    free(dmux->chunk_index_[i].chunks_);
+  }
+  free(dmux->chunk_index_);
+  free(dmux->frame_index_);
   free(dmux);
 }
 
@@ -793,11 +888,8 @@ uint32_t WebPDemuxGetI(const WebPDemuxer* dmux, WebPFormatFeature feature) {
 // Find the first 'frame_num' frame. There may be multiple such frames in a
 // fragmented frame.
 static const Frame* GetFrame(const WebPDemuxer* const dmux, int frame_num) {
-  const Frame* f;
-  for (f = dmux->frames_; f != NULL; f = f->next_) {
-    if (frame_num == f->frame_num_) break;
-  }
-  return f;
+  if (frame_num < 1 || frame_num > dmux->frame_index_size_) return NULL;
+  return dmux->frame_index_[frame_num - 1];
 }
 
 // Returns fragment 'fragment_num' and the total count.
@@ -922,43 +1014,21 @@ void WebPDemuxReleaseIterator(WebPIterator* iter) {
 // -----------------------------------------------------------------------------
 // Chunk iteration
 
-static int ChunkCount(const WebPDemuxer* const dmux, const char fourcc[4]) {
-  const uint8_t* const mem_buf = dmux->mem_.buf_;
-  const Chunk* c;
-  int count = 0;
-  for (c = dmux->chunks_; c != NULL; c = c->next_) {
-    const uint8_t* const header = mem_buf + c->data_.offset_;
-    if (!memcmp(header, fourcc, TAG_SIZE)) ++count;
-  }
-  return count;
-}
-
-static const Chunk* GetChunk(const WebPDemuxer* const dmux,
-                             const char fourcc[4], int chunk_num) {
-  const uint8_t* const mem_buf = dmux->mem_.buf_;
-  const Chunk* c;
-  int count = 0;
-  for (c = dmux->chunks_; c != NULL; c = c->next_) {
-    const uint8_t* const header = mem_buf + c->data_.offset_;
-    if (!memcmp(header, fourcc, TAG_SIZE)) ++count;
-    if (count == chunk_num) break;
-  }
-  return c;
-}
-
 static int SetChunk(const char fourcc[4], int chunk_num,
                     WebPChunkIterator* const iter) {
   const WebPDemuxer* const dmux = (WebPDemuxer*)iter->private_;
+  const ChunkIndex* index;
   int count;
 
   if (dmux == NULL || fourcc == NULL || chunk_num < 0) return 0;
-  count = ChunkCount(dmux, fourcc);
+  index = FindChunkIndex(dmux, (const uint8_t*)fourcc);
+  count = (index != NULL) ? index->num_chunks_ : 0;
   if (count == 0) return 0;
   if (chunk_num == 0) chunk_num = count;
 
   if (chunk_num <= count) {
     const uint8_t* const mem_buf = dmux->mem_.buf_;
-    const Chunk* const chunk = GetChunk(dmux, fourcc, chunk_num);
+    const Chunk* const chunk = index->chunks_[chunk_num - 1];
     iter->chunk.bytes = mem_buf + chunk->data_.offset_ + CHUNK_HEADER_SIZE;
     iter->chunk.size  = chunk->data_.size_ - CHUNK_HEADER_SIZE;
     iter->num_chunks  = count;
@@ -0,0 +1,91 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Alpha-blending of rows of pixels, for compositing animation frames.
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include "./dsp.h"
+
+//------------------------------------------------------------------------------
+
+// Returns 'src' over 'dst' for one channel, with the scaled alphas of both.
+static WEBP_INLINE uint8_t BlendChannelNonPremult(int src, int src_a,
+                                                  int dst, int dst_a,
+                                                  uint32_t scale) {
+  const uint32_t blend_unscaled = src * src_a + dst * dst_a;
+  return (uint8_t)((blend_unscaled * scale) >> 24);
+}
+
+void WebPBlendPixelRowNonPremult_C(uint8_t* const src,
+                                   const uint8_t* const dst, int num_pixels) {
+  int i;
+  for (i = 0; i < 4 * num_pixels; i += 4) {
+    const int src_a = src[i + 3];
+    if (src_a == 0) {
+      src[i + 0] = dst[i + 0];
+      src[i + 1] = dst[i + 1];
+      src[i + 2] = dst[i + 2];
+      src[i + 3] = dst[i + 3];
+    } else if (src_a != 0xff) {
+      // approximates dst_a * (255 - src_a) / 255
+      const int dst_factor_a = (dst[i + 3] * (256 - src_a)) >> 8;
+      const int blend_a = src_a + dst_factor_a;
+      const uint32_t scale = (1UL << 24) / blend_a;
+      src[i + 0] = BlendChannelNonPremult(src[i + 0], src_a,
+                                          dst[i + 0], dst_factor_a, scale);
+      src[i + 1] = BlendChannelNonPremult(src[i + 1], src_a,
+                                          dst[i + 1], dst_factor_a, scale);
+      src[i + 2] = BlendChannelNonPremult(src[i + 2], src_a,
+                                          dst[i + 2], dst_factor_a, scale);
+      src[i + 3] = (uint8_t)blend_a;
+    }
+  }
+}
+
+void WebPBlendPixelRowPremult_C(uint8_t* const src,
+                                const uint8_t* const dst, int num_pixels) {
+  int i;
+  for (i = 0; i < 4 * num_pixels; i += 4) {
+    const int src_a = src[i + 3];
+    if (src_a != 0xff) {
+      const int scale = 256 - src_a;
+      src[i + 0] += (dst[i + 0] * scale) >> 8;
+      src[i + 1] += (dst[i + 1] * scale) >> 8;
+      src[i + 2] += (dst[i + 2] * scale) >> 8;
+      src[i + 3] += (dst[i + 3] * scale) >> 8;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+WebPBlendPixelRowFunc WebPBlendPixelRowNonPremult;
+WebPBlendPixelRowFunc WebPBlendPixelRowPremult;
+
+extern void WebPInitAlphaBlendingSSE2(void);
+extern void WebPInitAlphaBlendingNEON(void);
+
+void WebPInitAlphaBlending(void) {
+  WebPBlendPixelRowNonPremult = WebPBlendPixelRowNonPremult_C;
+  WebPBlendPixelRowPremult = WebPBlendPixelRowPremult_C;
+
+  // If defined, use CPUInfo() to overwrite some pointers with faster versions.
+  if (VP8GetCPUInfo != NULL) {
+#if defined(WEBP_USE_SSE2)
+    if (VP8GetCPUInfo(kSSE2)) {
+      WebPInitAlphaBlendingSSE2();
+    }
+#elif defined(WEBP_USE_NEON)
+    if (VP8GetCPUInfo(kNEON)) {
+      WebPInitAlphaBlendingNEON();
+    }
+#endif
+  }
+}
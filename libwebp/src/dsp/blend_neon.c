@@ -0,0 +1,88 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// NEON version of the alpha-blending functions.
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_NEON)
+
+#include <arm_neon.h>
+
+// Pixels are processed eight at a time, de-interleaved by vld4_u8().
+
+// Returns true if all the 8 values of 'v' are equal to 'value'.
+static WEBP_INLINE int AllEqual(const uint8x8_t v, uint8_t value) {
+  const uint8x8_t eq = vceq_u8(v, vdup_n_u8(value));
+  return (vget_lane_u64(vreinterpret_u64_u8(eq), 0) == ~(uint64_t)0);
+}
+
+static void BlendPixelRowNonPremultNEON(uint8_t* const src,
+                                        const uint8_t* const dst,
+                                        int num_pixels) {
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    const uint8x8_t A = vld4_u8(src + 4 * i).val[3];
+    if (AllEqual(A, 0xff)) continue;   // most frequent case
+    if (AllEqual(A, 0x00)) {
+      vst1q_u8(src + 4 * i + 0, vld1q_u8(dst + 4 * i + 0));
+      vst1q_u8(src + 4 * i + 16, vld1q_u8(dst + 4 * i + 16));
+    } else {
+      // Semi-transparent pixels need the division of the plain-C version.
+      WebPBlendPixelRowNonPremult_C(src + 4 * i, dst + 4 * i, 8);
+    }
+  }
+  if (i < num_pixels) {
+    WebPBlendPixelRowNonPremult_C(src + 4 * i, dst + 4 * i, num_pixels - i);
+  }
+}
+
+// Returns src + (dst * scale) >> 8 for one channel.
+static WEBP_INLINE uint8x8_t BlendChannelPremult(const uint8x8_t src,
+                                                 const uint8x8_t dst,
+                                                 const uint16x8_t scale) {
+  const uint16x8_t prod = vmulq_u16(vmovl_u8(dst), scale);
+  return vadd_u8(src, vshrn_n_u16(prod, 8));
+}
+
+static void BlendPixelRowPremultNEON(uint8_t* const src,
+                                     const uint8_t* const dst,
+                                     int num_pixels) {
+  const uint16x8_t k256 = vdupq_n_u16(256);
+  int i;
+  for (i = 0; i + 8 <= num_pixels; i += 8) {
+    uint8x8x4_t S = vld4_u8(src + 4 * i);
+    const uint8x8x4_t D = vld4_u8(dst + 4 * i);
+    const uint16x8_t scale = vsubq_u16(k256, vmovl_u8(S.val[3]));
+    S.val[0] = BlendChannelPremult(S.val[0], D.val[0], scale);
+    S.val[1] = BlendChannelPremult(S.val[1], D.val[1], scale);
+    S.val[2] = BlendChannelPremult(S.val[2], D.val[2], scale);
+    S.val[3] = BlendChannelPremult(S.val[3], D.val[3], scale);
+    vst4_u8(src + 4 * i, S);
+  }
+  if (i < num_pixels) {
+    WebPBlendPixelRowPremult_C(src + 4 * i, dst + 4 * i, num_pixels - i);
+  }
+}
+
+#endif   // WEBP_USE_NEON
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPInitAlphaBlendingNEON(void);
+
+void WebPInitAlphaBlendingNEON(void) {
+#if defined(WEBP_USE_NEON)
+  WebPBlendPixelRowNonPremult = BlendPixelRowNonPremultNEON;
+  WebPBlendPixelRowPremult = BlendPixelRowPremultNEON;
+#endif   // WEBP_USE_NEON
+}
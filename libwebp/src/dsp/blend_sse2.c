@@ -0,0 +1,152 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// SSE2 version of the alpha-blending functions.
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_SSE2)
+
+#include <emmintrin.h>
+
+// Pixels are processed four at a time, with alpha in the top byte of each
+// 32b lane.
+
+// Returns (a * b) >> 24 for the four 32b lanes, the products fitting in 32b.
+static WEBP_INLINE __m128i MulShift24(const __m128i a, const __m128i b) {
+  const __m128i p_02 = _mm_mul_epu32(a, b);
+  const __m128i p_13 = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+                                     _mm_srli_epi64(b, 32));
+  return _mm_or_si128(_mm_srli_epi64(p_02, 24),
+                      _mm_slli_epi64(_mm_srli_epi64(p_13, 24), 32));
+}
+
+// Returns (1 << 24) / blend_a for the four 32b lanes. The quotients are
+// computed with doubles, whose precision makes the truncation exact.
+static WEBP_INLINE __m128i InvertAlpha(const __m128i blend_a) {
+  const __m128d k24 = _mm_set1_pd((double)(1 << 24));
+  const __m128d a_01 = _mm_cvtepi32_pd(blend_a);
+  const __m128d a_23 = _mm_cvtepi32_pd(_mm_unpackhi_epi64(blend_a, blend_a));
+  const __m128i q_01 = _mm_cvttpd_epi32(_mm_div_pd(k24, a_01));
+  const __m128i q_23 = _mm_cvttpd_epi32(_mm_div_pd(k24, a_23));
+  return _mm_unpacklo_epi64(q_01, q_23);
+}
+
+// Same as BlendChannelNonPremult() of the plain-C version, for the channel at
+// bit 'shift' of the four pixels. The 16b products cannot overflow, and the
+// upper halves of the 32b lanes are all zero.
+static WEBP_INLINE __m128i BlendChannel(const __m128i* const S,
+                                        const __m128i* const D,
+                                        const __m128i* const src_a,
+                                        const __m128i* const dst_factor_a,
+                                        const __m128i* const scale,
+                                        int shift) {
+  const __m128i mask = _mm_set1_epi32(0xff);
+  const __m128i src = _mm_and_si128(_mm_srli_epi32(*S, shift), mask);
+  const __m128i dst = _mm_and_si128(_mm_srli_epi32(*D, shift), mask);
+  const __m128i blend_unscaled = _mm_add_epi32(
+      _mm_mullo_epi16(src, *src_a), _mm_mullo_epi16(dst, *dst_factor_a));
+  return _mm_slli_epi32(MulShift24(blend_unscaled, *scale), shift);
+}
+
+static void BlendPixelRowNonPremultSSE2(uint8_t* const src,
+                                        const uint8_t* const dst,
+                                        int num_pixels) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i opaque = _mm_set1_epi32(0xff);
+  const __m128i k256 = _mm_set1_epi32(256);
+  int i;
+  for (i = 0; i + 4 <= num_pixels; i += 4) {
+    const __m128i S = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+    const __m128i src_a = _mm_srli_epi32(S, 24);
+    const __m128i is_opaque = _mm_cmpeq_epi32(src_a, opaque);
+    const __m128i is_transparent = _mm_cmpeq_epi32(src_a, zero);
+    const int mask_opaque = _mm_movemask_epi8(is_opaque);
+    const int mask_transparent = _mm_movemask_epi8(is_transparent);
+    __m128i D, out;
+    if (mask_opaque == 0xffff) continue;   // most frequent case
+    D = _mm_loadu_si128((const __m128i*)(dst + 4 * i));
+    // Fully opaque pixels are kept and fully transparent ones replaced by
+    // 'dst', as in the plain-C version.
+    out = _mm_or_si128(_mm_and_si128(is_opaque, S),
+                       _mm_and_si128(is_transparent, D));
+    if ((mask_opaque | mask_transparent) != 0xffff) {
+      // approximates dst_a * (255 - src_a) / 255
+      const __m128i dst_factor_a =
+          _mm_srli_epi32(_mm_mullo_epi16(_mm_srli_epi32(D, 24),
+                                         _mm_sub_epi32(k256, src_a)), 8);
+      const __m128i blend_a = _mm_add_epi32(src_a, dst_factor_a);
+      // blend_a can only be zero for the transparent pixels, ignored below.
+      const __m128i scale = InvertAlpha(_mm_max_epi16(blend_a, one));
+      const __m128i c0 = BlendChannel(&S, &D, &src_a, &dst_factor_a, &scale, 0);
+      const __m128i c1 = BlendChannel(&S, &D, &src_a, &dst_factor_a, &scale, 8);
+      const __m128i c2 =
+          BlendChannel(&S, &D, &src_a, &dst_factor_a, &scale, 16);
+      const __m128i blended = _mm_or_si128(
+          _mm_or_si128(c0, c1), _mm_or_si128(c2, _mm_slli_epi32(blend_a, 24)));
+      const __m128i is_kept = _mm_or_si128(is_opaque, is_transparent);
+      out = _mm_or_si128(out, _mm_andnot_si128(is_kept, blended));
+    }
+    _mm_storeu_si128((__m128i*)(src + 4 * i), out);
+  }
+  if (i < num_pixels) {
+    WebPBlendPixelRowNonPremult_C(src + 4 * i, dst + 4 * i, num_pixels - i);
+  }
+}
+
+// Returns dst * (256 - src_a) >> 8 for the 2 pixels of 'D' (16b samples),
+// with the 16b multipliers of the corresponding pixels in 'scale'.
+static WEBP_INLINE __m128i ScaleDst(const __m128i* const D,
+                                    const __m128i* const scale) {
+  return _mm_srli_epi16(_mm_mullo_epi16(*D, *scale), 8);
+}
+
+static void BlendPixelRowPremultSSE2(uint8_t* const src,
+                                     const uint8_t* const dst,
+                                     int num_pixels) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i k256 = _mm_set1_epi32(256);
+  int i;
+  for (i = 0; i + 4 <= num_pixels; i += 4) {
+    const __m128i S = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+    const __m128i D = _mm_loadu_si128((const __m128i*)(dst + 4 * i));
+    // 256 - src_a, in the two 16b halves of each 32b lane.
+    const __m128i scale32 = _mm_sub_epi32(k256, _mm_srli_epi32(S, 24));
+    const __m128i scale16 = _mm_or_si128(scale32, _mm_slli_epi32(scale32, 16));
+    const __m128i scale_lo = _mm_unpacklo_epi32(scale16, scale16);
+    const __m128i scale_hi = _mm_unpackhi_epi32(scale16, scale16);
+    const __m128i D_lo = _mm_unpacklo_epi8(D, zero);
+    const __m128i D_hi = _mm_unpackhi_epi8(D, zero);
+    const __m128i P_lo = ScaleDst(&D_lo, &scale_lo);
+    const __m128i P_hi = ScaleDst(&D_hi, &scale_hi);
+    // No overflow possible: the samples are premultiplied by alpha.
+    const __m128i out = _mm_add_epi8(S, _mm_packus_epi16(P_lo, P_hi));
+    _mm_storeu_si128((__m128i*)(src + 4 * i), out);
+  }
+  if (i < num_pixels) {
+    WebPBlendPixelRowPremult_C(src + 4 * i, dst + 4 * i, num_pixels - i);
+  }
+}
+
+#endif   // WEBP_USE_SSE2
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPInitAlphaBlendingSSE2(void);
+
+void WebPInitAlphaBlendingSSE2(void) {
+#if defined(WEBP_USE_SSE2)
+  WebPBlendPixelRowNonPremult = BlendPixelRowNonPremultSSE2;
+  WebPBlendPixelRowPremult = BlendPixelRowPremultSSE2;
+#endif   // WEBP_USE_SSE2
+}
@@ -99,6 +99,18 @@ typedef void (*VP8CHisto)(const uint8_t* ref, const uint8_t* pred,
 extern const int VP8DspScan[16 + 4 + 4];
 extern VP8CHisto VP8CollectHistogram;
 
+// Residual coefficients cost (see enc/cost.h for struct VP8Residual).
+struct VP8Residual;
+// Stores 'coeffs' in 'res' and sets res->last to the position of the last
+// non-zero one, or -1.
+typedef void (*VP8SetResidualCoeffsFunc)(const int16_t* const coeffs,
+                                         struct VP8Residual* const res);
+extern VP8SetResidualCoeffsFunc VP8SetResidualCoeffs;
+// Returns the bit-cost of coding the residual, starting in context 'ctx0'.
+typedef int (*VP8GetResidualCostFunc)(int ctx0,
+                                      const struct VP8Residual* const res);
+extern VP8GetResidualCostFunc VP8GetResidualCost;
+
 void VP8EncDspInit(void);   // must be called before using any of the above
 
 //------------------------------------------------------------------------------
@@ -215,6 +227,88 @@ void WebPInitPremultiply(void);
 void WebPInitPremultiplySSE2(void);   // should not be called directly.
 void WebPInitPremultiplyNEON(void);
 
+//------------------------------------------------------------------------------
+// Rescaler (see utils/rescaler.h)
+
+struct WebPRescaler;
+
+// Import a row of data for all channels and accumulate it into the rescaler,
+// for the horizontal upscaling (bilinear) and downscaling (box filter) cases.
+typedef void (*WebPRescalerImportRowFunc)(struct WebPRescaler* const wrk,
+                                          const uint8_t* const src);
+extern WebPRescalerImportRowFunc WebPRescalerImportRowExpand;
+extern WebPRescalerImportRowFunc WebPRescalerImportRowShrink;
+
+// Write the pending output row to 'wrk->dst' and restart the accumulation
+// with the fractional contribution of the last imported row.
+typedef void (*WebPRescalerEmitRowFunc)(struct WebPRescaler* const wrk);
+extern WebPRescalerEmitRowFunc WebPRescalerEmitRow;
+
+// Plain-C versions, used as fall-back by the SIMD variants.
+void WebPRescalerImportRowExpand_C(struct WebPRescaler* const wrk,
+                                   const uint8_t* const src);
+void WebPRescalerImportRowShrink_C(struct WebPRescaler* const wrk,
+                                   const uint8_t* const src);
+void WebPRescalerEmitRow_C(struct WebPRescaler* const wrk);
+
+// To be called first before using the above.
+void WebPRescalerDspInit(void);
+
+//------------------------------------------------------------------------------
+// Alpha blending (see demux/anim_decode.c)
+
+// Blends the 'num_pixels' pixels of 'src' over the ones of 'dst', and stores
+// the result in 'src'. Pixels are 4 bytes, with alpha last (RGBA or BGRA).
+// The 'NonPremult' version is for straight alpha, the 'Premult' one for
+// samples pre-multiplied by alpha.
+typedef void (*WebPBlendPixelRowFunc)(uint8_t* const src,
+                                      const uint8_t* const dst,
+                                      int num_pixels);
+extern WebPBlendPixelRowFunc WebPBlendPixelRowNonPremult;
+extern WebPBlendPixelRowFunc WebPBlendPixelRowPremult;
+
+// Plain-C versions, used as fall-back by the SIMD variants.
+void WebPBlendPixelRowNonPremult_C(uint8_t* const src,
+                                   const uint8_t* const dst, int num_pixels);
+void WebPBlendPixelRowPremult_C(uint8_t* const src,
+                                const uint8_t* const dst, int num_pixels);
+
+// To be called first before using the above.
+void WebPInitAlphaBlending(void);
+
+//------------------------------------------------------------------------------
+// Filter functions for the alpha plane (see utils/filters.h)
+
+typedef enum {     // Filter types.
+  WEBP_FILTER_NONE = 0,
+  WEBP_FILTER_HORIZONTAL,
+  WEBP_FILTER_VERTICAL,
+  WEBP_FILTER_GRADIENT,
+  WEBP_FILTER_LAST = WEBP_FILTER_GRADIENT + 1,  // end marker
+  WEBP_FILTER_BEST,
+  WEBP_FILTER_FAST
+} WEBP_FILTER_TYPE;
+
+typedef void (*WebPFilterFunc)(const uint8_t* in, int width, int height,
+                               int stride, uint8_t* out);
+typedef void (*WebPUnfilterFunc)(int width, int height, int stride,
+                                 int row, int num_rows, uint8_t* data);
+
+// Filter the given data using the given predictor.
+// 'in' corresponds to a 2-dimensional pixel array of size (stride * height)
+// in raster order.
+// 'stride' is number of bytes per scan line (with possible padding).
+// 'out' should be pre-allocated.
+extern WebPFilterFunc WebPFilters[WEBP_FILTER_LAST];
+
+// In-place reconstruct the original data from the given filtered data.
+// The reconstruction will be done for 'num_rows' rows starting from 'row'
+// (assuming rows upto 'row - 1' are already reconstructed).
+extern WebPUnfilterFunc WebPUnfilters[WEBP_FILTER_LAST];
+
+// To be called first before using the above.
+void VP8FiltersInit(void);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -15,6 +15,11 @@
 
 #if defined(WEBP_USE_NEON)
 
+#include <assert.h>
+#include <arm_neon.h>
+
+#include "./lossless.h"   // for BitsLog2Floor()
+#include "../enc/cost.h"
 #include "../enc/vp8enci.h"
 
 //------------------------------------------------------------------------------
@@ -610,6 +615,88 @@ static int Disto16x16(const uint8_t* const a, const uint8_t* const b,
   return D;
 }
 
+//------------------------------------------------------------------------------
+// Residual cost
+
+// Weights of the bytes of a comparison result, to gather it into a bitmask.
+static const uint8_t kByteBits[16] = {
+  1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+};
+
+static void SetResidualCoeffs(const int16_t* const coeffs,
+                              VP8Residual* const res) {
+  const int16x8_t c0 = vld1q_s16(coeffs + 0);
+  const int16x8_t c1 = vld1q_s16(coeffs + 8);
+  // 0xff for the non-zero coefficients, one byte each.
+  const uint8x16_t nz = vcombine_u8(vmovn_u16(vtstq_s16(c0, c0)),
+                                    vmovn_u16(vtstq_s16(c1, c1)));
+  // Pair-wise additions of the weighted bytes: lane 0 ends up with the
+  // bitmask of the first 8 coefficients, lane 1 with the one of the last 8.
+  const uint8x16_t bits = vandq_u8(nz, vld1q_u8(kByteBits));
+  uint8x8_t sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+  uint32_t mask;
+  sum = vpadd_u8(sum, sum);
+  sum = vpadd_u8(sum, sum);
+  mask = ((uint32_t)vget_lane_u8(sum, 0) |
+          ((uint32_t)vget_lane_u8(sum, 1) << 8)) & (0x0000ffffu << res->first);
+  res->last = mask ? BitsLog2Floor(mask) : -1;
+  res->coeffs = coeffs;
+}
+
+static int GetResidualCost(int ctx0, const VP8Residual* const res) {
+  uint8_t levels[16], ctxs[16];
+  uint16_t abs_levels[16];
+  int n = res->first;
+  // should be prob[VP8EncBands[n]], but it's equivalent for n=0 or 1
+  const int p0 = res->prob[n][ctx0][0];
+  CostArrayPtr const costs = res->costs;
+  const uint16_t* t = costs[n][ctx0];
+  int cost;
+
+  if (res->last < 0) {
+    return VP8BitCost(0, p0);
+  }
+
+  {   // precompute clamped levels and contexts, packed to 8b.
+    const uint16x8_t E0 =
+        vreinterpretq_u16_s16(vabsq_s16(vld1q_s16(&res->coeffs[0])));
+    const uint16x8_t E1 =
+        vreinterpretq_u16_s16(vabsq_s16(vld1q_s16(&res->coeffs[8])));
+    const uint8x16_t F = vcombine_u8(vqmovn_u16(E0), vqmovn_u16(E1));
+    const uint8x16_t G = vminq_u8(F, vdupq_n_u8(2));   // context = 0,1,2
+    const uint8x16_t H = vminq_u8(F, vdupq_n_u8(MAX_VARIABLE_LEVEL));
+
+    vst1q_u8(ctxs, G);
+    vst1q_u8(levels, H);    // clamp_level in [0..67]
+
+    vst1q_u16(&abs_levels[0], E0);
+    vst1q_u16(&abs_levels[8], E1);
+  }
+  cost = VP8BitCost(1, p0);
+  for (; n < res->last; ++n) {
+    const int ctx = ctxs[n];
+    const int level = levels[n];
+    const int flevel = abs_levels[n];   // full level
+    cost += VP8LevelFixedCosts[flevel] + t[level];  // simplified VP8LevelCost()
+    t = costs[n + 1][ctx];
+    if (ctx) cost += VP8BitCost(1, res->prob[VP8EncBands[n + 1]][ctx][0]);
+  }
+  // Last coefficient is always non-zero
+  {
+    const int level = levels[n];
+    const int flevel = abs_levels[n];
+    assert(flevel != 0);
+    cost += VP8LevelFixedCosts[flevel] + t[level];
+    if (n < 15) {
+      const int b = VP8EncBands[n + 1];
+      const int ctx = ctxs[n];
+      const int last_p0 = res->prob[b][ctx][0];
+      cost += VP8BitCost(0, last_p0);
+    }
+  }
+  return cost;
+}
+
 #endif   // WEBP_USE_NEON
 
 //------------------------------------------------------------------------------
@@ -627,6 +714,9 @@ void VP8EncDspInitNEON(void) {
 
   VP8TDisto4x4 = Disto4x4;
   VP8TDisto16x16 = Disto16x16;
+
+  VP8SetResidualCoeffs = SetResidualCoeffs;
+  VP8GetResidualCost = GetResidualCost;
 #endif   // WEBP_USE_NEON
 }
 
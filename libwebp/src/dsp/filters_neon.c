@@ -0,0 +1,213 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// NEON variant of alpha filters
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_NEON)
+
+#include <arm_neon.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+// Helpful macro.
+
+# define SANITY_CHECK(in, out)                                                 \
+  assert(in != NULL);                                                          \
+  assert(out != NULL);                                                         \
+  assert(width > 0);                                                           \
+  assert(height > 0);                                                          \
+  assert(stride >= width);                                                     \
+  (void)height;  // Silence unused warning.
+
+// dst[i] = src[i] - pred[i]. 'dst' may only alias 'src'.
+static void PredictLine(const uint8_t* src, const uint8_t* pred,
+                        uint8_t* dst, int length) {
+  int i;
+  for (i = 0; i + 16 <= length; i += 16) {
+    const uint8x16_t A = vld1q_u8(&src[i]);
+    const uint8x16_t B = vld1q_u8(&pred[i]);
+    vst1q_u8(&dst[i], vsubq_u8(A, B));
+  }
+  for (; i < length; ++i) dst[i] = src[i] - pred[i];
+}
+
+// dst[i] = src[i] + pred[i]. 'dst' may only alias 'src'.
+static void PredictLineInverse(const uint8_t* src, const uint8_t* pred,
+                               uint8_t* dst, int length) {
+  int i;
+  for (i = 0; i + 16 <= length; i += 16) {
+    const uint8x16_t A = vld1q_u8(&src[i]);
+    const uint8x16_t B = vld1q_u8(&pred[i]);
+    vst1q_u8(&dst[i], vaddq_u8(A, B));
+  }
+  for (; i < length; ++i) dst[i] = src[i] + pred[i];
+}
+
+// In-place inverse of the left-prediction: row[i] += row[i - 1], that is a
+// running sum along the row. row[-1] must be valid.
+static void PredictLineLeftInverse(uint8_t* const row, int length) {
+  const uint8x16_t zero = vdupq_n_u8(0);
+  uint8x16_t last = vdupq_n_u8(row[-1]);
+  int i;
+  for (i = 0; i + 16 <= length; i += 16) {
+    uint8x16_t A = vld1q_u8(&row[i]);
+    // Prefix-sum of the 16 samples, in log2(16) steps. vextq_u8(zero, A, n)
+    // shifts A by 16 - n lanes towards the end of the row.
+    A = vaddq_u8(A, vextq_u8(zero, A, 15));
+    A = vaddq_u8(A, vextq_u8(zero, A, 14));
+    A = vaddq_u8(A, vextq_u8(zero, A, 12));
+    A = vaddq_u8(A, vextq_u8(zero, A, 8));
+    A = vaddq_u8(A, last);
+    vst1q_u8(&row[i], A);
+    last = vdupq_n_u8(vgetq_lane_u8(A, 15));
+  }
+  for (; i < length; ++i) row[i] += row[i - 1];
+}
+
+//------------------------------------------------------------------------------
+// Horizontal filter.
+
+static void HorizontalFilter(const uint8_t* in, int width, int height,
+                             int stride, uint8_t* out) {
+  int row;
+  SANITY_CHECK(in, out);
+  // Leftmost pixel is the same as input for topmost scanline.
+  out[0] = in[0];
+  PredictLine(in + 1, in, out + 1, width - 1);
+  for (row = 1; row < height; ++row) {
+    in += stride;
+    out += stride;
+    // Leftmost pixel is predicted from above.
+    out[0] = in[0] - in[-stride];
+    PredictLine(in + 1, in, out + 1, width - 1);
+  }
+}
+
+static void HorizontalUnfilter(int width, int height, int stride, int row,
+                               int num_rows, uint8_t* data) {
+  const int last_row = row + num_rows;
+  uint8_t* out = data + row * stride;
+  SANITY_CHECK(data, data);
+  assert(row >= 0 && num_rows > 0 && last_row <= height);
+  if (row == 0) {
+    PredictLineLeftInverse(out + 1, width - 1);
+    ++row;
+    out += stride;
+  }
+  for (; row < last_row; ++row) {
+    out[0] += out[-stride];
+    PredictLineLeftInverse(out + 1, width - 1);
+    out += stride;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Vertical filter.
+
+static void VerticalFilter(const uint8_t* in, int width, int height,
+                           int stride, uint8_t* out) {
+  int row;
+  SANITY_CHECK(in, out);
+  // Very first top-left pixel is copied, the rest of top scan-line is
+  // left-predicted.
+  out[0] = in[0];
+  PredictLine(in + 1, in, out + 1, width - 1);
+  for (row = 1; row < height; ++row) {
+    in += stride;
+    out += stride;
+    PredictLine(in, in - stride, out, width);
+  }
+}
+
+static void VerticalUnfilter(int width, int height, int stride, int row,
+                             int num_rows, uint8_t* data) {
+  const int last_row = row + num_rows;
+  uint8_t* out = data + row * stride;
+  SANITY_CHECK(data, data);
+  assert(row >= 0 && num_rows > 0 && last_row <= height);
+  if (row == 0) {
+    PredictLineLeftInverse(out + 1, width - 1);
+    ++row;
+    out += stride;
+  }
+  for (; row < last_row; ++row) {
+    PredictLineInverse(out, out - stride, out, width);
+    out += stride;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Gradient filter.
+
+static WEBP_INLINE int GradientPredictor(uint8_t a, uint8_t b, uint8_t c) {
+  const int g = a + b - c;
+  return ((g & ~0xff) == 0) ? g : (g < 0) ? 0 : 255;  // clip to 8bit
+}
+
+// out[i] = row[i] - clip(row[i - 1] + top[i] - top[i - 1]).
+static void GradientPredictDirect(const uint8_t* const row,
+                                  const uint8_t* const top,
+                                  uint8_t* const out, int length) {
+  int i;
+  for (i = 0; i + 8 <= length; i += 8) {
+    const uint8x8_t A = vld1_u8(&row[i - 1]);
+    const uint8x8_t B = vld1_u8(&top[i]);
+    const uint8x8_t C = vld1_u8(&top[i - 1]);
+    const uint8x8_t D = vld1_u8(&row[i]);
+    // a + b - c in 16b, then clipped to [0, 255] by the saturated narrowing.
+    const int16x8_t G = vreinterpretq_s16_u16(
+        vsubq_u16(vaddl_u8(A, B), vmovl_u8(C)));
+    vst1_u8(&out[i], vsub_u8(D, vqmovun_s16(G)));
+  }
+  for (; i < length; ++i) {
+    out[i] = row[i] - GradientPredictor(row[i - 1], top[i], top[i - 1]);
+  }
+}
+
+static void GradientFilter(const uint8_t* in, int width, int height,
+                           int stride, uint8_t* out) {
+  int row;
+  SANITY_CHECK(in, out);
+  // left prediction for top scan-line
+  out[0] = in[0];
+  PredictLine(in + 1, in, out + 1, width - 1);
+  for (row = 1; row < height; ++row) {
+    in += stride;
+    out += stride;
+    // leftmost pixel: predict from above.
+    out[0] = in[0] - in[-stride];
+    GradientPredictDirect(in + 1, in + 1 - stride, out + 1, width - 1);
+  }
+}
+
+#undef SANITY_CHECK
+
+#endif   // WEBP_USE_NEON
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8FiltersInitNEON(void);
+
+void VP8FiltersInitNEON(void) {
+#if defined(WEBP_USE_NEON)
+  WebPFilters[WEBP_FILTER_HORIZONTAL] = HorizontalFilter;
+  WebPFilters[WEBP_FILTER_VERTICAL] = VerticalFilter;
+  WebPFilters[WEBP_FILTER_GRADIENT] = GradientFilter;
+
+  WebPUnfilters[WEBP_FILTER_HORIZONTAL] = HorizontalUnfilter;
+  WebPUnfilters[WEBP_FILTER_VERTICAL] = VerticalUnfilter;
+#endif   // WEBP_USE_NEON
+}
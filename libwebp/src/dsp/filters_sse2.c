@@ -0,0 +1,273 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// SSE2 variant of alpha filters
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_SSE2)
+
+#include <assert.h>
+#include <emmintrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+// Helpful macro.
+
+# define SANITY_CHECK(in, out)                                                 \
+  assert(in != NULL);                                                          \
+  assert(out != NULL);                                                         \
+  assert(width > 0);                                                           \
+  assert(height > 0);                                                          \
+  assert(stride >= width);                                                     \
+  (void)height;  // Silence unused warning.
+
+// dst[i] = src[i] - pred[i]. 'dst' may only alias 'src'.
+static void PredictLine(const uint8_t* src, const uint8_t* pred,
+                        uint8_t* dst, int length) {
+  int i;
+  for (i = 0; i + 16 <= length; i += 16) {
+    const __m128i A = _mm_loadu_si128((const __m128i*)&src[i]);
+    const __m128i B = _mm_loadu_si128((const __m128i*)&pred[i]);
+    _mm_storeu_si128((__m128i*)&dst[i], _mm_sub_epi8(A, B));
+  }
+  for (; i < length; ++i) dst[i] = src[i] - pred[i];
+}
+
+// dst[i] = src[i] + pred[i]. 'dst' may only alias 'src'.
+static void PredictLineInverse(const uint8_t* src, const uint8_t* pred,
+                               uint8_t* dst, int length) {
+  int i;
+  for (i = 0; i + 16 <= length; i += 16) {
+    const __m128i A = _mm_loadu_si128((const __m128i*)&src[i]);
+    const __m128i B = _mm_loadu_si128((const __m128i*)&pred[i]);
+    _mm_storeu_si128((__m128i*)&dst[i], _mm_add_epi8(A, B));
+  }
+  for (; i < length; ++i) dst[i] = src[i] + pred[i];
+}
+
+// In-place inverse of the left-prediction: row[i] += row[i - 1], that is a
+// running sum along the row. row[-1] must be valid.
+static void PredictLineLeftInverse(uint8_t* const row, int length) {
+  int i;
+  __m128i last = _mm_set1_epi8((char)row[-1]);
+  for (i = 0; i + 16 <= length; i += 16) {
+    __m128i A = _mm_loadu_si128((const __m128i*)&row[i]);
+    // Prefix-sum of the 16 samples, in log2(16) steps.
+    A = _mm_add_epi8(A, _mm_slli_si128(A, 1));
+    A = _mm_add_epi8(A, _mm_slli_si128(A, 2));
+    A = _mm_add_epi8(A, _mm_slli_si128(A, 4));
+    A = _mm_add_epi8(A, _mm_slli_si128(A, 8));
+    A = _mm_add_epi8(A, last);
+    _mm_storeu_si128((__m128i*)&row[i], A);
+    // Broadcast the last sample for the next 16 ones.
+    A = _mm_unpackhi_epi8(A, A);
+    A = _mm_unpackhi_epi16(A, A);
+    last = _mm_shuffle_epi32(A, 0xff);
+  }
+  for (; i < length; ++i) row[i] += row[i - 1];
+}
+
+//------------------------------------------------------------------------------
+// Horizontal filter.
+
+static void HorizontalFilter(const uint8_t* in, int width, int height,
+                             int stride, uint8_t* out) {
+  int row;
+  SANITY_CHECK(in, out);
+  // Leftmost pixel is the same as input for topmost scanline.
+  out[0] = in[0];
+  PredictLine(in + 1, in, out + 1, width - 1);
+  for (row = 1; row < height; ++row) {
+    in += stride;
+    out += stride;
+    // Leftmost pixel is predicted from above.
+    out[0] = in[0] - in[-stride];
+    PredictLine(in + 1, in, out + 1, width - 1);
+  }
+}
+
+static void HorizontalUnfilter(int width, int height, int stride, int row,
+                               int num_rows, uint8_t* data) {
+  const int last_row = row + num_rows;
+  uint8_t* out = data + row * stride;
+  SANITY_CHECK(data, data);
+  assert(row >= 0 && num_rows > 0 && last_row <= height);
+  if (row == 0) {
+    PredictLineLeftInverse(out + 1, width - 1);
+    ++row;
+    out += stride;
+  }
+  for (; row < last_row; ++row) {
+    out[0] += out[-stride];
+    PredictLineLeftInverse(out + 1, width - 1);
+    out += stride;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Vertical filter.
+
+static void VerticalFilter(const uint8_t* in, int width, int height,
+                           int stride, uint8_t* out) {
+  int row;
+  SANITY_CHECK(in, out);
+  // Very first top-left pixel is copied, the rest of top scan-line is
+  // left-predicted.
+  out[0] = in[0];
+  PredictLine(in + 1, in, out + 1, width - 1);
+  for (row = 1; row < height; ++row) {
+    in += stride;
+    out += stride;
+    PredictLine(in, in - stride, out, width);
+  }
+}
+
+static void VerticalUnfilter(int width, int height, int stride, int row,
+                             int num_rows, uint8_t* data) {
+  const int last_row = row + num_rows;
+  uint8_t* out = data + row * stride;
+  SANITY_CHECK(data, data);
+  assert(row >= 0 && num_rows > 0 && last_row <= height);
+  if (row == 0) {
+    PredictLineLeftInverse(out + 1, width - 1);
+    ++row;
+    out += stride;
+  }
+  for (; row < last_row; ++row) {
+    PredictLineInverse(out, out - stride, out, width);
+    out += stride;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Gradient filter.
+
+static WEBP_INLINE int GradientPredictor(uint8_t a, uint8_t b, uint8_t c) {
+  const int g = a + b - c;
+  return ((g & ~0xff) == 0) ? g : (g < 0) ? 0 : 255;  // clip to 8bit
+}
+
+// out[i] = row[i] - clip(row[i - 1] + top[i] - top[i - 1]).
+static void GradientPredictDirect(const uint8_t* const row,
+                                  const uint8_t* const top,
+                                  uint8_t* const out, int length) {
+  const __m128i zero = _mm_setzero_si128();
+  int i;
+  for (i = 0; i + 16 <= length; i += 16) {
+    const __m128i A = _mm_loadu_si128((const __m128i*)&row[i - 1]);
+    const __m128i B = _mm_loadu_si128((const __m128i*)&top[i]);
+    const __m128i C = _mm_loadu_si128((const __m128i*)&top[i - 1]);
+    const __m128i D = _mm_loadu_si128((const __m128i*)&row[i]);
+    // a + b - c in 16b, then clipped to [0, 255] by the saturated packing.
+    const __m128i G_lo = _mm_sub_epi16(
+        _mm_add_epi16(_mm_unpacklo_epi8(A, zero), _mm_unpacklo_epi8(B, zero)),
+        _mm_unpacklo_epi8(C, zero));
+    const __m128i G_hi = _mm_sub_epi16(
+        _mm_add_epi16(_mm_unpackhi_epi8(A, zero), _mm_unpackhi_epi8(B, zero)),
+        _mm_unpackhi_epi8(C, zero));
+    const __m128i pred = _mm_packus_epi16(G_lo, G_hi);
+    _mm_storeu_si128((__m128i*)&out[i], _mm_sub_epi8(D, pred));
+  }
+  for (; i < length; ++i) {
+    out[i] = row[i] - GradientPredictor(row[i - 1], top[i], top[i - 1]);
+  }
+}
+
+// In-place: row[i] += clip(row[i - 1] + top[i] - top[i - 1]). Each sample
+// depends on the previous one, so only 'top[i] - top[i - 1]' is computed
+// for 8 samples at once, and the predictors are resolved one 16b lane after
+// the other.
+static void GradientPredictInverse(uint8_t* const row,
+                                   const uint8_t* const top, int length) {
+  const __m128i zero = _mm_setzero_si128();
+  int i;
+  __m128i left = _mm_cvtsi32_si128(row[-1]);   // 16b lane #0
+  for (i = 0; i + 8 <= length; i += 8) {
+    const __m128i B = _mm_loadl_epi64((const __m128i*)&top[i]);
+    const __m128i C = _mm_loadl_epi64((const __m128i*)&top[i - 1]);
+    const __m128i D = _mm_loadl_epi64((const __m128i*)&row[i]);
+    const __m128i E = _mm_sub_epi16(_mm_unpacklo_epi8(B, zero),
+                                    _mm_unpacklo_epi8(C, zero));
+    __m128i mask = _mm_cvtsi32_si128(0xff);
+    __m128i out = zero;
+    int k;
+    for (k = 0; k < 8; ++k) {
+      // 'left' only holds the left sample of pixel #k, in 16b lane #k.
+      const __m128i pred = _mm_packus_epi16(_mm_add_epi16(left, E), zero);
+      const __m128i value = _mm_and_si128(_mm_add_epi8(pred, D), mask);
+      out = _mm_or_si128(out, value);
+      left = _mm_unpacklo_epi8(_mm_slli_si128(value, 1), zero);
+      mask = _mm_slli_si128(mask, 1);
+    }
+    _mm_storel_epi64((__m128i*)&row[i], out);
+    left = _mm_srli_si128(out, 7);   // last sample, back in lane #0
+  }
+  for (; i < length; ++i) {
+    row[i] += GradientPredictor(row[i - 1], top[i], top[i - 1]);
+  }
+}
+
+static void GradientFilter(const uint8_t* in, int width, int height,
+                           int stride, uint8_t* out) {
+  int row;
+  SANITY_CHECK(in, out);
+  // left prediction for top scan-line
+  out[0] = in[0];
+  PredictLine(in + 1, in, out + 1, width - 1);
+  for (row = 1; row < height; ++row) {
+    in += stride;
+    out += stride;
+    // leftmost pixel: predict from above.
+    out[0] = in[0] - in[-stride];
+    GradientPredictDirect(in + 1, in + 1 - stride, out + 1, width - 1);
+  }
+}
+
+static void GradientUnfilter(int width, int height, int stride, int row,
+                             int num_rows, uint8_t* data) {
+  const int last_row = row + num_rows;
+  uint8_t* out = data + row * stride;
+  SANITY_CHECK(data, data);
+  assert(row >= 0 && num_rows > 0 && last_row <= height);
+  if (row == 0) {
+    PredictLineLeftInverse(out + 1, width - 1);
+    ++row;
+    out += stride;
+  }
+  for (; row < last_row; ++row) {
+    out[0] += out[-stride];
+    GradientPredictInverse(out + 1, out + 1 - stride, width - 1);
+    out += stride;
+  }
+}
+
+#undef SANITY_CHECK
+
+#endif   // WEBP_USE_SSE2
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8FiltersInitSSE2(void);
+
+void VP8FiltersInitSSE2(void) {
+#if defined(WEBP_USE_SSE2)
+  WebPFilters[WEBP_FILTER_HORIZONTAL] = HorizontalFilter;
+  WebPFilters[WEBP_FILTER_VERTICAL] = VerticalFilter;
+  WebPFilters[WEBP_FILTER_GRADIENT] = GradientFilter;
+
+  WebPUnfilters[WEBP_FILTER_HORIZONTAL] = HorizontalUnfilter;
+  WebPUnfilters[WEBP_FILTER_VERTICAL] = VerticalUnfilter;
+  WebPUnfilters[WEBP_FILTER_GRADIENT] = GradientUnfilter;
+#endif   // WEBP_USE_SSE2
+}
@@ -15,15 +15,13 @@
 
 #include "./dsp.h"
 
-#if defined(WEBP_USE_SSE2)
-#include <emmintrin.h>
-#endif
-
 #include <math.h>
 #include <stdlib.h>
 #include "./lossless.h"
 #include "../dec/vp8li.h"
 #include "./yuv.h"
+#include "../utils/thread.h"
+#include "../utils/utils.h"
 
 #define MAX_DIFF_COST (1e30f)
 
@@ -559,11 +557,10 @@ static float PredictionCostSpatialHistogram(int accumulated[4][256],
   return (float)retval;
 }
 
-static int GetBestPredictorForTile(int width, int height,
-                                   int tile_x, int tile_y, int bits,
+static float PredictionCostForTile(int width, int height,
+                                   int tile_x, int tile_y, int bits, int mode,
                                    int accumulated[4][256],
                                    const uint32_t* const argb_scratch) {
-  const int kNumPredModes = 14;
   const int col_start = tile_x << bits;
   const int row_start = tile_y << bits;
   const int tile_size = 1 << bits;
@@ -571,48 +568,35 @@ static int GetBestPredictorForTile(int width, int height,
       tile_size : height - row_start;
   const int xmax = (tile_size <= width - col_start) ?
       tile_size : width - col_start;
+  const uint32_t* current_row = argb_scratch;
+  const PredictorFunc pred_func = kPredictors[mode];
   int histo[4][256];
-  float best_diff = MAX_DIFF_COST;
-  int best_mode = 0;
-
-  int mode;
-  for (mode = 0; mode < kNumPredModes; ++mode) {
-    const uint32_t* current_row = argb_scratch;
-    const PredictorFunc pred_func = kPredictors[mode];
-    float cur_diff;
-    int y;
-    memset(&histo[0][0], 0, sizeof(histo));
-    for (y = 0; y < ymax; ++y) {
-      int x;
-      const int row = row_start + y;
-      const uint32_t* const upper_row = current_row;
-      current_row = upper_row + width;
-      for (x = 0; x < xmax; ++x) {
-        const int col = col_start + x;
-        uint32_t predict;
-        uint32_t predict_diff;
-        if (row == 0) {
-          predict = (col == 0) ? ARGB_BLACK : current_row[col - 1];  // Left.
-        } else if (col == 0) {
-          predict = upper_row[col];  // Top.
-        } else {
-          predict = pred_func(current_row[col - 1], upper_row + col);
-        }
-        predict_diff = VP8LSubPixels(current_row[col], predict);
-        ++histo[0][predict_diff >> 24];
-        ++histo[1][((predict_diff >> 16) & 0xff)];
-        ++histo[2][((predict_diff >> 8) & 0xff)];
-        ++histo[3][(predict_diff & 0xff)];
+  int y;
+  memset(&histo[0][0], 0, sizeof(histo));
+  for (y = 0; y < ymax; ++y) {
+    int x;
+    const int row = row_start + y;
+    const uint32_t* const upper_row = current_row;
+    current_row = upper_row + width;
+    for (x = 0; x < xmax; ++x) {
+      const int col = col_start + x;
+      uint32_t predict;
+      uint32_t predict_diff;
+      if (row == 0) {
+        predict = (col == 0) ? ARGB_BLACK : current_row[col - 1];  // Left.
+      } else if (col == 0) {
+        predict = upper_row[col];  // Top.
+      } else {
+        predict = pred_func(current_row[col - 1], upper_row + col);
       }
-    }
-    cur_diff = PredictionCostSpatialHistogram(accumulated, histo);
-    if (cur_diff < best_diff) {
-      best_diff = cur_diff;
-      best_mode = mode;
+      predict_diff = VP8LSubPixels(current_row[col], predict);
+      ++histo[0][predict_diff >> 24];
+      ++histo[1][((predict_diff >> 16) & 0xff)];
+      ++histo[2][((predict_diff >> 8) & 0xff)];
+      ++histo[3][(predict_diff & 0xff)];
     }
   }
-
-  return best_mode;
+  return PredictionCostSpatialHistogram(accumulated, histo);
 }
 
 static void CopyTileWithPrediction(int width, int height,
@@ -651,9 +635,121 @@ static void CopyTileWithPrediction(int width, int height,
   }
 }
 
-void VP8LResidualImage(int width, int height, int bits,
-                       uint32_t* const argb, uint32_t* const argb_scratch,
-                       uint32_t* const image) {
+//------------------------------------------------------------------------------
+// Multi-threaded transform searches.
+// The tiles are processed one at a time and in raster order, since the search
+// for a tile depends on the statistics of all the tiles before it. What is
+// split between the jobs is the list of candidates (predictor modes or color
+// multipliers) tried for the tile: each job returns the best candidate of its
+// contiguous range, and the ranges are then merged in order. As ties keep the
+// first candidate, the result is the same as the one of the serial search.
+// The first job runs in the calling thread, the others on their own WebPWorker.
+
+#define MAX_SEARCH_JOBS 16
+
+typedef struct {
+  int start_, end_;    // range of candidates evaluated by this job.
+  int best_[2];        // best candidate found (-1 if none), per search kind.
+  float best_cost_[2];
+} SearchJob;
+
+typedef struct {
+  SearchJob jobs_[MAX_SEARCH_JOBS];
+  WebPWorker workers_[MAX_SEARCH_JOBS];   // workers_[i] runs jobs_[i].
+  int num_jobs_;
+  int num_parallel_;   // see WebPWorkersInit().
+} SearchJobs;
+
+// Returns NULL in case of memory error.
+static SearchJobs* SearchJobsNew(int num_threads, int num_candidates) {
+  SearchJobs* jobs;
+  int n = (num_threads < num_candidates) ? num_threads : num_candidates;
+  int i;
+  if (n > MAX_SEARCH_JOBS) n = MAX_SEARCH_JOBS;
+  if (n < 1) n = 1;
+  jobs = (SearchJobs*)calloc(1, sizeof(*jobs));
+  if (jobs == NULL) return NULL;
+  jobs->num_jobs_ = n;
+  jobs->num_parallel_ = WebPWorkersInit(jobs->workers_, n, n);
+  for (i = 0; i < n; ++i) {
+    jobs->jobs_[i].start_ = i * num_candidates / n;
+    jobs->jobs_[i].end_ = (i + 1) * num_candidates / n;
+  }
+  return jobs;
+}
+
+static void SearchJobsDelete(SearchJobs* const jobs) {
+  WebPWorkersEnd(jobs->workers_, jobs->num_jobs_);
+  free(jobs);
+}
+
+// Calls hook(job, params) for each job and waits for all of them to finish.
+static void SearchJobsRun(SearchJobs* const jobs,
+                          WebPWorkerHook hook, void* const params) {
+  int i;
+  for (i = 0; i < jobs->num_jobs_; ++i) {
+    SearchJob* const job = &jobs->jobs_[i];
+    WebPWorker* const worker = &jobs->workers_[i];
+    job->best_[0] = job->best_[1] = -1;
+    job->best_cost_[0] = job->best_cost_[1] = MAX_DIFF_COST;
+    worker->hook = hook;
+    worker->data1 = job;
+    worker->data2 = params;
+  }
+  WebPWorkersRun(jobs->workers_, jobs->num_jobs_, jobs->num_parallel_);
+}
+
+// Records 'candidate' if it is better than the job's current best.
+static WEBP_INLINE void SearchJobUpdate(SearchJob* const job, int kind,
+                                        int candidate, float cost) {
+  if (cost < job->best_cost_[kind]) {
+    job->best_cost_[kind] = cost;
+    job->best_[kind] = candidate;
+  }
+}
+
+// Returns the best candidate over all the jobs, or -1 if there is none.
+static int SearchJobsBest(const SearchJobs* const jobs, int kind) {
+  float best_cost = MAX_DIFF_COST;
+  int best = -1;
+  int i;
+  for (i = 0; i < jobs->num_jobs_; ++i) {
+    const SearchJob* const job = &jobs->jobs_[i];
+    if (job->best_[kind] >= 0 && job->best_cost_[kind] < best_cost) {
+      best_cost = job->best_cost_[kind];
+      best = job->best_[kind];
+    }
+  }
+  return best;
+}
+
+typedef struct {
+  int width_;
+  int height_;
+  int bits_;
+  int tile_x_;                      // tile being processed.
+  int tile_y_;
+  int (*histo_)[256];               // histogram of the previous tiles.
+  const uint32_t* argb_scratch_;
+} PredictorParams;
+
+static int PredictorHook(void* arg1, void* arg2) {
+  SearchJob* const job = (SearchJob*)arg1;
+  const PredictorParams* const p = (const PredictorParams*)arg2;
+  int mode;
+  for (mode = job->start_; mode < job->end_; ++mode) {
+    const float cost =
+        PredictionCostForTile(p->width_, p->height_, p->tile_x_, p->tile_y_,
+                              p->bits_, mode, p->histo_, p->argb_scratch_);
+    SearchJobUpdate(job, 0, mode, cost);
+  }
+  return 1;
+}
+
+int VP8LResidualImage(int width, int height, int bits,
+                      uint32_t* const argb, uint32_t* const argb_scratch,
+                      uint32_t* const image, int num_threads) {
+  const int kNumPredModes = 14;
   const int max_tile_size = 1 << bits;
   const int tiles_per_row = VP8LSubSampleSize(width, bits);
   const int tiles_per_col = VP8LSubSampleSize(height, bits);
@@ -661,7 +757,16 @@ void VP8LResidualImage(int width, int height, int bits,
   uint32_t* const current_tile_rows = argb_scratch + width;
   int tile_y;
   int histo[4][256];
+  PredictorParams params;
+  SearchJobs* const jobs = SearchJobsNew(num_threads, kNumPredModes);
+  if (jobs == NULL) return 0;
+
   memset(histo, 0, sizeof(histo));
+  params.width_ = width;
+  params.height_ = height;
+  params.bits_ = bits;
+  params.histo_ = histo;
+  params.argb_scratch_ = argb_scratch;
   for (tile_y = 0; tile_y < tiles_per_col; ++tile_y) {
     const int tile_y_offset = tile_y * max_tile_size;
     const int this_tile_height =
@@ -681,8 +786,11 @@ void VP8LResidualImage(int width, int height, int bits,
       if (all_x_max > width) {
         all_x_max = width;
       }
-      pred = GetBestPredictorForTile(width, height, tile_x, tile_y, bits, histo,
-                                     argb_scratch);
+      params.tile_x_ = tile_x;
+      params.tile_y_ = tile_y;
+      SearchJobsRun(jobs, PredictorHook, &params);
+      pred = SearchJobsBest(jobs, 0);
+      if (pred < 0) pred = 0;
       image[tile_y * tiles_per_row + tile_x] = 0xff000000u | (pred << 8);
       CopyTileWithPrediction(width, height, tile_x, tile_y, bits, pred,
                              argb_scratch, argb);
@@ -704,6 +812,8 @@ void VP8LResidualImage(int width, int height, int bits,
       }
     }
   }
+  SearchJobsDelete(jobs);
+  return 1;
 }
 
 // Inverse prediction.
@@ -781,13 +891,7 @@ static void AddGreenToBlueAndRed(uint32_t* data, const uint32_t* data_end) {
   }
 }
 
-typedef struct {
-  // Note: the members are uint8_t, so that any negative values are
-  // automatically converted to "mod 256" values.
-  uint8_t green_to_red_;
-  uint8_t green_to_blue_;
-  uint8_t red_to_blue_;
-} Multipliers;
+typedef VP8LMultipliers Multipliers;
 
 static WEBP_INLINE void MultipliersClear(Multipliers* m) {
   m->green_to_red_ = 0;
@@ -837,6 +941,22 @@ static WEBP_INLINE uint32_t TransformColor(const Multipliers* const m,
   return (argb & 0xff00ff00u) | (new_red << 16) | (new_blue);
 }
 
+void VP8LTransformColor_C(const VP8LMultipliers* const m,
+                          uint32_t* data, int num_pixels) {
+  int i;
+  for (i = 0; i < num_pixels; ++i) {
+    data[i] = TransformColor(m, data[i], 0);
+  }
+}
+
+void VP8LTransformColorInverse_C(const VP8LMultipliers* const m,
+                                 uint32_t* data, int num_pixels) {
+  int i;
+  for (i = 0; i < num_pixels; ++i) {
+    data[i] = TransformColor(m, data[i], 1);
+  }
+}
+
 static WEBP_INLINE uint8_t TransformColorRed(uint8_t green_to_red,
                                              uint32_t argb) {
   const uint32_t green = argb >> 8;
@@ -882,106 +1002,118 @@ static float PredictionCostCrossColor(const int accumulated[256],
          PredictionCostSpatial(counts, 3, kExpValue);
 }
 
-static Multipliers GetBestColorTransformForTile(
-    int tile_x, int tile_y, int bits,
-    Multipliers prevX,
-    Multipliers prevY,
-    int step, int xsize, int ysize,
-    int* accumulated_red_histo,
-    int* accumulated_blue_histo,
-    const uint32_t* const argb) {
-  float best_diff = MAX_DIFF_COST;
+typedef struct {
+  int width_;
+  int step_;
+  int x_start_, x_end_;             // pixel area of the tile being processed.
+  int y_start_, y_end_;
+  Multipliers prevX_;               // multipliers of the left and top tiles.
+  Multipliers prevY_;
+  const int* accumulated_red_histo_;   // histograms of the previous tiles.
+  const int* accumulated_blue_histo_;
+  const uint32_t* argb_;
+} CrossColorParams;
+
+static float GetRedCostForTile(const CrossColorParams* const p,
+                               int green_to_red) {
+  const uint32_t* const argb = p->argb_;
+  const int xsize = p->width_;
+  int histo[256] = { 0 };
   float cur_diff;
-  const int halfstep = step / 2;
-  const int max_tile_size = 1 << bits;
-  const int tile_y_offset = tile_y * max_tile_size;
-  const int tile_x_offset = tile_x * max_tile_size;
-  int green_to_red;
-  int green_to_blue;
-  int red_to_blue;
-  int all_x_max = tile_x_offset + max_tile_size;
-  int all_y_max = tile_y_offset + max_tile_size;
-  Multipliers best_tx;
-  MultipliersClear(&best_tx);
-  if (all_x_max > xsize) {
-    all_x_max = xsize;
+  int all_y;
+
+  for (all_y = p->y_start_; all_y < p->y_end_; ++all_y) {
+    int ix = all_y * xsize + p->x_start_;
+    int all_x;
+    for (all_x = p->x_start_; all_x < p->x_end_; ++all_x, ++ix) {
+      if (SkipRepeatedPixels(argb, ix, xsize)) {
+        continue;
+      }
+      ++histo[TransformColorRed(green_to_red, argb[ix])];  // red.
+    }
   }
-  if (all_y_max > ysize) {
-    all_y_max = ysize;
+  cur_diff = PredictionCostCrossColor(p->accumulated_red_histo_, &histo[0]);
+  if ((uint8_t)green_to_red == p->prevX_.green_to_red_) {
+    cur_diff -= 3;  // favor keeping the areas locally similar
   }
+  if ((uint8_t)green_to_red == p->prevY_.green_to_red_) {
+    cur_diff -= 3;  // favor keeping the areas locally similar
+  }
+  if (green_to_red == 0) {
+    cur_diff -= 3;
+  }
+  return cur_diff;
+}
 
-  for (green_to_red = -64; green_to_red <= 64; green_to_red += halfstep) {
-    int histo[256] = { 0 };
-    int all_y;
-
-    for (all_y = tile_y_offset; all_y < all_y_max; ++all_y) {
-      int ix = all_y * xsize + tile_x_offset;
-      int all_x;
-      for (all_x = tile_x_offset; all_x < all_x_max; ++all_x, ++ix) {
-        if (SkipRepeatedPixels(argb, ix, xsize)) {
-          continue;
-        }
-        ++histo[TransformColorRed(green_to_red, argb[ix])];  // red.
+static float GetBlueCostForTile(const CrossColorParams* const p,
+                                int green_to_blue, int red_to_blue) {
+  const uint32_t* const argb = p->argb_;
+  const int xsize = p->width_;
+  int histo[256] = { 0 };
+  float cur_diff;
+  int all_y;
+
+  for (all_y = p->y_start_; all_y < p->y_end_; ++all_y) {
+    int ix = all_y * xsize + p->x_start_;
+    int all_x;
+    for (all_x = p->x_start_; all_x < p->x_end_; ++all_x, ++ix) {
+      if (SkipRepeatedPixels(argb, ix, xsize)) {
+        continue;
       }
-    }
-    cur_diff = PredictionCostCrossColor(&accumulated_red_histo[0], &histo[0]);
-    if ((uint8_t)green_to_red == prevX.green_to_red_) {
-      cur_diff -= 3;  // favor keeping the areas locally similar
-    }
-    if ((uint8_t)green_to_red == prevY.green_to_red_) {
-      cur_diff -= 3;  // favor keeping the areas locally similar
-    }
-    if (green_to_red == 0) {
-      cur_diff -= 3;
-    }
-    if (cur_diff < best_diff) {
-      best_diff = cur_diff;
-      best_tx.green_to_red_ = green_to_red;
+      ++histo[TransformColorBlue(green_to_blue, red_to_blue, argb[ix])];
     }
   }
-  best_diff = MAX_DIFF_COST;
-  for (green_to_blue = -32; green_to_blue <= 32; green_to_blue += step) {
-    for (red_to_blue = -32; red_to_blue <= 32; red_to_blue += step) {
-      int all_y;
-      int histo[256] = { 0 };
-      for (all_y = tile_y_offset; all_y < all_y_max; ++all_y) {
-        int all_x;
-        int ix = all_y * xsize + tile_x_offset;
-        for (all_x = tile_x_offset; all_x < all_x_max; ++all_x, ++ix) {
-          if (SkipRepeatedPixels(argb, ix, xsize)) {
-            continue;
-          }
-          ++histo[TransformColorBlue(green_to_blue, red_to_blue, argb[ix])];
-        }
-      }
-      cur_diff =
-          PredictionCostCrossColor(&accumulated_blue_histo[0], &histo[0]);
-      if ((uint8_t)green_to_blue == prevX.green_to_blue_) {
-        cur_diff -= 3;  // favor keeping the areas locally similar
-      }
-      if ((uint8_t)green_to_blue == prevY.green_to_blue_) {
-        cur_diff -= 3;  // favor keeping the areas locally similar
-      }
-      if ((uint8_t)red_to_blue == prevX.red_to_blue_) {
-        cur_diff -= 3;  // favor keeping the areas locally similar
-      }
-      if ((uint8_t)red_to_blue == prevY.red_to_blue_) {
-        cur_diff -= 3;  // favor keeping the areas locally similar
-      }
-      if (green_to_blue == 0) {
-        cur_diff -= 3;
-      }
-      if (red_to_blue == 0) {
-        cur_diff -= 3;
-      }
-      if (cur_diff < best_diff) {
-        best_diff = cur_diff;
-        best_tx.green_to_blue_ = green_to_blue;
-        best_tx.red_to_blue_ = red_to_blue;
-      }
+  cur_diff = PredictionCostCrossColor(p->accumulated_blue_histo_, &histo[0]);
+  if ((uint8_t)green_to_blue == p->prevX_.green_to_blue_) {
+    cur_diff -= 3;  // favor keeping the areas locally similar
+  }
+  if ((uint8_t)green_to_blue == p->prevY_.green_to_blue_) {
+    cur_diff -= 3;  // favor keeping the areas locally similar
+  }
+  if ((uint8_t)red_to_blue == p->prevX_.red_to_blue_) {
+    cur_diff -= 3;  // favor keeping the areas locally similar
+  }
+  if ((uint8_t)red_to_blue == p->prevY_.red_to_blue_) {
+    cur_diff -= 3;  // favor keeping the areas locally similar
+  }
+  if (green_to_blue == 0) {
+    cur_diff -= 3;
+  }
+  if (red_to_blue == 0) {
+    cur_diff -= 3;
+  }
+  return cur_diff;
+}
+
+// Number of candidate multipliers tried for a tile, given the search 'step'.
+// The red candidates come first, then the blue ones in the order of the
+// serial search: green_to_blue first, red_to_blue second.
+static WEBP_INLINE int NumRedCandidates(int step) {
+  return 128 / (step / 2) + 1;
+}
+static WEBP_INLINE int NumBlueCandidates(int step) {
+  return (64 / step + 1) * (64 / step + 1);
+}
+
+static int CrossColorHook(void* arg1, void* arg2) {
+  SearchJob* const job = (SearchJob*)arg1;
+  const CrossColorParams* const p = (const CrossColorParams*)arg2;
+  const int step = p->step_;
+  const int num_red = NumRedCandidates(step);
+  const int num_blue_per_row = 64 / step + 1;
+  int i;
+  for (i = job->start_; i < job->end_; ++i) {
+    if (i < num_red) {
+      const int green_to_red = -64 + i * (step / 2);
+      SearchJobUpdate(job, 0, i, GetRedCostForTile(p, green_to_red));
+    } else {
+      const int green_to_blue = -32 + (i - num_red) / num_blue_per_row * step;
+      const int red_to_blue = -32 + (i - num_red) % num_blue_per_row * step;
+      SearchJobUpdate(job, 1, i - num_red,
+                      GetBlueCostForTile(p, green_to_blue, red_to_blue));
     }
   }
-  return best_tx;
+  return 1;
 }
 
 static void CopyTileWithColorTransform(int xsize, int ysize,
@@ -1001,48 +1133,67 @@ static void CopyTileWithColorTransform(int xsize, int ysize,
   }
   yscan += tile_y;
   for (y = tile_y; y < yscan; ++y) {
-    int ix = y * xsize + tile_x;
-    const int end_ix = ix + xscan;
-    for (; ix < end_ix; ++ix) {
-      argb[ix] = TransformColor(&color_transform, argb[ix], 0);
-    }
+    VP8LTransformColor(&color_transform, argb + y * xsize + tile_x, xscan);
   }
 }
 
-void VP8LColorSpaceTransform(int width, int height, int bits, int step,
-                             uint32_t* const argb, uint32_t* image) {
+int VP8LColorSpaceTransform(int width, int height, int bits, int step,
+                            uint32_t* const argb, uint32_t* image,
+                            int num_threads) {
   const int max_tile_size = 1 << bits;
+  const int num_blue_per_row = 64 / step + 1;
   int tile_xsize = VP8LSubSampleSize(width, bits);
   int tile_ysize = VP8LSubSampleSize(height, bits);
   int accumulated_red_histo[256] = { 0 };
   int accumulated_blue_histo[256] = { 0 };
   int tile_y;
   int tile_x;
-  Multipliers prevX;
-  Multipliers prevY;
-  MultipliersClear(&prevY);
-  MultipliersClear(&prevX);
+  const int num_candidates = NumRedCandidates(step) + NumBlueCandidates(step);
+  CrossColorParams params;
+  SearchJobs* const jobs = SearchJobsNew(num_threads, num_candidates);
+  if (jobs == NULL) return 0;
+  params.width_ = width;
+  params.step_ = step;
+  params.accumulated_red_histo_ = accumulated_red_histo;
+  params.accumulated_blue_histo_ = accumulated_blue_histo;
+  params.argb_ = argb;
+
+  MultipliersClear(&params.prevY_);
+  MultipliersClear(&params.prevX_);
   for (tile_y = 0; tile_y < tile_ysize; ++tile_y) {
     for (tile_x = 0; tile_x < tile_xsize; ++tile_x) {
       Multipliers color_transform;
       int all_x_max;
       int y;
+      int best;
       const int tile_y_offset = tile_y * max_tile_size;
       const int tile_x_offset = tile_x * max_tile_size;
       if (tile_y != 0) {
-        ColorCodeToMultipliers(image[tile_y * tile_xsize + tile_x - 1], &prevX);
+        ColorCodeToMultipliers(image[tile_y * tile_xsize + tile_x - 1],
+                               &params.prevX_);
         ColorCodeToMultipliers(image[(tile_y - 1) * tile_xsize + tile_x],
-                               &prevY);
+                               &params.prevY_);
       } else if (tile_x != 0) {
-        ColorCodeToMultipliers(image[tile_y * tile_xsize + tile_x - 1], &prevX);
+        ColorCodeToMultipliers(image[tile_y * tile_xsize + tile_x - 1],
+                               &params.prevX_);
+      }
+      params.x_start_ = tile_x_offset;
+      params.x_end_ = (tile_x_offset + max_tile_size > width) ?
+          width : tile_x_offset + max_tile_size;
+      params.y_start_ = tile_y_offset;
+      params.y_end_ = (tile_y_offset + max_tile_size > height) ?
+          height : tile_y_offset + max_tile_size;
+      SearchJobsRun(jobs, CrossColorHook, &params);
+      MultipliersClear(&color_transform);
+      best = SearchJobsBest(jobs, 0);
+      if (best >= 0) {
+        color_transform.green_to_red_ = -64 + best * (step / 2);
+      }
+      best = SearchJobsBest(jobs, 1);
+      if (best >= 0) {
+        color_transform.green_to_blue_ = -32 + best / num_blue_per_row * step;
+        color_transform.red_to_blue_ = -32 + best % num_blue_per_row * step;
       }
-      color_transform =
-          GetBestColorTransformForTile(tile_x, tile_y, bits,
-                                       prevX, prevY,
-                                       step, width, height,
-                                       &accumulated_red_histo[0],
-                                       &accumulated_blue_histo[0],
-                                       argb);
       image[tile_y * tile_xsize + tile_x] =
           MultipliersToColorCode(&color_transform);
       CopyTileWithColorTransform(width, height, tile_x, tile_y, bits,
@@ -1079,6 +1230,8 @@ void VP8LColorSpaceTransform(int width, int height, int bits, int step,
       }
     }
   }
+  SearchJobsDelete(jobs);
+  return 1;
 }
 
 // Color space inverse transform.
@@ -1096,9 +1249,10 @@ static void ColorSpaceInverseTransform(const VP8LTransform* const transform,
     Multipliers m = { 0, 0, 0 };
     int x;
 
-    for (x = 0; x < width; ++x) {
-      if ((x & mask) == 0) ColorCodeToMultipliers(*pred++, &m);
-      data[x] = TransformColor(&m, data[x], 1);
+    for (x = 0; x < width; x += mask + 1) {
+      const int num_pixels = (width - x <= mask) ? width - x : mask + 1;
+      ColorCodeToMultipliers(*pred++, &m);
+      VP8LTransformColorInverse(&m, data + x, num_pixels);
     }
     data += width;
     ++y;
@@ -1218,8 +1372,7 @@ static int is_big_endian(void) {
   return (tmp.b[0] != 1);
 }
 
-static void ConvertBGRAToRGB(const uint32_t* src,
-                             int num_pixels, uint8_t* dst) {
+void VP8LConvertBGRAToRGB_C(const uint32_t* src, int num_pixels, uint8_t* dst) {
   const uint32_t* const src_end = src + num_pixels;
   while (src < src_end) {
     const uint32_t argb = *src++;
@@ -1229,8 +1382,8 @@ static void ConvertBGRAToRGB(const uint32_t* src,
   }
 }
 
-static void ConvertBGRAToRGBA(const uint32_t* src,
-                              int num_pixels, uint8_t* dst) {
+void VP8LConvertBGRAToRGBA_C(const uint32_t* src,
+                             int num_pixels, uint8_t* dst) {
   const uint32_t* const src_end = src + num_pixels;
   while (src < src_end) {
     const uint32_t argb = *src++;
@@ -1241,8 +1394,8 @@ static void ConvertBGRAToRGBA(const uint32_t* src,
   }
 }
 
-static void ConvertBGRAToRGBA4444(const uint32_t* src,
-                                  int num_pixels, uint8_t* dst) {
+void VP8LConvertBGRAToRGBA4444_C(const uint32_t* src,
+                                 int num_pixels, uint8_t* dst) {
   const uint32_t* const src_end = src + num_pixels;
   while (src < src_end) {
     const uint32_t argb = *src++;
@@ -1258,8 +1411,8 @@ static void ConvertBGRAToRGBA4444(const uint32_t* src,
   }
 }
 
-static void ConvertBGRAToRGB565(const uint32_t* src,
-                                int num_pixels, uint8_t* dst) {
+void VP8LConvertBGRAToRGB565_C(const uint32_t* src,
+                               int num_pixels, uint8_t* dst) {
   const uint32_t* const src_end = src + num_pixels;
   while (src < src_end) {
     const uint32_t argb = *src++;
@@ -1275,8 +1428,7 @@ static void ConvertBGRAToRGB565(const uint32_t* src,
   }
 }
 
-static void ConvertBGRAToBGR(const uint32_t* src,
-                             int num_pixels, uint8_t* dst) {
+void VP8LConvertBGRAToBGR_C(const uint32_t* src, int num_pixels, uint8_t* dst) {
   const uint32_t* const src_end = src + num_pixels;
   while (src < src_end) {
     const uint32_t argb = *src++;
@@ -1330,17 +1482,17 @@ void VP8LConvertFromBGRA(const uint32_t* const in_data, int num_pixels,
                          WEBP_CSP_MODE out_colorspace, uint8_t* const rgba) {
   switch (out_colorspace) {
     case MODE_RGB:
-      ConvertBGRAToRGB(in_data, num_pixels, rgba);
+      VP8LConvertBGRAToRGB(in_data, num_pixels, rgba);
       break;
     case MODE_RGBA:
-      ConvertBGRAToRGBA(in_data, num_pixels, rgba);
+      VP8LConvertBGRAToRGBA(in_data, num_pixels, rgba);
       break;
     case MODE_rgbA:
-      ConvertBGRAToRGBA(in_data, num_pixels, rgba);
+      VP8LConvertBGRAToRGBA(in_data, num_pixels, rgba);
       WebPApplyAlphaMultiply(rgba, 0, num_pixels, 1, 0);
       break;
     case MODE_BGR:
-      ConvertBGRAToBGR(in_data, num_pixels, rgba);
+      VP8LConvertBGRAToBGR(in_data, num_pixels, rgba);
       break;
     case MODE_BGRA:
       CopyOrSwap(in_data, num_pixels, rgba, 1);
@@ -1357,14 +1509,14 @@ void VP8LConvertFromBGRA(const uint32_t* const in_data, int num_pixels,
       WebPApplyAlphaMultiply(rgba, 1, num_pixels, 1, 0);
       break;
     case MODE_RGBA_4444:
-      ConvertBGRAToRGBA4444(in_data, num_pixels, rgba);
+      VP8LConvertBGRAToRGBA4444(in_data, num_pixels, rgba);
       break;
     case MODE_rgbA_4444:
-      ConvertBGRAToRGBA4444(in_data, num_pixels, rgba);
+      VP8LConvertBGRAToRGBA4444(in_data, num_pixels, rgba);
       WebPApplyAlphaMultiply4444(rgba, num_pixels, 1, 0);
       break;
     case MODE_RGB_565:
-      ConvertBGRAToRGB565(in_data, num_pixels, rgba);
+      VP8LConvertBGRAToRGB565(in_data, num_pixels, rgba);
       break;
     default:
       assert(0);          // Code flow should not reach here.
@@ -1394,115 +1546,11 @@ void VP8LBundleColorMap(const uint8_t* const row, int width,
 
 //------------------------------------------------------------------------------
 
-// TODO(vikasa): Move the SSE2 functions to lossless_dsp.c (new file), once
-// color-space conversion methods (ConvertFromBGRA) are also updated for SSE2.
-#if defined(WEBP_USE_SSE2)
-static WEBP_INLINE uint32_t ClampedAddSubtractFullSSE2(uint32_t c0, uint32_t c1,
-                                                       uint32_t c2) {
-  const __m128i zero = _mm_setzero_si128();
-  const __m128i C0 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c0), zero);
-  const __m128i C1 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c1), zero);
-  const __m128i C2 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c2), zero);
-  const __m128i V1 = _mm_add_epi16(C0, C1);
-  const __m128i V2 = _mm_sub_epi16(V1, C2);
-  const __m128i b = _mm_packus_epi16(V2, V2);
-  const uint32_t output = _mm_cvtsi128_si32(b);
-  return output;
-}
-
-static WEBP_INLINE uint32_t ClampedAddSubtractHalfSSE2(uint32_t c0, uint32_t c1,
-                                                       uint32_t c2) {
-  const uint32_t ave = Average2(c0, c1);
-  const __m128i zero = _mm_setzero_si128();
-  const __m128i A0 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(ave), zero);
-  const __m128i B0 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c2), zero);
-  const __m128i A1 = _mm_sub_epi16(A0, B0);
-  const __m128i BgtA = _mm_cmpgt_epi16(B0, A0);
-  const __m128i A2 = _mm_sub_epi16(A1, BgtA);
-  const __m128i A3 = _mm_srai_epi16(A2, 1);
-  const __m128i A4 = _mm_add_epi16(A0, A3);
-  const __m128i A5 = _mm_packus_epi16(A4, A4);
-  const uint32_t output = _mm_cvtsi128_si32(A5);
-  return output;
-}
-
-static WEBP_INLINE uint32_t SelectSSE2(uint32_t a, uint32_t b, uint32_t c) {
-  int pa_minus_pb;
-  const __m128i zero = _mm_setzero_si128();
-  const __m128i A0 = _mm_cvtsi32_si128(a);
-  const __m128i B0 = _mm_cvtsi32_si128(b);
-  const __m128i C0 = _mm_cvtsi32_si128(c);
-  const __m128i AC0 = _mm_subs_epu8(A0, C0);
-  const __m128i CA0 = _mm_subs_epu8(C0, A0);
-  const __m128i BC0 = _mm_subs_epu8(B0, C0);
-  const __m128i CB0 = _mm_subs_epu8(C0, B0);
-  const __m128i AC = _mm_or_si128(AC0, CA0);
-  const __m128i BC = _mm_or_si128(BC0, CB0);
-  const __m128i pa = _mm_unpacklo_epi8(AC, zero);  // |a - c|
-  const __m128i pb = _mm_unpacklo_epi8(BC, zero);  // |b - c|
-  const __m128i diff = _mm_sub_epi16(pb, pa);
-  {
-    int16_t out[8];
-    _mm_storeu_si128((__m128i*)out, diff);
-    pa_minus_pb = out[0] + out[1] + out[2] + out[3];
-  }
-  return (pa_minus_pb <= 0) ? a : b;
-}
-
-static void SubtractGreenFromBlueAndRedSSE2(uint32_t* argb_data, int num_pixs) {
-  int i = 0;
-  const __m128i mask = _mm_set1_epi32(0x0000ff00);
-  for (; i + 4 < num_pixs; i += 4) {
-    const __m128i in = _mm_loadu_si128((__m128i*)&argb_data[i]);
-    const __m128i in_00g0 = _mm_and_si128(in, mask);     // 00g0|00g0|...
-    const __m128i in_0g00 = _mm_slli_epi32(in_00g0, 8);  // 0g00|0g00|...
-    const __m128i in_000g = _mm_srli_epi32(in_00g0, 8);  // 000g|000g|...
-    const __m128i in_0g0g = _mm_or_si128(in_0g00, in_000g);
-    const __m128i out = _mm_sub_epi8(in, in_0g0g);
-    _mm_storeu_si128((__m128i*)&argb_data[i], out);
-  }
-  // fallthrough and finish off with plain-C
-  for (; i < num_pixs; ++i) {
-    const uint32_t argb = argb_data[i];
-    const uint32_t green = (argb >> 8) & 0xff;
-    const uint32_t new_r = (((argb >> 16) & 0xff) - green) & 0xff;
-    const uint32_t new_b = ((argb & 0xff) - green) & 0xff;
-    argb_data[i] = (argb & 0xff00ff00) | (new_r << 16) | new_b;
-  }
-}
-
-static void AddGreenToBlueAndRedSSE2(uint32_t* data, const uint32_t* data_end) {
-  const __m128i mask = _mm_set1_epi32(0x0000ff00);
-  for (; data + 4 < data_end; data += 4) {
-    const __m128i in = _mm_loadu_si128((__m128i*)data);
-    const __m128i in_00g0 = _mm_and_si128(in, mask);     // 00g0|00g0|...
-    const __m128i in_0g00 = _mm_slli_epi32(in_00g0, 8);  // 0g00|0g00|...
-    const __m128i in_000g = _mm_srli_epi32(in_00g0, 8);  // 000g|000g|...
-    const __m128i in_0g0g = _mm_or_si128(in_0g00, in_000g);
-    const __m128i out = _mm_add_epi8(in, in_0g0g);
-    _mm_storeu_si128((__m128i*)data, out);
-  }
-  // fallthrough and finish off with plain-C
-  while (data < data_end) {
-    const uint32_t argb = *data;
-    const uint32_t green = ((argb >> 8) & 0xff);
-    uint32_t red_blue = (argb & 0x00ff00ffu);
-    red_blue += (green << 16) | green;
-    red_blue &= 0x00ff00ffu;
-    *data++ = (argb & 0xff00ff00u) | red_blue;
-  }
+void VP8LAddVector_C(const int* a, const int* b, int* out, int size) {
+  int i;
+  for (i = 0; i < size; ++i) out[i] = a[i] + b[i];
 }
 
-extern void VP8LDspInitSSE2(void);
-
-void VP8LDspInitSSE2(void) {
-  VP8LClampedAddSubtractFull = ClampedAddSubtractFullSSE2;
-  VP8LClampedAddSubtractHalf = ClampedAddSubtractHalfSSE2;
-  VP8LSelect = SelectSSE2;
-  VP8LSubtractGreenFromBlueAndRed = SubtractGreenFromBlueAndRedSSE2;
-  VP8LAddGreenToBlueAndRed = AddGreenToBlueAndRedSSE2;
-}
-#endif
 //------------------------------------------------------------------------------
 
 VP8LPredClampedAddSubFunc VP8LClampedAddSubtractFull;
@@ -1511,6 +1559,20 @@ VP8LPredSelectFunc VP8LSelect;
 VP8LSubtractGreenFromBlueAndRedFunc VP8LSubtractGreenFromBlueAndRed;
 VP8LAddGreenToBlueAndRedFunc VP8LAddGreenToBlueAndRed;
 
+VP8LTransformColorFunc VP8LTransformColor;
+VP8LTransformColorFunc VP8LTransformColorInverse;
+
+VP8LConvertFunc VP8LConvertBGRAToRGB;
+VP8LConvertFunc VP8LConvertBGRAToRGBA;
+VP8LConvertFunc VP8LConvertBGRAToRGBA4444;
+VP8LConvertFunc VP8LConvertBGRAToRGB565;
+VP8LConvertFunc VP8LConvertBGRAToBGR;
+
+VP8LAddVectorFunc VP8LAddVector;
+
+extern void VP8LDspInitSSE2(void);
+extern void VP8LDspInitNEON(void);
+
 void VP8LDspInit(void) {
   VP8LClampedAddSubtractFull = ClampedAddSubtractFull;
   VP8LClampedAddSubtractHalf = ClampedAddSubtractHalf;
@@ -1518,12 +1580,27 @@ void VP8LDspInit(void) {
   VP8LSubtractGreenFromBlueAndRed = SubtractGreenFromBlueAndRed;
   VP8LAddGreenToBlueAndRed = AddGreenToBlueAndRed;
 
+  VP8LTransformColor = VP8LTransformColor_C;
+  VP8LTransformColorInverse = VP8LTransformColorInverse_C;
+
+  VP8LConvertBGRAToRGB = VP8LConvertBGRAToRGB_C;
+  VP8LConvertBGRAToRGBA = VP8LConvertBGRAToRGBA_C;
+  VP8LConvertBGRAToRGBA4444 = VP8LConvertBGRAToRGBA4444_C;
+  VP8LConvertBGRAToRGB565 = VP8LConvertBGRAToRGB565_C;
+  VP8LConvertBGRAToBGR = VP8LConvertBGRAToBGR_C;
+
+  VP8LAddVector = VP8LAddVector_C;
+
   // If defined, use CPUInfo() to overwrite some pointers with faster versions.
   if (VP8GetCPUInfo != NULL) {
 #if defined(WEBP_USE_SSE2)
     if (VP8GetCPUInfo(kSSE2)) {
       VP8LDspInitSSE2();
     }
+#elif defined(WEBP_USE_NEON)
+    if (VP8GetCPUInfo(kNEON)) {
+      VP8LDspInitNEON();
+    }
 #endif
   }
 }
@@ -39,6 +39,50 @@ extern VP8LPredSelectFunc VP8LSelect;
 extern VP8LSubtractGreenFromBlueAndRedFunc VP8LSubtractGreenFromBlueAndRed;
 extern VP8LAddGreenToBlueAndRedFunc VP8LAddGreenToBlueAndRed;
 
+typedef struct {
+  // Note: the members are uint8_t, so that any negative values are
+  // automatically converted to "mod 256" values.
+  uint8_t green_to_red_;
+  uint8_t green_to_blue_;
+  uint8_t red_to_blue_;
+} VP8LMultipliers;
+
+// Applies the forward (resp. inverse) cross-color transform 'm' in-place to
+// the 'num_pixels' ARGB pixels of 'data'.
+typedef void (*VP8LTransformColorFunc)(const VP8LMultipliers* const m,
+                                       uint32_t* data, int num_pixels);
+extern VP8LTransformColorFunc VP8LTransformColor;
+extern VP8LTransformColorFunc VP8LTransformColorInverse;
+
+// Converts 'num_pixels' BGRA pixels of 'src' into packed 'dst' samples.
+typedef void (*VP8LConvertFunc)(const uint32_t* src, int num_pixels,
+                                uint8_t* dst);
+extern VP8LConvertFunc VP8LConvertBGRAToRGB;
+extern VP8LConvertFunc VP8LConvertBGRAToRGBA;
+extern VP8LConvertFunc VP8LConvertBGRAToRGBA4444;
+extern VP8LConvertFunc VP8LConvertBGRAToRGB565;
+extern VP8LConvertFunc VP8LConvertBGRAToBGR;
+
+// Stores a[i] + b[i] in out[i] for the 'size' first entries. 'out' can be
+// the same as 'a' or 'b'. Used to combine histograms.
+typedef void (*VP8LAddVectorFunc)(const int* a, const int* b, int* out,
+                                  int size);
+extern VP8LAddVectorFunc VP8LAddVector;
+
+// Plain-C versions of the above, used by the SIMD variants for the left-overs.
+void VP8LTransformColor_C(const VP8LMultipliers* const m,
+                          uint32_t* data, int num_pixels);
+void VP8LTransformColorInverse_C(const VP8LMultipliers* const m,
+                                 uint32_t* data, int num_pixels);
+void VP8LConvertBGRAToRGB_C(const uint32_t* src, int num_pixels, uint8_t* dst);
+void VP8LConvertBGRAToRGBA_C(const uint32_t* src, int num_pixels, uint8_t* dst);
+void VP8LConvertBGRAToRGBA4444_C(const uint32_t* src,
+                                 int num_pixels, uint8_t* dst);
+void VP8LConvertBGRAToRGB565_C(const uint32_t* src,
+                               int num_pixels, uint8_t* dst);
+void VP8LConvertBGRAToBGR_C(const uint32_t* src, int num_pixels, uint8_t* dst);
+void VP8LAddVector_C(const int* a, const int* b, int* out, int size);
+
 // Must be called before calling any of the above methods.
 void VP8LDspInit(void);
 
@@ -62,12 +106,17 @@ void VP8LColorIndexInverseTransformAlpha(
     const struct VP8LTransform* const transform, int y_start, int y_end,
     const uint8_t* src, uint8_t* dst);
 
-void VP8LResidualImage(int width, int height, int bits,
-                       uint32_t* const argb, uint32_t* const argb_scratch,
-                       uint32_t* const image);
-
-void VP8LColorSpaceTransform(int width, int height, int bits, int step,
-                             uint32_t* const argb, uint32_t* image);
+// Encoder-side searches of the predictor and cross-color transforms. The
+// candidates tried for each tile are split between up to 'num_threads'
+// threads; the output doesn't depend on this number. Return false in case of
+// memory error.
+int VP8LResidualImage(int width, int height, int bits,
+                      uint32_t* const argb, uint32_t* const argb_scratch,
+                      uint32_t* const image, int num_threads);
+
+int VP8LColorSpaceTransform(int width, int height, int bits, int step,
+                            uint32_t* const argb, uint32_t* image,
+                            int num_threads);
 
 //------------------------------------------------------------------------------
 // Color space conversion.
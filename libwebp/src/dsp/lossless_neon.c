@@ -0,0 +1,249 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// NEON variant of methods for lossless decoder / encoder (predictors, green
+// and cross-color transforms, BGRA color-space conversion).
+//
+// Authors: Vikas Arora (vikaas.arora@gmail.com)
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_NEON)
+
+#include <arm_neon.h>
+#include "./lossless.h"
+
+//------------------------------------------------------------------------------
+// Predictor Transform
+
+// Loads the 4 channels of 'argb' into the lower lanes of a uint8x8_t.
+static WEBP_INLINE uint8x8_t LoadPixel(uint32_t argb) {
+  return vreinterpret_u8_u32(vdup_n_u32(argb));
+}
+
+static WEBP_INLINE uint32_t StorePixel(uint8x8_t argb) {
+  return vget_lane_u32(vreinterpret_u32_u8(argb), 0);
+}
+
+static uint32_t ClampedAddSubtractFullNEON(uint32_t c0, uint32_t c1,
+                                           uint32_t c2) {
+  const uint16x8_t sum = vaddl_u8(LoadPixel(c0), LoadPixel(c1));
+  const uint16x8_t diff = vsubq_u16(sum, vmovl_u8(LoadPixel(c2)));
+  return StorePixel(vqmovun_s16(vreinterpretq_s16_u16(diff)));
+}
+
+static uint32_t ClampedAddSubtractHalfNEON(uint32_t c0, uint32_t c1,
+                                           uint32_t c2) {
+  const uint8x8_t ave = vhadd_u8(LoadPixel(c0), LoadPixel(c1));  // Average2()
+  const int16x8_t A = vreinterpretq_s16_u16(vmovl_u8(ave));
+  const int16x8_t diff = vreinterpretq_s16_u16(vsubl_u8(ave, LoadPixel(c2)));
+  // (a - b) / 2, rounded towards zero like the plain-C division.
+  const uint16x8_t sign = vshrq_n_u16(vreinterpretq_u16_s16(diff), 15);
+  const int16x8_t half =
+      vshrq_n_s16(vaddq_s16(diff, vreinterpretq_s16_u16(sign)), 1);
+  return StorePixel(vqmovun_s16(vaddq_s16(A, half)));
+}
+
+static uint32_t SelectNEON(uint32_t a, uint32_t b, uint32_t c) {
+  const uint8x8_t A = LoadPixel(a);
+  const uint8x8_t B = LoadPixel(b);
+  const uint8x8_t C = LoadPixel(c);
+  const uint32x2_t pa = vpaddl_u16(vpaddl_u8(vabd_u8(A, C)));  // sum |a - c|
+  const uint32x2_t pb = vpaddl_u16(vpaddl_u8(vabd_u8(B, C)));  // sum |b - c|
+  return (vget_lane_u32(pb, 0) <= vget_lane_u32(pa, 0)) ? a : b;
+}
+
+//------------------------------------------------------------------------------
+// Subtract-Green Transform
+
+// Returns the green channel of the 4 pixels, copied in the blue and red lanes.
+static WEBP_INLINE uint8x16_t GetGreen0g0g(const uint32x4_t argb) {
+  const uint32x4_t g = vandq_u32(argb, vdupq_n_u32(0x0000ff00));  // 00g0
+  return vreinterpretq_u8_u32(vorrq_u32(vshlq_n_u32(g, 8),
+                                        vshrq_n_u32(g, 8)));      // 0g0g
+}
+
+static void SubtractGreenFromBlueAndRedNEON(uint32_t* argb_data, int num_pixs) {
+  int i = 0;
+  for (; i + 4 <= num_pixs; i += 4) {
+    const uint32x4_t in = vld1q_u32(argb_data + i);
+    const uint8x16_t out = vsubq_u8(vreinterpretq_u8_u32(in), GetGreen0g0g(in));
+    vst1q_u32(argb_data + i, vreinterpretq_u32_u8(out));
+  }
+  // fallthrough and finish off with plain-C
+  for (; i < num_pixs; ++i) {
+    const uint32_t argb = argb_data[i];
+    const uint32_t green = (argb >> 8) & 0xff;
+    const uint32_t new_r = (((argb >> 16) & 0xff) - green) & 0xff;
+    const uint32_t new_b = ((argb & 0xff) - green) & 0xff;
+    argb_data[i] = (argb & 0xff00ff00) | (new_r << 16) | new_b;
+  }
+}
+
+static void AddGreenToBlueAndRedNEON(uint32_t* data, const uint32_t* data_end) {
+  for (; data + 4 <= data_end; data += 4) {
+    const uint32x4_t in = vld1q_u32(data);
+    const uint8x16_t out = vaddq_u8(vreinterpretq_u8_u32(in), GetGreen0g0g(in));
+    vst1q_u32(data, vreinterpretq_u32_u8(out));
+  }
+  // fallthrough and finish off with plain-C
+  while (data < data_end) {
+    const uint32_t argb = *data;
+    const uint32_t green = ((argb >> 8) & 0xff);
+    uint32_t red_blue = (argb & 0x00ff00ffu);
+    red_blue += (green << 16) | green;
+    red_blue &= 0x00ff00ffu;
+    *data++ = (argb & 0xff00ff00u) | red_blue;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Color Transform
+
+// Same trick as in the SSE2 version: with 'color << 8' in the 16b lanes,
+// the doubling high-half multiply by 'multiplier << 2' gives the exact
+// (color * multiplier) >> 5 of ColorTransformDelta() (no saturation possible).
+static WEBP_INLINE int16x8_t GetMultipliers(uint8_t lo, uint8_t hi) {
+  const uint16_t lo_16b = (uint16_t)((int8_t)lo * 4);
+  const uint16_t hi_16b = (uint16_t)((int8_t)hi * 4);
+  return vreinterpretq_s16_u32(vdupq_n_u32(((uint32_t)hi_16b << 16) | lo_16b));
+}
+
+// Returns the deltas to apply to the blue and red channels, given the channel
+// values 'c' stored as 'c << 8' in the 16b lanes.
+static WEBP_INLINE uint8x16_t GetDelta(const uint32x4_t c,
+                                       const int16x8_t mults) {
+  const int16x8_t delta = vqdmulhq_s16(vreinterpretq_s16_u32(c), mults);
+  return vreinterpretq_u8_u32(vandq_u32(vreinterpretq_u32_s16(delta),
+                                        vdupq_n_u32(0x00ff00ff)));
+}
+
+static void TransformColorNEON(const VP8LMultipliers* const m,
+                               uint32_t* data, int num_pixels) {
+  const int16x8_t mults_g = GetMultipliers(m->green_to_blue_, m->green_to_red_);
+  const int16x8_t mults_r = GetMultipliers(m->red_to_blue_, 0);
+  const uint32x4_t mask_g = vdupq_n_u32(0x0000ff00);
+  int i;
+  for (i = 0; i + 4 <= num_pixels; i += 4) {
+    const uint32x4_t in = vld1q_u32(data + i);
+    const uint32x4_t g = vandq_u32(in, mask_g);                  // 00g0
+    const uint32x4_t gg = vorrq_u32(g, vshlq_n_u32(g, 16));      // g0g0
+    const uint32x4_t r = vandq_u32(vshrq_n_u32(in, 8), mask_g);  // 00r0
+    const uint8x16_t tmp = vsubq_u8(vreinterpretq_u8_u32(in),
+                                    GetDelta(gg, mults_g));
+    const uint8x16_t out = vsubq_u8(tmp, GetDelta(r, mults_r));
+    vst1q_u32(data + i, vreinterpretq_u32_u8(out));
+  }
+  // fallthrough and finish off with plain-C
+  VP8LTransformColor_C(m, data + i, num_pixels - i);
+}
+
+static void TransformColorInverseNEON(const VP8LMultipliers* const m,
+                                      uint32_t* data, int num_pixels) {
+  const int16x8_t mults_g = GetMultipliers(m->green_to_blue_, m->green_to_red_);
+  const int16x8_t mults_r = GetMultipliers(m->red_to_blue_, 0);
+  const uint32x4_t mask_g = vdupq_n_u32(0x0000ff00);
+  int i;
+  for (i = 0; i + 4 <= num_pixels; i += 4) {
+    const uint32x4_t in = vld1q_u32(data + i);
+    const uint32x4_t g = vandq_u32(in, mask_g);                  // 00g0
+    const uint32x4_t gg = vorrq_u32(g, vshlq_n_u32(g, 16));      // g0g0
+    // The red channel is final after this step, and is then used for blue.
+    const uint32x4_t tmp = vreinterpretq_u32_u8(
+        vaddq_u8(vreinterpretq_u8_u32(in), GetDelta(gg, mults_g)));
+    const uint32x4_t r = vandq_u32(vshrq_n_u32(tmp, 8), mask_g);  // 00r0
+    const uint8x16_t out = vaddq_u8(vreinterpretq_u8_u32(tmp),
+                                    GetDelta(r, mults_r));
+    vst1q_u32(data + i, vreinterpretq_u32_u8(out));
+  }
+  // fallthrough and finish off with plain-C
+  VP8LTransformColorInverse_C(m, data + i, num_pixels - i);
+}
+
+//------------------------------------------------------------------------------
+// Color-space conversion functions
+
+static void ConvertBGRAToRGBNEON(const uint32_t* src,
+                                 int num_pixels, uint8_t* dst) {
+  const uint32_t* const src_end = src + (num_pixels & ~15);
+  for (; src < src_end; src += 16, dst += 16 * 3) {
+    const uint8x16x4_t bgra = vld4q_u8((const uint8_t*)src);
+    uint8x16x3_t rgb;
+    rgb.val[0] = bgra.val[2];
+    rgb.val[1] = bgra.val[1];
+    rgb.val[2] = bgra.val[0];
+    vst3q_u8(dst, rgb);
+  }
+  VP8LConvertBGRAToRGB_C(src, num_pixels & 15, dst);
+}
+
+static void ConvertBGRAToRGBANEON(const uint32_t* src,
+                                  int num_pixels, uint8_t* dst) {
+  const uint32_t* const src_end = src + (num_pixels & ~15);
+  for (; src < src_end; src += 16, dst += 16 * 4) {
+    uint8x16x4_t pixel = vld4q_u8((const uint8_t*)src);
+    const uint8x16_t tmp = pixel.val[0];   // swap B and R
+    pixel.val[0] = pixel.val[2];
+    pixel.val[2] = tmp;
+    vst4q_u8(dst, pixel);
+  }
+  VP8LConvertBGRAToRGBA_C(src, num_pixels & 15, dst);
+}
+
+static void ConvertBGRAToBGRNEON(const uint32_t* src,
+                                 int num_pixels, uint8_t* dst) {
+  const uint32_t* const src_end = src + (num_pixels & ~15);
+  for (; src < src_end; src += 16, dst += 16 * 3) {
+    const uint8x16x4_t bgra = vld4q_u8((const uint8_t*)src);
+    uint8x16x3_t bgr;
+    bgr.val[0] = bgra.val[0];
+    bgr.val[1] = bgra.val[1];
+    bgr.val[2] = bgra.val[2];
+    vst3q_u8(dst, bgr);
+  }
+  VP8LConvertBGRAToBGR_C(src, num_pixels & 15, dst);
+}
+
+//------------------------------------------------------------------------------
+
+static void AddVectorNEON(const int* a, const int* b, int* out, int size) {
+  int i;
+  for (i = 0; i + 4 <= size; i += 4) {
+    const int32x4_t A = vld1q_s32((const int32_t*)(a + i));
+    const int32x4_t B = vld1q_s32((const int32_t*)(b + i));
+    vst1q_s32((int32_t*)(out + i), vaddq_s32(A, B));
+  }
+  if (i < size) VP8LAddVector_C(a + i, b + i, out + i, size - i);
+}
+
+#endif   // WEBP_USE_NEON
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8LDspInitNEON(void);
+
+void VP8LDspInitNEON(void) {
+#if defined(WEBP_USE_NEON)
+  VP8LClampedAddSubtractFull = ClampedAddSubtractFullNEON;
+  VP8LClampedAddSubtractHalf = ClampedAddSubtractHalfNEON;
+  VP8LSelect = SelectNEON;
+  VP8LSubtractGreenFromBlueAndRed = SubtractGreenFromBlueAndRedNEON;
+  VP8LAddGreenToBlueAndRed = AddGreenToBlueAndRedNEON;
+
+  VP8LTransformColor = TransformColorNEON;
+  VP8LTransformColorInverse = TransformColorInverseNEON;
+
+  VP8LConvertBGRAToRGB = ConvertBGRAToRGBNEON;
+  VP8LConvertBGRAToRGBA = ConvertBGRAToRGBANEON;
+  VP8LConvertBGRAToBGR = ConvertBGRAToBGRNEON;
+
+  VP8LAddVector = AddVectorNEON;
+#endif   // WEBP_USE_NEON
+}
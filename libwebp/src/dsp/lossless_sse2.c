@@ -0,0 +1,368 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// SSE2 variant of methods for lossless decoder / encoder (predictors, green
+// and cross-color transforms, BGRA color-space conversion).
+//
+// Authors: Vikas Arora (vikaas.arora@gmail.com)
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_SSE2)
+
+#include <emmintrin.h>
+#include "./lossless.h"
+
+//------------------------------------------------------------------------------
+// Predictor Transform
+
+static WEBP_INLINE uint32_t Average2(uint32_t a0, uint32_t a1) {
+  return (((a0 ^ a1) & 0xfefefefeL) >> 1) + (a0 & a1);
+}
+
+static uint32_t ClampedAddSubtractFullSSE2(uint32_t c0, uint32_t c1,
+                                           uint32_t c2) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i C0 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c0), zero);
+  const __m128i C1 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c1), zero);
+  const __m128i C2 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c2), zero);
+  const __m128i V1 = _mm_add_epi16(C0, C1);
+  const __m128i V2 = _mm_sub_epi16(V1, C2);
+  const __m128i b = _mm_packus_epi16(V2, V2);
+  const uint32_t output = _mm_cvtsi128_si32(b);
+  return output;
+}
+
+static uint32_t ClampedAddSubtractHalfSSE2(uint32_t c0, uint32_t c1,
+                                           uint32_t c2) {
+  const uint32_t ave = Average2(c0, c1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i A0 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(ave), zero);
+  const __m128i B0 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c2), zero);
+  const __m128i A1 = _mm_sub_epi16(A0, B0);
+  const __m128i BgtA = _mm_cmpgt_epi16(B0, A0);
+  const __m128i A2 = _mm_sub_epi16(A1, BgtA);
+  const __m128i A3 = _mm_srai_epi16(A2, 1);
+  const __m128i A4 = _mm_add_epi16(A0, A3);
+  const __m128i A5 = _mm_packus_epi16(A4, A4);
+  const uint32_t output = _mm_cvtsi128_si32(A5);
+  return output;
+}
+
+static uint32_t SelectSSE2(uint32_t a, uint32_t b, uint32_t c) {
+  int pa_minus_pb;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i A0 = _mm_cvtsi32_si128(a);
+  const __m128i B0 = _mm_cvtsi32_si128(b);
+  const __m128i C0 = _mm_cvtsi32_si128(c);
+  const __m128i AC0 = _mm_subs_epu8(A0, C0);
+  const __m128i CA0 = _mm_subs_epu8(C0, A0);
+  const __m128i BC0 = _mm_subs_epu8(B0, C0);
+  const __m128i CB0 = _mm_subs_epu8(C0, B0);
+  const __m128i AC = _mm_or_si128(AC0, CA0);
+  const __m128i BC = _mm_or_si128(BC0, CB0);
+  const __m128i pa = _mm_unpacklo_epi8(AC, zero);  // |a - c|
+  const __m128i pb = _mm_unpacklo_epi8(BC, zero);  // |b - c|
+  const __m128i diff = _mm_sub_epi16(pb, pa);
+  {
+    int16_t out[8];
+    _mm_storeu_si128((__m128i*)out, diff);
+    pa_minus_pb = out[0] + out[1] + out[2] + out[3];
+  }
+  return (pa_minus_pb <= 0) ? a : b;
+}
+
+//------------------------------------------------------------------------------
+// Subtract-Green Transform
+
+static void SubtractGreenFromBlueAndRedSSE2(uint32_t* argb_data, int num_pixs) {
+  int i = 0;
+  const __m128i mask = _mm_set1_epi32(0x0000ff00);
+  for (; i + 4 < num_pixs; i += 4) {
+    const __m128i in = _mm_loadu_si128((__m128i*)&argb_data[i]);
+    const __m128i in_00g0 = _mm_and_si128(in, mask);     // 00g0|00g0|...
+    const __m128i in_0g00 = _mm_slli_epi32(in_00g0, 8);  // 0g00|0g00|...
+    const __m128i in_000g = _mm_srli_epi32(in_00g0, 8);  // 000g|000g|...
+    const __m128i in_0g0g = _mm_or_si128(in_0g00, in_000g);
+    const __m128i out = _mm_sub_epi8(in, in_0g0g);
+    _mm_storeu_si128((__m128i*)&argb_data[i], out);
+  }
+  // fallthrough and finish off with plain-C
+  for (; i < num_pixs; ++i) {
+    const uint32_t argb = argb_data[i];
+    const uint32_t green = (argb >> 8) & 0xff;
+    const uint32_t new_r = (((argb >> 16) & 0xff) - green) & 0xff;
+    const uint32_t new_b = ((argb & 0xff) - green) & 0xff;
+    argb_data[i] = (argb & 0xff00ff00) | (new_r << 16) | new_b;
+  }
+}
+
+static void AddGreenToBlueAndRedSSE2(uint32_t* data, const uint32_t* data_end) {
+  const __m128i mask = _mm_set1_epi32(0x0000ff00);
+  for (; data + 4 < data_end; data += 4) {
+    const __m128i in = _mm_loadu_si128((__m128i*)data);
+    const __m128i in_00g0 = _mm_and_si128(in, mask);     // 00g0|00g0|...
+    const __m128i in_0g00 = _mm_slli_epi32(in_00g0, 8);  // 0g00|0g00|...
+    const __m128i in_000g = _mm_srli_epi32(in_00g0, 8);  // 000g|000g|...
+    const __m128i in_0g0g = _mm_or_si128(in_0g00, in_000g);
+    const __m128i out = _mm_add_epi8(in, in_0g0g);
+    _mm_storeu_si128((__m128i*)data, out);
+  }
+  // fallthrough and finish off with plain-C
+  while (data < data_end) {
+    const uint32_t argb = *data;
+    const uint32_t green = ((argb >> 8) & 0xff);
+    uint32_t red_blue = (argb & 0x00ff00ffu);
+    red_blue += (green << 16) | green;
+    red_blue &= 0x00ff00ffu;
+    *data++ = (argb & 0xff00ff00u) | red_blue;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Color Transform
+
+// The color deltas are computed on 16b lanes holding 'color << 8': multiplying
+// by 'multiplier << 3' and keeping the upper 16b of the product (mulhi) gives
+// exactly the (color * multiplier) >> 5 value of ColorTransformDelta().
+// The lower 16b lane of each pixel receives 'lo', the upper one 'hi'.
+static WEBP_INLINE __m128i GetMultipliers(uint8_t lo, uint8_t hi) {
+  const uint16_t lo_16b = (uint16_t)((int8_t)lo * 8);
+  const uint16_t hi_16b = (uint16_t)((int8_t)hi * 8);
+  return _mm_set1_epi32((int)(((uint32_t)hi_16b << 16) | lo_16b));
+}
+
+static void TransformColorSSE2(const VP8LMultipliers* const m,
+                               uint32_t* data, int num_pixels) {
+  const __m128i mults_g = GetMultipliers(m->green_to_blue_, m->green_to_red_);
+  const __m128i mults_r = GetMultipliers(m->red_to_blue_, 0);
+  const __m128i mask_g = _mm_set1_epi32(0x0000ff00);
+  const __m128i mask_rb = _mm_set1_epi32(0x00ff00ff);
+  int i;
+  for (i = 0; i + 4 <= num_pixels; i += 4) {
+    const __m128i in = _mm_loadu_si128((__m128i*)&data[i]);
+    const __m128i g = _mm_and_si128(in, mask_g);                // 00g0
+    const __m128i gg = _mm_or_si128(g, _mm_slli_epi32(g, 16));  // g0g0
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(in, 8), mask_g);  // 00r0
+    const __m128i delta_g = _mm_mulhi_epi16(gg, mults_g);
+    const __m128i delta_r = _mm_mulhi_epi16(r, mults_r);
+    const __m128i delta = _mm_and_si128(_mm_add_epi16(delta_g, delta_r),
+                                        mask_rb);
+    const __m128i out = _mm_sub_epi8(in, delta);
+    _mm_storeu_si128((__m128i*)&data[i], out);
+  }
+  // fallthrough and finish off with plain-C
+  VP8LTransformColor_C(m, data + i, num_pixels - i);
+}
+
+static void TransformColorInverseSSE2(const VP8LMultipliers* const m,
+                                      uint32_t* data, int num_pixels) {
+  const __m128i mults_g = GetMultipliers(m->green_to_blue_, m->green_to_red_);
+  const __m128i mults_r = GetMultipliers(m->red_to_blue_, 0);
+  const __m128i mask_g = _mm_set1_epi32(0x0000ff00);
+  const __m128i mask_rb = _mm_set1_epi32(0x00ff00ff);
+  int i;
+  for (i = 0; i + 4 <= num_pixels; i += 4) {
+    const __m128i in = _mm_loadu_si128((__m128i*)&data[i]);
+    const __m128i g = _mm_and_si128(in, mask_g);                // 00g0
+    const __m128i gg = _mm_or_si128(g, _mm_slli_epi32(g, 16));  // g0g0
+    const __m128i delta_g = _mm_and_si128(_mm_mulhi_epi16(gg, mults_g),
+                                          mask_rb);
+    // The red channel is final after this step, and is then used for blue.
+    const __m128i tmp = _mm_add_epi8(in, delta_g);
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(tmp, 8), mask_g);  // 00r0
+    const __m128i delta_r = _mm_and_si128(_mm_mulhi_epi16(r, mults_r),
+                                          mask_rb);
+    const __m128i out = _mm_add_epi8(tmp, delta_r);
+    _mm_storeu_si128((__m128i*)&data[i], out);
+  }
+  // fallthrough and finish off with plain-C
+  VP8LTransformColorInverse_C(m, data + i, num_pixels - i);
+}
+
+//------------------------------------------------------------------------------
+// Color-space conversion functions
+
+// Swaps the blue and red channels of the 4 pixels: bgra -> rgba.
+static WEBP_INLINE __m128i SwapRB(const __m128i bgra) {
+  const __m128i mask_ag = _mm_set1_epi32(0xff00ff00);
+  const __m128i ag = _mm_and_si128(bgra, mask_ag);
+  const __m128i rb = _mm_andnot_si128(mask_ag, bgra);
+  const __m128i br = _mm_or_si128(_mm_slli_epi32(rb, 16),
+                                  _mm_srli_epi32(rb, 16));
+  return _mm_or_si128(ag, br);
+}
+
+// Drops the fourth byte of the 4 pixels, and packs the remaining 12 bytes in
+// the lower part of the register. The upper 4 bytes are zero.
+static WEBP_INLINE __m128i PackRGB(const __m128i in) {
+  const __m128i mask_even = _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff);
+  const __m128i mask_odd = _mm_slli_epi64(mask_even, 32);
+  const __m128i even = _mm_and_si128(in, mask_even);
+  const __m128i odd = _mm_and_si128(in, mask_odd);
+  // 6 bytes per 64b half: rgb0 rgb1 | rgb2 rgb3
+  const __m128i v0 = _mm_or_si128(even, _mm_srli_epi64(odd, 8));
+  const __m128i lo = _mm_move_epi64(v0);
+  const __m128i hi = _mm_xor_si128(v0, lo);
+  return _mm_or_si128(lo, _mm_srli_si128(hi, 2));
+}
+
+// Stores the 8 pixels packed by PackRGB() as 24 contiguous bytes.
+static WEBP_INLINE void StoreRGB(const __m128i rgb0, const __m128i rgb4,
+                                 uint8_t* const dst) {
+  _mm_storeu_si128((__m128i*)dst, _mm_or_si128(rgb0, _mm_slli_si128(rgb4, 12)));
+  _mm_storel_epi64((__m128i*)(dst + 16), _mm_srli_si128(rgb4, 4));
+}
+
+// Packs the eight 32b values of 'a' and 'b', which must fit in 16 bits.
+static WEBP_INLINE __m128i Pack32bTo16b(const __m128i a, const __m128i b) {
+  // sign-extend, so that _mm_packs_epi32() doesn't saturate.
+  const __m128i A = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+  const __m128i B = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+  return _mm_packs_epi32(A, B);
+}
+
+static void ConvertBGRAToRGBSSE2(const uint32_t* src,
+                                 int num_pixels, uint8_t* dst) {
+  const __m128i* in = (const __m128i*)src;
+  const uint32_t* const src_end = src + (num_pixels & ~7);
+  for (; (const uint32_t*)in < src_end; in += 2, dst += 24) {
+    const __m128i rgb0 = PackRGB(SwapRB(_mm_loadu_si128(in + 0)));
+    const __m128i rgb4 = PackRGB(SwapRB(_mm_loadu_si128(in + 1)));
+    StoreRGB(rgb0, rgb4, dst);
+  }
+  VP8LConvertBGRAToRGB_C(src_end, num_pixels & 7, dst);
+}
+
+static void ConvertBGRAToRGBASSE2(const uint32_t* src,
+                                  int num_pixels, uint8_t* dst) {
+  const __m128i* in = (const __m128i*)src;
+  __m128i* out = (__m128i*)dst;
+  const uint32_t* const src_end = src + (num_pixels & ~3);
+  for (; (const uint32_t*)in < src_end; ++in, ++out) {
+    _mm_storeu_si128(out, SwapRB(_mm_loadu_si128(in)));
+  }
+  VP8LConvertBGRAToRGBA_C(src_end, num_pixels & 3, (uint8_t*)out);
+}
+
+// Computes the two bytes of the output pixels, for 4 input pixels.
+static WEBP_INLINE __m128i BGRAToRGBA4444(const __m128i argb) {
+  const __m128i mask_f0 = _mm_set1_epi32(0xf0);
+  const __m128i mask_0f = _mm_set1_epi32(0x0f);
+  const __m128i r = _mm_and_si128(_mm_srli_epi32(argb, 16), mask_f0);
+  const __m128i g = _mm_and_si128(_mm_srli_epi32(argb, 12), mask_0f);
+  const __m128i b = _mm_and_si128(argb, mask_f0);
+  const __m128i a = _mm_srli_epi32(argb, 28);
+  const __m128i rg = _mm_or_si128(r, g);
+  const __m128i ba = _mm_or_si128(b, a);
+#ifdef WEBP_SWAP_16BIT_CSP
+  return _mm_or_si128(ba, _mm_slli_epi32(rg, 8));
+#else
+  return _mm_or_si128(rg, _mm_slli_epi32(ba, 8));
+#endif
+}
+
+static void ConvertBGRAToRGBA4444SSE2(const uint32_t* src,
+                                      int num_pixels, uint8_t* dst) {
+  const __m128i* in = (const __m128i*)src;
+  __m128i* out = (__m128i*)dst;
+  const uint32_t* const src_end = src + (num_pixels & ~7);
+  for (; (const uint32_t*)in < src_end; in += 2, ++out) {
+    const __m128i v0 = BGRAToRGBA4444(_mm_loadu_si128(in + 0));
+    const __m128i v4 = BGRAToRGBA4444(_mm_loadu_si128(in + 1));
+    _mm_storeu_si128(out, Pack32bTo16b(v0, v4));
+  }
+  VP8LConvertBGRAToRGBA4444_C(src_end, num_pixels & 7, (uint8_t*)out);
+}
+
+static WEBP_INLINE __m128i BGRAToRGB565(const __m128i argb) {
+  const __m128i r = _mm_and_si128(_mm_srli_epi32(argb, 16),
+                                  _mm_set1_epi32(0xf8));
+  const __m128i g_hi = _mm_and_si128(_mm_srli_epi32(argb, 13),
+                                     _mm_set1_epi32(0x07));
+  const __m128i g_lo = _mm_and_si128(_mm_srli_epi32(argb, 5),
+                                     _mm_set1_epi32(0xe0));
+  const __m128i b = _mm_and_si128(_mm_srli_epi32(argb, 3),
+                                  _mm_set1_epi32(0x1f));
+  const __m128i rg = _mm_or_si128(r, g_hi);
+  const __m128i gb = _mm_or_si128(g_lo, b);
+#ifdef WEBP_SWAP_16BIT_CSP
+  return _mm_or_si128(gb, _mm_slli_epi32(rg, 8));
+#else
+  return _mm_or_si128(rg, _mm_slli_epi32(gb, 8));
+#endif
+}
+
+static void ConvertBGRAToRGB565SSE2(const uint32_t* src,
+                                    int num_pixels, uint8_t* dst) {
+  const __m128i* in = (const __m128i*)src;
+  __m128i* out = (__m128i*)dst;
+  const uint32_t* const src_end = src + (num_pixels & ~7);
+  for (; (const uint32_t*)in < src_end; in += 2, ++out) {
+    const __m128i v0 = BGRAToRGB565(_mm_loadu_si128(in + 0));
+    const __m128i v4 = BGRAToRGB565(_mm_loadu_si128(in + 1));
+    _mm_storeu_si128(out, Pack32bTo16b(v0, v4));
+  }
+  VP8LConvertBGRAToRGB565_C(src_end, num_pixels & 7, (uint8_t*)out);
+}
+
+static void ConvertBGRAToBGRSSE2(const uint32_t* src,
+                                 int num_pixels, uint8_t* dst) {
+  const __m128i* in = (const __m128i*)src;
+  const uint32_t* const src_end = src + (num_pixels & ~7);
+  for (; (const uint32_t*)in < src_end; in += 2, dst += 24) {
+    const __m128i bgr0 = PackRGB(_mm_loadu_si128(in + 0));
+    const __m128i bgr4 = PackRGB(_mm_loadu_si128(in + 1));
+    StoreRGB(bgr0, bgr4, dst);
+  }
+  VP8LConvertBGRAToBGR_C(src_end, num_pixels & 7, dst);
+}
+
+//------------------------------------------------------------------------------
+
+static void AddVectorSSE2(const int* a, const int* b, int* out, int size) {
+  int i;
+  for (i = 0; i + 8 <= size; i += 8) {
+    const __m128i a0 = _mm_loadu_si128((const __m128i*)&a[i + 0]);
+    const __m128i a1 = _mm_loadu_si128((const __m128i*)&a[i + 4]);
+    const __m128i b0 = _mm_loadu_si128((const __m128i*)&b[i + 0]);
+    const __m128i b1 = _mm_loadu_si128((const __m128i*)&b[i + 4]);
+    _mm_storeu_si128((__m128i*)&out[i + 0], _mm_add_epi32(a0, b0));
+    _mm_storeu_si128((__m128i*)&out[i + 4], _mm_add_epi32(a1, b1));
+  }
+  if (i < size) VP8LAddVector_C(a + i, b + i, out + i, size - i);
+}
+
+#endif   // WEBP_USE_SSE2
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void VP8LDspInitSSE2(void);
+
+void VP8LDspInitSSE2(void) {
+#if defined(WEBP_USE_SSE2)
+  VP8LClampedAddSubtractFull = ClampedAddSubtractFullSSE2;
+  VP8LClampedAddSubtractHalf = ClampedAddSubtractHalfSSE2;
+  VP8LSelect = SelectSSE2;
+  VP8LSubtractGreenFromBlueAndRed = SubtractGreenFromBlueAndRedSSE2;
+  VP8LAddGreenToBlueAndRed = AddGreenToBlueAndRedSSE2;
+
+  VP8LTransformColor = TransformColorSSE2;
+  VP8LTransformColorInverse = TransformColorInverseSSE2;
+
+  VP8LConvertBGRAToRGB = ConvertBGRAToRGBSSE2;
+  VP8LConvertBGRAToRGBA = ConvertBGRAToRGBASSE2;
+  VP8LConvertBGRAToRGBA4444 = ConvertBGRAToRGBA4444SSE2;
+  VP8LConvertBGRAToRGB565 = ConvertBGRAToRGB565SSE2;
+  VP8LConvertBGRAToBGR = ConvertBGRAToBGRSSE2;
+
+  VP8LAddVector = AddVectorSSE2;
+#endif   // WEBP_USE_SSE2
+}
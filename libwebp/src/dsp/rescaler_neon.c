@@ -0,0 +1,181 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// NEON version of the rescaling functions.
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_NEON)
+
+#include <arm_neon.h>
+#include <string.h>
+#include "../utils/rescaler.h"
+
+#define RFIX WEBP_RESCALER_RFIX
+#define MULT_FIX(x, y) (((int64_t)(x) * (y) + (1 << (RFIX - 1))) >> RFIX)
+
+// As in the SSE2 version, all the values are known to be positive and the
+// unsigned multiplies give the same results as MULT_FIX().
+
+// Returns MULT_FIX(A[i], scale), using the rounding narrowing shift.
+static WEBP_INLINE uint32x4_t MultFix(const uint32x4_t A, uint32_t scale) {
+  const uint64x2_t lo = vmull_n_u32(vget_low_u32(A), scale);
+  const uint64x2_t hi = vmull_n_u32(vget_high_u32(A), scale);
+  return vcombine_u32(vrshrn_n_u64(lo, RFIX), vrshrn_n_u64(hi, RFIX));
+}
+
+// Returns the 4 bytes at 'src' as 32b values.
+static WEBP_INLINE uint32x4_t LoadPixel(const uint8_t* const src) {
+  uint32_t argb;
+  memcpy(&argb, src, sizeof(argb));
+  return vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(
+      vdup_n_u32(argb)))));
+}
+
+static void AccumulateRowNEON(WebPRescaler* const wrk) {
+  const int x_out_max = wrk->dst_width * wrk->num_channels;
+  int32_t* const irow = wrk->irow;
+  const int32_t* const frow = wrk->frow;
+  int x_out;
+  for (x_out = 0; x_out + 4 <= x_out_max; x_out += 4) {
+    vst1q_s32(irow + x_out, vaddq_s32(vld1q_s32(irow + x_out),
+                                      vld1q_s32(frow + x_out)));
+  }
+  for (; x_out < x_out_max; ++x_out) {
+    irow[x_out] += frow[x_out];
+  }
+}
+
+//------------------------------------------------------------------------------
+// Row import
+
+// The four channels of a pixel are processed at once. Other layouts use the
+// plain-C version.
+
+static void ImportRowExpandNEON(WebPRescaler* const wrk,
+                                const uint8_t* const src) {
+  const int x_out_max = wrk->dst_width * 4;
+  int x_in = 0;
+  int x_out;
+  int accum = 0;
+  uint32x4_t left, right;
+  if (wrk->num_channels != 4) {
+    WebPRescalerImportRowExpand_C(wrk, src);
+    return;
+  }
+  left = right = LoadPixel(src);
+  for (x_out = 0; x_out < x_out_max; x_out += 4) {
+    uint32x4_t frow;
+    if (accum < 0) {
+      left = right;
+      x_in += 4;
+      right = LoadPixel(src + x_in);
+      accum += wrk->x_add;
+    }
+    // right * x_add + (left - right) * accum
+    frow = vmulq_n_u32(left, accum);
+    frow = vmlaq_n_u32(frow, right, wrk->x_add - accum);
+    vst1q_s32(wrk->frow + x_out, vreinterpretq_s32_u32(frow));
+    accum -= wrk->x_sub;
+  }
+  AccumulateRowNEON(wrk);
+}
+
+static void ImportRowShrinkNEON(WebPRescaler* const wrk,
+                                const uint8_t* const src) {
+  const int x_out_max = wrk->dst_width * 4;
+  int x_in = 0;
+  int x_out;
+  int accum = 0;
+  uint32x4_t sum = vdupq_n_u32(0);
+  if (wrk->num_channels != 4) {
+    WebPRescalerImportRowShrink_C(wrk, src);
+    return;
+  }
+  for (x_out = 0; x_out < x_out_max; x_out += 4) {
+    accum += wrk->x_add;
+    for (; accum > 0; accum -= wrk->x_sub) {
+      sum = vaddq_u32(sum, LoadPixel(src + x_in));
+      x_in += 4;
+    }
+    {        // Emit next horizontal pixel.
+      const uint32x4_t base = LoadPixel(src + x_in);
+      const uint32x4_t frac = vmulq_n_u32(base, -accum);
+      const uint32x4_t frow =
+          vsubq_u32(vmulq_n_u32(vaddq_u32(sum, base), wrk->x_sub), frac);
+      x_in += 4;
+      vst1q_s32(wrk->frow + x_out, vreinterpretq_s32_u32(frow));
+      // fresh fractional start for next pixel
+      sum = MultFix(frac, wrk->fx_scale);
+    }
+  }
+  AccumulateRowNEON(wrk);
+}
+
+//------------------------------------------------------------------------------
+// Row export
+
+static void EmitRowNEON(WebPRescaler* const wrk) {
+  int x_out;
+  uint8_t* const dst = wrk->dst;
+  int32_t* const irow = wrk->irow;
+  const int32_t* const frow = wrk->frow;
+  const int yscale = wrk->fy_scale * (-wrk->y_accum);
+  const int x_out_max = wrk->dst_width * wrk->num_channels;
+  uint32_t fxy_scale;
+  // 'fxy_scale' is only larger than 32b for extreme vertical upscaling.
+  if (wrk->fxy_scale > (int64_t)0xffffffffu) {
+    WebPRescalerEmitRow_C(wrk);
+    return;
+  }
+  fxy_scale = (uint32_t)wrk->fxy_scale;
+  for (x_out = 0; x_out + 8 <= x_out_max; x_out += 8) {
+    const uint32x4_t F0 = vreinterpretq_u32_s32(vld1q_s32(frow + x_out + 0));
+    const uint32x4_t F1 = vreinterpretq_u32_s32(vld1q_s32(frow + x_out + 4));
+    const uint32x4_t I0 = vreinterpretq_u32_s32(vld1q_s32(irow + x_out + 0));
+    const uint32x4_t I1 = vreinterpretq_u32_s32(vld1q_s32(irow + x_out + 4));
+    const uint32x4_t frac0 = MultFix(F0, yscale);
+    const uint32x4_t frac1 = MultFix(F1, yscale);
+    const uint32x4_t V0 = MultFix(vsubq_u32(I0, frac0), fxy_scale);
+    const uint32x4_t V1 = MultFix(vsubq_u32(I1, frac1), fxy_scale);
+    // the saturating narrowing does the clipping to [0..255]
+    const int16x8_t V = vcombine_s16(vqmovn_s32(vreinterpretq_s32_u32(V0)),
+                                     vqmovn_s32(vreinterpretq_s32_u32(V1)));
+    vst1_u8(dst + x_out, vqmovun_s16(V));
+    // new fractional start
+    vst1q_s32(irow + x_out + 0, vreinterpretq_s32_u32(frac0));
+    vst1q_s32(irow + x_out + 4, vreinterpretq_s32_u32(frac1));
+  }
+  for (; x_out < x_out_max; ++x_out) {
+    const int frac = (int)MULT_FIX(frow[x_out], yscale);
+    const int v = (int)MULT_FIX(irow[x_out] - frac, wrk->fxy_scale);
+    dst[x_out] = (!(v & ~0xff)) ? v : (v < 0) ? 0 : 255;
+    irow[x_out] = frac;   // new fractional start
+  }
+}
+
+#undef MULT_FIX
+#undef RFIX
+
+#endif   // WEBP_USE_NEON
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPRescalerDspInitNEON(void);
+
+void WebPRescalerDspInitNEON(void) {
+#if defined(WEBP_USE_NEON)
+  WebPRescalerImportRowExpand = ImportRowExpandNEON;
+  WebPRescalerImportRowShrink = ImportRowShrinkNEON;
+  WebPRescalerEmitRow = EmitRowNEON;
+#endif   // WEBP_USE_NEON
+}
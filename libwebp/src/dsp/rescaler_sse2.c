@@ -0,0 +1,219 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// SSE2 version of the rescaling functions.
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include "./dsp.h"
+
+#if defined(WEBP_USE_SSE2)
+
+#include <emmintrin.h>
+#include <string.h>
+#include "../utils/rescaler.h"
+
+#define RFIX WEBP_RESCALER_RFIX
+#define MULT_FIX(x, y) (((int64_t)(x) * (y) + (1 << (RFIX - 1))) >> RFIX)
+
+// All the values handled below (samples, accumulators and scales) are known
+// to be positive, so that the unsigned 32b x 32b -> 64b multiply of
+// _mm_mul_epu32() gives the same results as the int64_t ones of MULT_FIX().
+
+// Gathers the low 32b of the four 64b products of the even lanes (in 'A')
+// and odd lanes (in 'B') of the multiplied vector.
+static WEBP_INLINE __m128i Interleave64to32(const __m128i* const A,
+                                            const __m128i* const B) {
+  const __m128i A1 = _mm_shuffle_epi32(*A, _MM_SHUFFLE(3, 1, 2, 0));
+  const __m128i B1 = _mm_shuffle_epi32(*B, _MM_SHUFFLE(3, 1, 2, 0));
+  return _mm_unpacklo_epi32(A1, B1);
+}
+
+// Returns the low 32b of the products A[i] * scale[0]. 'scale' must be stored
+// in the even lanes.
+static WEBP_INLINE __m128i Mult32(const __m128i* const A,
+                                  const __m128i* const scale) {
+  const __m128i P_even = _mm_mul_epu32(*A, *scale);
+  const __m128i P_odd = _mm_mul_epu32(_mm_srli_epi64(*A, 32), *scale);
+  return Interleave64to32(&P_even, &P_odd);
+}
+
+// Returns MULT_FIX(A[i], scale[0]). 'scale' must be stored in the even lanes.
+static WEBP_INLINE __m128i MultFix(const __m128i* const A,
+                                   const __m128i* const scale) {
+  const __m128i rounder = _mm_set_epi32(0, 1 << (RFIX - 1), 0, 1 << (RFIX - 1));
+  const __m128i P_even = _mm_add_epi64(_mm_mul_epu32(*A, *scale), rounder);
+  const __m128i P_odd =
+      _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(*A, 32), *scale), rounder);
+  const __m128i V_even = _mm_srli_epi64(P_even, RFIX);
+  const __m128i V_odd = _mm_srli_epi64(P_odd, RFIX);
+  return Interleave64to32(&V_even, &V_odd);
+}
+
+// Returns the 4 bytes at 'src' as 32b values.
+static WEBP_INLINE __m128i LoadPixel(const uint8_t* const src,
+                                     const __m128i* const zero) {
+  uint32_t argb;
+  __m128i A;
+  memcpy(&argb, src, sizeof(argb));
+  A = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)argb), *zero);
+  return _mm_unpacklo_epi16(A, *zero);
+}
+
+static void AccumulateRowSSE2(WebPRescaler* const wrk) {
+  const int x_out_max = wrk->dst_width * wrk->num_channels;
+  int32_t* const irow = wrk->irow;
+  const int32_t* const frow = wrk->frow;
+  int x_out;
+  for (x_out = 0; x_out + 4 <= x_out_max; x_out += 4) {
+    const __m128i A = _mm_loadu_si128((const __m128i*)(irow + x_out));
+    const __m128i B = _mm_loadu_si128((const __m128i*)(frow + x_out));
+    _mm_storeu_si128((__m128i*)(irow + x_out), _mm_add_epi32(A, B));
+  }
+  for (; x_out < x_out_max; ++x_out) {
+    irow[x_out] += frow[x_out];
+  }
+}
+
+//------------------------------------------------------------------------------
+// Row import
+
+// The four channels of a pixel are processed at once. Other layouts use the
+// plain-C version.
+
+static void ImportRowExpandSSE2(WebPRescaler* const wrk,
+                                const uint8_t* const src) {
+  const __m128i zero = _mm_setzero_si128();
+  const int x_out_max = wrk->dst_width * 4;
+  const int x_add = wrk->x_add;
+  int x_in = 0;
+  int x_out;
+  int accum = 0;
+  __m128i left, right;
+  // 'accum' and 'x_add - accum' are used as 16b weights by _mm_madd_epi16().
+  if (wrk->num_channels != 4 || x_add >= (1 << 15)) {
+    WebPRescalerImportRowExpand_C(wrk, src);
+    return;
+  }
+  left = right = LoadPixel(src, &zero);
+  for (x_out = 0; x_out < x_out_max; x_out += 4) {
+    __m128i LR, weights;
+    if (accum < 0) {
+      left = right;
+      x_in += 4;
+      right = LoadPixel(src + x_in, &zero);
+      accum += x_add;
+    }
+    // right * x_add + (left - right) * accum, as a 16b pair-wise product
+    LR = _mm_or_si128(left, _mm_slli_epi32(right, 16));
+    weights = _mm_set1_epi32(accum | ((x_add - accum) << 16));
+    _mm_storeu_si128((__m128i*)(wrk->frow + x_out),
+                     _mm_madd_epi16(LR, weights));
+    accum -= wrk->x_sub;
+  }
+  AccumulateRowSSE2(wrk);
+}
+
+static void ImportRowShrinkSSE2(WebPRescaler* const wrk,
+                                const uint8_t* const src) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i x_sub = _mm_set_epi32(0, wrk->x_sub, 0, wrk->x_sub);
+  const __m128i fx_scale = _mm_set_epi32(0, wrk->fx_scale, 0, wrk->fx_scale);
+  const int x_out_max = wrk->dst_width * 4;
+  int x_in = 0;
+  int x_out;
+  int accum = 0;
+  __m128i sum = zero;
+  if (wrk->num_channels != 4) {
+    WebPRescalerImportRowShrink_C(wrk, src);
+    return;
+  }
+  for (x_out = 0; x_out < x_out_max; x_out += 4) {
+    accum += wrk->x_add;
+    for (; accum > 0; accum -= wrk->x_sub) {
+      sum = _mm_add_epi32(sum, LoadPixel(src + x_in, &zero));
+      x_in += 4;
+    }
+    {        // Emit next horizontal pixel.
+      const __m128i base = LoadPixel(src + x_in, &zero);
+      const __m128i weight = _mm_set_epi32(0, -accum, 0, -accum);
+      const __m128i frac = Mult32(&base, &weight);
+      const __m128i sum_base = _mm_add_epi32(sum, base);
+      x_in += 4;
+      _mm_storeu_si128((__m128i*)(wrk->frow + x_out),
+                       _mm_sub_epi32(Mult32(&sum_base, &x_sub), frac));
+      // fresh fractional start for next pixel
+      sum = MultFix(&frac, &fx_scale);
+    }
+  }
+  AccumulateRowSSE2(wrk);
+}
+
+//------------------------------------------------------------------------------
+// Row export
+
+static void EmitRowSSE2(WebPRescaler* const wrk) {
+  int x_out;
+  uint8_t* const dst = wrk->dst;
+  int32_t* const irow = wrk->irow;
+  const int32_t* const frow = wrk->frow;
+  const int yscale = wrk->fy_scale * (-wrk->y_accum);
+  const int x_out_max = wrk->dst_width * wrk->num_channels;
+  const __m128i mult_y = _mm_set_epi32(0, yscale, 0, yscale);
+  __m128i mult_xy;
+  // 'fxy_scale' is only larger than 32b for extreme vertical upscaling.
+  if (wrk->fxy_scale > (int64_t)0xffffffffu) {
+    WebPRescalerEmitRow_C(wrk);
+    return;
+  }
+  mult_xy = _mm_set_epi32(0, (int)wrk->fxy_scale, 0, (int)wrk->fxy_scale);
+  for (x_out = 0; x_out + 8 <= x_out_max; x_out += 8) {
+    const __m128i F0 = _mm_loadu_si128((const __m128i*)(frow + x_out + 0));
+    const __m128i F1 = _mm_loadu_si128((const __m128i*)(frow + x_out + 4));
+    const __m128i I0 = _mm_loadu_si128((const __m128i*)(irow + x_out + 0));
+    const __m128i I1 = _mm_loadu_si128((const __m128i*)(irow + x_out + 4));
+    const __m128i frac0 = MultFix(&F0, &mult_y);
+    const __m128i frac1 = MultFix(&F1, &mult_y);
+    const __m128i A0 = _mm_sub_epi32(I0, frac0);
+    const __m128i A1 = _mm_sub_epi32(I1, frac1);
+    const __m128i V0 = MultFix(&A0, &mult_xy);
+    const __m128i V1 = MultFix(&A1, &mult_xy);
+    // the saturation of the packing does the clipping to [0..255]
+    const __m128i V16 = _mm_packs_epi32(V0, V1);
+    const __m128i V = _mm_packus_epi16(V16, V16);
+    _mm_storel_epi64((__m128i*)(dst + x_out), V);
+    // new fractional start
+    _mm_storeu_si128((__m128i*)(irow + x_out + 0), frac0);
+    _mm_storeu_si128((__m128i*)(irow + x_out + 4), frac1);
+  }
+  for (; x_out < x_out_max; ++x_out) {
+    const int frac = (int)MULT_FIX(frow[x_out], yscale);
+    const int v = (int)MULT_FIX(irow[x_out] - frac, wrk->fxy_scale);
+    dst[x_out] = (!(v & ~0xff)) ? v : (v < 0) ? 0 : 255;
+    irow[x_out] = frac;   // new fractional start
+  }
+}
+
+#undef MULT_FIX
+#undef RFIX
+
+#endif   // WEBP_USE_SSE2
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPRescalerDspInitSSE2(void);
+
+void WebPRescalerDspInitSSE2(void) {
+#if defined(WEBP_USE_SSE2)
+  WebPRescalerImportRowExpand = ImportRowExpandSSE2;
+  WebPRescalerImportRowShrink = ImportRowShrinkSSE2;
+  WebPRescalerEmitRow = EmitRowSSE2;
+#endif   // WEBP_USE_SSE2
+}
@@ -205,3 +205,47 @@ void VP8YUVInitSSE2(void) {}
 
 #endif  // WEBP_USE_SSE2
 
+//------------------------------------------------------------------------------
+// RGB -> YUV conversion
+
+void WebPConvertRGBToY_C(const uint8_t* r, const uint8_t* g, const uint8_t* b,
+                         int step, uint8_t* y, int width) {
+  int i;
+  for (i = 0; i < width; ++i, r += step, g += step, b += step) {
+    y[i] = VP8RGBToY(r[0], g[0], b[0], YUV_HALF);
+  }
+}
+
+void WebPConvertRGBToUV_C(const uint16_t* r, const uint16_t* g,
+                          const uint16_t* b, uint8_t* u, uint8_t* v,
+                          int width) {
+  int i;
+  for (i = 0; i < width; ++i) {
+    u[i] = VP8RGBToU(r[i], g[i], b[i], YUV_HALF << 2);
+    v[i] = VP8RGBToV(r[i], g[i], b[i], YUV_HALF << 2);
+  }
+}
+
+WebPConvertRGBToYFunc WebPConvertRGBToY;
+WebPConvertRGBToUVFunc WebPConvertRGBToUV;
+
+extern void WebPInitConvertRGBToYUVSSE2(void);
+extern void WebPInitConvertRGBToYUVNEON(void);
+
+void WebPInitConvertRGBToYUV(void) {
+  WebPConvertRGBToY = WebPConvertRGBToY_C;
+  WebPConvertRGBToUV = WebPConvertRGBToUV_C;
+
+  // If defined, use CPUInfo() to overwrite some pointers with faster versions.
+  if (VP8GetCPUInfo != NULL) {
+#if defined(WEBP_USE_SSE2)
+    if (VP8GetCPUInfo(kSSE2)) {
+      WebPInitConvertRGBToYUVSSE2();
+    }
+#elif defined(WEBP_USE_NEON)
+    if (VP8GetCPUInfo(kNEON)) {
+      WebPInitConvertRGBToYUVNEON();
+    }
+#endif
+  }
+}
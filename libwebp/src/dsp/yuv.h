@@ -310,6 +310,32 @@ static WEBP_INLINE int VP8_RGB_TO_V(int r, int g, int b, int rounding) {
 
 #endif    // USE_YUVj
 
+//------------------------------------------------------------------------------
+// RGB -> YUV conversion of whole rows, using the non-dithered rounding.
+
+// Converts 'width' pixels to luma. The r/g/b samples of consecutive pixels are
+// 'step' bytes apart (3 or 4).
+typedef void (*WebPConvertRGBToYFunc)(const uint8_t* r, const uint8_t* g,
+                                      const uint8_t* b, int step,
+                                      uint8_t* y, int width);
+extern WebPConvertRGBToYFunc WebPConvertRGBToY;
+
+// Converts 'width' r/g/b values, in the [0..1020] range of a sum of four
+// samples, to chroma.
+typedef void (*WebPConvertRGBToUVFunc)(const uint16_t* r, const uint16_t* g,
+                                       const uint16_t* b,
+                                       uint8_t* u, uint8_t* v, int width);
+extern WebPConvertRGBToUVFunc WebPConvertRGBToUV;
+
+// Plain-C versions, used for the left-over pixels of the SIMD variants.
+void WebPConvertRGBToY_C(const uint8_t* r, const uint8_t* g, const uint8_t* b,
+                         int step, uint8_t* y, int width);
+void WebPConvertRGBToUV_C(const uint16_t* r, const uint16_t* g,
+                          const uint16_t* b, uint8_t* u, uint8_t* v, int width);
+
+// Must be called before using the above.
+void WebPInitConvertRGBToYUV(void);
+
 #ifdef __cplusplus
 }    // extern "C"
 #endif
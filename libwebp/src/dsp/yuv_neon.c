@@ -0,0 +1,121 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// NEON version of the RGB -> YUV conversion functions.
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include "./yuv.h"
+
+#if defined(WEBP_USE_NEON) && !defined(USE_YUVj)
+
+#include <arm_neon.h>
+
+// Converts 8 r/g/b 16b values to luma, with VP8RGBToY()'s rounding.
+static WEBP_INLINE uint8x8_t ConvertRGBToY(const uint16x8_t R,
+                                           const uint16x8_t G,
+                                           const uint16x8_t B) {
+  const uint32x4_t kHALF_Y = vdupq_n_u32((16 << YUV_FIX) + YUV_HALF);
+  uint32x4_t lo = vmlal_n_u16(kHALF_Y, vget_low_u16(R), 16839);
+  uint32x4_t hi = vmlal_n_u16(kHALF_Y, vget_high_u16(R), 16839);
+  lo = vmlal_n_u16(lo, vget_low_u16(G), 33059);
+  hi = vmlal_n_u16(hi, vget_high_u16(G), 33059);
+  lo = vmlal_n_u16(lo, vget_low_u16(B), 6420);
+  hi = vmlal_n_u16(hi, vget_high_u16(B), 6420);
+  // values are in [16..235] range: no need to saturate
+  return vmovn_u16(vcombine_u16(vshrn_n_u32(lo, YUV_FIX),
+                                vshrn_n_u32(hi, YUV_FIX)));
+}
+
+// Returns the clipped (a * R + b * G + c * B + rounder) >> (YUV_FIX + 2), for
+// 8 signed r/g/b values.
+static WEBP_INLINE uint8x8_t ConvertRGBToUVHelper(const int16x8_t R,
+                                                  const int16x8_t G,
+                                                  const int16x8_t B,
+                                                  int16_t a, int16_t b,
+                                                  int16_t c) {
+  const int32x4_t kHALF_UV = vdupq_n_s32(((128 << YUV_FIX) + YUV_HALF) << 2);
+  int32x4_t lo = vmlal_n_s16(kHALF_UV, vget_low_s16(R), a);
+  int32x4_t hi = vmlal_n_s16(kHALF_UV, vget_high_s16(R), a);
+  lo = vmlal_n_s16(lo, vget_low_s16(G), b);
+  hi = vmlal_n_s16(hi, vget_high_s16(G), b);
+  lo = vmlal_n_s16(lo, vget_low_s16(B), c);
+  hi = vmlal_n_s16(hi, vget_high_s16(B), c);
+  lo = vshrq_n_s32(lo, YUV_FIX + 2);
+  hi = vshrq_n_s32(hi, YUV_FIX + 2);
+  return vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+}
+
+//------------------------------------------------------------------------------
+
+// Returns the 8 low bytes of the 32b words at src[0..31], as 16b values.
+static WEBP_INLINE uint16x8_t Load8x32b(const uint8_t* const src) {
+  const uint32x4_t mask = vdupq_n_u32(0xff);
+  const uint32x4_t A = vreinterpretq_u32_u8(vld1q_u8(src +  0));
+  const uint32x4_t B = vreinterpretq_u32_u8(vld1q_u8(src + 16));
+  return vcombine_u16(vmovn_u32(vandq_u32(A, mask)),
+                      vmovn_u32(vandq_u32(B, mask)));
+}
+
+static void ConvertRGBToYNEON(const uint8_t* r, const uint8_t* g,
+                              const uint8_t* b, int step,
+                              uint8_t* y, int width) {
+  int i = 0;
+  if (step == 3 && (r - g) * (b - g) == -1) {   // RGB or BGR order
+    const uint8_t* const src = g - 1;
+    for (; i + 8 <= width; i += 8) {
+      const uint8x8x3_t rgb = vld3_u8(src + 3 * i);
+      const uint8x8_t R = (r < g) ? rgb.val[0] : rgb.val[2];
+      const uint8x8_t B = (r < g) ? rgb.val[2] : rgb.val[0];
+      vst1_u8(y + i, ConvertRGBToY(vmovl_u8(R), vmovl_u8(rgb.val[1]),
+                                   vmovl_u8(B)));
+    }
+  } else if (step == 4) {
+    // Each 16b load reads up to 3 bytes past the last pixel's r/g/b samples,
+    // so the last pixel of the row is always left to the plain-C version.
+    for (; i + 8 < width; i += 8) {
+      const uint16x8_t R = Load8x32b(r + 4 * i);
+      const uint16x8_t G = Load8x32b(g + 4 * i);
+      const uint16x8_t B = Load8x32b(b + 4 * i);
+      vst1_u8(y + i, ConvertRGBToY(R, G, B));
+    }
+  }
+  // fallthrough and finish off with plain-C
+  WebPConvertRGBToY_C(r + step * i, g + step * i, b + step * i, step,
+                      y + i, width - i);
+}
+
+static void ConvertRGBToUVNEON(const uint16_t* r, const uint16_t* g,
+                               const uint16_t* b, uint8_t* u, uint8_t* v,
+                               int width) {
+  int i;
+  for (i = 0; i + 8 <= width; i += 8) {
+    const int16x8_t R = vreinterpretq_s16_u16(vld1q_u16(r + i));
+    const int16x8_t G = vreinterpretq_s16_u16(vld1q_u16(g + i));
+    const int16x8_t B = vreinterpretq_s16_u16(vld1q_u16(b + i));
+    vst1_u8(u + i, ConvertRGBToUVHelper(R, G, B, -9719, -19081, 28800));
+    vst1_u8(v + i, ConvertRGBToUVHelper(R, G, B, 28800, -24116, -4684));
+  }
+  // fallthrough and finish off with plain-C
+  WebPConvertRGBToUV_C(r + i, g + i, b + i, u + i, v + i, width - i);
+}
+
+#endif   // WEBP_USE_NEON && !USE_YUVj
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPInitConvertRGBToYUVNEON(void);
+
+void WebPInitConvertRGBToYUVNEON(void) {
+#if defined(WEBP_USE_NEON) && !defined(USE_YUVj)
+  WebPConvertRGBToY = ConvertRGBToYNEON;
+  WebPConvertRGBToUV = ConvertRGBToUVNEON;
+#endif   // WEBP_USE_NEON && !USE_YUVj
+}
@@ -0,0 +1,195 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// SSE2 version of the RGB -> YUV conversion functions.
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include "./yuv.h"
+
+#if defined(WEBP_USE_SSE2) && !defined(USE_YUVj)
+
+#include <emmintrin.h>
+
+// Coefficients are multiplied two at a time with _mm_madd_epi16(), on
+// interleaved (R,G) and (G,B) 16b pairs. The green luma coefficient 33059
+// doesn't fit in 16b and is split among both pairs.
+#define MK_CST_16(A, B) _mm_set_epi16((B), (A), (B), (A), (B), (A), (B), (A))
+
+// Returns the 8 values (cst0 * A + cst1 * B + C + rounder) >> descale, for
+// A/B/C given as interleaved (A,B) and (B,C) pairs.
+static WEBP_INLINE __m128i Transform(const __m128i* const AB_lo,
+                                     const __m128i* const AB_hi,
+                                     const __m128i* const BC_lo,
+                                     const __m128i* const BC_hi,
+                                     const __m128i* const mult_AB,
+                                     const __m128i* const mult_BC,
+                                     const __m128i* const rounder,
+                                     int descale) {
+  const __m128i V0_lo = _mm_madd_epi16(*AB_lo, *mult_AB);
+  const __m128i V0_hi = _mm_madd_epi16(*AB_hi, *mult_AB);
+  const __m128i V1_lo = _mm_madd_epi16(*BC_lo, *mult_BC);
+  const __m128i V1_hi = _mm_madd_epi16(*BC_hi, *mult_BC);
+  const __m128i V2_lo = _mm_add_epi32(_mm_add_epi32(V0_lo, V1_lo), *rounder);
+  const __m128i V2_hi = _mm_add_epi32(_mm_add_epi32(V0_hi, V1_hi), *rounder);
+  return _mm_packs_epi32(_mm_srai_epi32(V2_lo, descale),
+                         _mm_srai_epi32(V2_hi, descale));
+}
+
+// Converts 8 r/g/b 16b values to luma, with VP8RGBToY()'s rounding.
+static WEBP_INLINE __m128i ConvertRGBToY(const __m128i* const R,
+                                         const __m128i* const G,
+                                         const __m128i* const B) {
+  const __m128i kRG_y = MK_CST_16(16839, 33059 - 16384);
+  const __m128i kGB_y = MK_CST_16(16384, 6420);
+  const __m128i kHALF_Y = _mm_set1_epi32((16 << YUV_FIX) + YUV_HALF);
+  const __m128i RG_lo = _mm_unpacklo_epi16(*R, *G);
+  const __m128i RG_hi = _mm_unpackhi_epi16(*R, *G);
+  const __m128i GB_lo = _mm_unpacklo_epi16(*G, *B);
+  const __m128i GB_hi = _mm_unpackhi_epi16(*G, *B);
+  return Transform(&RG_lo, &RG_hi, &GB_lo, &GB_hi, &kRG_y, &kGB_y, &kHALF_Y,
+                   YUV_FIX);
+}
+
+// Converts 8 r/g/b 16b values to 8 u and 8 v values, stored in the low and
+// high 8 bytes of the result. Clipping is done by the final packing.
+static WEBP_INLINE __m128i ConvertRGBToUV(const __m128i* const R,
+                                          const __m128i* const G,
+                                          const __m128i* const B) {
+  const __m128i kRG_u = MK_CST_16(-9719, -19081);
+  const __m128i kGB_u = MK_CST_16(0, 28800);
+  const __m128i kRG_v = MK_CST_16(28800, 0);
+  const __m128i kGB_v = MK_CST_16(-24116, -4684);
+  const __m128i kHALF_UV = _mm_set1_epi32(((128 << YUV_FIX) + YUV_HALF) << 2);
+  const __m128i RG_lo = _mm_unpacklo_epi16(*R, *G);
+  const __m128i RG_hi = _mm_unpackhi_epi16(*R, *G);
+  const __m128i GB_lo = _mm_unpacklo_epi16(*G, *B);
+  const __m128i GB_hi = _mm_unpackhi_epi16(*G, *B);
+  const __m128i U = Transform(&RG_lo, &RG_hi, &GB_lo, &GB_hi, &kRG_u, &kGB_u,
+                              &kHALF_UV, YUV_FIX + 2);
+  const __m128i V = Transform(&RG_lo, &RG_hi, &GB_lo, &GB_hi, &kRG_v, &kGB_v,
+                              &kHALF_UV, YUV_FIX + 2);
+  return _mm_packus_epi16(U, V);
+}
+
+#undef MK_CST_16
+
+//------------------------------------------------------------------------------
+
+// Interleaves the bytes of in[0..2] with the ones of in[3..5].
+static WEBP_INLINE void UnpackHelper(const __m128i* const in,
+                                     __m128i* const out) {
+  out[0] = _mm_unpacklo_epi8(in[0], in[3]);
+  out[1] = _mm_unpackhi_epi8(in[0], in[3]);
+  out[2] = _mm_unpacklo_epi8(in[1], in[4]);
+  out[3] = _mm_unpackhi_epi8(in[1], in[4]);
+  out[4] = _mm_unpacklo_epi8(in[2], in[5]);
+  out[5] = _mm_unpackhi_epi8(in[2], in[5]);
+}
+
+// Splits 32 packed 24b pixels into three planes of 32 samples each:
+// out[0..1] for the first channel, out[2..3] and out[4..5] for the others.
+static WEBP_INLINE void Packed24ToPlanar(const uint8_t* const src,
+                                         __m128i* const out) {
+  __m128i tmp[6];
+  int i;
+  for (i = 0; i < 6; ++i) {
+    tmp[i] = _mm_loadu_si128((const __m128i*)(src + 16 * i));
+  }
+  UnpackHelper(tmp, out);
+  UnpackHelper(out, tmp);
+  UnpackHelper(tmp, out);
+  UnpackHelper(out, tmp);
+  UnpackHelper(tmp, out);
+}
+
+// Returns the 8 low bytes of the 32b words at src[0..31], as 16b values.
+static WEBP_INLINE __m128i Load8x32b(const uint8_t* const src,
+                                     const __m128i* const mask) {
+  const __m128i A = _mm_loadu_si128((const __m128i*)(src +  0));
+  const __m128i B = _mm_loadu_si128((const __m128i*)(src + 16));
+  return _mm_packs_epi32(_mm_and_si128(A, *mask), _mm_and_si128(B, *mask));
+}
+
+static void ConvertRGBToYSSE2(const uint8_t* r, const uint8_t* g,
+                              const uint8_t* b, int step,
+                              uint8_t* y, int width) {
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  if (step == 3 && (r - g) * (b - g) == -1) {   // RGB or BGR order
+    const uint8_t* const src = g - 1;
+    for (; i + 32 <= width; i += 32) {
+      __m128i rgb[6], Y0, Y1;
+      Packed24ToPlanar(src + 3 * i, rgb);
+      {
+        // first and last planes hold the red or blue samples
+        const __m128i* const R = (r < g) ? rgb + 0 : rgb + 4;
+        const __m128i* const B = (r < g) ? rgb + 4 : rgb + 0;
+        const __m128i* const G = rgb + 2;
+        int k;
+        for (k = 0; k < 2; ++k) {
+          const __m128i R_lo = _mm_unpacklo_epi8(R[k], zero);
+          const __m128i G_lo = _mm_unpacklo_epi8(G[k], zero);
+          const __m128i B_lo = _mm_unpacklo_epi8(B[k], zero);
+          const __m128i R_hi = _mm_unpackhi_epi8(R[k], zero);
+          const __m128i G_hi = _mm_unpackhi_epi8(G[k], zero);
+          const __m128i B_hi = _mm_unpackhi_epi8(B[k], zero);
+          Y0 = ConvertRGBToY(&R_lo, &G_lo, &B_lo);
+          Y1 = ConvertRGBToY(&R_hi, &G_hi, &B_hi);
+          _mm_storeu_si128((__m128i*)(y + i + 16 * k),
+                           _mm_packus_epi16(Y0, Y1));
+        }
+      }
+    }
+  } else if (step == 4) {
+    const __m128i mask = _mm_set1_epi32(0xff);
+    // Each 16b load reads up to 3 bytes past the last pixel's r/g/b samples,
+    // so the last pixel of the row is always left to the plain-C version.
+    for (; i + 8 < width; i += 8) {
+      const __m128i R = Load8x32b(r + 4 * i, &mask);
+      const __m128i G = Load8x32b(g + 4 * i, &mask);
+      const __m128i B = Load8x32b(b + 4 * i, &mask);
+      const __m128i Y = ConvertRGBToY(&R, &G, &B);
+      _mm_storel_epi64((__m128i*)(y + i), _mm_packus_epi16(Y, Y));
+    }
+  }
+  // fallthrough and finish off with plain-C
+  WebPConvertRGBToY_C(r + step * i, g + step * i, b + step * i, step,
+                      y + i, width - i);
+}
+
+static void ConvertRGBToUVSSE2(const uint16_t* r, const uint16_t* g,
+                               const uint16_t* b, uint8_t* u, uint8_t* v,
+                               int width) {
+  int i;
+  for (i = 0; i + 8 <= width; i += 8) {
+    const __m128i R = _mm_loadu_si128((const __m128i*)(r + i));
+    const __m128i G = _mm_loadu_si128((const __m128i*)(g + i));
+    const __m128i B = _mm_loadu_si128((const __m128i*)(b + i));
+    const __m128i UV = ConvertRGBToUV(&R, &G, &B);
+    _mm_storel_epi64((__m128i*)(u + i), UV);
+    _mm_storel_epi64((__m128i*)(v + i), _mm_srli_si128(UV, 8));
+  }
+  // fallthrough and finish off with plain-C
+  WebPConvertRGBToUV_C(r + i, g + i, b + i, u + i, v + i, width - i);
+}
+
+#endif   // WEBP_USE_SSE2 && !USE_YUVj
+
+//------------------------------------------------------------------------------
+// Entry point
+
+extern void WebPInitConvertRGBToYUVSSE2(void);
+
+void WebPInitConvertRGBToYUVSSE2(void) {
+#if defined(WEBP_USE_SSE2) && !defined(USE_YUVj)
+  WebPConvertRGBToY = ConvertRGBToYSSE2;
+  WebPConvertRGBToUV = ConvertRGBToUVSSE2;
+#endif   // WEBP_USE_SSE2 && !USE_YUVj
+}
@@ -17,6 +17,7 @@
 #include "./vp8enci.h"
 #include "../utils/filters.h"
 #include "../utils/quant_levels.h"
+#include "../utils/utils.h"
 #include "../webp/format_constants.h"
 
 // -----------------------------------------------------------------------------
@@ -219,9 +220,32 @@ static void InitFilterTrial(FilterTrial* const score) {
   VP8BitWriterInit(&score->bw, 0);
 }
 
+// Worker job compressing the alpha plane with one of the candidate filters.
+typedef struct {
+  const uint8_t* alpha_;
+  int width_;
+  int height_;
+  int method_;
+  int filter_;
+  int reduce_levels_;
+  int effort_level_;
+  uint8_t* filtered_alpha_;   // scratch buffer for the filtered plane
+  FilterTrial trial_;
+} FilterTrialJob;
+
+static int FilterTrialHook(void* arg1, void* arg2) {
+  FilterTrialJob* const job = (FilterTrialJob*)arg1;
+  (void)arg2;
+  return EncodeAlphaInternal(job->alpha_, job->width_, job->height_,
+                             job->method_, job->filter_, job->reduce_levels_,
+                             job->effort_level_, job->filtered_alpha_,
+                             &job->trial_);
+}
+
 static int ApplyFiltersAndEncode(const uint8_t* alpha, int width, int height,
                                  size_t data_size, int method, int filter,
                                  int reduce_levels, int effort_level,
+                                 int num_threads,
                                  uint8_t** const output,
                                  size_t* const output_size,
                                  WebPAuxStats* const stats) {
@@ -231,24 +255,54 @@ static int ApplyFiltersAndEncode(const uint8_t* alpha, int width, int height,
       GetFilterMap(alpha, width, height, filter, effort_level);
   InitFilterTrial(&best);
   if (try_map != FILTER_TRY_NONE) {
-    uint8_t* filtered_alpha =  (uint8_t*)malloc(data_size);
-    if (filtered_alpha == NULL) return 0;
-
-    for (filter = WEBP_FILTER_NONE; ok && try_map; ++filter, try_map >>= 1) {
-      if (try_map & 1) {
-        FilterTrial trial;
-        ok = EncodeAlphaInternal(alpha, width, height, method, filter,
-                                 reduce_levels, effort_level, filtered_alpha,
-                                 &trial);
-        if (ok && trial.score < best.score) {
-          VP8BitWriterWipeOut(&best.bw);
-          best = trial;
-        } else {
-          VP8BitWriterWipeOut(&trial.bw);
-        }
-      }
+    FilterTrialJob jobs[WEBP_FILTER_LAST];
+    WebPWorker workers[WEBP_FILTER_LAST];
+    int num_jobs = 0;
+    int num_parallel;
+    int i;
+    uint8_t* filtered_alpha;
+
+    for (filter = WEBP_FILTER_NONE; try_map; ++filter, try_map >>= 1) {
+      if (try_map & 1) jobs[num_jobs++].filter_ = filter;
     }
+    // The trials are independent: they're spread over the available threads.
+    // Job #0 and the jobs without a thread of their own run in turn in the
+    // calling thread, and share the first scratch buffer.
+    num_parallel = WebPWorkersInit(workers, num_jobs, num_threads);
+    filtered_alpha = (uint8_t*)WebPSafeMalloc(num_parallel, data_size);
+    if (filtered_alpha == NULL) {
+      WebPWorkersEnd(workers, num_jobs);
+      return 0;
+    }
+
+    for (i = 0; i < num_jobs; ++i) {
+      FilterTrialJob* const job = &jobs[i];
+      job->alpha_ = alpha;
+      job->width_ = width;
+      job->height_ = height;
+      job->method_ = method;
+      job->reduce_levels_ = reduce_levels;
+      job->effort_level_ = effort_level;
+      job->filtered_alpha_ =
+          filtered_alpha + (i < num_parallel ? i * data_size : 0);
+      workers[i].hook = FilterTrialHook;
+      workers[i].data1 = job;
+      workers[i].data2 = NULL;
+    }
+    ok = WebPWorkersRun(workers, num_jobs, num_parallel);
+    WebPWorkersEnd(workers, num_jobs);
     free(filtered_alpha);
+
+    // Keep the smallest output, the first one in filter order upon ties.
+    for (i = 0; i < num_jobs; ++i) {
+      FilterTrial* const trial = &jobs[i].trial_;
+      if (ok && trial->score < best.score) {
+        VP8BitWriterWipeOut(&best.bw);
+        best = *trial;
+      } else {
+        VP8BitWriterWipeOut(&trial->bw);
+      }
+    }
   } else {
     ok = EncodeAlphaInternal(alpha, width, height, method, WEBP_FILTER_NONE,
                              reduce_levels, effort_level, NULL, &best);
@@ -270,6 +324,7 @@ static int EncodeAlpha(VP8Encoder* const enc,
   const WebPPicture* const pic = enc->pic_;
   const int width = pic->width;
   const int height = pic->height;
+  const int num_threads = (enc->thread_level_ > 0) ? WebPGetNumCores() : 1;
 
   uint8_t* quant_alpha = NULL;
   const size_t data_size = width * height;
@@ -297,6 +352,7 @@ static int EncodeAlpha(VP8Encoder* const enc,
     // Don't filter, as filtering will make no impact on compressed size.
     filter = WEBP_FILTER_NONE;
   }
+  VP8FiltersInit();
 
   quant_alpha = (uint8_t*)malloc(data_size);
   if (quant_alpha == NULL) {
@@ -317,8 +373,8 @@ static int EncodeAlpha(VP8Encoder* const enc,
 
   if (ok) {
     ok = ApplyFiltersAndEncode(quant_alpha, width, height, data_size, method,
-                               filter, reduce_levels, effort_level, output,
-                               output_size, pic->stats);
+                               filter, reduce_levels, effort_level, num_threads,
+                               output, output_size, pic->stats);
     if (pic->stats != NULL) {  // need stats?
       pic->stats->coded_size += (int)(*output_size);
       enc->sse_[3] = sse;
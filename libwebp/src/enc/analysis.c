@@ -20,15 +20,15 @@
 #include "../utils/utils.h"
 
 #define MAX_ITERS_K_MEANS  6
+#define MAX_SEGMENT_JOBS   16   // maximum number of parallel analysis bands
 
 //------------------------------------------------------------------------------
-// Smooth the segment map by replacing isolated block by the majority of its
-// neighbours.
+// Smooth the segment map of the first 'h' rows by replacing isolated block by
+// the majority of its neighbours.
 
-static void SmoothSegmentMap(VP8Encoder* const enc) {
+static void SmoothSegmentMap(VP8Encoder* const enc, int h) {
   int n, x, y;
   const int w = enc->mb_w_;
-  const int h = enc->mb_h_;
   const int majority_cnt_3_x_3_grid = 5;
   uint8_t* const tmp = (uint8_t*)WebPSafeMalloc((uint64_t)w * h, sizeof(*tmp));
   assert((uint64_t)(w * h) == (uint64_t)w * h);   // no overflow, as per spec
@@ -137,10 +137,11 @@ static void MergeHistograms(const VP8Histogram* const in,
 }
 
 //------------------------------------------------------------------------------
-// Simplified k-Means, to assign Nb segments based on alpha-histogram
+// Simplified k-Means, to assign Nb segments based on alpha-histogram of the
+// first 'num_rows' macroblock rows.
 
 static void AssignSegments(VP8Encoder* const enc,
-                           const int alphas[MAX_ALPHA + 1]) {
+                           const int alphas[MAX_ALPHA + 1], int num_rows) {
   const int nb = enc->segment_hdr_.num_segments_;
   int centers[NUM_MB_SEGMENTS];
   int weighted_average = 0;
@@ -205,7 +206,7 @@ static void AssignSegments(VP8Encoder* const enc,
   }
 
   // Map each original value to the closest centroid
-  for (n = 0; n < enc->mb_w_ * enc->mb_h_; ++n) {
+  for (n = 0; n < enc->mb_w_ * num_rows; ++n) {
     VP8MBInfo* const mb = &enc->mb_info_[n];
     const int alpha = mb->alpha_;
     mb->segment_ = map[alpha];
@@ -214,10 +215,11 @@ static void AssignSegments(VP8Encoder* const enc,
 
   if (nb > 1) {
     const int smooth = (enc->config_->preprocessing & 1);
-    if (smooth) SmoothSegmentMap(enc);
+    if (smooth) SmoothSegmentMap(enc, num_rows);
   }
 
   SetSegmentAlphas(enc, centers, weighted_average);  // pick some alphas.
+  memcpy(enc->centers_, centers, nb * sizeof(*centers));
 }
 
 //------------------------------------------------------------------------------
@@ -435,63 +437,120 @@ static void InitSegmentJob(VP8Encoder* const enc, SegmentJob* const job,
   memset(job->alphas, 0, sizeof(job->alphas));
   job->alpha = 0;
   job->uv_alpha = 0;
-  // only one of both jobs can record the progress, since we don't
+  // only one of the jobs can record the progress, since we don't
   // expect the user's hook to be multi-thread safe
   job->delta_progress = (start_row == 0) ? 20 : 0;
 }
 
-// main entry point
-int VP8EncAnalyze(VP8Encoder* const enc) {
-  int ok = 1;
-  const int do_segments =
-      enc->config_->emulate_jpeg_size ||   // We need the complexity evaluation.
-      (enc->segment_hdr_.num_segments_ > 1) ||
-      (enc->method_ == 0);  // for method 0, we need preds_[] to be filled.
-  if (do_segments) {
-    const int last_row = enc->mb_h_;
-    // We give a little more than a half work to the main thread.
-    const int split_row = (9 * last_row + 15) >> 4;
-    const int total_mb = last_row * enc->mb_w_;
+// Returns the number of row bands the analysis of 'num_rows' rows is split
+// into.
+static int GetNumSegmentJobs(const VP8Encoder* const enc, int num_rows) {
+  int num_jobs = 1;
 #ifdef WEBP_USE_THREAD
-    const int kMinSplitRow = 2;  // minimal rows needed for mt to be worth it
-    const int do_mt = (enc->thread_level_ > 0) && (split_row >= kMinSplitRow);
+  if (enc->thread_level_ > 0) {
+    const int kMinRowsPerJob = 2;  // minimal rows needed for mt to be worth it
+    const int max_jobs = num_rows / kMinRowsPerJob;
+    num_jobs = WebPGetNumCores();
+    if (num_jobs < 2) num_jobs = 2;
+    if (num_jobs > MAX_SEGMENT_JOBS) num_jobs = MAX_SEGMENT_JOBS;
+    if (num_jobs > max_jobs) num_jobs = max_jobs;
+    if (num_jobs < 1) num_jobs = 1;
+  }
 #else
-    const int do_mt = 0;
+  (void)enc;
+  (void)num_rows;
 #endif
-    SegmentJob main_job;
-    if (do_mt) {
-      SegmentJob side_job;
+  return num_jobs;
+}
+
+static int DoSegmentsAnalysis(const VP8Encoder* const enc) {
+  return enc->config_->emulate_jpeg_size ||   // need the complexity evaluation
+         (enc->segment_hdr_.num_segments_ > 1) ||
+         (enc->method_ == 0);  // for method 0, we need preds_[] to be filled.
+}
+
+int VP8EncAnalyzeFirstRows(VP8Encoder* const enc, int num_rows) {
+  int ok = 1;
+  if (DoSegmentsAnalysis(enc)) {
+    const int last_row = num_rows;
+    const int total_mb = last_row * enc->mb_w_;
+    const int num_jobs = GetNumSegmentJobs(enc, num_rows);
+    SegmentJob* const jobs =
+        (SegmentJob*)WebPSafeMalloc((uint64_t)num_jobs, sizeof(*jobs));
+    int i;
+    if (jobs == NULL) {
+      return WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    }
+    // Split the rows into equal bands. The first one is processed by the
+    // main thread, the others by side workers.
+    for (i = 0; i < num_jobs; ++i) {
+      InitSegmentJob(enc, &jobs[i], i * last_row / num_jobs,
+                     (i + 1) * last_row / num_jobs);
+    }
+    // we don't need to call Reset() on jobs[0].worker, since we're calling
+    // WebPWorkerExecute() on it
+    for (i = 1; i < num_jobs; ++i) {
+      ok &= WebPWorkerReset(&jobs[i].worker);
+    }
+    // launch the jobs in parallel
+    if (ok) {
+      for (i = 1; i < num_jobs; ++i) WebPWorkerLaunch(&jobs[i].worker);
+      WebPWorkerExecute(&jobs[0].worker);
       // Note the use of '&' instead of '&&' because we must call the functions
       // no matter what.
-      InitSegmentJob(enc, &main_job, 0, split_row);
-      InitSegmentJob(enc, &side_job, split_row, last_row);
-      // we don't need to call Reset() on main_job.worker, since we're calling
-      // WebPWorkerExecute() on it
-      ok &= WebPWorkerReset(&side_job.worker);
-      // launch the two jobs in parallel
-      if (ok) {
-        WebPWorkerLaunch(&side_job.worker);
-        WebPWorkerExecute(&main_job.worker);
-        ok &= WebPWorkerSync(&side_job.worker);
-        ok &= WebPWorkerSync(&main_job.worker);
-      }
-      WebPWorkerEnd(&side_job.worker);
-      if (ok) MergeJobs(&side_job, &main_job);  // merge results together
-    } else {
-      // Even for single-thread case, we use the generic Worker tools.
-      InitSegmentJob(enc, &main_job, 0, last_row);
-      WebPWorkerExecute(&main_job.worker);
-      ok &= WebPWorkerSync(&main_job.worker);
+      for (i = 0; i < num_jobs; ++i) ok &= WebPWorkerSync(&jobs[i].worker);
+    }
+    for (i = 0; i < num_jobs; ++i) {
+      WebPWorkerEnd(&jobs[i].worker);
+      if (ok && i > 0) MergeJobs(&jobs[i], &jobs[0]);  // merge results together
     }
-    WebPWorkerEnd(&main_job.worker);
     if (ok) {
-      enc->alpha_ = main_job.alpha / total_mb;
-      enc->uv_alpha_ = main_job.uv_alpha / total_mb;
-      AssignSegments(enc, main_job.alphas);
+      enc->alpha_ = jobs[0].alpha / total_mb;
+      enc->uv_alpha_ = jobs[0].uv_alpha / total_mb;
+      AssignSegments(enc, jobs[0].alphas, num_rows);
+      // The next rows will be analyzed later on. Meanwhile, they get some
+      // default info, for the statistics collected over all macroblocks.
+      for (i = total_mb; i < enc->mb_w_ * enc->mb_h_; ++i) {
+        DefaultMBInfo(&enc->mb_info_[i]);
+      }
     }
+    free(jobs);
   } else {   // Use only one default segment.
     ResetAllMBInfo(enc);
   }
   return ok;
 }
 
+void VP8EncAnalyzeRow(VP8EncIterator* const it, int y) {
+  VP8Encoder* const enc = it->enc_;
+  if (DoSegmentsAnalysis(enc)) {
+    const int nb = enc->segment_hdr_.num_segments_;
+    int alphas[MAX_ALPHA + 1] = { 0 };   // unused
+    int alpha = 0, uv_alpha = 0;         // unused
+    uint8_t tmp[32 + ALIGN_CST];
+    uint8_t* const scratch = (uint8_t*)DO_ALIGN(tmp);
+    VP8IteratorSetRow(it, y);
+    VP8IteratorSetCountDown(it, enc->mb_w_);
+    do {
+      VP8MBInfo* const mb = it->mb_;
+      int best = 0, n;
+      VP8IteratorImport(it, scratch);
+      MBAnalyze(it, alphas, &alpha, &uv_alpha);
+      // Map to the closest segment, as the first rows were.
+      for (n = 1; n < nb; ++n) {
+        if (abs(mb->alpha_ - enc->centers_[n]) <
+            abs(mb->alpha_ - enc->centers_[best])) {
+          best = n;
+        }
+      }
+      mb->segment_ = best;
+      mb->alpha_ = enc->centers_[best];
+    } while (VP8IteratorNext(it));
+  }
+}
+
+// main entry point
+int VP8EncAnalyze(VP8Encoder* const enc) {
+  return VP8EncAnalyzeFirstRows(enc, enc->mb_h_);
+}
+
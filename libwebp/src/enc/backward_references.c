@@ -18,6 +18,7 @@
 #include "./histogram.h"
 #include "../dsp/lossless.h"
 #include "../utils/color_cache.h"
+#include "../utils/thread.h"
 #include "../utils/utils.h"
 
 #define VALUES_IN_BYTE 256
@@ -33,13 +34,10 @@
 #define MIN_LENGTH 2
 #define MAX_LENGTH 4096
 
-typedef struct {
-  // Stores the most recently added position with the given hash value.
-  int32_t hash_to_first_index_[HASH_SIZE];
-  // chain_[pos] stores the previous position with the same hash value
-  // for every pixel in the image.
-  int32_t* chain_;
-} HashChain;
+// The best match of each pixel is stored on 32 bits: the distance uses the
+// upper bits (it is less than WINDOW_SIZE) and the length the lower ones.
+#define MAX_LENGTH_BITS 12
+#define MAX_CHAIN_LENGTH ((1 << MAX_LENGTH_BITS) - 1)
 
 // -----------------------------------------------------------------------------
 
@@ -113,38 +111,26 @@ static WEBP_INLINE uint64_t GetPixPairHash64(const uint32_t* const argb) {
   return key;
 }
 
-static int HashChainInit(HashChain* const p, int size) {
-  int i;
-  p->chain_ = (int*)WebPSafeMalloc((uint64_t)size, sizeof(*p->chain_));
-  if (p->chain_ == NULL) {
-    return 0;
-  }
-  for (i = 0; i < size; ++i) {
-    p->chain_[i] = -1;
-  }
-  for (i = 0; i < HASH_SIZE; ++i) {
-    p->hash_to_first_index_[i] = -1;
-  }
+int VP8LHashChainInit(VP8LHashChain* const p, int size) {
+  assert(p->size_ == 0);
+  assert(p->offset_length_ == NULL);
+  assert(size > 0);
+  p->offset_length_ =
+      (uint32_t*)WebPSafeMalloc((uint64_t)size, sizeof(*p->offset_length_));
+  if (p->offset_length_ == NULL) return 0;
+  p->size_ = size;
   return 1;
 }
 
-static void HashChainDelete(HashChain* const p) {
-  if (p != NULL) {
-    free(p->chain_);
-    free(p);
-  }
-}
-
-// Insertion of two pixels at a time.
-static void HashChainInsert(HashChain* const p,
-                            const uint32_t* const argb, int pos) {
-  const uint64_t hash_code = GetPixPairHash64(argb);
-  p->chain_[pos] = p->hash_to_first_index_[hash_code];
-  p->hash_to_first_index_[hash_code] = pos;
+void VP8LHashChainClear(VP8LHashChain* const p) {
+  assert(p != NULL);
+  free(p->offset_length_);
+  p->offset_length_ = NULL;
+  p->size_ = 0;
 }
 
 static void GetParamsForHashChainFindCopy(int quality, int xsize,
-                                          int cache_bits, int* window_size,
+                                          int* window_size,
                                           int* iter_pos, int* iter_limit) {
   const int iter_mult = (quality < 27) ? 1 : 1 + ((quality - 27) >> 4);
   const int iter_neg = -iter_mult * (quality >> 1);
@@ -156,17 +142,15 @@ static void GetParamsForHashChainFindCopy(int quality, int xsize,
   *window_size = (max_window_size > WINDOW_SIZE) ? WINDOW_SIZE
                : max_window_size;
   *iter_pos = 8 + (quality >> 3);
-  // For lower entropy images, the rigorous search loop in HashChainFindCopy
-  // can be relaxed.
-  *iter_limit = (cache_bits > 0) ? iter_neg : iter_neg / 2;
+  *iter_limit = iter_neg;
 }
 
-static int HashChainFindCopy(const HashChain* const p,
-                             int base_position, int xsize_signed,
-                             const uint32_t* const argb, int max_len,
-                             int window_size, int iter_pos, int iter_limit,
-                             int* const distance_ptr,
-                             int* const length_ptr) {
+// Returns the best match of the pixel at 'base_position', following the
+// positions with the same hash value stored in 'chain'.
+static uint32_t FindBestMatch(const int32_t* const chain,
+                              int base_position, int xsize_signed,
+                              const uint32_t* const argb, int max_len,
+                              int window_size, int iter_pos, int iter_limit) {
   const uint32_t* const argb_start = argb + base_position;
   uint64_t best_val = 0;
   uint32_t best_length = 1;
@@ -176,12 +160,10 @@ static int HashChainFindCopy(const HashChain* const p,
       (base_position > window_size) ? base_position - window_size : 0;
   int pos;
   assert(xsize > 0);
-  if (max_len > MAX_LENGTH) {
-    max_len = MAX_LENGTH;
+  if (max_len > MAX_CHAIN_LENGTH) {
+    max_len = MAX_CHAIN_LENGTH;
   }
-  for (pos = p->hash_to_first_index_[GetPixPairHash64(argb_start)];
-       pos >= min_pos;
-       pos = p->chain_[pos]) {
+  for (pos = chain[base_position]; pos >= min_pos; pos = chain[pos]) {
     uint64_t val;
     uint32_t curr_length;
     uint32_t distance;
@@ -231,9 +213,72 @@ static int HashChainFindCopy(const HashChain* const p,
       }
     }
   }
-  *distance_ptr = (int)best_distance;
-  *length_ptr = best_length;
-  return (best_length >= MIN_LENGTH);
+  if (best_length < MIN_LENGTH) return 0;
+  return (best_distance << MAX_LENGTH_BITS) | best_length;
+}
+
+int VP8LHashChainFill(VP8LHashChain* const p, int quality,
+                      const uint32_t* const argb, int xsize, int ysize) {
+  const int size = xsize * ysize;
+  // The chain of previous positions with the same hash value is built in the
+  // 'offset_length_' storage, which is then overwritten by the best matches,
+  // from the last pixel to the first one.
+  int32_t* const chain = (int32_t*)p->offset_length_;
+  int32_t* hash_to_first_index;
+  int window_size, iter_pos, iter_limit;
+  int pos;
+  assert(p->size_ == size);
+
+  hash_to_first_index =
+      (int32_t*)WebPSafeMalloc(HASH_SIZE, sizeof(*hash_to_first_index));
+  if (hash_to_first_index == NULL) return 0;
+  for (pos = 0; pos < HASH_SIZE; ++pos) {
+    hash_to_first_index[pos] = -1;
+  }
+  // Insertion of two pixels at a time: the last pixel can't be inserted.
+  for (pos = 0; pos < size - 1; ++pos) {
+    const uint64_t hash_code = GetPixPairHash64(argb + pos);
+    chain[pos] = hash_to_first_index[hash_code];
+    hash_to_first_index[hash_code] = pos;
+  }
+  free(hash_to_first_index);
+
+  GetParamsForHashChainFindCopy(quality, xsize,
+                                &window_size, &iter_pos, &iter_limit);
+  p->offset_length_[size - 1] = 0;
+  // The search at 'pos' only visits smaller positions, whose chain entries
+  // are still intact.
+  for (pos = size - 2; pos >= 0;) {
+    uint32_t offset_length = FindBestMatch(chain, pos, xsize, argb, size - pos,
+                                           window_size, iter_pos, iter_limit);
+    const int distance = offset_length >> MAX_LENGTH_BITS;
+    int max_pos = pos;
+    p->offset_length_[pos--] = offset_length;
+    // If the matching intervals extend to the left, the same distance gives
+    // the matches of the preceding pixels without searching again.
+    while (distance > 0 && pos >= distance &&
+           argb[pos - distance] == argb[pos]) {
+      if ((offset_length & MAX_CHAIN_LENGTH) < MAX_CHAIN_LENGTH) {
+        ++offset_length;
+        max_pos = pos;
+      } else if (distance != 1 && pos + MAX_CHAIN_LENGTH < max_pos) {
+        // At the length limit, a closer interval could be as long: search.
+        break;
+      }
+      p->offset_length_[pos--] = offset_length;
+    }
+  }
+  return 1;
+}
+
+static WEBP_INLINE int HashChainFindOffset(const VP8LHashChain* const p,
+                                           int base_position) {
+  return p->offset_length_[base_position] >> MAX_LENGTH_BITS;
+}
+
+static WEBP_INLINE int HashChainFindLength(const VP8LHashChain* const p,
+                                           int base_position) {
+  return p->offset_length_[base_position] & MAX_CHAIN_LENGTH;
 }
 
 static WEBP_INLINE void PushBackCopy(VP8LBackwardRefs* const refs, int length) {
@@ -271,70 +316,44 @@ static void BackwardReferencesRle(int xsize, int ysize,
 
 static int BackwardReferencesHashChain(int xsize, int ysize,
                                        const uint32_t* const argb,
-                                       int cache_bits, int quality,
+                                       int cache_bits,
+                                       const VP8LHashChain* const hash_chain,
                                        VP8LBackwardRefs* const refs) {
   int i;
-  int ok = 0;
   int cc_init = 0;
   const int use_color_cache = (cache_bits > 0);
   const int pix_count = xsize * ysize;
-  HashChain* const hash_chain = (HashChain*)malloc(sizeof(*hash_chain));
   VP8LColorCache hashers;
-  int window_size = WINDOW_SIZE;
-  int iter_pos = 1;
-  int iter_limit = -1;
 
-  if (hash_chain == NULL) return 0;
   if (use_color_cache) {
     cc_init = VP8LColorCacheInit(&hashers, cache_bits);
-    if (!cc_init) goto Error;
+    if (!cc_init) return 0;
   }
 
-  if (!HashChainInit(hash_chain, pix_count)) goto Error;
-
   refs->size = 0;
-  GetParamsForHashChainFindCopy(quality, xsize, cache_bits,
-                                &window_size, &iter_pos, &iter_limit);
   for (i = 0; i < pix_count; ) {
     // Alternative#1: Code the pixels starting at 'i' using backward reference.
-    int offset = 0;
-    int len = 0;
-    if (i < pix_count - 1) {  // FindCopy(i,..) reads pixels at [i] and [i + 1].
-      int max_len = pix_count - i;
-      HashChainFindCopy(hash_chain, i, xsize, argb, max_len,
-                        window_size, iter_pos, iter_limit,
-                        &offset, &len);
-    }
+    int offset = HashChainFindOffset(hash_chain, i);
+    int len = HashChainFindLength(hash_chain, i);
     if (len >= MIN_LENGTH) {
       // Alternative#2: Insert the pixel at 'i' as literal, and code the
       // pixels starting at 'i + 1' using backward reference.
-      int offset2 = 0;
-      int len2 = 0;
+      const int len2 = HashChainFindLength(hash_chain, i + 1);
       int k;
-      HashChainInsert(hash_chain, &argb[i], i);
-      if (i < pix_count - 2) {  // FindCopy(i+1,..) reads [i + 1] and [i + 2].
-        int max_len = pix_count - (i + 1);
-        HashChainFindCopy(hash_chain, i + 1, xsize, argb, max_len,
-                          window_size, iter_pos, iter_limit,
-                          &offset2, &len2);
-        if (len2 > len + 1) {
-          const uint32_t pixel = argb[i];
-          // Alternative#2 is a better match. So push pixel at 'i' as literal.
-          if (use_color_cache && VP8LColorCacheContains(&hashers, pixel)) {
-            const int ix = VP8LColorCacheGetIndex(&hashers, pixel);
-            refs->refs[refs->size] = PixOrCopyCreateCacheIdx(ix);
-          } else {
-            if (use_color_cache) VP8LColorCacheInsert(&hashers, pixel);
-            refs->refs[refs->size] = PixOrCopyCreateLiteral(pixel);
-          }
-          ++refs->size;
-          i++;  // Backward reference to be done for next pixel.
-          len = len2;
-          offset = offset2;
+      if (len2 > len + 1) {
+        const uint32_t pixel = argb[i];
+        // Alternative#2 is a better match. So push pixel at 'i' as literal.
+        if (use_color_cache && VP8LColorCacheContains(&hashers, pixel)) {
+          const int ix = VP8LColorCacheGetIndex(&hashers, pixel);
+          refs->refs[refs->size] = PixOrCopyCreateCacheIdx(ix);
+        } else {
+          if (use_color_cache) VP8LColorCacheInsert(&hashers, pixel);
+          refs->refs[refs->size] = PixOrCopyCreateLiteral(pixel);
         }
-      }
-      if (len >= MAX_LENGTH) {
-        len = MAX_LENGTH - 1;
+        ++refs->size;
+        i++;  // Backward reference to be done for next pixel.
+        len = len2;
+        offset = HashChainFindOffset(hash_chain, i);
       }
       refs->refs[refs->size++] = PixOrCopyCreateCopy(offset, len);
       if (use_color_cache) {
@@ -342,13 +361,6 @@ static int BackwardReferencesHashChain(int xsize, int ysize,
           VP8LColorCacheInsert(&hashers, argb[i + k]);
         }
       }
-      // Add to the hash_chain (but cannot add the last pixel).
-      {
-        const int last = (len < pix_count - 1 - i) ? len : pix_count - 1 - i;
-        for (k = 1; k < last; ++k) {
-          HashChainInsert(hash_chain, &argb[i + k], i + k);
-        }
-      }
       i += len;
     } else {
       const uint32_t pixel = argb[i];
@@ -361,17 +373,11 @@ static int BackwardReferencesHashChain(int xsize, int ysize,
         refs->refs[refs->size] = PixOrCopyCreateLiteral(pixel);
       }
       ++refs->size;
-      if (i + 1 < pix_count) {
-        HashChainInsert(hash_chain, &argb[i], i);
-      }
       ++i;
     }
   }
-  ok = 1;
-Error:
   if (cc_init) VP8LColorCacheClear(&hashers);
-  HashChainDelete(hash_chain);
-  return ok;
+  return 1;
 }
 
 // -----------------------------------------------------------------------------
@@ -386,8 +392,8 @@ typedef struct {
 
 static int BackwardReferencesTraceBackwards(
     int xsize, int ysize, int recursive_cost_model,
-    const uint32_t* const argb, int quality, int cache_bits,
-    VP8LBackwardRefs* const refs);
+    const uint32_t* const argb, int cache_bits,
+    const VP8LHashChain* const hash_chain, VP8LBackwardRefs* const refs);
 
 static void ConvertPopulationCountTableToBitEstimates(
     int num_symbols, const int population_counts[], double output[]) {
@@ -412,7 +418,8 @@ static void ConvertPopulationCountTableToBitEstimates(
 
 static int CostModelBuild(CostModel* const m, int xsize, int ysize,
                           int recursion_level, const uint32_t* const argb,
-                          int quality, int cache_bits) {
+                          int cache_bits,
+                          const VP8LHashChain* const hash_chain) {
   int ok = 0;
   VP8LHistogram histo;
   VP8LBackwardRefs refs;
@@ -421,12 +428,13 @@ static int CostModelBuild(CostModel* const m, int xsize, int ysize,
 
   if (recursion_level > 0) {
     if (!BackwardReferencesTraceBackwards(xsize, ysize, recursion_level - 1,
-                                          argb, quality, cache_bits, &refs)) {
+                                          argb, cache_bits, hash_chain,
+                                          &refs)) {
       goto Error;
     }
   } else {
-    if (!BackwardReferencesHashChain(xsize, ysize, argb, cache_bits, quality,
-                                     &refs)) {
+    if (!BackwardReferencesHashChain(xsize, ysize, argb, cache_bits,
+                                     hash_chain, &refs)) {
       goto Error;
     }
   }
@@ -476,7 +484,8 @@ static WEBP_INLINE double GetDistanceCost(const CostModel* const m,
 
 static int BackwardReferencesHashChainDistanceOnly(
     int xsize, int ysize, int recursive_cost_model, const uint32_t* const argb,
-    int quality, int cache_bits, uint32_t* const dist_array) {
+    int cache_bits, const VP8LHashChain* const hash_chain,
+    uint32_t* const dist_array) {
   int i;
   int ok = 0;
   int cc_init = 0;
@@ -485,18 +494,14 @@ static int BackwardReferencesHashChainDistanceOnly(
   float* const cost =
       (float*)WebPSafeMalloc((uint64_t)pix_count, sizeof(*cost));
   CostModel* cost_model = (CostModel*)malloc(sizeof(*cost_model));
-  HashChain* hash_chain = (HashChain*)malloc(sizeof(*hash_chain));
   VP8LColorCache hashers;
   const double mul0 = (recursive_cost_model != 0) ? 1.0 : 0.68;
   const double mul1 = (recursive_cost_model != 0) ? 1.0 : 0.82;
   const int min_distance_code = 2;  // TODO(vikasa): tune as function of quality
-  int window_size = WINDOW_SIZE;
-  int iter_pos = 1;
-  int iter_limit = -1;
-
-  if (cost == NULL || cost_model == NULL || hash_chain == NULL) goto Error;
+  int prev_offset = 0;
+  int prev_len = 0;
 
-  if (!HashChainInit(hash_chain, pix_count)) goto Error;
+  if (cost == NULL || cost_model == NULL) goto Error;
 
   if (use_color_cache) {
     cc_init = VP8LColorCacheInit(&hashers, cache_bits);
@@ -504,7 +509,7 @@ static int BackwardReferencesHashChainDistanceOnly(
   }
 
   if (!CostModelBuild(cost_model, xsize, ysize, recursive_cost_model, argb,
-                      quality, cache_bits)) {
+                      cache_bits, hash_chain)) {
     goto Error;
   }
 
@@ -513,63 +518,49 @@ static int BackwardReferencesHashChainDistanceOnly(
   // We loop one pixel at a time, but store all currently best points to
   // non-processed locations from this point.
   dist_array[0] = 0;
-  GetParamsForHashChainFindCopy(quality, xsize, cache_bits,
-                                &window_size, &iter_pos, &iter_limit);
   for (i = 0; i < pix_count; ++i) {
     double prev_cost = 0.0;
-    int shortmax;
+    const int len = HashChainFindLength(hash_chain, i);
+    const int offset = HashChainFindOffset(hash_chain, i);
+    // The tail of the previous pixel's match was already evaluated, and
+    // starting a new copy in its middle is hardly ever cheaper.
+    const int is_tail = (offset == prev_offset && len == prev_len - 1);
+    prev_offset = offset;
+    prev_len = len;
     if (i > 0) {
       prev_cost = cost[i - 1];
     }
-    for (shortmax = 0; shortmax < 2; ++shortmax) {
-      int offset = 0;
-      int len = 0;
-      if (i < pix_count - 1) {  // FindCopy reads pixels at [i] and [i + 1].
-        int max_len = shortmax ? 2 : pix_count - i;
-        HashChainFindCopy(hash_chain, i, xsize, argb, max_len,
-                          window_size, iter_pos, iter_limit,
-                          &offset, &len);
-      }
-      if (len >= MIN_LENGTH) {
-        const int code = DistanceToPlaneCode(xsize, offset);
-        const double distance_cost =
-            prev_cost + GetDistanceCost(cost_model, code);
-        int k;
-        for (k = 1; k < len; ++k) {
-          const double cost_val = distance_cost + GetLengthCost(cost_model, k);
-          if (cost[i + k] > cost_val) {
-            cost[i + k] = (float)cost_val;
-            dist_array[i + k] = k + 1;
-          }
+    if (len >= MIN_LENGTH) {
+      const int code = DistanceToPlaneCode(xsize, offset);
+      const double distance_cost =
+          prev_cost + GetDistanceCost(cost_model, code);
+      int k;
+      for (k = 1; !is_tail && k < len; ++k) {
+        const double cost_val = distance_cost + GetLengthCost(cost_model, k);
+        if (cost[i + k] > cost_val) {
+          cost[i + k] = (float)cost_val;
+          dist_array[i + k] = k + 1;
         }
-        // This if is for speedup only. It roughly doubles the speed, and
-        // makes compression worse by .1 %.
-        if (len >= 128 && code <= min_distance_code) {
-          // Long copy for short distances, let's skip the middle
-          // lookups for better copies.
-          // 1) insert the hashes.
-          if (use_color_cache) {
-            for (k = 0; k < len; ++k) {
-              VP8LColorCacheInsert(&hashers, argb[i + k]);
-            }
-          }
-          // 2) Add to the hash_chain (but cannot add the last pixel)
-          {
-            const int last = (len + i < pix_count - 1) ? len + i
-                                                       : pix_count - 1;
-            for (k = i; k < last; ++k) {
-              HashChainInsert(hash_chain, &argb[k], k);
-            }
+      }
+      // This if is for speedup only. It roughly doubles the speed, and
+      // makes compression worse by .1 %.
+      if (len >= 128 && code <= min_distance_code) {
+        // Long copy for short distances, let's skip the middle
+        // lookups for better copies.
+        // 1) insert the hashes.
+        if (use_color_cache) {
+          for (k = 0; k < len; ++k) {
+            VP8LColorCacheInsert(&hashers, argb[i + k]);
           }
-          // 3) jump.
-          i += len - 1;  // for loop does ++i, thus -1 here.
-          goto next_symbol;
         }
+        // 2) jump.
+        i += len - 1;  // for loop does ++i, thus -1 here.
+        // The next pixel is not the tail of an evaluated match: the costs
+        // from its position on still have to be filled.
+        prev_len = 0;
+        continue;
       }
     }
-    if (i < pix_count - 1) {
-      HashChainInsert(hash_chain, &argb[i], i);
-    }
     {
       // inserting a literal pixel
       double cost_val = prev_cost;
@@ -585,14 +576,12 @@ static int BackwardReferencesHashChainDistanceOnly(
         dist_array[i] = 1;  // only one is inserted.
       }
     }
- next_symbol: ;
   }
   // Last pixel still to do, it can only be a single step if not reached
   // through cheaper means already.
   ok = 1;
 Error:
   if (cc_init) VP8LColorCacheClear(&hashers);
-  HashChainDelete(hash_chain);
   free(cost_model);
   free(cost);
   return ok;
@@ -618,56 +607,32 @@ static void TraceBackwards(uint32_t* const dist_array,
 }
 
 static int BackwardReferencesHashChainFollowChosenPath(
-    int xsize, int ysize, const uint32_t* const argb,
-    int quality, int cache_bits,
+    int xsize, int ysize, const uint32_t* const argb, int cache_bits,
     const uint32_t* const chosen_path, int chosen_path_size,
-    VP8LBackwardRefs* const refs) {
-  const int pix_count = xsize * ysize;
+    const VP8LHashChain* const hash_chain, VP8LBackwardRefs* const refs) {
   const int use_color_cache = (cache_bits > 0);
   int size = 0;
   int i = 0;
   int k;
   int ix;
-  int ok = 0;
-  int cc_init = 0;
-  int window_size = WINDOW_SIZE;
-  int iter_pos = 1;
-  int iter_limit = -1;
-  HashChain* hash_chain = (HashChain*)malloc(sizeof(*hash_chain));
   VP8LColorCache hashers;
 
-  if (hash_chain == NULL || !HashChainInit(hash_chain, pix_count)) {
-    goto Error;
-  }
   if (use_color_cache) {
-    cc_init = VP8LColorCacheInit(&hashers, cache_bits);
-    if (!cc_init) goto Error;
+    if (!VP8LColorCacheInit(&hashers, cache_bits)) return 0;
   }
 
   refs->size = 0;
-  GetParamsForHashChainFindCopy(quality, xsize, cache_bits,
-                                &window_size, &iter_pos, &iter_limit);
   for (ix = 0; ix < chosen_path_size; ++ix, ++size) {
-    int offset = 0;
-    int len = 0;
-    int max_len = chosen_path[ix];
-    if (max_len != 1) {
-      HashChainFindCopy(hash_chain, i, xsize, argb, max_len,
-                        window_size, iter_pos, iter_limit,
-                        &offset, &len);
-      assert(len == max_len);
+    const int len = chosen_path[ix];
+    if (len != 1) {
+      const int offset = HashChainFindOffset(hash_chain, i);
+      assert(len <= HashChainFindLength(hash_chain, i));
       refs->refs[size] = PixOrCopyCreateCopy(offset, len);
       if (use_color_cache) {
         for (k = 0; k < len; ++k) {
           VP8LColorCacheInsert(&hashers, argb[i + k]);
         }
       }
-      {
-        const int last = (len < pix_count - 1 - i) ? len : pix_count - 1 - i;
-        for (k = 0; k < last; ++k) {
-          HashChainInsert(hash_chain, &argb[i + k], i + k);
-        }
-      }
       i += len;
     } else {
       if (use_color_cache && VP8LColorCacheContains(&hashers, argb[i])) {
@@ -678,27 +643,23 @@ static int BackwardReferencesHashChainFollowChosenPath(
         if (use_color_cache) VP8LColorCacheInsert(&hashers, argb[i]);
         refs->refs[size] = PixOrCopyCreateLiteral(argb[i]);
       }
-      if (i + 1 < pix_count) {
-        HashChainInsert(hash_chain, &argb[i], i);
-      }
       ++i;
     }
   }
+  assert(i == xsize * ysize);
+  (void)xsize;  // xsize is not used in non-debug compilations otherwise.
+  (void)ysize;  // ysize is not used in non-debug compilations otherwise.
   assert(size <= refs->max_size);
   refs->size = size;
-  ok = 1;
-Error:
-  if (cc_init) VP8LColorCacheClear(&hashers);
-  HashChainDelete(hash_chain);
-  return ok;
+  if (use_color_cache) VP8LColorCacheClear(&hashers);
+  return 1;
 }
 
 // Returns 1 on success.
-static int BackwardReferencesTraceBackwards(int xsize, int ysize,
-                                            int recursive_cost_model,
-                                            const uint32_t* const argb,
-                                            int quality, int cache_bits,
-                                            VP8LBackwardRefs* const refs) {
+static int BackwardReferencesTraceBackwards(
+    int xsize, int ysize, int recursive_cost_model,
+    const uint32_t* const argb, int cache_bits,
+    const VP8LHashChain* const hash_chain, VP8LBackwardRefs* const refs) {
   int ok = 0;
   const int dist_array_size = xsize * ysize;
   uint32_t* chosen_path = NULL;
@@ -709,14 +670,14 @@ static int BackwardReferencesTraceBackwards(int xsize, int ysize,
   if (dist_array == NULL) goto Error;
 
   if (!BackwardReferencesHashChainDistanceOnly(
-      xsize, ysize, recursive_cost_model, argb, quality, cache_bits,
+      xsize, ysize, recursive_cost_model, argb, cache_bits, hash_chain,
       dist_array)) {
     goto Error;
   }
   TraceBackwards(dist_array, dist_array_size, &chosen_path, &chosen_path_size);
   if (!BackwardReferencesHashChainFollowChosenPath(
-      xsize, ysize, argb, quality, cache_bits, chosen_path, chosen_path_size,
-      refs)) {
+      xsize, ysize, argb, cache_bits, chosen_path, chosen_path_size,
+      hash_chain, refs)) {
     goto Error;
   }
   ok = 1;
@@ -740,6 +701,7 @@ static void BackwardReferences2DLocality(int xsize,
 int VP8LGetBackwardReferences(int width, int height,
                               const uint32_t* const argb,
                               int quality, int cache_bits, int use_2d_locality,
+                              const VP8LHashChain* const hash_chain,
                               VP8LBackwardRefs* const best) {
   int ok = 0;
   int lz77_is_useful;
@@ -756,8 +718,8 @@ int VP8LGetBackwardReferences(int width, int height,
     goto End;
   }
 
-  if (!BackwardReferencesHashChain(width, height, argb, cache_bits, quality,
-                                   &refs_lz77)) {
+  if (!BackwardReferencesHashChain(width, height, argb, cache_bits,
+                                   hash_chain, &refs_lz77)) {
     goto End;
   }
   // Backward Reference using RLE only.
@@ -793,7 +755,8 @@ int VP8LGetBackwardReferences(int width, int height,
         goto End;
       }
       if (BackwardReferencesTraceBackwards(width, height, recursion_level, argb,
-                                           quality, cache_bits, &refs_trace)) {
+                                           cache_bits, hash_chain,
+                                           &refs_trace)) {
         VP8LClearBackwardRefs(&refs_lz77);
         *best = refs_trace;
       }
@@ -861,26 +824,78 @@ static int ComputeCacheHistogram(const uint32_t* const argb,
   return 1;
 }
 
+// Worker job computing the entropy estimates of the cache sizes
+// 'first_bits_', 'first_bits_ + step_', ...
+typedef struct {
+  int first_bits_;
+  int step_;
+  const uint32_t* argb_;
+  int xsize_;
+  int ysize_;
+  const VP8LBackwardRefs* refs_;
+  double* entropies_;
+} CacheSizeJob;
+
+static int CacheSizeHook(void* arg1, void* arg2) {
+  const CacheSizeJob* const job = (const CacheSizeJob*)arg1;
+  int cache_bits;
+  (void)arg2;
+  for (cache_bits = job->first_bits_; cache_bits <= MAX_COLOR_CACHE_BITS;
+       cache_bits += job->step_) {
+    VP8LHistogram histo;
+    VP8LHistogramInit(&histo, cache_bits);
+    ComputeCacheHistogram(job->argb_, job->xsize_, job->ysize_, job->refs_,
+                          cache_bits, &histo);
+    job->entropies_[cache_bits] = VP8LHistogramEstimateBits(&histo);
+  }
+  return 1;
+}
+
 // Returns how many bits are to be used for a color cache.
 int VP8LCalculateEstimateForCacheSize(const uint32_t* const argb,
                                       int xsize, int ysize,
+                                      const VP8LHashChain* const hash_chain,
+                                      int num_threads,
                                       int* const best_cache_bits) {
   int ok = 0;
   int cache_bits;
+  int num_jobs, num_parallel;
+  int i;
   double lowest_entropy = 1e99;
+  double entropies[MAX_COLOR_CACHE_BITS + 1];
+  CacheSizeJob jobs[MAX_COLOR_CACHE_BITS + 1];
+  WebPWorker workers[MAX_COLOR_CACHE_BITS + 1];
   VP8LBackwardRefs refs;
   static const double kSmallPenaltyForLargeCache = 4.0;
-  static const int quality = 30;
   if (!VP8LBackwardRefsAlloc(&refs, xsize * ysize) ||
-      !BackwardReferencesHashChain(xsize, ysize, argb, 0, quality, &refs)) {
+      !BackwardReferencesHashChain(xsize, ysize, argb, 0, hash_chain, &refs)) {
     goto Error;
   }
+
+  // The histograms of the different cache sizes are independent: spread them
+  // over the available threads. Job #0 runs in the calling thread.
+  num_jobs = (num_threads < 1) ? 1 :
+             (num_threads > MAX_COLOR_CACHE_BITS + 1) ? MAX_COLOR_CACHE_BITS + 1
+                                                      : num_threads;
+  num_parallel = WebPWorkersInit(workers, num_jobs, num_jobs);
+  for (i = 0; i < num_jobs; ++i) {
+    CacheSizeJob* const job = &jobs[i];
+    job->first_bits_ = i;
+    job->step_ = num_jobs;
+    job->argb_ = argb;
+    job->xsize_ = xsize;
+    job->ysize_ = ysize;
+    job->refs_ = &refs;
+    job->entropies_ = entropies;
+    workers[i].hook = CacheSizeHook;
+    workers[i].data1 = job;
+    workers[i].data2 = NULL;
+  }
+  WebPWorkersRun(workers, num_jobs, num_parallel);
+  WebPWorkersEnd(workers, num_jobs);
+
   for (cache_bits = 0; cache_bits <= MAX_COLOR_CACHE_BITS; ++cache_bits) {
-    double cur_entropy;
-    VP8LHistogram histo;
-    VP8LHistogramInit(&histo, cache_bits);
-    ComputeCacheHistogram(argb, xsize, ysize, &refs, cache_bits, &histo);
-    cur_entropy = VP8LHistogramEstimateBits(&histo) +
+    const double cur_entropy = entropies[cache_bits] +
         kSmallPenaltyForLargeCache * cache_bits;
     if (cache_bits == 0 || cur_entropy < lowest_entropy) {
       *best_cache_bits = cache_bits;
@@ -130,19 +130,47 @@ void VP8LClearBackwardRefs(VP8LBackwardRefs* const refs);
 // Allocate 'max_size' references. Returns false in case of memory error.
 int VP8LBackwardRefsAlloc(VP8LBackwardRefs* const refs, int max_size);
 
+// -----------------------------------------------------------------------------
+// Hash chain
+
+// Best match found for each pixel of an image. It is computed once per image
+// and shared by the different backward references passes.
+typedef struct {
+  // For each pixel, the distance to its best match is stored in the upper 20
+  // bits and the match length in the lower 12 bits (0 if there is no match).
+  uint32_t* offset_length_;
+  int size_;
+} VP8LHashChain;
+
+// Allocates the hash chain for 'size' pixels. 'p' must be zero-initialized.
+// Returns false in case of memory error.
+int VP8LHashChainInit(VP8LHashChain* const p, int size);
+// Finds the best matches of the 'xsize' x 'ysize' image 'argb'. 'quality'
+// (0..100) trades the search speed for the match quality.
+// Returns false in case of memory error.
+int VP8LHashChainFill(VP8LHashChain* const p, int quality,
+                      const uint32_t* const argb, int xsize, int ysize);
+// Releases the memory and resets the object.
+void VP8LHashChainClear(VP8LHashChain* const p);
+
 // -----------------------------------------------------------------------------
 // Main entry points
 
-// Evaluates best possible backward references for specified quality.
+// Evaluates best possible backward references for specified quality, using
+// the matches of 'hash_chain' (filled for 'argb').
 // Further optimize for 2D locality if use_2d_locality flag is set.
 int VP8LGetBackwardReferences(int width, int height,
                               const uint32_t* const argb,
                               int quality, int cache_bits, int use_2d_locality,
+                              const VP8LHashChain* const hash_chain,
                               VP8LBackwardRefs* const best);
 
-// Produce an estimate for a good color cache size for the image.
+// Produce an estimate for a good color cache size for the image, using up to
+// 'num_threads' threads.
 int VP8LCalculateEstimateForCacheSize(const uint32_t* const argb,
                                       int xsize, int ysize,
+                                      const VP8LHashChain* const hash_chain,
+                                      int num_threads,
                                       int* const best_cache_bits);
 
 #ifdef __cplusplus
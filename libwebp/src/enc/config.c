@@ -47,6 +47,7 @@ int WebPConfigInitInternal(WebPConfig* config,
   config->emulate_jpeg_size = 0;
   config->thread_level = 0;
   config->low_memory = 0;
+  config->lossless_search = 0;
 
   // TODO(skal): tune.
   switch (preset) {
@@ -133,6 +134,8 @@ int WebPValidateConfig(const WebPConfig* config) {
     return 0;
   if (config->low_memory < 0 || config->low_memory > 1)
     return 0;
+  if (config->lossless_search < 0 || config->lossless_search > 100)
+    return 0;
   return 1;
 }
 
@@ -18,24 +18,12 @@
 
 #include "./vp8enci.h"
 #include "./cost.h"
+#include "../utils/utils.h"
 #include "../webp/format_constants.h"  // RIFF constants
 
 #define SEGMENT_VISU 0
 #define DEBUG_SEARCH 0    // useful to track search convergence
 
-// On-the-fly info about the current set of residuals. Handy to avoid
-// passing zillions of params.
-typedef struct {
-  int first;
-  int last;
-  const int16_t* coeffs;
-
-  int coeff_type;
-  ProbaArray* prob;
-  StatsArray* stats;
-  CostArray*  cost;
-} VP8Residual;
-
 //------------------------------------------------------------------------------
 // multi-pass convergence
 
@@ -45,6 +33,18 @@ typedef struct {
 // we allow 2k of extra head-room in PARTITION0 limit.
 #define PARTITION0_SIZE_LIMIT ((VP8_MAX_PARTITION0_SIZE - 2048ULL) << 11)
 
+// Rate model used for the search: log(size) and PSNR are taken as locally
+// linear in q. The typical slopes below give the first step, then the slope
+// is measured between the last two passes.
+#define LOG_SIZE_SLOPE 0.015  // d(log(size)) / dq
+#define PSNR_SLOPE     0.12   // d(PSNR) / dq
+
+// The intermediate passes of the search only visit one macroblock row out of
+// 'row_step' (up to MAX_ROW_STEP), keeping at least MIN_SAMPLED_MBS
+// macroblocks. The last pass always visits all of them.
+#define MAX_ROW_STEP    8
+#define MIN_SAMPLED_MBS 400
+
 typedef struct {  // struct for organizing convergence in either size or PSNR
   int is_first;
   float dq;
@@ -74,13 +74,22 @@ static float Clamp(float v, float min, float max) {
   return (v < min) ? min : (v > max) ? max : v;
 }
 
+// Returns the value of the searched metric, in the rate model's domain.
+static double ModelValue(const PassStats* const s, double value) {
+  return s->do_size_search ? log(value > 1. ? value : 1.) : value;
+}
+
 static float ComputeNextQ(PassStats* const s) {
   float dq;
+  const double target = ModelValue(s, s->target);
+  const double value = ModelValue(s, s->value);
+  const double last_value = ModelValue(s, s->last_value);
   if (s->is_first) {
-    dq = (s->value > s->target) ? -s->dq : s->dq;
+    const double slope = s->do_size_search ? LOG_SIZE_SLOPE : PSNR_SLOPE;
+    dq = (float)((target - value) / slope);
     s->is_first = 0;
-  } else if (s->value != s->last_value) {
-    const double slope = (s->target - s->value) / (s->last_value - s->value);
+  } else if (value != last_value) {
+    const double slope = (target - value) / (last_value - value);
     dq = (float)(slope * (s->last_q - s->q));
   } else {
     dq = 0.;  // we're done?!
@@ -316,61 +325,13 @@ static void InitResidual(int first, int coeff_type,
   res->coeff_type = coeff_type;
   res->prob  = enc->proba_.coeffs_[coeff_type];
   res->stats = enc->proba_.stats_[coeff_type];
-  res->cost  = enc->proba_.level_cost_[coeff_type];
+  res->costs = enc->proba_.remapped_costs_[coeff_type];
   res->first = first;
 }
 
-static void SetResidualCoeffs(const int16_t* const coeffs,
-                              VP8Residual* const res) {
-  int n;
-  res->last = -1;
-  for (n = 15; n >= res->first; --n) {
-    if (coeffs[n]) {
-      res->last = n;
-      break;
-    }
-  }
-  res->coeffs = coeffs;
-}
-
 //------------------------------------------------------------------------------
 // Mode costs
 
-static int GetResidualCost(int ctx0, const VP8Residual* const res) {
-  int n = res->first;
-  // should be prob[VP8EncBands[n]], but it's equivalent for n=0 or 1
-  int p0 = res->prob[n][ctx0][0];
-  const uint16_t* t = res->cost[n][ctx0];
-  int cost;
-
-  if (res->last < 0) {
-    return VP8BitCost(0, p0);
-  }
-  cost = VP8BitCost(1, p0);
-  for (; n < res->last; ++n) {
-    const int v = abs(res->coeffs[n]);
-    const int b = VP8EncBands[n + 1];
-    const int ctx = (v >= 2) ? 2 : v;
-    cost += VP8LevelCost(t, v);
-    t = res->cost[b][ctx];
-    // the masking trick is faster than "if (v) cost += ..." with clang
-    cost += (v ? ~0U : 0) & VP8BitCost(1, res->prob[b][ctx][0]);
-  }
-  // Last coefficient is always non-zero
-  {
-    const int v = abs(res->coeffs[n]);
-    assert(v != 0);
-    cost += VP8LevelCost(t, v);
-    if (n < 15) {
-      const int b = VP8EncBands[n + 1];
-      const int ctx = (v == 1) ? 1 : 2;
-      const int last_p0 = res->prob[b][ctx][0];
-      cost += VP8BitCost(0, last_p0);
-    }
-  }
-  return cost;
-}
-
 int VP8GetCostLuma4(VP8EncIterator* const it, const int16_t levels[16]) {
   const int x = (it->i4_ & 3), y = (it->i4_ >> 2);
   VP8Residual res;
@@ -380,8 +341,8 @@ int VP8GetCostLuma4(VP8EncIterator* const it, const int16_t levels[16]) {
 
   InitResidual(0, 3, enc, &res);
   ctx = it->top_nz_[x] + it->left_nz_[y];
-  SetResidualCoeffs(levels, &res);
-  R += GetResidualCost(ctx, &res);
+  VP8SetResidualCoeffs(levels, &res);
+  R += VP8GetResidualCost(ctx, &res);
   return R;
 }
 
@@ -395,16 +356,16 @@ int VP8GetCostLuma16(VP8EncIterator* const it, const VP8ModeScore* const rd) {
 
   // DC
   InitResidual(0, 1, enc, &res);
-  SetResidualCoeffs(rd->y_dc_levels, &res);
-  R += GetResidualCost(it->top_nz_[8] + it->left_nz_[8], &res);
+  VP8SetResidualCoeffs(rd->y_dc_levels, &res);
+  R += VP8GetResidualCost(it->top_nz_[8] + it->left_nz_[8], &res);
 
   // AC
   InitResidual(1, 0, enc, &res);
   for (y = 0; y < 4; ++y) {
     for (x = 0; x < 4; ++x) {
       const int ctx = it->top_nz_[x] + it->left_nz_[y];
-      SetResidualCoeffs(rd->y_ac_levels[x + y * 4], &res);
-      R += GetResidualCost(ctx, &res);
+      VP8SetResidualCoeffs(rd->y_ac_levels[x + y * 4], &res);
+      R += VP8GetResidualCost(ctx, &res);
       it->top_nz_[x] = it->left_nz_[y] = (res.last >= 0);
     }
   }
@@ -424,8 +385,8 @@ int VP8GetCostUV(VP8EncIterator* const it, const VP8ModeScore* const rd) {
     for (y = 0; y < 2; ++y) {
       for (x = 0; x < 2; ++x) {
         const int ctx = it->top_nz_[4 + ch + x] + it->left_nz_[4 + ch + y];
-        SetResidualCoeffs(rd->uv_levels[ch * 2 + x + y * 2], &res);
-        R += GetResidualCost(ctx, &res);
+        VP8SetResidualCoeffs(rd->uv_levels[ch * 2 + x + y * 2], &res);
+        R += VP8GetResidualCost(ctx, &res);
         it->top_nz_[4 + ch + x] = it->left_nz_[4 + ch + y] = (res.last >= 0);
       }
     }
@@ -522,7 +483,7 @@ static void CodeResiduals(VP8BitWriter* const bw, VP8EncIterator* const it,
   pos1 = VP8BitWriterPos(bw);
   if (i16) {
     InitResidual(0, 1, enc, &res);
-    SetResidualCoeffs(rd->y_dc_levels, &res);
+    VP8SetResidualCoeffs(rd->y_dc_levels, &res);
     it->top_nz_[8] = it->left_nz_[8] =
       PutCoeffs(bw, it->top_nz_[8] + it->left_nz_[8], &res);
     InitResidual(1, 0, enc, &res);
@@ -534,7 +495,7 @@ static void CodeResiduals(VP8BitWriter* const bw, VP8EncIterator* const it,
   for (y = 0; y < 4; ++y) {
     for (x = 0; x < 4; ++x) {
       const int ctx = it->top_nz_[x] + it->left_nz_[y];
-      SetResidualCoeffs(rd->y_ac_levels[x + y * 4], &res);
+      VP8SetResidualCoeffs(rd->y_ac_levels[x + y * 4], &res);
       it->top_nz_[x] = it->left_nz_[y] = PutCoeffs(bw, ctx, &res);
     }
   }
@@ -546,7 +507,7 @@ static void CodeResiduals(VP8BitWriter* const bw, VP8EncIterator* const it,
     for (y = 0; y < 2; ++y) {
       for (x = 0; x < 2; ++x) {
         const int ctx = it->top_nz_[4 + ch + x] + it->left_nz_[4 + ch + y];
-        SetResidualCoeffs(rd->uv_levels[ch * 2 + x + y * 2], &res);
+        VP8SetResidualCoeffs(rd->uv_levels[ch * 2 + x + y * 2], &res);
         it->top_nz_[4 + ch + x] = it->left_nz_[4 + ch + y] =
             PutCoeffs(bw, ctx, &res);
       }
@@ -572,7 +533,7 @@ static void RecordResiduals(VP8EncIterator* const it,
 
   if (it->mb_->type_ == 1) {   // i16x16
     InitResidual(0, 1, enc, &res);
-    SetResidualCoeffs(rd->y_dc_levels, &res);
+    VP8SetResidualCoeffs(rd->y_dc_levels, &res);
     it->top_nz_[8] = it->left_nz_[8] =
       RecordCoeffs(it->top_nz_[8] + it->left_nz_[8], &res);
     InitResidual(1, 0, enc, &res);
@@ -584,7 +545,7 @@ static void RecordResiduals(VP8EncIterator* const it,
   for (y = 0; y < 4; ++y) {
     for (x = 0; x < 4; ++x) {
       const int ctx = it->top_nz_[x] + it->left_nz_[y];
-      SetResidualCoeffs(rd->y_ac_levels[x + y * 4], &res);
+      VP8SetResidualCoeffs(rd->y_ac_levels[x + y * 4], &res);
       it->top_nz_[x] = it->left_nz_[y] = RecordCoeffs(ctx, &res);
     }
   }
@@ -595,7 +556,7 @@ static void RecordResiduals(VP8EncIterator* const it,
     for (y = 0; y < 2; ++y) {
       for (x = 0; x < 2; ++x) {
         const int ctx = it->top_nz_[4 + ch + x] + it->left_nz_[4 + ch + y];
-        SetResidualCoeffs(rd->uv_levels[ch * 2 + x + y * 2], &res);
+        VP8SetResidualCoeffs(rd->uv_levels[ch * 2 + x + y * 2], &res);
         it->top_nz_[4 + ch + x] = it->left_nz_[4 + ch + y] =
             RecordCoeffs(ctx, &res);
       }
@@ -620,7 +581,7 @@ static void RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
   if (it->mb_->type_ == 1) {   // i16x16
     const int ctx = it->top_nz_[8] + it->left_nz_[8];
     InitResidual(0, 1, enc, &res);
-    SetResidualCoeffs(rd->y_dc_levels, &res);
+    VP8SetResidualCoeffs(rd->y_dc_levels, &res);
     it->top_nz_[8] = it->left_nz_[8] =
         VP8RecordCoeffTokens(ctx, 1,
                              res.first, res.last, res.coeffs, tokens);
@@ -634,7 +595,7 @@ static void RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
   for (y = 0; y < 4; ++y) {
     for (x = 0; x < 4; ++x) {
       const int ctx = it->top_nz_[x] + it->left_nz_[y];
-      SetResidualCoeffs(rd->y_ac_levels[x + y * 4], &res);
+      VP8SetResidualCoeffs(rd->y_ac_levels[x + y * 4], &res);
       it->top_nz_[x] = it->left_nz_[y] =
           VP8RecordCoeffTokens(ctx, res.coeff_type,
                                res.first, res.last, res.coeffs, tokens);
@@ -648,7 +609,7 @@ static void RecordTokens(VP8EncIterator* const it, const VP8ModeScore* const rd,
     for (y = 0; y < 2; ++y) {
       for (x = 0; x < 2; ++x) {
         const int ctx = it->top_nz_[4 + ch + x] + it->left_nz_[4 + ch + y];
-        SetResidualCoeffs(rd->uv_levels[ch * 2 + x + y * 2], &res);
+        VP8SetResidualCoeffs(rd->uv_levels[ch * 2 + x + y * 2], &res);
         it->top_nz_[4 + ch + x] = it->left_nz_[4 + ch + y] =
             VP8RecordCoeffTokens(ctx, 2,
                                  res.first, res.last, res.coeffs, tokens);
@@ -682,27 +643,31 @@ static void ResetSSE(VP8Encoder* const enc) {
   enc->sse_count_ = 0;
 }
 
-static void StoreSSE(const VP8EncIterator* const it) {
-  VP8Encoder* const enc = it->enc_;
+static void StoreSSE(const VP8EncIterator* const it,
+                     uint64_t sse[3], uint64_t* const sse_count) {
   const uint8_t* const in = it->yuv_in_;
   const uint8_t* const out = it->yuv_out_;
   // Note: not totally accurate at boundary. And doesn't include in-loop filter.
-  enc->sse_[0] += VP8SSE16x16(in + Y_OFF, out + Y_OFF);
-  enc->sse_[1] += VP8SSE8x8(in + U_OFF, out + U_OFF);
-  enc->sse_[2] += VP8SSE8x8(in + V_OFF, out + V_OFF);
-  enc->sse_count_ += 16 * 16;
+  sse[0] += VP8SSE16x16(in + Y_OFF, out + Y_OFF);
+  sse[1] += VP8SSE8x8(in + U_OFF, out + U_OFF);
+  sse[2] += VP8SSE8x8(in + V_OFF, out + V_OFF);
+  *sse_count += 16 * 16;
 }
 
-static void StoreSideInfo(const VP8EncIterator* const it) {
+// Records the macroblock's statistics. The sse[], sse_count and block_count[]
+// accumulators are usually the encoder's own, or a row-job's private ones.
+static void StoreSideInfo(const VP8EncIterator* const it,
+                          uint64_t sse[3], uint64_t* const sse_count,
+                          int block_count[3]) {
   VP8Encoder* const enc = it->enc_;
   const VP8MBInfo* const mb = it->mb_;
   WebPPicture* const pic = enc->pic_;
 
   if (pic->stats != NULL) {
-    StoreSSE(it);
-    enc->block_count_[0] += (mb->type_ == 0);
-    enc->block_count_[1] += (mb->type_ == 1);
-    enc->block_count_[2] += (mb->skip_ != 0);
+    StoreSSE(it, sse, sse_count);
+    block_count[0] += (mb->type_ == 0);
+    block_count[1] += (mb->type_ == 1);
+    block_count[2] += (mb->skip_ != 0);
   }
 
   if (pic->extra_info != NULL) {
@@ -748,16 +713,65 @@ static void SetLoopParams(VP8Encoder* const enc, float q) {
   ResetSSE(enc);
 }
 
+// Returns the row step to use for the intermediate passes of the search,
+// over the 'nb_mbs' first macroblocks.
+static int GetSearchRowStep(const VP8Encoder* const enc, int nb_mbs) {
+  const int nb_rows = (nb_mbs + enc->mb_w_ - 1) / enc->mb_w_;
+  int row_step = 1;
+  if (!enc->do_search_) return 1;
+  while (2 * row_step <= MAX_ROW_STEP &&
+         ((nb_rows + 2 * row_step - 1) / (2 * row_step)) * enc->mb_w_ >=
+             MIN_SAMPLED_MBS) {
+    row_step *= 2;
+  }
+  return row_step;
+}
+
+// Number of macroblocks visited with one row out of 'row_step'.
+static int GetNumSampledMBs(const VP8Encoder* const enc, int nb_mbs,
+                            int row_step) {
+  if (row_step > 1) {
+    const int nb_rows = (nb_mbs + enc->mb_w_ - 1) / enc->mb_w_;
+    return ((nb_rows + row_step - 1) / row_step) * enc->mb_w_;
+  }
+  return nb_mbs;
+}
+
+// After a row is complete, jumps to the next row that is a multiple of
+// 'row_step'.
+static void SkipRows(VP8EncIterator* const it, int row_step) {
+  if (row_step > 1 && it->x_ == 0 && (it->y_ % row_step) != 0) {
+    const int y = it->y_ + row_step - (it->y_ % row_step);
+    if (y < it->enc_->mb_h_) VP8IteratorSetRow(it, y);
+  }
+}
+
+// Extrapolates the size of the macroblock data from the 'nb_sampled' ones
+// visited to the whole picture.
+static uint64_t ScaleSize(const VP8Encoder* const enc, uint64_t size,
+                          int nb_sampled) {
+  const uint64_t total_mbs = (uint64_t)enc->mb_w_ * enc->mb_h_;
+  return (nb_sampled > 0) ? size * total_mbs / nb_sampled : size;
+}
+
 static uint64_t OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt,
-                            int nb_mbs, int percent_delta,
+                            int nb_mbs, int row_step, int percent_delta,
                             PassStats* const s) {
   VP8EncIterator it;
   uint64_t size = 0;
   uint64_t size_p0 = 0;
   uint64_t distortion = 0;
-  const uint64_t pixel_count = nb_mbs * 384;
-
+  const int total_mbs = enc->mb_w_ * enc->mb_h_;
+  int nb_sampled = GetNumSampledMBs(enc, nb_mbs, row_step);
+  uint64_t pixel_count;
+
+  // The iterator must never be asked for more macroblocks than the picture
+  // has, whatever the probe size and row rounding.
+  if (nb_sampled > total_mbs) nb_sampled = total_mbs;
+  pixel_count = (uint64_t)nb_sampled * 384;
+  nb_mbs = nb_sampled;
   VP8IteratorInit(enc, &it);
+  VP8IteratorSetCountDown(&it, nb_sampled);
   SetLoopParams(enc, s->q);
   do {
     VP8ModeScore info;
@@ -773,10 +787,19 @@ static uint64_t OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt,
     if (percent_delta && !VP8IteratorProgress(&it, percent_delta))
       return 0;
     VP8IteratorSaveBoundary(&it);
-  } while (VP8IteratorNext(&it) && --nb_mbs > 0);
+    if (!VP8IteratorNext(&it)) break;
+    SkipRows(&it, row_step);
+  } while (--nb_mbs > 0);
 
+  if (s->do_size_search) {
+    size = ScaleSize(enc, size, nb_sampled);
+    size_p0 = ScaleSize(enc, size_p0, nb_sampled);
+  }
   size_p0 += enc->segment_hdr_.size_;
   if (s->do_size_search) {
+    // The skip probability is computed over the whole picture.
+    enc->proba_.nb_skip_ =
+        (int)ScaleSize(enc, (uint64_t)enc->proba_.nb_skip_, nb_sampled);
     size += FinalizeSkipProba(enc);
     size += FinalizeTokenProbas(&enc->proba_);
     size = ((size + size_p0 + 1024) >> 11) + HEADER_SIZE_ESTIMATE;
@@ -787,7 +810,8 @@ static uint64_t OneStatPass(VP8Encoder* const enc, VP8RDLevel rd_opt,
   return size_p0;
 }
 
-static int StatLoop(VP8Encoder* const enc) {
+// 'nb_mbs' is the number of macroblocks available for the stats collection.
+static int StatLoop(VP8Encoder* const enc, int nb_mbs) {
   const int method = enc->method_;
   const int do_search = enc->do_search_;
   const int fast_probe = ((method == 0 || method == 3) && !do_search);
@@ -798,27 +822,31 @@ static int StatLoop(VP8Encoder* const enc) {
   const int final_percent = enc->percent_ + task_percent;
   const VP8RDLevel rd_opt =
       (method >= 3 || do_search) ? RD_OPT_BASIC : RD_OPT_NONE;
-  int nb_mbs = enc->mb_w_ * enc->mb_h_;
+  const int row_step = GetSearchRowStep(enc, nb_mbs);
   PassStats stats;
 
   InitPassStats(enc, &stats);
   ResetTokenStats(enc);
 
   // Fast mode: quick analysis pass over few mbs. Better than nothing.
+  // The probe can't go past the 'nb_mbs' macroblocks available.
   if (fast_probe) {
+    int nb_probe;
     if (method == 3) {  // we need more stats for method 3 to be reliable.
-      nb_mbs = (nb_mbs > 200) ? nb_mbs >> 1 : 100;
+      nb_probe = (nb_mbs > 200) ? nb_mbs >> 1 : 100;
     } else {
-      nb_mbs = (nb_mbs > 200) ? nb_mbs >> 2 : 50;
+      nb_probe = (nb_mbs > 200) ? nb_mbs >> 2 : 50;
     }
+    if (nb_probe < nb_mbs) nb_mbs = nb_probe;
   }
 
   while (num_pass_left-- > 0) {
     const int is_last_pass = (fabs(stats.dq) <= DQ_LIMIT) ||
                              (num_pass_left == 0) ||
                              (enc->max_i4_header_bits_ == 0);
-    const uint64_t size_p0 =
-        OneStatPass(enc, rd_opt, nb_mbs, percent_per_pass, &stats);
+    const int pass_row_step = is_last_pass ? 1 : row_step;
+    const uint64_t size_p0 = OneStatPass(enc, rd_opt, nb_mbs, pass_row_step,
+                                         percent_per_pass, &stats);
     if (size_p0 == 0) return 0;
 #if (DEBUG_SEARCH > 0)
     printf("#%d value:%.1lf -> %.1lf   q:%.2f -> %.2f\n",
@@ -835,7 +863,9 @@ static int StatLoop(VP8Encoder* const enc) {
     // If no target size: just do several pass without changing 'q'
     if (do_search) {
       ComputeNextQ(&stats);
-      if (fabs(stats.dq) <= DQ_LIMIT) break;
+      // Once converged, a last pass over all macroblocks is still needed if
+      // this one was partial.
+      if (fabs(stats.dq) <= DQ_LIMIT && pass_row_step == 1) break;
     }
   }
   if (!do_search || !stats.do_size_search) {
@@ -906,43 +936,245 @@ static void ResetAfterSkip(VP8EncIterator* const it) {
   }
 }
 
+// Codes the current macroblock into its partition.
+static void CodeMacroblock(VP8EncIterator* const it,
+                           uint64_t sse[3], uint64_t* const sse_count,
+                           int block_count[3]) {
+  const VP8Encoder* const enc = it->enc_;
+  VP8ModeScore info;
+  const int dont_use_skip = !enc->proba_.use_skip_proba_;
+  const VP8RDLevel rd_opt = enc->rd_opt_level_;
+
+  VP8IteratorImport(it, NULL);
+  // Warning! order is important: first call VP8Decimate() and
+  // *then* decide how to code the skip decision if there's one.
+  if (!VP8Decimate(it, &info, rd_opt) || dont_use_skip) {
+    CodeResiduals(it->bw_, it, &info);
+  } else {   // reset predictors after a skip
+    ResetAfterSkip(it);
+  }
+#ifdef WEBP_EXPERIMENTAL_FEATURES
+  if (enc->use_layer_) {
+    VP8EncCodeLayerBlock(it);
+  }
+#endif
+  StoreSideInfo(it, sse, sse_count, block_count);
+  VP8StoreFilterStats(it);
+  VP8IteratorExport(it);
+}
+
+//------------------------------------------------------------------------------
+// Row-parallel coding.
+//
+// Each job codes every 'num_jobs'-th macroblock row, so that it owns whole
+// token partitions and writes them in order. Jobs advance in a wavefront: a
+// macroblock can only be coded once its top-right neighbour is, since its
+// top samples and non-zero context are read from the shared (single row)
+// y_top_/uv_top_/nz_ buffers. All jobs code a few macroblocks in each step,
+// and the next step is scheduled from their positions once they are synced.
+// The generated bitstream doesn't depend on the number of jobs.
+
+#define MAX_ROW_STEP 8    // maximum number of macroblocks coded per job & step
+
+typedef struct {
+  WebPWorker worker;
+  VP8EncIterator it;
+  int row_step;         // distance between two rows coded by this job
+  int num_mbs;          // number of macroblocks to code during this step
+  // private statistics, merged at the end
+  LFStats lf_stats;
+  uint64_t sse[3];
+  uint64_t sse_count;
+  int block_count[3];
+} RowJob;
+
+static int DoRowJob(RowJob* const job, void* const unused) {
+  VP8EncIterator* const it = &job->it;
+  const VP8Encoder* const enc = it->enc_;
+  int n;
+  (void)unused;
+  for (n = 0; n < job->num_mbs; ++n) {
+    CodeMacroblock(it, job->sse, &job->sse_count, job->block_count);
+    VP8IteratorSaveBoundary(it);
+    VP8IteratorNext(it);
+    if (it->x_ == 0) {    // end of row: move to our next one, if any.
+      const int next_row = it->y_ - 1 + job->row_step;
+      if (next_row < enc->mb_h_) {
+        VP8IteratorSetRow(it, next_row);
+      } else {
+        it->y_ = enc->mb_h_;
+      }
+    }
+  }
+  return 1;
+}
+
+// Returns the number of macroblocks already coded in row 'y', given the
+// iterator of the job it belongs to.
+static int GetRowProgress(const VP8EncIterator* const it, int y) {
+  return (it->y_ > y) ? it->enc_->mb_w_ : (it->y_ == y) ? it->x_ : 0;
+}
+
+// Returns the number of parallel row-jobs to use. It must be a divisor of the
+// number of partitions.
+static int GetNumRowJobs(const VP8Encoder* const enc) {
+  int num_jobs = 1;
+  if (enc->thread_level_ > 0 && !enc->use_layer_) {
+    const int num_cores = WebPGetNumCores();
+    while (2 * num_jobs <= enc->num_parts_ && 2 * num_jobs <= num_cores) {
+      num_jobs *= 2;
+    }
+  }
+  return num_jobs;
+}
+
+static int RowJobsLoop(VP8Encoder* const enc, VP8EncIterator* const it,
+                       int num_jobs) {
+  const int mb_w = enc->mb_w_;
+  const int mb_h = enc->mb_h_;
+  const int total_mbs = mb_w * mb_h;
+  const int percent0 = enc->percent_;
+  int done_mbs = 0;
+  int ok = 1;
+  int j;
+  RowJob* const jobs =
+      (RowJob*)WebPSafeMalloc((uint64_t)num_jobs, sizeof(*jobs));
+  if (jobs == NULL) {
+    return WebPEncodingSetError(enc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+  for (j = 0; j < num_jobs; ++j) {
+    RowJob* const job = &jobs[j];
+    WebPWorkerInit(&job->worker);
+    job->worker.data1 = job;
+    job->worker.data2 = NULL;
+    job->worker.hook = (WebPWorkerHook)DoRowJob;
+    VP8IteratorInit(enc, &job->it);
+    job->it.lf_stats_ = (enc->lf_stats_ != NULL) ? &job->lf_stats : NULL;
+    VP8InitFilter(&job->it);
+    if (j < mb_h) {
+      VP8IteratorSetRow(&job->it, j);
+    } else {
+      job->it.y_ = mb_h;
+    }
+    job->row_step = num_jobs;
+    memset(job->sse, 0, sizeof(job->sse));
+    job->sse_count = 0;
+    memset(job->block_count, 0, sizeof(job->block_count));
+    // jobs[0] is run in the main thread, with WebPWorkerExecute().
+    if (j > 0) ok &= WebPWorkerReset(&job->worker);
+  }
+
+  while (ok && done_mbs < total_mbs) {
+    // Schedule the step: a row can progress up to one macroblock behind the
+    // row above, or till its end if the row above is complete.
+    for (j = 0; j < num_jobs; ++j) {
+      RowJob* const job = &jobs[j];
+      const int y = job->it.y_;
+      int num_mbs = 0;
+      if (y < mb_h) {
+        const int top_done = (y == 0) ? mb_w
+            : GetRowProgress(&jobs[(y - 1) % num_jobs].it, y - 1);
+        const int limit = (top_done == mb_w) ? mb_w : top_done - 1;
+        num_mbs = limit - job->it.x_;
+        if (num_mbs > MAX_ROW_STEP) num_mbs = MAX_ROW_STEP;
+        if (num_mbs < 0) num_mbs = 0;
+      }
+      job->num_mbs = num_mbs;
+      done_mbs += num_mbs;
+    }
+    for (j = 1; j < num_jobs; ++j) {
+      if (jobs[j].num_mbs > 0) WebPWorkerLaunch(&jobs[j].worker);
+    }
+    if (jobs[0].num_mbs > 0) WebPWorkerExecute(&jobs[0].worker);
+    for (j = 1; j < num_jobs; ++j) ok &= WebPWorkerSync(&jobs[j].worker);
+    // only the main thread reports the progress
+    ok = ok && WebPReportProgress(enc->pic_,
+                                  percent0 + 20 * done_mbs / total_mbs,
+                                  &enc->percent_);
+  }
+
+  // Merge the statistics, in job order.
+  for (j = 0; j < num_jobs; ++j) {
+    const RowJob* const job = &jobs[j];
+    int s, i;
+    WebPWorkerEnd(&jobs[j].worker);
+    for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+      for (i = 0; i < 3; ++i) it->bit_count_[s][i] += job->it.bit_count_[s][i];
+    }
+    if (enc->lf_stats_ != NULL) {
+      for (s = 0; s < NUM_MB_SEGMENTS; ++s) {
+        for (i = 0; i < MAX_LF_LEVELS; ++i) {
+          (*enc->lf_stats_)[s][i] += job->lf_stats[s][i];
+        }
+      }
+    }
+    for (i = 0; i < 3; ++i) {
+      enc->sse_[i] += job->sse[i];
+      enc->block_count_[i] += job->block_count[i];
+    }
+    enc->sse_count_ += job->sse_count;
+  }
+  free(jobs);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+
 int VP8EncLoop(VP8Encoder* const enc) {
   VP8EncIterator it;
+  const int num_jobs = GetNumRowJobs(enc);
   int ok = PreLoopInitialize(enc);
   if (!ok) return 0;
 
-  StatLoop(enc);  // stats-collection loop
+  StatLoop(enc, enc->mb_w_ * enc->mb_h_);  // stats-collection loop
 
   VP8IteratorInit(enc, &it);
   VP8InitFilter(&it);
-  do {
-    VP8ModeScore info;
-    const int dont_use_skip = !enc->proba_.use_skip_proba_;
-    const VP8RDLevel rd_opt = enc->rd_opt_level_;
-
-    VP8IteratorImport(&it, NULL);
-    // Warning! order is important: first call VP8Decimate() and
-    // *then* decide how to code the skip decision if there's one.
-    if (!VP8Decimate(&it, &info, rd_opt) || dont_use_skip) {
-      CodeResiduals(it.bw_, &it, &info);
-    } else {   // reset predictors after a skip
-      ResetAfterSkip(&it);
-    }
-#ifdef WEBP_EXPERIMENTAL_FEATURES
-    if (enc->use_layer_) {
-      VP8EncCodeLayerBlock(&it);
-    }
-#endif
-    StoreSideInfo(&it);
-    VP8StoreFilterStats(&it);
-    VP8IteratorExport(&it);
-    ok = VP8IteratorProgress(&it, 20);
-    VP8IteratorSaveBoundary(&it);
-  } while (ok && VP8IteratorNext(&it));
+  if (num_jobs > 1) {
+    ok = RowJobsLoop(enc, &it, num_jobs);
+  } else {
+    do {
+      CodeMacroblock(&it, enc->sse_, &enc->sse_count_, enc->block_count_);
+      ok = VP8IteratorProgress(&it, 20);
+      VP8IteratorSaveBoundary(&it);
+    } while (ok && VP8IteratorNext(&it));
+  }
 
   return PostLoopFinalize(&it, ok);
 }
 
+//------------------------------------------------------------------------------
+// Incremental coding
+
+int VP8EncStartRowLoop(VP8Encoder* const enc, VP8EncIterator* const it,
+                       int num_rows) {
+  if (!PreLoopInitialize(enc)) return 0;
+
+  StatLoop(enc, num_rows * enc->mb_w_);  // stats-collection loop
+
+  VP8IteratorInit(enc, it);
+  VP8InitFilter(it);
+  return 1;
+}
+
+int VP8EncCodeRow(VP8EncIterator* const it) {
+  const int y = it->y_;
+  int ok;
+  VP8Encoder* const enc = it->enc_;
+  do {
+    CodeMacroblock(it, enc->sse_, &enc->sse_count_, enc->block_count_);
+    ok = VP8IteratorProgress(it, 20);
+    VP8IteratorSaveBoundary(it);
+  } while (ok && VP8IteratorNext(it) && it->y_ == y);
+  return ok;
+}
+
+int VP8EncFinishRowLoop(VP8EncIterator* const it, int ok) {
+  // The segment map is only complete now.
+  SetSegmentProbas(it->enc_);
+  return PostLoopFinalize(it, ok);
+}
+
 //------------------------------------------------------------------------------
 // Single pass using Token Buffer.
 
@@ -950,25 +1182,78 @@ int VP8EncLoop(VP8Encoder* const enc) {
 
 #define MIN_COUNT 96  // minimum number of macroblocks before updating stats
 
+// Each partition has its own token buffer, coded in its own worker when
+// multi-threading is enabled.
+typedef struct {
+  WebPWorker worker;
+  VP8TBuffer* tokens;
+  VP8BitWriter* bw;
+  const uint8_t* probas;
+} EmitJob;
+
+static int DoEmitJob(EmitJob* const job, void* const unused) {
+  (void)unused;
+  return VP8EmitTokens(job->tokens, job->bw, job->probas, 1);
+}
+
+static int EmitPartitions(VP8Encoder* const enc, const uint8_t* const probas) {
+  const int num_parts = enc->num_parts_;
+  const int use_threads = (enc->thread_level_ > 0) && (num_parts > 1);
+  EmitJob jobs[MAX_NUM_PARTITIONS];
+  int ok = 1;
+  int p;
+  for (p = 0; p < num_parts; ++p) {
+    EmitJob* const job = &jobs[p];
+    WebPWorkerInit(&job->worker);
+    job->worker.data1 = job;
+    job->worker.data2 = NULL;
+    job->worker.hook = (WebPWorkerHook)DoEmitJob;
+    job->tokens = &enc->tokens_[p];
+    job->bw = &enc->parts_[p];
+    job->probas = probas;
+    // jobs[0] is always run in the main thread.
+    if (use_threads && p > 0) ok &= WebPWorkerReset(&job->worker);
+  }
+  for (p = 0; ok && p < num_parts; ++p) {
+    if (use_threads && p > 0) {
+      WebPWorkerLaunch(&jobs[p].worker);
+    } else {
+      WebPWorkerExecute(&jobs[p].worker);
+    }
+  }
+  for (p = 0; p < num_parts; ++p) {
+    ok &= WebPWorkerSync(&jobs[p].worker);
+    WebPWorkerEnd(&jobs[p].worker);
+  }
+  return ok;
+}
+
+// Estimated size of all the partitions.
+static uint64_t EstimatePartitionsSize(VP8Encoder* const enc,
+                                       const uint8_t* const probas) {
+  uint64_t size = 0;
+  int p;
+  for (p = 0; p < enc->num_parts_; ++p) {
+    size += VP8EstimateTokenSize(&enc->tokens_[p], probas);
+  }
+  return size;
+}
+
 int VP8EncTokenLoop(VP8Encoder* const enc) {
-  // Roughly refresh the proba eight times per pass
-  int max_count = (enc->mb_w_ * enc->mb_h_) >> 3;
+  const int total_mbs = enc->mb_w_ * enc->mb_h_;
+  const int row_step = GetSearchRowStep(enc, total_mbs);
   int num_pass_left = enc->config_->pass;
   const int do_search = enc->do_search_;
   VP8EncIterator it;
   VP8Proba* const proba = &enc->proba_;
   const VP8RDLevel rd_opt = enc->rd_opt_level_;
-  const uint64_t pixel_count = enc->mb_w_ * enc->mb_h_ * 384;
   PassStats stats;
-  int ok;
+  int ok, p;
 
   InitPassStats(enc, &stats);
   ok = PreLoopInitialize(enc);
   if (!ok) return 0;
 
-  if (max_count < MIN_COUNT) max_count = MIN_COUNT;
-
-  assert(enc->num_parts_ == 1);
   assert(enc->use_tokens_);
   assert(proba->use_skip_proba_ == 0);
   assert(rd_opt >= RD_OPT_BASIC);   // otherwise, token-buffer won't be useful
@@ -978,16 +1263,22 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
     const int is_last_pass = (fabs(stats.dq) <= DQ_LIMIT) ||
                              (num_pass_left == 0) ||
                              (enc->max_i4_header_bits_ == 0);
+    const int pass_row_step = is_last_pass ? 1 : row_step;
+    const int nb_mbs = GetNumSampledMBs(enc, total_mbs, pass_row_step);
+    const uint64_t pixel_count = (uint64_t)nb_mbs * 384;
+    // Roughly refresh the proba eight times per pass
+    const int max_count = (nb_mbs >> 3) < MIN_COUNT ? MIN_COUNT : nb_mbs >> 3;
     uint64_t size_p0 = 0;
     uint64_t distortion = 0;
     int cnt = max_count;
     VP8IteratorInit(enc, &it);
+    VP8IteratorSetCountDown(&it, nb_mbs);
     SetLoopParams(enc, stats.q);
     if (is_last_pass) {
       ResetTokenStats(enc);
       VP8InitFilter(&it);  // don't collect stats until last pass (too costly)
     }
-    VP8TBufferClear(&enc->tokens_);
+    for (p = 0; p < enc->num_parts_; ++p) VP8TBufferClear(&enc->tokens_[p]);
     do {
       VP8ModeScore info;
       VP8IteratorImport(&it, NULL);
@@ -997,7 +1288,7 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
         cnt = max_count;
       }
       VP8Decimate(&it, &info, rd_opt);
-      RecordTokens(&it, &info, &enc->tokens_);
+      RecordTokens(&it, &info, &enc->tokens_[it.y_ & (enc->num_parts_ - 1)]);
       size_p0 += info.H;
       distortion += info.D;
 #ifdef WEBP_EXPERIMENTAL_FEATURES
@@ -1006,20 +1297,24 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
       }
 #endif
       if (is_last_pass) {
-        StoreSideInfo(&it);
+        StoreSideInfo(&it, enc->sse_, &enc->sse_count_, enc->block_count_);
         VP8StoreFilterStats(&it);
         VP8IteratorExport(&it);
         ok = VP8IteratorProgress(&it, 20);
       }
       VP8IteratorSaveBoundary(&it);
-    } while (ok && VP8IteratorNext(&it));
+      if (!VP8IteratorNext(&it)) break;
+      SkipRows(&it, pass_row_step);
+    } while (ok);
     if (!ok) break;
 
+    size_p0 = ScaleSize(enc, size_p0, nb_mbs);
     size_p0 += enc->segment_hdr_.size_;
     if (stats.do_size_search) {
       uint64_t size = FinalizeTokenProbas(&enc->proba_);
-      size += VP8EstimateTokenSize(&enc->tokens_,
-                                   (const uint8_t*)proba->coeffs_);
+      const uint64_t tokens_size =
+          EstimatePartitionsSize(enc, (const uint8_t*)proba->coeffs_);
+      size += ScaleSize(enc, tokens_size, nb_mbs);
       size = (size + size_p0 + 1024) >> 11;  // -> size in bytes
       size += HEADER_SIZE_ESTIMATE;
       stats.value = (double)size;
@@ -1048,8 +1343,7 @@ int VP8EncTokenLoop(VP8Encoder* const enc) {
     if (!stats.do_size_search) {
       FinalizeTokenProbas(&enc->proba_);
     }
-    ok = VP8EmitTokens(&enc->tokens_, enc->parts_ + 0,
-                       (const uint8_t*)proba->coeffs_, 1);
+    ok = EmitPartitions(enc, (const uint8_t*)proba->coeffs_);
   }
   ok = ok && WebPReportProgress(enc->pic_, enc->percent_ + 20, &enc->percent_);
   return PostLoopFinalize(&it, ok);
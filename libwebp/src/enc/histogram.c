@@ -21,13 +21,33 @@
 #include "../dsp/lossless.h"
 #include "../utils/utils.h"
 
+// Types of codes, indexing VP8LHistogram's population_cost_[] and
+// trivial_symbol_[].
+enum { HISTO_LITERAL = 0, HISTO_RED, HISTO_BLUE, HISTO_ALPHA, HISTO_DISTANCE,
+       HISTO_NUM_TYPES };
+
+// Special values of trivial_symbol_[], besides the index of the only symbol
+// used.
+#define HISTO_EMPTY (-1)          // no symbol used
+#define HISTO_NON_TRIVIAL (-2)    // several symbols used
+
 static void HistogramClear(VP8LHistogram* const p) {
+  int i;
   memset(p->literal_, 0, sizeof(p->literal_));
   memset(p->red_, 0, sizeof(p->red_));
   memset(p->blue_, 0, sizeof(p->blue_));
   memset(p->alpha_, 0, sizeof(p->alpha_));
   memset(p->distance_, 0, sizeof(p->distance_));
   p->bit_cost_ = 0;
+  p->literal_cost_ = 0;
+  p->red_cost_ = 0;
+  p->blue_cost_ = 0;
+  // As bit_cost_, the cached costs are only valid after UpdateHistogramCost()
+  // or HistogramAddEval().
+  for (i = 0; i < HISTO_NUM_TYPES; ++i) {
+    p->population_cost_[i] = 0.;
+    p->trivial_symbol_[i] = HISTO_NON_TRIVIAL;
+  }
 }
 
 void VP8LHistogramStoreRefs(const VP8LBackwardRefs* const refs,
@@ -208,6 +228,49 @@ double VP8LHistogramEstimateBits(const VP8LHistogram* const p) {
        + ExtraCost(p->distance_, NUM_DISTANCE_CODES);
 }
 
+// Returns the only symbol used in 'population', or HISTO_EMPTY or
+// HISTO_NON_TRIVIAL.
+static int GetTrivialSymbol(const int* const population, int length) {
+  int symbol = HISTO_EMPTY;
+  int i;
+  for (i = 0; i < length; ++i) {
+    if (population[i] != 0) {
+      if (symbol != HISTO_EMPTY) return HISTO_NON_TRIVIAL;
+      symbol = i;
+    }
+  }
+  return symbol;
+}
+
+// Same as VP8LHistogramEstimateBits(), but also caches the dominant costs and
+// the population costs.
+static void UpdateHistogramCost(VP8LHistogram* const p) {
+  const int num_codes = VP8LHistogramNumCodes(p);
+  const double literal_cost = PopulationCost(p->literal_, num_codes);
+  const double alpha_cost = PopulationCost(p->alpha_, 256);
+  const double distance_cost = PopulationCost(p->distance_, NUM_DISTANCE_CODES);
+  const double literal_extra_cost =
+      ExtraCost(p->literal_ + 256, NUM_LENGTH_CODES);
+  p->red_cost_ = PopulationCost(p->red_, 256);
+  p->blue_cost_ = PopulationCost(p->blue_, 256);
+  p->literal_cost_ = literal_cost + literal_extra_cost;
+  // Summed in the same order as VP8LHistogramEstimateBits().
+  p->bit_cost_ = literal_cost + p->red_cost_ + p->blue_cost_ + alpha_cost
+               + distance_cost + literal_extra_cost
+               + ExtraCost(p->distance_, NUM_DISTANCE_CODES);
+  p->population_cost_[HISTO_LITERAL] = literal_cost;
+  p->population_cost_[HISTO_RED] = p->red_cost_;
+  p->population_cost_[HISTO_BLUE] = p->blue_cost_;
+  p->population_cost_[HISTO_ALPHA] = alpha_cost;
+  p->population_cost_[HISTO_DISTANCE] = distance_cost;
+  p->trivial_symbol_[HISTO_LITERAL] = GetTrivialSymbol(p->literal_, num_codes);
+  p->trivial_symbol_[HISTO_RED] = GetTrivialSymbol(p->red_, 256);
+  p->trivial_symbol_[HISTO_BLUE] = GetTrivialSymbol(p->blue_, 256);
+  p->trivial_symbol_[HISTO_ALPHA] = GetTrivialSymbol(p->alpha_, 256);
+  p->trivial_symbol_[HISTO_DISTANCE] =
+      GetTrivialSymbol(p->distance_, NUM_DISTANCE_CODES);
+}
+
 double VP8LHistogramEstimateBitsBulk(const VP8LHistogram* const p) {
   return BitsEntropy(p->literal_, VP8LHistogramNumCodes(p))
        + BitsEntropy(p->red_, 256)
@@ -224,18 +287,58 @@ double VP8LHistogramEstimateBitsBulk(const VP8LHistogram* const p) {
 // Adds 'in' histogram to 'out'
 static void HistogramAdd(const VP8LHistogram* const in,
                          VP8LHistogram* const out) {
-  int i;
-  for (i = 0; i < PIX_OR_COPY_CODES_MAX; ++i) {
-    out->literal_[i] += in->literal_[i];
+  VP8LAddVector(in->literal_, out->literal_, out->literal_,
+                PIX_OR_COPY_CODES_MAX);
+  VP8LAddVector(in->distance_, out->distance_, out->distance_,
+                NUM_DISTANCE_CODES);
+  VP8LAddVector(in->red_, out->red_, out->red_, 256);
+  VP8LAddVector(in->blue_, out->blue_, out->blue_, 256);
+  VP8LAddVector(in->alpha_, out->alpha_, out->alpha_, 256);
+}
+
+// Returns true if the population cost of the sum of the 'type' codes of 'a' and
+// 'b' is one of their cached costs, and stores it in '*cost'. This is the
+// case when one of them is empty, or when both use the same single symbol:
+// PopulationCost() doesn't depend on the count of a single symbol.
+static int GetCachedCombinedCost(const VP8LHistogram* const a,
+                                 const VP8LHistogram* const b, int type,
+                                 double* const cost) {
+  const int symbol_a = a->trivial_symbol_[type];
+  const int symbol_b = b->trivial_symbol_[type];
+  // The number of literal codes must match the one of the cached costs.
+  if (type == HISTO_LITERAL && a->palette_code_bits_ != b->palette_code_bits_) {
+    return 0;
+  }
+  if (symbol_b == HISTO_EMPTY ||
+      (symbol_a == symbol_b && symbol_a != HISTO_NON_TRIVIAL)) {
+    *cost = a->population_cost_[type];
+    return 1;
   }
-  for (i = 0; i < NUM_DISTANCE_CODES; ++i) {
-    out->distance_[i] += in->distance_[i];
+  if (symbol_a == HISTO_EMPTY) {
+    *cost = b->population_cost_[type];
+    return 1;
   }
-  for (i = 0; i < 256; ++i) {
-    out->red_[i] += in->red_[i];
-    out->blue_[i] += in->blue_[i];
-    out->alpha_[i] += in->alpha_[i];
+  return 0;
+}
+
+// Stores the population cost of 'out' = 'a' + 'b' for the 'type' codes, and
+// the symbol used if it's trivial. Returns this cost.
+static double UpdateCombinedCost(const VP8LHistogram* const a,
+                                 const VP8LHistogram* const b, int type,
+                                 const int* const population, int length,
+                                 VP8LHistogram* const out) {
+  const int symbol_a = a->trivial_symbol_[type];
+  const int symbol_b = b->trivial_symbol_[type];
+  double cost;
+  if (!GetCachedCombinedCost(a, b, type, &cost)) {
+    cost = PopulationCost(population, length);
   }
+  out->population_cost_[type] = cost;
+  out->trivial_symbol_[type] =
+      (symbol_a == HISTO_EMPTY) ? symbol_b :
+      (symbol_b == HISTO_EMPTY || symbol_a == symbol_b) ? symbol_a :
+      HISTO_NON_TRIVIAL;
+  return cost;
 }
 
 // Performs out = a + b, computing the cost C(a+b) - C(a) - C(b) while comparing
@@ -250,7 +353,6 @@ static double HistogramAddEval(const VP8LHistogram* const a,
                                double cost_threshold) {
   double cost = 0;
   const double sum_cost = a->bit_cost_ + b->bit_cost_;
-  int i;
 
   cost_threshold += sum_cost;
 
@@ -259,30 +361,29 @@ static double HistogramAddEval(const VP8LHistogram* const a,
   out->palette_code_bits_ =
       (a->palette_code_bits_ > b->palette_code_bits_) ? a->palette_code_bits_ :
                                                         b->palette_code_bits_;
-  for (i = 0; i < PIX_OR_COPY_CODES_MAX; ++i) {
-    out->literal_[i] = a->literal_[i] + b->literal_[i];
-  }
-  cost += PopulationCost(out->literal_, VP8LHistogramNumCodes(out));
+  VP8LAddVector(a->literal_, b->literal_, out->literal_, PIX_OR_COPY_CODES_MAX);
+  cost += UpdateCombinedCost(a, b, HISTO_LITERAL, out->literal_,
+                             VP8LHistogramNumCodes(out), out);
   cost += ExtraCost(out->literal_ + 256, NUM_LENGTH_CODES);
   if (cost > cost_threshold) return cost;
 
-  for (i = 0; i < 256; ++i) out->red_[i] = a->red_[i] + b->red_[i];
-  cost += PopulationCost(out->red_, 256);
+  VP8LAddVector(a->red_, b->red_, out->red_, 256);
+  cost += UpdateCombinedCost(a, b, HISTO_RED, out->red_, 256, out);
   if (cost > cost_threshold) return cost;
 
-  for (i = 0; i < 256; ++i) out->blue_[i] = a->blue_[i] + b->blue_[i];
-  cost += PopulationCost(out->blue_, 256);
+  VP8LAddVector(a->blue_, b->blue_, out->blue_, 256);
+  cost += UpdateCombinedCost(a, b, HISTO_BLUE, out->blue_, 256, out);
   if (cost > cost_threshold) return cost;
 
-  for (i = 0; i < NUM_DISTANCE_CODES; ++i) {
-    out->distance_[i] = a->distance_[i] + b->distance_[i];
-  }
-  cost += PopulationCost(out->distance_, NUM_DISTANCE_CODES);
+  VP8LAddVector(a->distance_, b->distance_, out->distance_,
+                NUM_DISTANCE_CODES);
+  cost += UpdateCombinedCost(a, b, HISTO_DISTANCE, out->distance_,
+                             NUM_DISTANCE_CODES, out);
   cost += ExtraCost(out->distance_, NUM_DISTANCE_CODES);
   if (cost > cost_threshold) return cost;
 
-  for (i = 0; i < 256; ++i) out->alpha_[i] = a->alpha_[i] + b->alpha_[i];
-  cost += PopulationCost(out->alpha_, 256);
+  VP8LAddVector(a->alpha_, b->alpha_, out->alpha_, 256);
+  cost += UpdateCombinedCost(a, b, HISTO_ALPHA, out->alpha_, 256, out);
 
   out->bit_cost_ = cost;
   return cost - sum_cost;
@@ -295,35 +396,47 @@ static double HistogramAddThresh(const VP8LHistogram* const a,
                                  const VP8LHistogram* const b,
                                  double cost_threshold) {
   int tmp[PIX_OR_COPY_CODES_MAX];  // <= max storage we'll need
-  int i;
   double cost = -a->bit_cost_;
+  double population_cost;
 
-  for (i = 0; i < PIX_OR_COPY_CODES_MAX; ++i) {
-    tmp[i] = a->literal_[i] + b->literal_[i];
-  }
+  VP8LAddVector(a->literal_, b->literal_, tmp, PIX_OR_COPY_CODES_MAX);
   // note that the tests are ordered so that the usually largest
   // cost shares come first.
-  cost += PopulationCost(tmp, VP8LHistogramNumCodes(a));
+  if (!GetCachedCombinedCost(a, b, HISTO_LITERAL, &population_cost)) {
+    population_cost = PopulationCost(tmp, VP8LHistogramNumCodes(a));
+  }
+  cost += population_cost;
   cost += ExtraCost(tmp + 256, NUM_LENGTH_CODES);
   if (cost > cost_threshold) return cost;
 
-  for (i = 0; i < 256; ++i) tmp[i] = a->red_[i] + b->red_[i];
-  cost += PopulationCost(tmp, 256);
+  // The other sums are only needed when their cost isn't cached.
+  if (!GetCachedCombinedCost(a, b, HISTO_RED, &population_cost)) {
+    VP8LAddVector(a->red_, b->red_, tmp, 256);
+    population_cost = PopulationCost(tmp, 256);
+  }
+  cost += population_cost;
   if (cost > cost_threshold) return cost;
 
-  for (i = 0; i < 256; ++i) tmp[i] = a->blue_[i] + b->blue_[i];
-  cost += PopulationCost(tmp, 256);
+  if (!GetCachedCombinedCost(a, b, HISTO_BLUE, &population_cost)) {
+    VP8LAddVector(a->blue_, b->blue_, tmp, 256);
+    population_cost = PopulationCost(tmp, 256);
+  }
+  cost += population_cost;
   if (cost > cost_threshold) return cost;
 
-  for (i = 0; i < NUM_DISTANCE_CODES; ++i) {
-    tmp[i] = a->distance_[i] + b->distance_[i];
+  VP8LAddVector(a->distance_, b->distance_, tmp, NUM_DISTANCE_CODES);
+  if (!GetCachedCombinedCost(a, b, HISTO_DISTANCE, &population_cost)) {
+    population_cost = PopulationCost(tmp, NUM_DISTANCE_CODES);
   }
-  cost += PopulationCost(tmp, NUM_DISTANCE_CODES);
+  cost += population_cost;
   cost += ExtraCost(tmp, NUM_DISTANCE_CODES);
   if (cost > cost_threshold) return cost;
 
-  for (i = 0; i < 256; ++i) tmp[i] = a->alpha_[i] + b->alpha_[i];
-  cost += PopulationCost(tmp, 256);
+  if (!GetCachedCombinedCost(a, b, HISTO_ALPHA, &population_cost)) {
+    VP8LAddVector(a->alpha_, b->alpha_, tmp, 256);
+    population_cost = PopulationCost(tmp, 256);
+  }
+  cost += population_cost;
 
   return cost;
 }
@@ -350,6 +463,113 @@ static void HistogramBuildImage(int xsize, int histo_bits,
   }
 }
 
+// -----------------------------------------------------------------------------
+// Entropy-binned pre-clustering
+
+// The range of the literal, red and blue costs is split into NUM_PARTITIONS
+// intervals each, giving BIN_SIZE bins. Histograms falling into the same bin
+// are likely to combine well, and are merged without any search.
+#define NUM_PARTITIONS 4
+#define BIN_SIZE (NUM_PARTITIONS * NUM_PARTITIONS * NUM_PARTITIONS)
+
+typedef struct {
+  double literal_max_;
+  double literal_min_;
+  double red_max_;
+  double red_min_;
+  double blue_max_;
+  double blue_min_;
+} DominantCostRange;
+
+static void DominantCostRangeInit(DominantCostRange* const c) {
+  c->literal_max_ = 0.;
+  c->literal_min_ = 1.e38;
+  c->red_max_ = 0.;
+  c->red_min_ = 1.e38;
+  c->blue_max_ = 0.;
+  c->blue_min_ = 1.e38;
+}
+
+static void UpdateDominantCostRange(const VP8LHistogram* const h,
+                                    DominantCostRange* const c) {
+  if (c->literal_max_ < h->literal_cost_) c->literal_max_ = h->literal_cost_;
+  if (c->literal_min_ > h->literal_cost_) c->literal_min_ = h->literal_cost_;
+  if (c->red_max_ < h->red_cost_) c->red_max_ = h->red_cost_;
+  if (c->red_min_ > h->red_cost_) c->red_min_ = h->red_cost_;
+  if (c->blue_max_ < h->blue_cost_) c->blue_max_ = h->blue_cost_;
+  if (c->blue_min_ > h->blue_cost_) c->blue_min_ = h->blue_cost_;
+}
+
+static int GetBinIdForEntropy(double min, double max, double val) {
+  const double range = max - min + 1e-6;
+  const double delta = val - min;
+  return (int)(NUM_PARTITIONS * delta / range);
+}
+
+static int GetHistoBinIndex(const VP8LHistogram* const h,
+                            const DominantCostRange* const c) {
+  const int bin_id =
+      GetBinIdForEntropy(c->blue_min_, c->blue_max_, h->blue_cost_) +
+      NUM_PARTITIONS * GetBinIdForEntropy(c->red_min_, c->red_max_,
+                                          h->red_cost_) +
+      NUM_PARTITIONS * NUM_PARTITIONS *
+          GetBinIdForEntropy(c->literal_min_, c->literal_max_,
+                             h->literal_cost_);
+  assert(bin_id < BIN_SIZE);
+  return bin_id;
+}
+
+// Minimal fraction of the cost of a histogram that merging it into its bin
+// must save. The more histograms, the more aggressive the merging.
+static double GetCombineCostFactor(int histo_size) {
+  double combine_cost_factor = 0.08;
+  if (histo_size > 256) combine_cost_factor /= 2.;
+  if (histo_size > 512) combine_cost_factor /= 2.;
+  if (histo_size > 1024) combine_cost_factor /= 2.;
+  return combine_cost_factor;
+}
+
+// Merges the histograms of 'set' into the first one of their bin when this
+// saves enough bits, and compacts the set. bit_cost_ and the dominant costs
+// must be up-to-date.
+static void HistogramCombineEntropyBin(VP8LHistogramSet* const set,
+                                       VP8LHistogram* const cur_combo,
+                                       double combine_cost_factor) {
+  int bin_first[BIN_SIZE];   // position of the first histogram of each bin
+  DominantCostRange cost_range;
+  int i, size = 0;
+
+  DominantCostRangeInit(&cost_range);
+  for (i = 0; i < set->size; ++i) {
+    UpdateDominantCostRange(set->histograms[i], &cost_range);
+  }
+  for (i = 0; i < BIN_SIZE; ++i) bin_first[i] = -1;
+
+  for (i = 0; i < set->size; ++i) {
+    VP8LHistogram* const histo = set->histograms[i];
+    const int bin_id = GetHistoBinIndex(histo, &cost_range);
+    if (bin_first[bin_id] >= 0) {
+      VP8LHistogram* const first = set->histograms[bin_first[bin_id]];
+      const double bit_cost_thresh = -histo->bit_cost_ * combine_cost_factor;
+      const double curr_cost_diff =
+          HistogramAddEval(first, histo, cur_combo, bit_cost_thresh);
+      if (curr_cost_diff < bit_cost_thresh) {
+        *first = *cur_combo;
+        continue;   // 'histo' is dropped from the set.
+      }
+    } else {
+      bin_first[bin_id] = size;
+    }
+    set->histograms[size++] = histo;
+  }
+  for (i = size; i < set->size; ++i) {
+    set->histograms[i] = NULL;   // just for sanity check.
+  }
+  set->size = size;
+}
+
+// -----------------------------------------------------------------------------
+
 static uint32_t MyRand(uint32_t *seed) {
   *seed *= 16807U;
   if (*seed == 0) {
@@ -358,14 +578,17 @@ static uint32_t MyRand(uint32_t *seed) {
   return *seed;
 }
 
+// If 'combine_cost_factor' is positive, the histograms are first merged by
+// entropy bin (see HistogramCombineEntropyBin()).
 static int HistogramCombine(const VP8LHistogramSet* const in,
                             VP8LHistogramSet* const out, int iter_mult,
-                            int num_pairs, int num_tries_no_success) {
+                            int num_pairs, int num_tries_no_success,
+                            double combine_cost_factor) {
   int ok = 0;
   int i, iter;
   uint32_t seed = 0;
   int tries_with_no_success = 0;
-  int out_size = in->size;
+  int out_size;
   const int outer_iters = in->size * iter_mult;
   const int min_cluster_size = 2;
   VP8LHistogram* const histos = (VP8LHistogram*)malloc(2 * sizeof(*histos));
@@ -376,9 +599,14 @@ static int HistogramCombine(const VP8LHistogramSet* const in,
   // Copy histograms from in[] to out[].
   assert(in->size <= out->size);
   for (i = 0; i < in->size; ++i) {
-    in->histograms[i]->bit_cost_ = VP8LHistogramEstimateBits(in->histograms[i]);
+    UpdateHistogramCost(in->histograms[i]);
     *out->histograms[i] = *in->histograms[i];
   }
+  out->size = in->size;
+  if (combine_cost_factor > 0.) {
+    HistogramCombineEntropyBin(out, cur_combo, combine_cost_factor);
+  }
+  out_size = out->size;
 
   // Collapse similar histograms in 'out'.
   for (iter = 0; iter < outer_iters && out_size >= min_cluster_size; ++iter) {
@@ -487,6 +715,12 @@ int VP8LGetHistoImageSymbols(int xsize, int ysize,
   const int histo_image_raw_size = histo_xsize * histo_ysize;
 
   // Heuristic params for HistogramCombine().
+  // The entropy-binned pre-clustering trades some compression for speed: it
+  // is only used by the fast (quality < 25) encodings, and only when there
+  // are enough histograms for it to pay off.
+  const double combine_cost_factor =
+      (histo_image_raw_size > 2 * BIN_SIZE && quality < 25) ?
+          GetCombineCostFactor(histo_image_raw_size) : 0.;
   const int num_tries_no_success = 8 + (quality >> 1);
   const int iter_mult = (quality < 27) ? 1 : 1 + ((quality - 27) >> 4);
   const int num_pairs = (quality < 25) ? 10 : (5 * quality) >> 3;
@@ -499,7 +733,7 @@ int VP8LGetHistoImageSymbols(int xsize, int ysize,
   HistogramBuildImage(xsize, histo_bits, refs, image_out);
   // Collapse similar histograms.
   if (!HistogramCombine(image_out, image_in, iter_mult, num_pairs,
-                        num_tries_no_success)) {
+                        num_tries_no_success, combine_cost_factor)) {
     goto Error;
   }
   // Find the optimal map from original histograms to the final ones.
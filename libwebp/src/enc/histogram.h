@@ -40,6 +40,14 @@ typedef struct {
   int distance_[NUM_DISTANCE_CODES];
   int palette_code_bits_;
   double bit_cost_;   // cached value of VP8LHistogramEstimateBits(this)
+  double literal_cost_;   // Cached values of dominant entropy costs:
+  double red_cost_;       // literal, red & blue.
+  double blue_cost_;
+  // Cached population costs of the literal, red, blue, alpha and distance
+  // codes, and for each of them: the only symbol used, or HISTO_EMPTY or
+  // HISTO_NON_TRIVIAL (see histogram.c).
+  double population_cost_[5];
+  int trivial_symbol_[5];
 } VP8LHistogram;
 
 // Collection of histograms with fixed capacity, allocated as one
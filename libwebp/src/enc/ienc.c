@@ -0,0 +1,404 @@
+// Copyright 2014 Google Inc. All Rights Reserved.
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the COPYING file in the root of the source
+// tree. An additional intellectual property rights grant can be found
+// in the file PATENTS. All contributing project authors may
+// be found in the AUTHORS file in the root of the source tree.
+// -----------------------------------------------------------------------------
+//
+// Incremental encoding
+//
+// Author: Skal (pascal.massimino@gmail.com)
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./vp8enci.h"
+#include "../utils/utils.h"
+
+// Number of macroblocks we'd like the first rows to hold, for the analysis
+// and the token statistics to be meaningful.
+#define MIN_FIRST_MBS 1024
+#define MAX_FIRST_ROWS 16   // maximum number of first macroblock rows
+
+//------------------------------------------------------------------------------
+// Data structures
+
+// Encoding states. State normally flows as:
+// FIRST_ROWS->ROWS->DONE
+// The first macroblock rows are buffered, and analyzed and coded all together
+// once they are available. The next ones are then coded one by one, reusing
+// the top of the window of samples.
+// If there is any error the encoder goes into state ERROR.
+typedef enum {
+  STATE_FIRST_ROWS,
+  STATE_ROWS,
+  STATE_DONE,
+  STATE_ERROR
+} EncState;
+
+struct WebPIEncoder {
+  EncState state_;               // current encoding state
+  WebPConfig config_;            // private copy of the configuration
+  WebPPicture* pic_;             // user's picture, holding the window planes
+  VP8Encoder* enc_;
+  VP8EncIterator it_;            // coding iterator
+  VP8EncIterator analysis_it_;   // analysis iterator, for the next rows
+  int num_first_rows_;           // macroblock rows analyzed together
+  int num_rows_;                 // number of rows of samples imported so far
+
+  uint8_t* mem_;                 // window of YUV samples, plus scratch rows
+  uint8_t* pending_;             // RGBA row waiting for the next one
+  int has_pending_;
+  uint16_t* tmp_rgb_;            // scratch area for VP8ImportRGBRows()
+  uint8_t* alpha_;               // full alpha plane, if any transparency
+};
+
+static int SetError(WebPIEncoder* const ienc, WebPEncodingError error) {
+  ienc->state_ = STATE_ERROR;
+  return WebPEncodingSetError(ienc->pic_, error);
+}
+
+//------------------------------------------------------------------------------
+// Coding
+
+static int CodeRows(WebPIEncoder* const ienc) {
+  VP8Encoder* const enc = ienc->enc_;
+  const int mb_y = (ienc->num_rows_ - 1) >> 4;   // last complete row
+  int ok = 1;
+  if (ienc->state_ == STATE_FIRST_ROWS) {
+    const int num_rows = mb_y + 1;
+    int y;
+    if (num_rows < ienc->num_first_rows_) return 1;   // need more rows
+    ok = VP8EncAnalyzeFirstRows(enc, num_rows);
+    if (ok) {
+      VP8IteratorInit(enc, &ienc->analysis_it_);
+      ok = VP8EncStartRowLoop(enc, &ienc->it_, num_rows);
+    }
+    for (y = 0; ok && y < num_rows; ++y) {
+      ok = VP8EncCodeRow(&ienc->it_);
+    }
+    ienc->state_ = STATE_ROWS;
+  } else {
+    VP8EncAnalyzeRow(&ienc->analysis_it_, mb_y);
+    ok = VP8EncCodeRow(&ienc->it_);
+  }
+  if (!ok) {
+    // the error code is already set, unless the memory went short.
+    if (ienc->pic_->error_code == VP8_ENC_OK) {
+      WebPEncodingSetError(ienc->pic_, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    }
+    ienc->state_ = STATE_ERROR;
+  }
+  return ok;
+}
+
+// Moves the window down to macroblock row 'mb_y', keeping the last row of
+// samples above it, which the analysis needs.
+static void ShiftWindow(WebPIEncoder* const ienc, int mb_y) {
+  const WebPPicture* const pic = ienc->pic_;
+  VP8Encoder* const enc = ienc->enc_;
+  const int y_last = 16 * (mb_y - enc->row_offset_) - 1;
+  const int uv_last = 8 * (mb_y - enc->row_offset_) - 1;
+  memcpy(pic->y - pic->y_stride, pic->y + y_last * pic->y_stride, pic->width);
+  memcpy(pic->u - pic->uv_stride, pic->u + uv_last * pic->uv_stride,
+         pic->uv_stride);
+  memcpy(pic->v - pic->uv_stride, pic->v + uv_last * pic->uv_stride,
+         pic->uv_stride);
+  enc->row_offset_ = mb_y;
+}
+
+//------------------------------------------------------------------------------
+// Import
+
+static int ImportAlpha(WebPIEncoder* const ienc, const uint8_t* const a_ptr,
+                       int step, int rgb_stride, int num_rows) {
+  const WebPPicture* const pic = ienc->pic_;
+  const int width = pic->width;
+  uint8_t* dst;
+  int x, y;
+  if (ienc->alpha_ == NULL) {
+    int has_alpha = 0;
+    for (y = 0; y < num_rows && !has_alpha; ++y) {
+      for (x = 0; x < width; ++x) {
+        if (a_ptr[step * x + y * rgb_stride] != 0xff) {
+          has_alpha = 1;
+          break;
+        }
+      }
+    }
+    if (!has_alpha) return 1;
+    ienc->alpha_ =
+        (uint8_t*)WebPSafeMalloc((uint64_t)width * pic->height, sizeof(*dst));
+    if (ienc->alpha_ == NULL) {
+      return SetError(ienc, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    }
+    memset(ienc->alpha_, 0xff, (size_t)width * pic->height);
+  }
+  dst = ienc->alpha_ + (size_t)ienc->num_rows_ * width;
+  for (y = 0; y < num_rows; ++y) {
+    for (x = 0; x < width; ++x) {
+      dst[x] = a_ptr[step * x + y * rgb_stride];
+    }
+    dst += width;
+  }
+  return 1;
+}
+
+// Imports a pair of rows, or a last single one if 'rgb_stride' is 0, and codes
+// the macroblock row they complete, if any.
+static int ImportRows(WebPIEncoder* const ienc,
+                      const uint8_t* const rgb, int rgb_stride,
+                      int step, int swap_rb, int import_alpha) {
+  const WebPPicture* const pic = ienc->pic_;
+  VP8Encoder* const enc = ienc->enc_;
+  const uint8_t* const r_ptr = rgb + (swap_rb ? 2 : 0);
+  const uint8_t* const g_ptr = rgb + 1;
+  const uint8_t* const b_ptr = rgb + (swap_rb ? 0 : 2);
+  const int num_rows = (rgb_stride != 0) ? 2 : 1;
+  int row;
+
+  assert((ienc->num_rows_ & 1) == 0);
+  if (ienc->state_ == STATE_ROWS && (ienc->num_rows_ & 15) == 0) {
+    ShiftWindow(ienc, ienc->num_rows_ >> 4);
+  }
+  row = ienc->num_rows_ - 16 * enc->row_offset_;   // position in the window
+  VP8ImportRGBRows(r_ptr, g_ptr, b_ptr, step, rgb_stride, pic->width,
+                   pic->y + row * pic->y_stride, pic->y_stride,
+                   pic->u + (row >> 1) * pic->uv_stride,
+                   pic->v + (row >> 1) * pic->uv_stride, ienc->tmp_rgb_);
+  if (import_alpha &&
+      !ImportAlpha(ienc, rgb + 3, step, rgb_stride, num_rows)) {
+    return 0;
+  }
+  ienc->num_rows_ += num_rows;
+  if ((ienc->num_rows_ & 15) == 0 || ienc->num_rows_ == pic->height) {
+    return CodeRows(ienc);
+  }
+  return 1;
+}
+
+// Stores one row in 'dst' as RGBA.
+static void CopyRow(const uint8_t* const rgb, int step, int swap_rb,
+                    int import_alpha, int width, uint8_t* dst) {
+  int x;
+  for (x = 0; x < width; ++x) {
+    const uint8_t* const src = rgb + step * x;
+    dst[0] = src[swap_rb ? 2 : 0];
+    dst[1] = src[1];
+    dst[2] = src[swap_rb ? 0 : 2];
+    dst[3] = import_alpha ? src[3] : 0xff;
+    dst += 4;
+  }
+}
+
+static int Append(WebPIEncoder* const ienc,
+                  const uint8_t* rgb, int rgb_stride, int num_rows,
+                  int step, int swap_rb, int import_alpha) {
+  const WebPPicture* pic;
+  int width, height;
+  if (ienc == NULL) return 0;
+  pic = ienc->pic_;
+  width = pic->width;
+  height = pic->height;
+  if (ienc->state_ == STATE_ERROR || ienc->state_ == STATE_DONE) return 0;
+  if (rgb == NULL && num_rows > 0) {
+    return SetError(ienc, VP8_ENC_ERROR_NULL_PARAMETER);
+  }
+  if (num_rows < 0 ||
+      num_rows > height - ienc->num_rows_ - ienc->has_pending_) {
+    return SetError(ienc, VP8_ENC_ERROR_BAD_DIMENSION);
+  }
+
+  while (num_rows > 0) {
+    int ok;
+    if (ienc->has_pending_) {
+      // Complete the pair with the first row.
+      uint8_t* const next = ienc->pending_ + 4 * width;
+      CopyRow(rgb, step, swap_rb, import_alpha, width, next);
+      ienc->has_pending_ = 0;
+      ok = ImportRows(ienc, ienc->pending_, 4 * width, 4, 0, 1);
+      rgb += rgb_stride;
+      num_rows -= 1;
+    } else if (ienc->num_rows_ + 1 == height) {   // last single row
+      ok = ImportRows(ienc, rgb, 0, step, swap_rb, import_alpha);
+      num_rows -= 1;
+    } else if (num_rows == 1) {   // keep it until the next call
+      CopyRow(rgb, step, swap_rb, import_alpha, width, ienc->pending_);
+      ienc->has_pending_ = 1;
+      ok = 1;
+      num_rows -= 1;
+    } else {
+      ok = ImportRows(ienc, rgb, rgb_stride, step, swap_rb, import_alpha);
+      rgb += 2 * rgb_stride;
+      num_rows -= 2;
+    }
+    if (!ok) return 0;
+  }
+  return 1;
+}
+
+//------------------------------------------------------------------------------
+// Public functions
+
+WebPIEncoder* WebPINewEncoder(const WebPConfig* config, WebPPicture* picture) {
+  WebPIEncoder* ienc;
+  int mb_w, mb_h, num_first_rows;
+  int y_stride, uv_stride, y_lines, uv_lines;
+  uint64_t size;
+  uint8_t* mem;
+
+  if (picture == NULL) return NULL;
+  WebPEncodingSetError(picture, VP8_ENC_OK);  // all ok so far
+  if (config == NULL) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_NULL_PARAMETER);
+    return NULL;
+  }
+  if (!WebPValidateConfig(config) || config->lossless) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_INVALID_CONFIGURATION);
+    return NULL;
+  }
+  if (picture->width <= 0 || picture->height <= 0 ||
+      picture->width > WEBP_MAX_DIMENSION ||
+      picture->height > WEBP_MAX_DIMENSION) {
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_BAD_DIMENSION);
+    return NULL;
+  }
+
+  // The window holds the first macroblock rows, and one more row of samples
+  // above them (see ShiftWindow()).
+  mb_w = (picture->width + 15) >> 4;
+  mb_h = (picture->height + 15) >> 4;
+  num_first_rows = (MIN_FIRST_MBS + mb_w - 1) / mb_w;
+  if (num_first_rows > MAX_FIRST_ROWS) num_first_rows = MAX_FIRST_ROWS;
+  if (num_first_rows > mb_h) num_first_rows = mb_h;
+  y_stride = picture->width;
+  uv_stride = (picture->width + 1) >> 1;
+  y_lines = 16 * num_first_rows + 1;
+  uv_lines = 8 * num_first_rows + 1;
+  size = 3ULL * uv_stride * sizeof(uint16_t)      // tmp_rgb_
+       + (uint64_t)y_stride * y_lines + 2ULL * uv_stride * uv_lines
+       + 2ULL * 4 * picture->width;                // pending_ RGBA rows
+
+  ienc = (WebPIEncoder*)WebPSafeCalloc(1ULL, sizeof(*ienc));
+  mem = (uint8_t*)WebPSafeMalloc(size, sizeof(*mem));
+  if (ienc == NULL || mem == NULL) {
+    free(ienc);
+    free(mem);
+    WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    return NULL;
+  }
+  ienc->mem_ = mem;
+  ienc->state_ = STATE_FIRST_ROWS;
+  ienc->pic_ = picture;
+  ienc->num_first_rows_ = num_first_rows;
+
+  ienc->tmp_rgb_ = (uint16_t*)mem;
+  mem += 3 * uv_stride * sizeof(uint16_t);
+  // The picture's planes point into the window.
+  picture->use_argb = 0;
+  picture->colorspace = WEBP_YUV420;
+  picture->y = mem + y_stride;
+  picture->y_stride = y_stride;
+  mem += y_stride * y_lines;
+  picture->u = mem + uv_stride;
+  mem += uv_stride * uv_lines;
+  picture->v = mem + uv_stride;
+  mem += uv_stride * uv_lines;
+  picture->uv_stride = uv_stride;
+  picture->a = NULL;
+  picture->a_stride = 0;
+  ienc->pending_ = mem;
+
+  // Rows can't be coded in parallel, neither can the whole picture be
+  // searched for a target size: adjust the configuration accordingly.
+  ienc->config_ = *config;
+  ienc->config_.low_memory = 1;
+  ienc->config_.target_size = 0;
+  ienc->config_.target_PSNR = 0.f;
+  ienc->config_.preprocessing &= ~2;   // no dithering
+
+  if (picture->stats != NULL) {
+    memset(picture->stats, 0, sizeof(*picture->stats));
+  }
+  ienc->enc_ = VP8EncoderNew(&ienc->config_, picture);
+  if (ienc->enc_ == NULL) {   // picture->error_code is already set.
+    WebPIEncoderDelete(ienc);
+    return NULL;
+  }
+  VP8InitImportRGBRows();
+  return ienc;
+}
+
+int WebPIEncodeRGB(WebPIEncoder* ienc,
+                   const uint8_t* rgb, int stride, int num_rows) {
+  return Append(ienc, rgb, stride, num_rows, 3, 0, 0);
+}
+
+int WebPIEncodeBGR(WebPIEncoder* ienc,
+                   const uint8_t* bgr, int stride, int num_rows) {
+  return Append(ienc, bgr, stride, num_rows, 3, 1, 0);
+}
+
+int WebPIEncodeRGBA(WebPIEncoder* ienc,
+                    const uint8_t* rgba, int stride, int num_rows) {
+  return Append(ienc, rgba, stride, num_rows, 4, 0, 1);
+}
+
+int WebPIEncodeBGRA(WebPIEncoder* ienc,
+                    const uint8_t* bgra, int stride, int num_rows) {
+  return Append(ienc, bgra, stride, num_rows, 4, 1, 1);
+}
+
+int WebPIEncodeFinish(WebPIEncoder* ienc) {
+  WebPPicture* pic;
+  VP8Encoder* enc;
+  int ok;
+  if (ienc == NULL) return 0;
+  pic = ienc->pic_;
+  enc = ienc->enc_;
+  if (ienc->state_ == STATE_ERROR || ienc->state_ == STATE_DONE) return 0;
+  if (ienc->num_rows_ < pic->height) {
+    return SetError(ienc, VP8_ENC_ERROR_BAD_DIMENSION);
+  }
+  assert(ienc->state_ == STATE_ROWS);
+
+  ok = VP8EncFinishRowLoop(&ienc->it_, 1);
+  if (ok && ienc->alpha_ != NULL) {
+    pic->a = ienc->alpha_;
+    pic->a_stride = pic->width;
+    pic->colorspace |= WEBP_CSP_ALPHA_BIT;
+    VP8EncInitAlpha(enc);
+    ok = VP8EncStartAlpha(enc);
+  }
+  ok = ok && VP8EncFinishAlpha(enc);
+  ok = ok && VP8EncWrite(enc);
+  VP8EncStoreStats(enc);
+  if (!ok) {
+    VP8EncFreeBitWriters(enc);
+    if (pic->error_code == VP8_ENC_OK) {
+      WebPEncodingSetError(pic, VP8_ENC_ERROR_OUT_OF_MEMORY);
+    }
+  }
+  ienc->state_ = ok ? STATE_DONE : STATE_ERROR;
+  return ok;
+}
+
+void WebPIEncoderDelete(WebPIEncoder* ienc) {
+  if (ienc != NULL) {
+    WebPPicture* const pic = ienc->pic_;
+    if (ienc->enc_ != NULL) {
+      VP8EncFreeBitWriters(ienc->enc_);
+      VP8EncoderDelete(ienc->enc_);
+    }
+    pic->y = pic->u = pic->v = pic->a = NULL;
+    pic->y_stride = pic->uv_stride = pic->a_stride = 0;
+    free(ienc->alpha_);
+    free(ienc->mem_);
+    free(ienc);
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -127,10 +127,11 @@ static void ImportLine(const uint8_t* src, int src_stride,
 void VP8IteratorImport(VP8EncIterator* const it, uint8_t* tmp_32) {
   const VP8Encoder* const enc = it->enc_;
   const int x = it->x_, y = it->y_;
+  const int row = y - enc->row_offset_;   // row position in the planes
   const WebPPicture* const pic = enc->pic_;
-  const uint8_t* const ysrc = pic->y + (y * pic->y_stride  + x) * 16;
-  const uint8_t* const usrc = pic->u + (y * pic->uv_stride + x) * 8;
-  const uint8_t* const vsrc = pic->v + (y * pic->uv_stride + x) * 8;
+  const uint8_t* const ysrc = pic->y + (row * pic->y_stride  + x) * 16;
+  const uint8_t* const usrc = pic->u + (row * pic->uv_stride + x) * 8;
+  const uint8_t* const vsrc = pic->v + (row * pic->uv_stride + x) * 8;
   const int w = MinSize(pic->width - x * 16, 16);
   const int h = MinSize(pic->height - y * 16, 16);
   const int uv_w = (w + 1) >> 1;
@@ -185,13 +186,14 @@ void VP8IteratorExport(const VP8EncIterator* const it) {
   const VP8Encoder* const enc = it->enc_;
   if (enc->config_->show_compressed) {
     const int x = it->x_, y = it->y_;
+    const int row = y - enc->row_offset_;
     const uint8_t* const ysrc = it->yuv_out_ + Y_OFF;
     const uint8_t* const usrc = it->yuv_out_ + U_OFF;
     const uint8_t* const vsrc = it->yuv_out_ + V_OFF;
     const WebPPicture* const pic = enc->pic_;
-    uint8_t* const ydst = pic->y + (y * pic->y_stride + x) * 16;
-    uint8_t* const udst = pic->u + (y * pic->uv_stride + x) * 8;
-    uint8_t* const vdst = pic->v + (y * pic->uv_stride + x) * 8;
+    uint8_t* const ydst = pic->y + (row * pic->y_stride + x) * 16;
+    uint8_t* const udst = pic->u + (row * pic->uv_stride + x) * 8;
+    uint8_t* const vdst = pic->v + (row * pic->uv_stride + x) * 8;
     int w = (pic->width - x * 16);
     int h = (pic->height - y * 16);
 
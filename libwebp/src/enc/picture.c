@@ -697,6 +697,82 @@ static WEBP_INLINE int LinearToGamma(uint32_t base_value, int shift) {
   picture->v0[dst] = RGBToV(r, g, b, &rg);               \
 }
 
+// Stores the gamma-corrected sums of the r/g/b samples of each 2x2 block of
+// a pair of rows, in dst_r/g/b[]. 'rgb_stride' is 0 for a last, single row.
+// The sums of the right-most, odd column and of a single row are computed
+// by duplicating the samples, which is exactly SUM2V(), SUM2H() and SUM1().
+static void AccumulateRGB(const uint8_t* const r_ptr,
+                          const uint8_t* const g_ptr,
+                          const uint8_t* const b_ptr,
+                          int step, int rgb_stride,
+                          uint16_t* const dst_r, uint16_t* const dst_g,
+                          uint16_t* const dst_b, int width) {
+  int i, j;
+  for (i = 0, j = 0; i < (width >> 1); ++i, j += 2 * step) {
+    dst_r[i] = SUM4(r_ptr + j);
+    dst_g[i] = SUM4(g_ptr + j);
+    dst_b[i] = SUM4(b_ptr + j);
+  }
+  if (width & 1) {
+    dst_r[i] = SUM2V(r_ptr + j);
+    dst_g[i] = SUM2V(g_ptr + j);
+    dst_b[i] = SUM2V(b_ptr + j);
+  }
+}
+
+void VP8InitImportRGBRows(void) {
+  InitGammaTables();
+  WebPInitConvertRGBToYUV();
+}
+
+void VP8ImportRGBRows(const uint8_t* const r_ptr, const uint8_t* const g_ptr,
+                      const uint8_t* const b_ptr, int step, int rgb_stride,
+                      int width, uint8_t* const y_dst, int y_stride,
+                      uint8_t* const u_dst, uint8_t* const v_dst,
+                      uint16_t* const tmp_rgb) {
+  const int uv_width = HALVE(width);
+  uint16_t* const tmp_r = tmp_rgb;
+  uint16_t* const tmp_g = tmp_rgb + uv_width;
+  uint16_t* const tmp_b = tmp_rgb + 2 * uv_width;
+  WebPConvertRGBToY(r_ptr, g_ptr, b_ptr, step, y_dst, width);
+  if (rgb_stride != 0) {
+    WebPConvertRGBToY(r_ptr + rgb_stride, g_ptr + rgb_stride,
+                      b_ptr + rgb_stride, step, y_dst + y_stride, width);
+  }
+  AccumulateRGB(r_ptr, g_ptr, b_ptr, step, rgb_stride,
+                tmp_r, tmp_g, tmp_b, width);
+  WebPConvertRGBToUV(tmp_r, tmp_g, tmp_b, u_dst, v_dst, uv_width);
+}
+
+// Non-dithered conversion, using the dsp row converters.
+static int ImportYUVFromRGBRows(const uint8_t* const r_ptr,
+                                const uint8_t* const g_ptr,
+                                const uint8_t* const b_ptr,
+                                int step, int rgb_stride,
+                                WebPPicture* const picture) {
+  const int width = picture->width;
+  const int height = picture->height;
+  uint16_t* const tmp_rgb =
+      (uint16_t*)WebPSafeMalloc(3ULL * HALVE(width), sizeof(*tmp_rgb));
+  int y;
+
+  if (tmp_rgb == NULL) {
+    return WebPEncodingSetError(picture, VP8_ENC_ERROR_OUT_OF_MEMORY);
+  }
+  VP8InitImportRGBRows();
+  for (y = 0; y < height; y += 2) {
+    const int offset = y * rgb_stride;
+    const int stride = (y + 1 < height) ? rgb_stride : 0;
+    VP8ImportRGBRows(r_ptr + offset, g_ptr + offset, b_ptr + offset,
+                     step, stride, width,
+                     picture->y + y * picture->y_stride, picture->y_stride,
+                     picture->u + (y >> 1) * picture->uv_stride,
+                     picture->v + (y >> 1) * picture->uv_stride, tmp_rgb);
+  }
+  free(tmp_rgb);
+  return 1;
+}
+
 static void MakeGray(WebPPicture* const picture) {
   int y;
   const int uv_width = HALVE(picture->width);
@@ -732,56 +808,64 @@ static int ImportYUVAFromRGBA(const uint8_t* const r_ptr,
   VP8InitRandom(&rg, dithering);
   InitGammaTables();
 
-  // Import luma plane
-  for (y = 0; y < height; ++y) {
-    for (x = 0; x < width; ++x) {
-      const int offset = step * x + y * rgb_stride;
-      picture->y[x + y * picture->y_stride] =
-          RGBToY(r_ptr[offset], g_ptr[offset], b_ptr[offset], &rg);
-    }
-  }
-
-  // Downsample U/V plane
-  if (uv_csp != WEBP_YUV400) {
-    for (y = 0; y < (height >> 1); ++y) {
-      for (x = 0; x < (width >> 1); ++x) {
-        RGB_TO_UV(x, y, SUM4);
-      }
-      if (width & 1) {
-        RGB_TO_UV(x, y, SUM2V);
-      }
+  if (dithering <= 0.f) {
+    if (!ImportYUVFromRGBRows(r_ptr, g_ptr, b_ptr, step, rgb_stride,
+                              picture)) {
+      return 0;
     }
-    if (height & 1) {
-      for (x = 0; x < (width >> 1); ++x) {
-        RGB_TO_UV(x, y, SUM2H);
-      }
-      if (width & 1) {
-        RGB_TO_UV(x, y, SUM1);
+  } else {
+    // Import luma plane
+    for (y = 0; y < height; ++y) {
+      for (x = 0; x < width; ++x) {
+        const int offset = step * x + y * rgb_stride;
+        picture->y[x + y * picture->y_stride] =
+            RGBToY(r_ptr[offset], g_ptr[offset], b_ptr[offset], &rg);
       }
     }
 
-#ifdef WEBP_EXPERIMENTAL_FEATURES
-    // Store original U/V samples too
-    if (uv_csp == WEBP_YUV422) {
-      for (y = 0; y < height; ++y) {
+    // Downsample U/V plane
+    if (uv_csp != WEBP_YUV400) {
+      for (y = 0; y < (height >> 1); ++y) {
         for (x = 0; x < (width >> 1); ++x) {
-          RGB_TO_UV0(2 * x, x, y, SUM2H);
+          RGB_TO_UV(x, y, SUM4);
         }
         if (width & 1) {
-          RGB_TO_UV0(2 * x, x, y, SUM1);
+          RGB_TO_UV(x, y, SUM2V);
         }
       }
-    } else if (uv_csp == WEBP_YUV444) {
-      for (y = 0; y < height; ++y) {
-        for (x = 0; x < width; ++x) {
-          RGB_TO_UV0(x, x, y, SUM1);
+      if (height & 1) {
+        for (x = 0; x < (width >> 1); ++x) {
+          RGB_TO_UV(x, y, SUM2H);
+        }
+        if (width & 1) {
+          RGB_TO_UV(x, y, SUM1);
         }
       }
     }
-#endif
-  } else {
+  }
+
+  if (uv_csp == WEBP_YUV400) {
     MakeGray(picture);
   }
+#ifdef WEBP_EXPERIMENTAL_FEATURES
+  // Store original U/V samples too
+  if (uv_csp == WEBP_YUV422) {
+    for (y = 0; y < height; ++y) {
+      for (x = 0; x < (width >> 1); ++x) {
+        RGB_TO_UV0(2 * x, x, y, SUM2H);
+      }
+      if (width & 1) {
+        RGB_TO_UV0(2 * x, x, y, SUM1);
+      }
+    }
+  } else if (uv_csp == WEBP_YUV444) {
+    for (y = 0; y < height; ++y) {
+      for (x = 0; x < width; ++x) {
+        RGB_TO_UV0(x, x, y, SUM1);
+      }
+    }
+  }
+#endif
 
   if (has_alpha) {
     assert(step >= 4);
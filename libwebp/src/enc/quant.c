@@ -549,7 +549,7 @@ static int TrellisQuantizeBlock(const VP8EncIterator* const it,
                                 const VP8Matrix* const mtx,
                                 int lambda) {
   ProbaArray* const last_costs = it->enc_->proba_.coeffs_[coeff_type];
-  CostArray* const costs = it->enc_->proba_.level_cost_[coeff_type];
+  CostArrayPtr const costs = it->enc_->proba_.remapped_costs_[coeff_type];
   const int first = (coeff_type == 0) ? 1 : 0;
   Node nodes[17][NUM_NODES];
   int best_path[3] = {-1, -1, -1};   // store best-last/best-level/best-previous
@@ -590,6 +590,10 @@ static int TrellisQuantizeBlock(const VP8EncIterator* const it,
   }
 
   // traverse trellis.
+  // Note: each position only has NUM_NODES x NUM_NODES (level, predecessor)
+  // pairs to score, with a serial dependency on the previous position. This
+  // is too narrow for SIMD, so the loop stays scalar. The RD scoring of whole
+  // blocks (VP8GetResidualCost()) is the vectorized part.
   for (n = first; n <= last; ++n) {
     const int j  = kZigzag[n];
     const int Q  = mtx->q_[j];
@@ -600,14 +604,29 @@ static int TrellisQuantizeBlock(const VP8EncIterator* const it,
     const int sign = (in[j] < 0);
     const int coeff0 = (sign ? -in[j] : in[j]) + mtx->sharpen_[j];
     int level0 = QUANTDIV(coeff0, iQ, B);
+    // Score and cost table of the predecessors. They don't depend on the
+    // level tested, so they are computed once for all alternates.
+    score_t prev_scores[NUM_NODES];
+    const uint16_t* prev_costs[NUM_NODES];
     if (level0 > MAX_LEVEL) level0 = MAX_LEVEL;
 
+    for (p = -MIN_DELTA; p <= MAX_DELTA; ++p) {
+      const Node* const prev = &NODE(n - 1, p);
+      prev_scores[p + MIN_DELTA] = (prev->cost >= MAX_COST) ? MAX_COST
+                                 : RDScoreTrellis(lambda, prev->cost,
+                                                  prev->error);
+      prev_costs[p + MIN_DELTA] = costs[n][prev->ctx];
+    }
+
     // test all alternate level values around level0.
     for (m = -MIN_DELTA; m <= MAX_DELTA; ++m) {
       Node* const cur = &NODE(n, m);
+      const Node* prev;
       int delta_error, new_error;
       score_t cur_score = MAX_COST;
+      score_t base_cost, total_error, score;
       int level = level0 + m;
+      int best_prev = -MIN_DELTA - 1;
       int last_proba;
 
       cur->sign = sign;
@@ -619,51 +638,58 @@ static int TrellisQuantizeBlock(const VP8EncIterator* const it,
       }
       last_proba = last_costs[VP8EncBands[n + 1]][cur->ctx][0];
 
+      // Inspect all possible non-dead predecessors. Retain only the best one.
+      // The terms not depending on the predecessor are left out of the
+      // comparison: the selected one is the same for the terminal and
+      // non-terminal cases.
+      for (p = -MIN_DELTA; p <= MAX_DELTA; ++p) {
+        if (prev_scores[p + MIN_DELTA] >= MAX_COST) {   // dead node?
+          continue;
+        }
+        score = prev_scores[p + MIN_DELTA] +
+                RDScoreTrellis(lambda,
+                               VP8LevelCost(prev_costs[p + MIN_DELTA], level),
+                               0);
+        if (score < cur_score) {
+          cur_score = score;
+          best_prev = p;
+        }
+      }
+      if (best_prev < -MIN_DELTA) {   // no live predecessor
+        cur->cost = MAX_COST;
+        continue;
+      }
+      prev = &NODE(n - 1, best_prev);
+
       // Compute delta_error = how much coding this level will
       // subtract as distortion to max_error
       new_error = coeff0 - level * Q;
       delta_error =
         kWeightTrellis[j] * (coeff0 * coeff0 - new_error * new_error);
+      total_error = prev->error - delta_error;
 
-      // Inspect all possible non-dead predecessors. Retain only the best one.
-      for (p = -MIN_DELTA; p <= MAX_DELTA; ++p) {
-        const Node* const prev = &NODE(n - 1, p);
-        const int prev_ctx = prev->ctx;
-        const uint16_t* const tcost = costs[VP8EncBands[n]][prev_ctx];
-        const score_t total_error = prev->error - delta_error;
-        score_t cost, base_cost, score;
-
-        if (prev->cost >= MAX_COST) {   // dead node?
-          continue;
-        }
+      // Base cost of both terminal/non-terminal
+      base_cost = prev->cost +
+                  VP8LevelCost(prev_costs[best_prev + MIN_DELTA], level);
 
-        // Base cost of both terminal/non-terminal
-        base_cost = prev->cost + VP8LevelCost(tcost, level);
+      // Store the node assuming it's a non-terminal one.
+      cur->cost = base_cost;
+      if (level && n < 15) {
+        cur->cost += VP8BitCost(1, last_proba);
+      }
+      cur->error = total_error;
+      cur->prev  = best_prev;
 
-        // Examine node assuming it's a non-terminal one.
-        cost = base_cost;
-        if (level && n < 15) {
-          cost += VP8BitCost(1, last_proba);
-        }
+      // Now, record best terminal node (and thus best entry in the graph).
+      if (level) {
+        score_t cost = base_cost;
+        if (n < 15) cost += VP8BitCost(0, last_proba);
         score = RDScoreTrellis(lambda, cost, total_error);
-        if (score < cur_score) {
-          cur_score = score;
-          cur->cost  = cost;
-          cur->error = total_error;
-          cur->prev  = p;
-        }
-
-        // Now, record best terminal node (and thus best entry in the graph).
-        if (level) {
-          cost = base_cost;
-          if (n < 15) cost += VP8BitCost(0, last_proba);
-          score = RDScoreTrellis(lambda, cost, total_error);
-          if (score < best_score) {
-            best_score = score;
-            best_path[0] = n;   // best eob position
-            best_path[1] = m;   // best level
-            best_path[2] = p;   // best predecessor
-          }
+        if (score < best_score) {
+          best_score = score;
+          best_path[0] = n;           // best eob position
+          best_path[1] = m;           // best level
+          best_path[2] = best_prev;   // best predecessor
         }
       }
     }
@@ -188,6 +188,9 @@ typedef uint32_t proba_t;   // 16b + 16b
 typedef uint8_t ProbaArray[NUM_CTX][NUM_PROBAS];
 typedef proba_t StatsArray[NUM_CTX][NUM_PROBAS];
 typedef uint16_t CostArray[NUM_CTX][MAX_VARIABLE_LEVEL + 1];
+// Cost tables indexed by coefficient position rather than band.
+typedef const uint16_t* CostArrayMap[16][NUM_CTX];
+typedef const uint16_t* (*CostArrayPtr)[NUM_CTX];   // for easy casting
 typedef double LFStats[NUM_MB_SEGMENTS][MAX_LF_LEVELS];  // filter stats
 
 typedef struct VP8Encoder VP8Encoder;
@@ -207,6 +210,7 @@ typedef struct {
   ProbaArray coeffs_[NUM_TYPES][NUM_BANDS];      // 924 bytes
   StatsArray stats_[NUM_TYPES][NUM_BANDS];       // 4224 bytes
   CostArray level_cost_[NUM_TYPES][NUM_BANDS];   // 11.4k
+  CostArrayMap remapped_costs_[NUM_TYPES];       // 1.5k (64b: 3k)
   int dirty_;               // if true, need to call VP8CalculateLevelCosts()
   int use_skip_proba_;      // Note: we always use skip_proba for now.
   int nb_skip_;             // number of skipped blocks
@@ -412,7 +416,7 @@ struct VP8Encoder {
   // per-partition boolean decoders.
   VP8BitWriter bw_;                         // part0
   VP8BitWriter parts_[MAX_NUM_PARTITIONS];  // token partitions
-  VP8TBuffer tokens_;                       // token buffer
+  VP8TBuffer tokens_[MAX_NUM_PARTITIONS];   // token buffers, per partition
 
   int percent_;                             // for progress
 
@@ -434,6 +438,7 @@ struct VP8Encoder {
                                    // for relative coding of segments' quant.
   int alpha_;                      // global susceptibility (<=> complexity)
   int uv_alpha_;                   // U/V quantization susceptibility
+  int centers_[NUM_MB_SEGMENTS];   // susceptibility of each segment
   // global offset of quantizers, shared by all segments
   int dq_y1_dc_;
   int dq_y2_dc_, dq_y2_ac_;
@@ -454,6 +459,10 @@ struct VP8Encoder {
   int thread_level_;         // derived from config->thread_level
   int do_search_;            // derived from config->target_XXX
   int use_tokens_;           // if true, use token buffer
+  // Index of the macroblock row stored at the top of pic_'s planes. This is
+  // only non-zero with incremental encoding, where the planes just hold a
+  // window of rows (see ienc.c).
+  int row_offset_;
 
   // Memory
   VP8MBInfo* mb_info_;   // contextual macroblock infos (mb_w_ + 1)
@@ -508,8 +517,22 @@ int VP8GetCostUV(VP8EncIterator* const it, const VP8ModeScore* const rd);
 // Main coding calls
 int VP8EncLoop(VP8Encoder* const enc);
 int VP8EncTokenLoop(VP8Encoder* const enc);
+// Incremental coding, one macroblock row at a time. The statistics used for
+// the token probabilities are collected on the first 'num_rows' rows only.
+int VP8EncStartRowLoop(VP8Encoder* const enc, VP8EncIterator* const it,
+                       int num_rows);
+int VP8EncCodeRow(VP8EncIterator* const it);   // codes the next row
+int VP8EncFinishRowLoop(VP8EncIterator* const it, int ok);
 
   // in webpenc.c
+// Allocates and sets up a lossy encoder for 'picture'. Returns NULL and sets
+// the picture's error code in case of error.
+VP8Encoder* VP8EncoderNew(const WebPConfig* const config,
+                          WebPPicture* const picture);
+// Releases the encoder. Returns false if the alpha coding had failed.
+int VP8EncoderDelete(VP8Encoder* enc);
+// Stores the final statistics in the picture, if requested.
+void VP8EncStoreStats(VP8Encoder* const enc);
 // Assign an error code to a picture. Return false for convenience.
 int WebPEncodingSetError(const WebPPicture* const pic, WebPEncodingError error);
 int WebPReportProgress(const WebPPicture* const pic,
@@ -519,6 +542,13 @@ int WebPReportProgress(const WebPPicture* const pic,
 // Main analysis loop. Decides the segmentations and complexity.
 // Assigns a first guess for Intra16 and uvmode_ prediction modes.
 int VP8EncAnalyze(VP8Encoder* const enc);
+// Incremental analysis: the segmentation is decided from the first
+// 'num_rows' macroblock rows only. Each of the next rows is then analyzed with
+// VP8EncAnalyzeRow() and its macroblocks mapped to the closest segments.
+// 'it' must be initialized before the coding starts, since VP8IteratorInit()
+// resets the top samples of the coding loop.
+int VP8EncAnalyzeFirstRows(VP8Encoder* const enc, int num_rows);
+void VP8EncAnalyzeRow(VP8EncIterator* const it, int y);
 
   // in quant.c
 // Sets up segment's quantization values, base_quant_ and filter strengths.
@@ -527,6 +557,18 @@ void VP8SetSegmentParams(VP8Encoder* const enc, float quality);
 int VP8Decimate(VP8EncIterator* const it, VP8ModeScore* const rd,
                 VP8RDLevel rd_opt);
 
+  // in picture.c
+// Sets up the tables and functions used by VP8ImportRGBRows().
+void VP8InitImportRGBRows(void);
+// Converts a pair of rows of r/g/b samples into two rows of luma and one row
+// of each chroma plane. A last, single row is converted if 'rgb_stride' is 0.
+// 'tmp_rgb' is a scratch buffer of 3 * ((width + 1) >> 1) values.
+void VP8ImportRGBRows(const uint8_t* const r_ptr, const uint8_t* const g_ptr,
+                      const uint8_t* const b_ptr, int step, int rgb_stride,
+                      int width, uint8_t* const y_dst, int y_stride,
+                      uint8_t* const u_dst, uint8_t* const v_dst,
+                      uint16_t* const tmp_rgb);
+
   // in alpha.c
 void VP8EncInitAlpha(VP8Encoder* const enc);    // initialize alpha compression
 int VP8EncStartAlpha(VP8Encoder* const enc);    // start alpha coding process
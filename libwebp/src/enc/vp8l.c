@@ -22,6 +22,7 @@
 #include "../dsp/lossless.h"
 #include "../utils/bit_writer.h"
 #include "../utils/huffman_encode.h"
+#include "../utils/thread.h"
 #include "../utils/utils.h"
 #include "../webp/format_constants.h"
 
@@ -468,13 +469,21 @@ static int EncodeImageNoHuffman(VP8LBitWriter* const bw,
   int i;
   int ok = 0;
   VP8LBackwardRefs refs;
+  VP8LHashChain hash_chain;
   HuffmanTreeCode huffman_codes[5] = { { 0, NULL, NULL } };
   const uint16_t histogram_symbols[1] = { 0 };    // only one tree, one symbol
   VP8LHistogramSet* const histogram_image = VP8LAllocateHistogramSet(1, 0);
   if (histogram_image == NULL) return 0;
 
+  memset(&hash_chain, 0, sizeof(hash_chain));
+  VP8LInitBackwardRefs(&refs);
+  if (!VP8LHashChainInit(&hash_chain, width * height) ||
+      !VP8LHashChainFill(&hash_chain, quality, argb, width, height)) {
+    goto Error;
+  }
   // Calculate backward references from ARGB image.
-  if (!VP8LGetBackwardReferences(width, height, argb, quality, 0, 1, &refs)) {
+  if (!VP8LGetBackwardReferences(width, height, argb, quality, 0, 1,
+                                 &hash_chain, &refs)) {
     goto Error;
   }
   // Build histogram image and symbols from backward references.
@@ -505,12 +514,14 @@ static int EncodeImageNoHuffman(VP8LBitWriter* const bw,
  Error:
   free(histogram_image);
   VP8LClearBackwardRefs(&refs);
+  VP8LHashChainClear(&hash_chain);
   free(huffman_codes[0].codes);
   return ok;
 }
 
 static int EncodeImageInternal(VP8LBitWriter* const bw,
                                const uint32_t* const argb,
+                               const VP8LHashChain* const hash_chain,
                                int width, int height, int quality,
                                int cache_bits, int histogram_bits) {
   int ok = 0;
@@ -539,7 +550,7 @@ static int EncodeImageInternal(VP8LBitWriter* const bw,
 
   // Calculate backward references from ARGB image.
   if (!VP8LGetBackwardReferences(width, height, argb, quality, cache_bits,
-                                 use_2d_locality, &refs)) {
+                                 use_2d_locality, hash_chain, &refs)) {
     goto Error;
   }
   // Build histogram image and symbols from backward references.
@@ -676,8 +687,11 @@ static int ApplyPredictFilter(const VP8LEncoder* const enc,
   const int transform_width = VP8LSubSampleSize(width, pred_bits);
   const int transform_height = VP8LSubSampleSize(height, pred_bits);
 
-  VP8LResidualImage(width, height, pred_bits, enc->argb_, enc->argb_scratch_,
-                    enc->transform_data_);
+  if (!VP8LResidualImage(width, height, pred_bits, enc->argb_,
+                         enc->argb_scratch_, enc->transform_data_,
+                         enc->num_threads_)) {
+    return 0;
+  }
   VP8LWriteBits(bw, 1, TRANSFORM_PRESENT);
   VP8LWriteBits(bw, 2, PREDICTOR_TRANSFORM);
   assert(pred_bits >= 2);
@@ -697,8 +711,11 @@ static int ApplyCrossColorFilter(const VP8LEncoder* const enc,
   const int transform_height = VP8LSubSampleSize(height, ccolor_transform_bits);
   const int step = (quality < 25) ? 32 : (quality > 50) ? 8 : 16;
 
-  VP8LColorSpaceTransform(width, height, ccolor_transform_bits, step,
-                          enc->argb_, enc->transform_data_);
+  if (!VP8LColorSpaceTransform(width, height, ccolor_transform_bits, step,
+                               enc->argb_, enc->transform_data_,
+                               enc->num_threads_)) {
+    return 0;
+  }
   VP8LWriteBits(bw, 1, TRANSFORM_PRESENT);
   VP8LWriteBits(bw, 2, CROSS_COLOR_TRANSFORM);
   assert(ccolor_transform_bits >= 2);
@@ -938,6 +955,9 @@ static void FinishEncParams(VP8LEncoder* const enc) {
   enc->transform_bits_ = (method < 4) ? 5 : (method > 4) ? 3 : 4;
   enc->histo_bits_ = GetHistoBits(method, use_palette, pic->width, pic->height);
   enc->cache_bits_ = (quality <= 25.f) ? 0 : 7;
+  enc->num_threads_ = (config->thread_level > 0) ? WebPGetNumCores() : 1;
+  enc->search_quality_ = (config->lossless_search > 0) ? config->lossless_search
+                                                       : (int)quality;
 }
 
 // -----------------------------------------------------------------------------
@@ -959,8 +979,11 @@ static VP8LEncoder* VP8LEncoderNew(const WebPConfig* const config,
 }
 
 static void VP8LEncoderDelete(VP8LEncoder* enc) {
-  free(enc->argb_);
-  free(enc);
+  if (enc != NULL) {
+    VP8LHashChainClear(&enc->hash_chain_);
+    free(enc->argb_);
+    free(enc);
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -1035,12 +1058,25 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
 
   VP8LWriteBits(bw, 1, !TRANSFORM_PRESENT);  // No more transforms.
 
+  // ---------------------------------------------------------------------------
+  // Find the matches of the transformed image, used by all the backward
+  // references passes.
+
+  if (!VP8LHashChainInit(&enc->hash_chain_, enc->current_width_ * height) ||
+      !VP8LHashChainFill(&enc->hash_chain_, enc->search_quality_, enc->argb_,
+                         enc->current_width_, height)) {
+    err = VP8_ENC_ERROR_OUT_OF_MEMORY;
+    goto Error;
+  }
+
   // ---------------------------------------------------------------------------
   // Estimate the color cache size.
 
   if (enc->cache_bits_ > 0) {
     if (!VP8LCalculateEstimateForCacheSize(enc->argb_, enc->current_width_,
-                                           height, &enc->cache_bits_)) {
+                                           height, &enc->hash_chain_,
+                                           enc->num_threads_,
+                                           &enc->cache_bits_)) {
       err = VP8_ENC_ERROR_INVALID_CONFIGURATION;
       goto Error;
     }
@@ -1049,7 +1085,8 @@ WebPEncodingError VP8LEncodeStream(const WebPConfig* const config,
   // ---------------------------------------------------------------------------
   // Encode and write the transformed image.
 
-  if (!EncodeImageInternal(bw, enc->argb_, enc->current_width_, height,
+  if (!EncodeImageInternal(bw, enc->argb_, &enc->hash_chain_,
+                           enc->current_width_, height,
                            quality, enc->cache_bits_, enc->histo_bits_)) {
     err = VP8_ENC_ERROR_OUT_OF_MEMORY;
     goto Error;
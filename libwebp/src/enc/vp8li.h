@@ -37,6 +37,10 @@ typedef struct {
   int histo_bits_;
   int transform_bits_;
   int cache_bits_;        // If equal to 0, don't use color cache.
+  int num_threads_;       // Number of threads used for the transforms search.
+  int search_quality_;    // Effort of the match search, in [0..100].
+
+  VP8LHashChain hash_chain_;    // Best matches of the transformed image.
 
   // Encoding parameters derived from image characteristics.
   int use_cross_color_;
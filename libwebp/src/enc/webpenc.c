@@ -134,9 +134,6 @@ static void MapConfigToTools(VP8Encoder* const enc) {
 #if !defined(DISABLE_TOKEN_BUFFER)
     enc->use_tokens_ = (enc->rd_opt_level_ >= RD_OPT_BASIC);  // need rd stats
 #endif
-    if (enc->use_tokens_) {
-      enc->num_parts_ = 1;   // doesn't work with multi-partition
-    }
   }
 }
 
@@ -161,8 +158,8 @@ static void MapConfigToTools(VP8Encoder* const enc) {
 //              LFStats: 2048
 // Picture size (yuv): 589824
 
-static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
-                                  WebPPicture* const picture) {
+VP8Encoder* VP8EncoderNew(const WebPConfig* const config,
+                          WebPPicture* const picture) {
   const int use_filter =
       (config->filter_strength > 0) || (config->autofilter > 0);
   const int mb_w = (picture->width + 15) >> 4;
@@ -179,6 +176,7 @@ static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
       config->autofilter ? sizeof(LFStats) + ALIGN_CST : 0;
   VP8Encoder* enc;
   uint8_t* mem;
+  int i;
   const uint64_t size = (uint64_t)sizeof(VP8Encoder)   // main struct
                       + ALIGN_CST                      // cache alignment
                       + info_size                      // modes info
@@ -257,18 +255,19 @@ static VP8Encoder* InitVP8Encoder(const WebPConfig* const config,
   VP8EncInitLayer(enc);
 #endif
 
-  VP8TBufferInit(&enc->tokens_);
+  for (i = 0; i < MAX_NUM_PARTITIONS; ++i) VP8TBufferInit(&enc->tokens_[i]);
   return enc;
 }
 
-static int DeleteVP8Encoder(VP8Encoder* enc) {
+int VP8EncoderDelete(VP8Encoder* enc) {
   int ok = 1;
   if (enc != NULL) {
+    int i;
     ok = VP8EncDeleteAlpha(enc);
 #ifdef WEBP_EXPERIMENTAL_FEATURES
     VP8EncDeleteLayer(enc);
 #endif
-    VP8TBufferClear(&enc->tokens_);
+    for (i = 0; i < MAX_NUM_PARTITIONS; ++i) VP8TBufferClear(&enc->tokens_[i]);
     free(enc);
   }
   return ok;
@@ -291,7 +290,7 @@ static void FinalizePSNR(const VP8Encoder* const enc) {
   stats->PSNR[4] = (float)GetPSNR(sse[3], size);
 }
 
-static void StoreStats(VP8Encoder* const enc) {
+void VP8EncStoreStats(VP8Encoder* const enc) {
   WebPAuxStats* const stats = enc->pic_->stats;
   if (stats != NULL) {
     int i, s;
@@ -367,7 +366,7 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
       }
     }
 
-    enc = InitVP8Encoder(config, pic);
+    enc = VP8EncoderNew(config, pic);
     if (enc == NULL) return 0;  // pic->error is already set.
     // Note: each of the tasks below account for 20% in the progress report.
     ok = VP8EncAnalyze(enc);
@@ -385,11 +384,11 @@ int WebPEncode(const WebPConfig* config, WebPPicture* pic) {
 #endif
 
     ok = ok && VP8EncWrite(enc);
-    StoreStats(enc);
+    VP8EncStoreStats(enc);
     if (!ok) {
       VP8EncFreeBitWriters(enc);
     }
-    ok &= DeleteVP8Encoder(enc);  // must always be called, even if !ok
+    ok &= VP8EncoderDelete(enc);  // must always be called, even if !ok
   } else {
     // Make sure we have ARGB samples.
     if (pic->argb == NULL && !WebPPictureYUVAToARGB(pic)) {
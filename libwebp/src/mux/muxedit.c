@@ -588,64 +588,109 @@ static size_t ImageListDiskSize(const WebPMuxImage* wpi_list) {
   return size;
 }
 
-// Write out the given list of images into 'dst'.
-static uint8_t* ImageListEmit(const WebPMuxImage* wpi_list, uint8_t* dst) {
+// Write out the given list of images through 'writer'.
+static int ImageListWrite(const WebPMuxImage* wpi_list,
+                          WebPMuxWriterFunction writer, void* user_data) {
   while (wpi_list != NULL) {
-    dst = MuxImageEmit(wpi_list, dst);
+    if (!MuxImageWrite(wpi_list, writer, user_data)) return 0;
     wpi_list = wpi_list->next_;
   }
-  return dst;
+  return 1;
+}
+
+// Finalizes and validates 'mux' before it is assembled.
+static WebPMuxError MuxFinalize(WebPMux* const mux) {
+  WebPMuxError err = MuxCleanup(mux);
+  if (err != WEBP_MUX_OK) return err;
+  err = CreateVP8XChunk(mux);
+  if (err != WEBP_MUX_OK) return err;
+  return MuxValidate(mux);
+}
+
+// Total size of the assembled data, RIFF header included.
+static size_t MuxDiskSize(const WebPMux* const mux) {
+  return ChunkListDiskSize(mux->vp8x_) + ChunkListDiskSize(mux->iccp_)
+       + ChunkListDiskSize(mux->anim_) + ImageListDiskSize(mux->images_)
+       + ChunkListDiskSize(mux->exif_) + ChunkListDiskSize(mux->xmp_)
+       + ChunkListDiskSize(mux->unknown_) + RIFF_HEADER_SIZE;
+}
+
+// Emit header & chunks through 'writer'.
+static int MuxWrite(const WebPMux* const mux, size_t size,
+                    WebPMuxWriterFunction writer, void* user_data) {
+  return MuxWriteRiffHeader(size, writer, user_data) &&
+         ChunkListWrite(mux->vp8x_, writer, user_data) &&
+         ChunkListWrite(mux->iccp_, writer, user_data) &&
+         ChunkListWrite(mux->anim_, writer, user_data) &&
+         ImageListWrite(mux->images_, writer, user_data) &&
+         ChunkListWrite(mux->exif_, writer, user_data) &&
+         ChunkListWrite(mux->xmp_, writer, user_data) &&
+         ChunkListWrite(mux->unknown_, writer, user_data);
+}
+
+// Writer copying the data to a large enough buffer. 'user_data' points to the
+// current write position.
+static int MuxMemoryWrite(const uint8_t* data, size_t data_size,
+                          void* user_data) {
+  uint8_t** const dst = (uint8_t**)user_data;
+  memcpy(*dst, data, data_size);
+  *dst += data_size;
+  return 1;
 }
 
 WebPMuxError WebPMuxAssemble(WebPMux* mux, WebPData* assembled_data) {
   size_t size = 0;
   uint8_t* data = NULL;
   uint8_t* dst = NULL;
+  int ok;
   WebPMuxError err;
 
   if (mux == NULL || assembled_data == NULL) {
     return WEBP_MUX_INVALID_ARGUMENT;
   }
 
+  // Clean up returned data, in case of error.
+  assembled_data->bytes = NULL;
+  assembled_data->size = 0;
+
   // Finalize mux.
-  err = MuxCleanup(mux);
-  if (err != WEBP_MUX_OK) return err;
-  err = CreateVP8XChunk(mux);
+  err = MuxFinalize(mux);
   if (err != WEBP_MUX_OK) return err;
 
   // Allocate data.
-  size = ChunkListDiskSize(mux->vp8x_) + ChunkListDiskSize(mux->iccp_)
-       + ChunkListDiskSize(mux->anim_) + ImageListDiskSize(mux->images_)
-       + ChunkListDiskSize(mux->exif_) + ChunkListDiskSize(mux->xmp_)
-       + ChunkListDiskSize(mux->unknown_) + RIFF_HEADER_SIZE;
-
+  size = MuxDiskSize(mux);
   data = (uint8_t*)malloc(size);
   if (data == NULL) return WEBP_MUX_MEMORY_ERROR;
 
-  // Emit header & chunks.
-  dst = MuxEmitRiffHeader(data, size);
-  dst = ChunkListEmit(mux->vp8x_, dst);
-  dst = ChunkListEmit(mux->iccp_, dst);
-  dst = ChunkListEmit(mux->anim_, dst);
-  dst = ImageListEmit(mux->images_, dst);
-  dst = ChunkListEmit(mux->exif_, dst);
-  dst = ChunkListEmit(mux->xmp_, dst);
-  dst = ChunkListEmit(mux->unknown_, dst);
-  assert(dst == data + size);
-
-  // Validate mux.
-  err = MuxValidate(mux);
-  if (err != WEBP_MUX_OK) {
-    free(data);
-    data = NULL;
-    size = 0;
-  }
+  dst = data;
+  ok = MuxWrite(mux, size, MuxMemoryWrite, &dst);
+  assert(ok && dst == data + size);
+  (void)ok;
 
   // Finalize data.
   assembled_data->bytes = data;
   assembled_data->size = size;
 
-  return err;
+  return WEBP_MUX_OK;
+}
+
+WebPMuxError WebPMuxAssembleToWriter(WebPMux* mux,
+                                     WebPMuxWriterFunction writer,
+                                     void* user_data) {
+  WebPMuxError err;
+
+  if (mux == NULL || writer == NULL) {
+    return WEBP_MUX_INVALID_ARGUMENT;
+  }
+
+  // Finalize mux.
+  err = MuxFinalize(mux);
+  if (err != WEBP_MUX_OK) return err;
+
+  if (!MuxWrite(mux, MuxDiskSize(mux), writer, user_data)) {
+    return WEBP_MUX_MEMORY_ERROR;
+  }
+  return WEBP_MUX_OK;
 }
 
 //------------------------------------------------------------------------------
@@ -158,6 +158,12 @@ size_t ChunkListDiskSize(const WebPChunk* chunk_list);
 // Write out the given list of chunks into 'dst'.
 uint8_t* ChunkListEmit(const WebPChunk* chunk_list, uint8_t* dst);
 
+// Write out the given list of chunks through 'writer'. The chunk payloads are
+// passed to 'writer' as they are, without copy. Returns false if 'writer'
+// failed.
+int ChunkListWrite(const WebPChunk* chunk_list,
+                   WebPMuxWriterFunction writer, void* user_data);
+
 //------------------------------------------------------------------------------
 // MuxImage object management.
 
@@ -203,8 +209,10 @@ WebPMuxError MuxImageGetNth(const WebPMuxImage** wpi_list, uint32_t nth,
 // Total size of the given image.
 size_t MuxImageDiskSize(const WebPMuxImage* const wpi);
 
-// Write out the given image into 'dst'.
-uint8_t* MuxImageEmit(const WebPMuxImage* const wpi, uint8_t* dst);
+// Write out the given image through 'writer'. Returns false if 'writer'
+// failed.
+int MuxImageWrite(const WebPMuxImage* const wpi,
+                  WebPMuxWriterFunction writer, void* user_data);
 
 //------------------------------------------------------------------------------
 // Helper methods for mux.
@@ -215,6 +223,10 @@ int MuxHasAlpha(const WebPMuxImage* images);
 // Write out RIFF header into 'data', given total data size 'size'.
 uint8_t* MuxEmitRiffHeader(uint8_t* const data, size_t size);
 
+// Write out RIFF header through 'writer', given total data size 'size'.
+int MuxWriteRiffHeader(size_t size, WebPMuxWriterFunction writer,
+                       void* user_data);
+
 // Returns the list where chunk with given ID is to be inserted in mux.
 WebPChunk** MuxGetChunkListFromId(const WebPMux* mux, WebPChunkId id);
 
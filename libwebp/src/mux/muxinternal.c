@@ -213,6 +213,41 @@ uint8_t* ChunkListEmit(const WebPChunk* chunk_list, uint8_t* dst) {
   return dst;
 }
 
+// Writes the header of a chunk with the given 'tag' and 'chunk_size', followed
+// by 'payload' and the padding byte (if any).
+static int ChunkWriteRaw(uint32_t tag, size_t chunk_size,
+                         const WebPData* const payload,
+                         WebPMuxWriterFunction writer, void* user_data) {
+  static const uint8_t kPadding[1] = { 0 };
+  uint8_t header[CHUNK_HEADER_SIZE];
+  PutLE32(header + 0, tag);
+  PutLE32(header + TAG_SIZE, (uint32_t)chunk_size);
+  assert(chunk_size == (uint32_t)chunk_size);
+  if (!writer(header, CHUNK_HEADER_SIZE, user_data)) return 0;
+  if (payload->size > 0 && !writer(payload->bytes, payload->size, user_data)) {
+    return 0;
+  }
+  if ((payload->size & 1) && !writer(kPadding, 1, user_data)) return 0;
+  return 1;
+}
+
+static int ChunkWrite(const WebPChunk* const chunk,
+                      WebPMuxWriterFunction writer, void* user_data) {
+  assert(chunk);
+  assert(chunk->tag_ != NIL_TAG);
+  return ChunkWriteRaw(chunk->tag_, chunk->data_.size, &chunk->data_,
+                       writer, user_data);
+}
+
+int ChunkListWrite(const WebPChunk* chunk_list,
+                   WebPMuxWriterFunction writer, void* user_data) {
+  while (chunk_list != NULL) {
+    if (!ChunkWrite(chunk_list, writer, user_data)) return 0;
+    chunk_list = chunk_list->next_;
+  }
+  return 1;
+}
+
 size_t ChunkListDiskSize(const WebPChunk* chunk_list) {
   size_t size = 0;
   while (chunk_list != NULL) {
@@ -372,36 +407,31 @@ size_t MuxImageDiskSize(const WebPMuxImage* const wpi) {
   return size;
 }
 
-// Special case as ANMF/FRGM chunk encapsulates other image chunks.
-static uint8_t* ChunkEmitSpecial(const WebPChunk* const header,
-                                 size_t total_size, uint8_t* dst) {
-  const size_t header_size = header->data_.size;
-  const size_t offset_to_next = total_size - CHUNK_HEADER_SIZE;
-  assert(header->tag_ == kChunks[IDX_ANMF].tag ||
-         header->tag_ == kChunks[IDX_FRGM].tag);
-  PutLE32(dst + 0, header->tag_);
-  PutLE32(dst + TAG_SIZE, (uint32_t)offset_to_next);
-  assert(header_size == (uint32_t)header_size);
-  memcpy(dst + CHUNK_HEADER_SIZE, header->data_.bytes, header_size);
-  if (header_size & 1) {
-    dst[CHUNK_HEADER_SIZE + header_size] = 0;  // Add padding.
-  }
-  return dst + ChunkDiskSize(header);
-}
-
-uint8_t* MuxImageEmit(const WebPMuxImage* const wpi, uint8_t* dst) {
+int MuxImageWrite(const WebPMuxImage* const wpi,
+                  WebPMuxWriterFunction writer, void* user_data) {
   // Ordering of chunks to be emitted is strictly as follows:
   // 1. ANMF/FRGM chunk (if present).
   // 2. ALPH chunk (if present).
   // 3. VP8/VP8L chunk.
   assert(wpi);
   if (wpi->header_ != NULL) {
-    dst = ChunkEmitSpecial(wpi->header_, MuxImageDiskSize(wpi), dst);
+    // Special case as ANMF/FRGM chunk encapsulates other image chunks.
+    const WebPChunk* const header = wpi->header_;
+    const size_t offset_to_next = MuxImageDiskSize(wpi) - CHUNK_HEADER_SIZE;
+    assert(header->tag_ == kChunks[IDX_ANMF].tag ||
+           header->tag_ == kChunks[IDX_FRGM].tag);
+    if (!ChunkWriteRaw(header->tag_, offset_to_next, &header->data_,
+                       writer, user_data)) {
+      return 0;
+    }
   }
-  if (wpi->alpha_ != NULL) dst = ChunkEmit(wpi->alpha_, dst);
-  if (wpi->img_ != NULL) dst = ChunkEmit(wpi->img_, dst);
-  if (wpi->unknown_ != NULL) dst = ChunkListEmit(wpi->unknown_, dst);
-  return dst;
+  if (wpi->alpha_ != NULL && !ChunkWrite(wpi->alpha_, writer, user_data)) {
+    return 0;
+  }
+  if (wpi->img_ != NULL && !ChunkWrite(wpi->img_, writer, user_data)) {
+    return 0;
+  }
+  return ChunkListWrite(wpi->unknown_, writer, user_data);
 }
 
 //------------------------------------------------------------------------------
@@ -423,6 +453,13 @@ uint8_t* MuxEmitRiffHeader(uint8_t* const data, size_t size) {
   return data + RIFF_HEADER_SIZE;
 }
 
+int MuxWriteRiffHeader(size_t size, WebPMuxWriterFunction writer,
+                       void* user_data) {
+  uint8_t header[RIFF_HEADER_SIZE];
+  MuxEmitRiffHeader(header, size);
+  return writer(header, RIFF_HEADER_SIZE, user_data);
+}
+
 WebPChunk** MuxGetChunkListFromId(const WebPMux* mux, WebPChunkId id) {
   assert(mux != NULL);
   switch (id) {
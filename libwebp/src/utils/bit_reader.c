@@ -33,6 +33,32 @@ void VP8InitBitReader(VP8BitReader* const br,
   br->value_   = 0;
   br->bits_    = -8;   // to load the very first 8bits
   br->eof_     = 0;
+  br->segs_     = NULL;
+  br->next_seg_ = 0;
+  br->num_segs_ = 0;
+  br->left_     = 0;
+}
+
+void VP8InitBitReaderSegments(VP8BitReader* const br,
+                              const VP8InputSegment* const segs, int num_segs,
+                              size_t offset, size_t size) {
+  int i = 0;
+  assert(segs != NULL);
+  while (offset >= segs[i].size_) {   // skip the segments before 'offset'
+    offset -= segs[i].size_;
+    ++i;
+    assert(i < num_segs);
+  }
+  {
+    const uint8_t* const start = segs[i].buf_ + offset;
+    const size_t avail = segs[i].size_ - offset;
+    const size_t len = (avail < size) ? avail : size;
+    VP8InitBitReader(br, start, start + len);
+    br->segs_ = segs;
+    br->next_seg_ = i + 1;
+    br->num_segs_ = num_segs;
+    br->left_ = size - len;
+  }
 }
 
 const uint8_t kVP8Log2Range[128] = {
@@ -69,8 +95,23 @@ const range_t kVP8NewRange[128] = {
 
 #undef MK
 
+// Moves on to the next non-empty segment of input, if it is available.
+static void NextSegment(VP8BitReader* const br) {
+  while (br->left_ > 0 && br->next_seg_ < br->num_segs_) {
+    const VP8InputSegment* const seg = &br->segs_[br->next_seg_++];
+    const size_t size = (seg->size_ < br->left_) ? seg->size_ : br->left_;
+    br->buf_ = seg->buf_;
+    br->buf_end_ = seg->buf_ + size;
+    br->left_ -= size;
+    if (size > 0) break;
+  }
+}
+
 void VP8LoadFinalBytes(VP8BitReader* const br) {
   assert(br != NULL && br->buf_ != NULL);
+  if (br->buf_ == br->buf_end_ && br->left_ > 0) {
+    NextSegment(br);
+  }
   // Only read 8bits at a time
   if (br->buf_ < br->buf_end_) {
 #ifndef USE_RIGHT_JUSTIFY
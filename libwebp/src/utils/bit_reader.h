@@ -117,6 +117,12 @@ typedef uint32_t range_t;  // range_ only uses 8bits here. No need for bit_t.
 //------------------------------------------------------------------------------
 // Bitreader
 
+// One of the buffers the input is split into, when it is not contiguous.
+typedef struct {
+  const uint8_t* buf_;
+  size_t size_;
+} VP8InputSegment;
+
 typedef struct VP8BitReader VP8BitReader;
 struct VP8BitReader {
   const uint8_t* buf_;        // next byte to be read
@@ -127,12 +133,28 @@ struct VP8BitReader {
   range_t range_;            // current range minus 1. In [127, 254] interval.
   bit_t value_;              // current value
   int bits_;                 // number of valid bits left
+
+  // Segmented input: once buf_end_ is reached, the reading goes on with
+  // segs_[next_seg_] and the following segments (up to num_segs_), for at most
+  // left_ more bytes. segs_ is NULL for a contiguous input.
+  const VP8InputSegment* segs_;
+  int next_seg_;
+  int num_segs_;
+  size_t left_;
 };
 
 // Initialize the bit reader and the boolean decoder.
 void VP8InitBitReader(VP8BitReader* const br,
                       const uint8_t* const start, const uint8_t* const end);
 
+// Same as above, for an input split into the 'num_segs' segments 'segs'. At
+// most 'size' bytes are read, starting at byte 'offset' of the input, which
+// must be within the segments. More segments can be made visible later on by
+// updating segs_ and num_segs_.
+void VP8InitBitReaderSegments(VP8BitReader* const br,
+                              const VP8InputSegment* const segs, int num_segs,
+                              size_t offset, size_t size);
+
 // return the next value made of 'num_bits' bits
 uint32_t VP8GetValue(VP8BitReader* const br, int num_bits);
 static WEBP_INLINE uint32_t VP8Get(VP8BitReader* const br) {
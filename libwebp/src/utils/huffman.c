@@ -24,52 +24,12 @@
 
 #define NON_EXISTENT_SYMBOL (-1)
 
-static void TreeNodeInit(HuffmanTreeNode* const node) {
-  node->children_ = -1;   // means: 'unassigned so far'
-}
-
-static int NodeIsEmpty(const HuffmanTreeNode* const node) {
-  return (node->children_ < 0);
-}
-
-static int IsFull(const HuffmanTree* const tree) {
-  return (tree->num_nodes_ == tree->max_nodes_);
-}
-
-static void AssignChildren(HuffmanTree* const tree,
-                           HuffmanTreeNode* const node) {
-  HuffmanTreeNode* const children = tree->root_ + tree->num_nodes_;
-  node->children_ = (int)(children - node);
-  assert(children - node == (int)(children - node));
-  tree->num_nodes_ += 2;
-  TreeNodeInit(children + 0);
-  TreeNodeInit(children + 1);
-}
-
-static int TreeInit(HuffmanTree* const tree, int num_leaves) {
-  assert(tree != NULL);
-  if (num_leaves == 0) return 0;
-  // We allocate maximum possible nodes in the tree at once.
-  // Note that a Huffman tree is a full binary tree; and in a full binary tree
-  // with L leaves, the total number of nodes N = 2 * L - 1.
-  tree->max_nodes_ = 2 * num_leaves - 1;
-  assert(tree->max_nodes_ < (1 << 16));   // limit for the lut_jump_ table
-  tree->root_ = (HuffmanTreeNode*)WebPSafeMalloc((uint64_t)tree->max_nodes_,
-                                                 sizeof(*tree->root_));
-  if (tree->root_ == NULL) return 0;
-  TreeNodeInit(tree->root_);  // Initialize root.
-  tree->num_nodes_ = 1;
-  memset(tree->lut_bits_, 255, sizeof(tree->lut_bits_));
-  memset(tree->lut_jump_, 0, sizeof(tree->lut_jump_));
-  return 1;
-}
-
 void HuffmanTreeRelease(HuffmanTree* const tree) {
   if (tree != NULL) {
-    free(tree->root_);
-    tree->root_ = NULL;
-    tree->max_nodes_ = 0;
-    tree->num_nodes_ = 0;
+    free(tree->table_);
+    tree->table_ = NULL;
+    tree->num_symbols_ = 0;
+    tree->max_code_length_ = 0;
   }
 }
 
@@ -123,10 +83,10 @@ int HuffmanCodeLengthsToCodes(const int* const code_lengths,
 
 #ifndef USE_LUT_REVERSE_BITS
 
-static int ReverseBitsShort(int bits, int num_bits) {
+static int ReverseBits(int bits, int num_bits) {
   int retval = 0;
   int i;
-  assert(num_bits <= 8);   // Not a hard requirement, just for coherency.
+  assert(num_bits <= MAX_ALLOWED_CODE_LENGTH);
   for (i = 0; i < num_bits; ++i) {
     retval <<= 1;
     retval |= bits & 1;
@@ -142,114 +102,163 @@ static const uint8_t kReversedBits[16] = {  // Pre-reversed 4-bit values.
   0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf
 };
 
-static int ReverseBitsShort(int bits, int num_bits) {
-  const uint8_t v = (kReversedBits[bits & 0xf] << 4) | kReversedBits[bits >> 4];
-  assert(num_bits <= 8);
-  return v >> (8 - num_bits);
+static int ReverseBits(int bits, int num_bits) {
+  const int v = (kReversedBits[(bits >>  0) & 0xf] << 12) |
+                (kReversedBits[(bits >>  4) & 0xf] <<  8) |
+                (kReversedBits[(bits >>  8) & 0xf] <<  4) |
+                (kReversedBits[(bits >> 12) & 0xf] <<  0);
+  assert(num_bits <= 16);
+  return v >> (16 - num_bits);
 }
 
 #endif
 
-static int TreeAddSymbol(HuffmanTree* const tree,
-                         int symbol, int code, int code_length) {
-  int step = HUFF_LUT_BITS;
-  int base_code;
-  HuffmanTreeNode* node = tree->root_;
-  const HuffmanTreeNode* const max_node = tree->root_ + tree->max_nodes_;
-  assert(symbol == (int16_t)symbol);
-  if (code_length <= HUFF_LUT_BITS) {
-    int i;
-    base_code = ReverseBitsShort(code, code_length);
-    for (i = 0; i < (1 << (HUFF_LUT_BITS - code_length)); ++i) {
-      const int idx = base_code | (i << code_length);
-      tree->lut_symbol_[idx] = (int16_t)symbol;
-      tree->lut_bits_[idx] = code_length;
+// Fills the 'num_entries' entries of 'table' starting at 'first' with a
+// stride of 'step', checking that none of them was occupied already.
+static int FillEntries(HuffmanCode* const table, int first, int step,
+                       int num_entries, int bits, int symbol) {
+  int i;
+  for (i = first; i < num_entries; i += step) {
+    if (table[i].bits_ != 0) return 0;   // code is already in use.
+    table[i].bits_ = (uint8_t)bits;
+    table[i].value_ = (uint16_t)symbol;
+  }
+  return 1;
+}
+
+// Builds the lookup tables from the (code_lengths[i], codes[i], symbols[i])
+// triplets. Entries whose code is NON_EXISTENT_SYMBOL are ignored.
+// Codes are stored MSB-first, while the bitstream is read LSB-first, hence
+// the tables are indexed by the bit-reversed codes.
+// Returns false if the codes don't form a complete prefix code, or in case of
+// memory error.
+static int BuildTables(HuffmanTree* const tree,
+                       const int* const code_lengths, const int* const codes,
+                       const int* const symbols, int num_symbols) {
+  // For each root entry, number of bits of the second-level table (if any).
+  int sub_bits[1 << HUFFMAN_TABLE_BITS] = { 0 };
+  int num_coded = 0;
+  int max_code_length = 0;
+  int coded_symbol = 0;
+  uint32_t kraft_sum = 0;
+  uint64_t table_size;
+  HuffmanCode* table;
+  int i;
+
+  tree->table_ = NULL;
+  tree->num_symbols_ = 0;
+  tree->max_code_length_ = 0;
+
+  // Validate the code lengths and compute the size of the second-level tables.
+  for (i = 0; i < num_symbols; ++i) {
+    const int len = code_lengths[i];
+    if (codes[i] == NON_EXISTENT_SYMBOL) continue;
+    if (len < 0 || len > MAX_ALLOWED_CODE_LENGTH) return 0;
+    ++num_coded;
+    coded_symbol = symbols[i];
+    if (len > max_code_length) max_code_length = len;
+    kraft_sum += 1U << (MAX_ALLOWED_CODE_LENGTH - len);
+    if (len > HUFFMAN_TABLE_BITS) {
+      const int idx = ReverseBits(codes[i] >> (len - HUFFMAN_TABLE_BITS),
+                                  HUFFMAN_TABLE_BITS);
+      if (len - HUFFMAN_TABLE_BITS > sub_bits[idx]) {
+        sub_bits[idx] = len - HUFFMAN_TABLE_BITS;
+      }
     }
-  } else {
-    base_code = ReverseBitsShort((code >> (code_length - HUFF_LUT_BITS)),
-                                 HUFF_LUT_BITS);
   }
-  while (code_length-- > 0) {
-    if (node >= max_node) {
-      return 0;
+  if (num_coded == 0) return 0;
+
+  table_size = 1 << HUFFMAN_TABLE_BITS;
+  if (num_coded > 1) {
+    // A complete prefix code has a Kraft sum of exactly 1.
+    if (kraft_sum != (1U << MAX_ALLOWED_CODE_LENGTH)) return 0;
+    for (i = 0; i < (1 << HUFFMAN_TABLE_BITS); ++i) {
+      if (sub_bits[i] > 0) table_size += 1 << sub_bits[i];
     }
-    if (NodeIsEmpty(node)) {
-      if (IsFull(tree)) return 0;    // error: too many symbols.
-      AssignChildren(tree, node);
-    } else if (!HuffmanTreeNodeIsNotLeaf(node)) {
-      return 0;  // leaf is already occupied.
+  }
+
+  table = (HuffmanCode*)WebPSafeCalloc(table_size, sizeof(*table));
+  if (table == NULL) return 0;
+  tree->table_ = table;
+  tree->num_symbols_ = num_coded;
+
+  if (num_coded == 1) {  // Trivial case: zero-length code, whatever its length.
+    for (i = 0; i < (1 << HUFFMAN_TABLE_BITS); ++i) {
+      table[i].bits_ = 0;
+      table[i].value_ = (uint16_t)coded_symbol;
     }
-    node += node->children_ + ((code >> code_length) & 1);
-    if (--step == 0) {
-      tree->lut_jump_[base_code] = (int16_t)(node - tree->root_);
+    return 1;
+  }
+  tree->max_code_length_ = max_code_length;
+
+  // Link the root entries to their second-level tables.
+  {
+    int offset = 1 << HUFFMAN_TABLE_BITS;
+    for (i = 0; i < (1 << HUFFMAN_TABLE_BITS); ++i) {
+      if (sub_bits[i] > 0) {
+        table[i].bits_ = (uint8_t)(HUFFMAN_TABLE_BITS + sub_bits[i]);
+        table[i].value_ = (uint16_t)(offset - i);
+        offset += 1 << sub_bits[i];
+      }
     }
+    assert((uint64_t)offset == table_size);
   }
-  if (NodeIsEmpty(node)) {
-    node->children_ = 0;      // turn newly created node into a leaf.
-  } else if (HuffmanTreeNodeIsNotLeaf(node)) {
-    return 0;   // trying to assign a symbol to already used code.
+
+  // Add symbols one-by-one.
+  for (i = 0; i < num_symbols; ++i) {
+    const int len = code_lengths[i];
+    const int code = codes[i];
+    if (code == NON_EXISTENT_SYMBOL) continue;
+    if (len == 0) return 0;  // Zero-length code among several symbols.
+    if (len <= HUFFMAN_TABLE_BITS) {
+      if (!FillEntries(table, ReverseBits(code, len), 1 << len,
+                       1 << HUFFMAN_TABLE_BITS, len, symbols[i])) {
+        return 0;
+      }
+    } else {
+      const int sub_len = len - HUFFMAN_TABLE_BITS;
+      const int idx = ReverseBits(code >> sub_len, HUFFMAN_TABLE_BITS);
+      HuffmanCode* const sub_table = table + idx + table[idx].value_;
+      assert(sub_bits[idx] >= sub_len);
+      if (!FillEntries(sub_table, ReverseBits(code & ((1 << sub_len) - 1),
+                                              sub_len),
+                       1 << sub_len, 1 << sub_bits[idx], sub_len, symbols[i])) {
+        return 0;
+      }
+    }
   }
-  node->symbol_ = symbol;  // Add symbol in this node.
+  // Being prefix-free with a Kraft sum of 1, the code covers all the entries.
   return 1;
 }
 
 int HuffmanTreeBuildImplicit(HuffmanTree* const tree,
                              const int* const code_lengths,
                              int code_lengths_size) {
+  int ok = 0;
   int symbol;
-  int num_symbols = 0;
-  int root_symbol = 0;
+  int* codes;
+  int* symbols;
 
   assert(tree != NULL);
   assert(code_lengths != NULL);
 
-  // Find out number of symbols and the root symbol.
-  for (symbol = 0; symbol < code_lengths_size; ++symbol) {
-    if (code_lengths[symbol] > 0) {
-      // Note: code length = 0 indicates non-existent symbol.
-      ++num_symbols;
-      root_symbol = symbol;
-    }
-  }
-
-  // Initialize the tree. Will fail for num_symbols = 0
-  if (!TreeInit(tree, num_symbols)) return 0;
-
-  // Build tree.
-  if (num_symbols == 1) {  // Trivial case.
-    const int max_symbol = code_lengths_size;
-    if (root_symbol < 0 || root_symbol >= max_symbol) {
-      HuffmanTreeRelease(tree);
-      return 0;
-    }
-    return TreeAddSymbol(tree, root_symbol, 0, 0);
-  } else {  // Normal case.
-    int ok = 0;
+  tree->table_ = NULL;
+  if (code_lengths_size <= 0) return 0;
 
-    // Get Huffman codes from the code lengths.
-    int* const codes =
-        (int*)WebPSafeMalloc((uint64_t)code_lengths_size, sizeof(*codes));
-    if (codes == NULL) goto End;
+  // Get Huffman codes from the code lengths.
+  codes = (int*)WebPSafeMalloc(2ULL * code_lengths_size, sizeof(*codes));
+  if (codes == NULL) return 0;
+  symbols = codes + code_lengths_size;
 
-    if (!HuffmanCodeLengthsToCodes(code_lengths, code_lengths_size, codes)) {
-      goto End;
-    }
-
-    // Add symbols one-by-one.
+  if (HuffmanCodeLengthsToCodes(code_lengths, code_lengths_size, codes)) {
     for (symbol = 0; symbol < code_lengths_size; ++symbol) {
-      if (code_lengths[symbol] > 0) {
-        if (!TreeAddSymbol(tree, symbol, codes[symbol], code_lengths[symbol])) {
-          goto End;
-        }
-      }
+      symbols[symbol] = symbol;
     }
-    ok = 1;
- End:
-    free(codes);
-    ok = ok && IsFull(tree);
-    if (!ok) HuffmanTreeRelease(tree);
-    return ok;
+    ok = BuildTables(tree, code_lengths, codes, symbols, code_lengths_size);
   }
+  free(codes);
+  if (!ok) HuffmanTreeRelease(tree);
+  return ok;
 }
 
 int HuffmanTreeBuildExplicit(HuffmanTree* const tree,
@@ -265,24 +274,13 @@ int HuffmanTreeBuildExplicit(HuffmanTree* const tree,
   assert(codes != NULL);
   assert(symbols != NULL);
 
-  // Initialize the tree. Will fail if num_symbols = 0.
-  if (!TreeInit(tree, num_symbols)) return 0;
-
-  // Add symbols one-by-one.
+  tree->table_ = NULL;
   for (i = 0; i < num_symbols; ++i) {
     if (codes[i] != NON_EXISTENT_SYMBOL) {
-      if (symbols[i] < 0 || symbols[i] >= max_symbol) {
-        goto End;
-      }
-      if (!TreeAddSymbol(tree, symbols[i], codes[i], code_lengths[i])) {
-        goto End;
-      }
+      if (symbols[i] < 0 || symbols[i] >= max_symbol) return 0;
     }
   }
-  ok = 1;
- End:
-  ok = ok && IsFull(tree);
+  ok = BuildTables(tree, code_lengths, codes, symbols, num_symbols);
   if (!ok) HuffmanTreeRelease(tree);
   return ok;
 }
-
@@ -21,40 +21,37 @@
 extern "C" {
 #endif
 
-// A node of a Huffman tree.
+// Huffman decoding is done through a two-level lookup table: the root table
+// is indexed by the next HUFFMAN_TABLE_BITS bits of the stream, which resolves
+// all codes of up to HUFFMAN_TABLE_BITS bits in one look-up. Longer codes
+// point to a second-level table holding the remaining bits of the code.
+#define HUFFMAN_TABLE_BITS 8
+#define HUFFMAN_TABLE_MASK ((1 << HUFFMAN_TABLE_BITS) - 1)
+
+// An entry of the lookup tables.
 typedef struct {
-  int symbol_;
-  int children_;  // delta offset to both children (contiguous) or 0 if leaf.
-} HuffmanTreeNode;
+  uint8_t bits_;    // number of bits used for this symbol. For a root entry
+                    // leading to a second-level table, this is
+                    // HUFFMAN_TABLE_BITS plus the second-level table's bits.
+  uint16_t value_;  // symbol value, or offset to the second-level table.
+} HuffmanCode;
 
 // Huffman Tree.
-#define HUFF_LUT_BITS 7
-#define HUFF_LUT (1U << HUFF_LUT_BITS)
 typedef struct HuffmanTree HuffmanTree;
 struct HuffmanTree {
-  // Fast lookup for short bit lengths.
-  uint8_t lut_bits_[HUFF_LUT];
-  int16_t lut_symbol_[HUFF_LUT];
-  int16_t lut_jump_[HUFF_LUT];
-  // Complete tree for lookups.
-  HuffmanTreeNode* root_;   // all the nodes, starting at root.
-  int max_nodes_;           // max number of nodes
-  int num_nodes_;           // number of currently occupied nodes
+  HuffmanCode* table_;     // root table, followed by the second-level tables.
+  int num_symbols_;        // number of symbols having a code.
+  int max_code_length_;    // length of the longest code, in bits.
 };
 
-// Returns true if the given node is not a leaf of the Huffman tree.
-static WEBP_INLINE int HuffmanTreeNodeIsNotLeaf(
-    const HuffmanTreeNode* const node) {
-  return node->children_;
-}
-
-// Go down one level. Most critical function. 'right_child' must be 0 or 1.
-static WEBP_INLINE const HuffmanTreeNode* HuffmanTreeNextNode(
-    const HuffmanTreeNode* node, int right_child) {
-  return node + node->children_ + right_child;
+// Returns the symbol of a tree having only one symbol (that is: a code of
+// zero length), or -1 otherwise.
+static WEBP_INLINE int HuffmanTreeGetTrivialSymbol(
+    const HuffmanTree* const tree) {
+  return (tree->table_[0].bits_ == 0) ? tree->table_[0].value_ : -1;
 }
 
-// Releases the nodes of the Huffman tree.
+// Releases the lookup tables of the Huffman tree.
 // Note: It does NOT free 'tree' itself.
 void HuffmanTreeRelease(HuffmanTree* const tree);
 
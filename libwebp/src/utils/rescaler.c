@@ -14,11 +14,11 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "./rescaler.h"
+#include "../dsp/dsp.h"
 
 //------------------------------------------------------------------------------
 
-#define RFIX 30
-#define MULT_FIX(x, y) (((int64_t)(x) * (y) + (1 << (RFIX - 1))) >> RFIX)
+#define RFIX WEBP_RESCALER_RFIX
 
 void WebPRescalerInit(WebPRescaler* const wrk, int src_width, int src_height,
                       uint8_t* const dst, int dst_width, int dst_height,
@@ -40,71 +40,32 @@ void WebPRescalerInit(WebPRescaler* const wrk, int src_width, int src_height,
   wrk->y_sub = y_sub;
   wrk->fx_scale = (1 << RFIX) / x_sub;
   wrk->fy_scale = (1 << RFIX) / y_sub;
+  // The vertical normalization uses the y_add/y_sub ratio rather than the
+  // dimensions: they differ for the half-resolution U/V planes of an odd
+  // height, which are rescaled with the Y plane's increments, and with a
+  // reduced decoding resolution.
   wrk->fxy_scale = wrk->x_expand ?
-      ((int64_t)dst_height << RFIX) / (x_sub * src_height) :
-      ((int64_t)dst_height << RFIX) / (x_add * src_height);
+      ((int64_t)y_sub << RFIX) / ((int64_t)x_sub * y_add) :
+      ((int64_t)y_sub << RFIX) / ((int64_t)x_add * y_add);
   wrk->irow = work;
   wrk->frow = work + num_channels * dst_width;
+
+  WebPRescalerDspInit();
 }
 
 void WebPRescalerImportRow(WebPRescaler* const wrk,
-                           const uint8_t* const src, int channel) {
-  const int x_stride = wrk->num_channels;
-  const int x_out_max = wrk->dst_width * wrk->num_channels;
-  int x_in = channel;
-  int x_out;
-  int accum = 0;
-  if (!wrk->x_expand) {
-    int sum = 0;
-    for (x_out = channel; x_out < x_out_max; x_out += x_stride) {
-      accum += wrk->x_add;
-      for (; accum > 0; accum -= wrk->x_sub) {
-        sum += src[x_in];
-        x_in += x_stride;
-      }
-      {        // Emit next horizontal pixel.
-        const int32_t base = src[x_in];
-        const int32_t frac = base * (-accum);
-        x_in += x_stride;
-        wrk->frow[x_out] = (sum + base) * wrk->x_sub - frac;
-        // fresh fractional start for next pixel
-        sum = (int)MULT_FIX(frac, wrk->fx_scale);
-      }
-    }
-  } else {        // simple bilinear interpolation
-    int left = src[channel], right = src[channel];
-    for (x_out = channel; x_out < x_out_max; x_out += x_stride) {
-      if (accum < 0) {
-        left = right;
-        x_in += x_stride;
-        right = src[x_in];
-        accum += wrk->x_add;
-      }
-      wrk->frow[x_out] = right * wrk->x_add + (left - right) * accum;
-      accum -= wrk->x_sub;
-    }
-  }
-  // Accumulate the new row's contribution
-  for (x_out = channel; x_out < x_out_max; x_out += x_stride) {
-    wrk->irow[x_out] += wrk->frow[x_out];
+                           const uint8_t* const src) {
+  if (wrk->x_expand) {
+    WebPRescalerImportRowExpand(wrk, src);
+  } else {
+    WebPRescalerImportRowShrink(wrk, src);
   }
 }
 
 uint8_t* WebPRescalerExportRow(WebPRescaler* const wrk) {
   if (wrk->y_accum <= 0) {
-    int x_out;
     uint8_t* const dst = wrk->dst;
-    int32_t* const irow = wrk->irow;
-    const int32_t* const frow = wrk->frow;
-    const int yscale = wrk->fy_scale * (-wrk->y_accum);
-    const int x_out_max = wrk->dst_width * wrk->num_channels;
-
-    for (x_out = 0; x_out < x_out_max; ++x_out) {
-      const int frac = (int)MULT_FIX(frow[x_out], yscale);
-      const int v = (int)MULT_FIX(irow[x_out] - frac, wrk->fxy_scale);
-      dst[x_out] = (!(v & ~0xff)) ? v : (v < 0) ? 0 : 255;
-      irow[x_out] = frac;   // new fractional start
-    }
+    WebPRescalerEmitRow(wrk);
     wrk->y_accum += wrk->y_add;
     wrk->dst += wrk->dst_stride;
     return dst;
@@ -113,7 +74,6 @@ uint8_t* WebPRescalerExportRow(WebPRescaler* const wrk) {
   }
 }
 
-#undef MULT_FIX
 #undef RFIX
 
 //------------------------------------------------------------------------------
@@ -128,10 +88,7 @@ int WebPRescalerImport(WebPRescaler* const wrk, int num_lines,
                        const uint8_t* src, int src_stride) {
   int total_imported = 0;
   while (total_imported < num_lines && wrk->y_accum > 0) {
-    int channel;
-    for (channel = 0; channel < wrk->num_channels; ++channel) {
-      WebPRescalerImportRow(wrk, src, channel);
-    }
+    WebPRescalerImportRow(wrk, src);
     src += src_stride;
     ++total_imported;
     wrk->y_accum -= wrk->y_sub;
@@ -20,8 +20,10 @@ extern "C" {
 
 #include "../webp/types.h"
 
+#define WEBP_RESCALER_RFIX 30   // fixed-point precision for multiplies
+
 // Structure used for on-the-fly rescaling
-typedef struct {
+typedef struct WebPRescaler {
   int x_expand;               // true if we're expanding in the x direction
   int num_channels;           // bytes to jump between pixels
   int fy_scale, fx_scale;     // fixed-point scaling factor
@@ -52,10 +54,10 @@ void WebPRescalerInit(WebPRescaler* const rescaler,
 int WebPRescaleNeededLines(const WebPRescaler* const rescaler,
                            int max_num_lines);
 
-// Import a row of data and save its contribution in the rescaler.
-// 'channel' denotes the channel number to be imported.
+// Import a row of data, for all channels, and save its contribution in the
+// rescaler.
 void WebPRescalerImportRow(WebPRescaler* const rescaler,
-                           const uint8_t* const src, int channel);
+                           const uint8_t* const src);
 
 // Import multiple rows over all channels, until at least one row is ready to
 // be exported. Returns the actual number of lines that were imported.
@@ -15,6 +15,10 @@
 #include <string.h>   // for memset()
 #include "./thread.h"
 
+#if defined(WEBP_USE_THREAD) && !defined(_WIN32)
+#include <unistd.h>   // for sysconf()
+#endif
+
 #ifdef WEBP_USE_THREAD
 
 #if defined(_WIN32)
@@ -239,3 +243,53 @@ void WebPWorkerEnd(WebPWorker* const worker) {
 
 //------------------------------------------------------------------------------
 
+int WebPWorkersInit(WebPWorker* const workers, int num_workers,
+                    int num_threads) {
+  int num_parallel = 1;
+  int i;
+  for (i = 0; i < num_workers; ++i) WebPWorkerInit(&workers[i]);
+  // The jobs of the workers without a thread run in the calling thread.
+  while (num_parallel < num_threads && num_parallel < num_workers &&
+         WebPWorkerReset(&workers[num_parallel])) {
+    ++num_parallel;
+  }
+  return num_parallel;
+}
+
+int WebPWorkersRun(WebPWorker* const workers, int num_workers,
+                   int num_parallel) {
+  int ok = 1;
+  int i;
+  for (i = 0; i < num_workers; ++i) {
+    workers[i].had_error = 0;
+    if (i > 0 && i < num_parallel) WebPWorkerLaunch(&workers[i]);
+  }
+  for (i = 0; i < num_workers; ++i) {
+    if (i == 0 || i >= num_parallel) WebPWorkerExecute(&workers[i]);
+  }
+  for (i = 0; i < num_workers; ++i) ok &= WebPWorkerSync(&workers[i]);
+  return ok;
+}
+
+void WebPWorkersEnd(WebPWorker* const workers, int num_workers) {
+  int i;
+  for (i = 0; i < num_workers; ++i) WebPWorkerEnd(&workers[i]);
+}
+
+//------------------------------------------------------------------------------
+
+int WebPGetNumCores(void) {
+  int num_cores = 1;
+#ifdef WEBP_USE_THREAD
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  num_cores = (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  num_cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+#endif
+  return (num_cores > 1) ? num_cores : 1;
+}
+
+//------------------------------------------------------------------------------
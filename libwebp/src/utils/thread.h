@@ -88,6 +88,26 @@ void WebPWorkerExecute(WebPWorker* const worker);
 // must call WebPWorkerReset() again.
 void WebPWorkerEnd(WebPWorker* const worker);
 
+// Arrays of workers running independent jobs, the first one always in the
+// calling thread.
+// Initializes the 'num_workers' workers of 'workers' and starts the threads of
+// the workers #1 to #'num_threads' - 1. Returns the number of workers running
+// in parallel: #0 plus the ones with a thread, which are the first ones.
+int WebPWorkersInit(WebPWorker* const workers, int num_workers,
+                    int num_threads);
+// Calls the hooks of the 'num_workers' workers of 'workers' and waits for all
+// of them to finish. The workers #1 to #'num_parallel' - 1 run in their own
+// thread, and the others in turn in the calling thread. Returns false if any
+// hook failed.
+int WebPWorkersRun(WebPWorker* const workers, int num_workers,
+                   int num_parallel);
+// Ends the 'num_workers' workers of 'workers'.
+void WebPWorkersEnd(WebPWorker* const workers, int num_workers);
+
+// Returns the number of processors available to run worker threads, or 1 if
+// unknown or if threads are not supported.
+int WebPGetNumCores(void);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -20,7 +20,7 @@
 extern "C" {
 #endif
 
-#define WEBP_DECODER_ABI_VERSION 0x0203    // MAJOR(8b) + MINOR(8b)
+#define WEBP_DECODER_ABI_VERSION 0x0207    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -30,6 +30,7 @@ typedef struct WebPRGBABuffer WebPRGBABuffer;
 typedef struct WebPYUVABuffer WebPYUVABuffer;
 typedef struct WebPDecBuffer WebPDecBuffer;
 typedef struct WebPIDecoder WebPIDecoder;
+typedef struct WebPDecoderContext WebPDecoderContext;
 typedef struct WebPBitstreamFeatures WebPBitstreamFeatures;
 typedef struct WebPDecoderOptions WebPDecoderOptions;
 typedef struct WebPDecoderConfig WebPDecoderConfig;
@@ -329,6 +330,17 @@ WEBP_EXTERN(VP8StatusCode) WebPIAppend(
 WEBP_EXTERN(VP8StatusCode) WebPIUpdate(
     WebPIDecoder* idec, const uint8_t* data, size_t data_size);
 
+// Another variant, for input arriving as a chain of separate buffers
+// ('segments'): each call adds the next segment of the bitstream. The token
+// data of lossy bitstreams is read straight from the segments, without being
+// copied. Only the headers and partition #0 are copied to the internal memory
+// (and the whole data for lossless bitstreams, which can't be decoded
+// incrementally). The segments must stay valid and unchanged until the image
+// is decoded or WebPIDelete() is called.
+// Can't be mixed with calls to WebPIAppend() or WebPIUpdate().
+WEBP_EXTERN(VP8StatusCode) WebPIAppendSegment(
+    WebPIDecoder* idec, const uint8_t* data, size_t data_size);
+
 // Returns the RGB/A image decoded so far. Returns NULL if output params
 // are not initialized yet. The RGB/A output type corresponds to the colorspace
 // specified during call to WebPINewDecoder() or WebPINewRGB().
@@ -442,11 +454,17 @@ struct WebPDecoderOptions {
   int scaled_width, scaled_height;    // final resolution
   int use_threads;                    // if true, use multi-threaded decoding
   int dithering_strength;             // dithering strength (0=Off, 100=full)
+  int use_fast_downscaling;           // if true, lossy pictures may be first
+                                      // reconstructed at 1/2, 1/4 or 1/8 of
+                                      // their size when scaling (approximate)
+  int num_threads;                    // with use_threads, if > 1: maximum
+                                      // number of threads parsing the token
+                                      // partitions of lossy pictures
 
   // Unused for now:
   int force_rotation;                 // forced rotation (to be applied _last_)
   int no_enhancement;                 // if true, discard enhancement layer
-  uint32_t pad[5];                    // padding for later use
+  uint32_t pad[3];                    // padding for later use
 };
 
 // Main object storing the configuration for advanced decoding.
@@ -484,6 +502,29 @@ WEBP_EXTERN(WebPIDecoder*) WebPIDecode(const uint8_t* data, size_t data_size,
 WEBP_EXTERN(VP8StatusCode) WebPDecode(const uint8_t* data, size_t data_size,
                                       WebPDecoderConfig* config);
 
+//------------------------------------------------------------------------------
+// Decoding contexts
+//
+// A WebPDecoderContext keeps the internal buffers of the decoders, and the
+// worker thread used with 'options.use_threads', from one picture to the next.
+// This saves the allocations and thread creation when decoding many pictures
+// in a row. A context must not be used by several threads at the same time.
+
+// Returns a new context, or NULL in case of memory error. After each picture,
+// a decoder holding more than 'max_memory' bytes is released instead of being
+// kept. If 'max_memory' is 0, memory is always kept.
+WEBP_EXTERN(WebPDecoderContext*) WebPNewDecoderContext(size_t max_memory);
+
+// Same as WebPDecode(), but reusing the memory kept in 'context'. If 'context'
+// is NULL, this is exactly WebPDecode().
+WEBP_EXTERN(VP8StatusCode) WebPDecodeWithContext(WebPDecoderContext* context,
+                                                 const uint8_t* data,
+                                                 size_t data_size,
+                                                 WebPDecoderConfig* config);
+
+// Deletes the context, along with the memory and thread it holds.
+WEBP_EXTERN(void) WebPDeleteDecoderContext(WebPDecoderContext* context);
+
 #ifdef __cplusplus
 }    // extern "C"
 #endif
@@ -45,16 +45,35 @@
   WebPDemuxDelete(demux);
 */
 
+// Code Example: Decoding the frames of an animation, composited on the canvas.
+/*
+  WebPAnimDecoderOptions dec_options;
+  WebPAnimDecoderOptionsInit(&dec_options);
+  // ... (Tune 'dec_options' as needed).
+  WebPAnimDecoder* dec = WebPAnimDecoderNew(&webp_data, &dec_options);
+  WebPAnimInfo anim_info;
+  WebPAnimDecoderGetInfo(dec, &anim_info);
+  while (WebPAnimDecoderHasMoreFrames(dec)) {
+    uint8_t* buf;
+    int timestamp;
+    WebPAnimDecoderGetNext(dec, &buf, &timestamp);
+    // ... (Render 'buf', of size anim_info.canvas_width x canvas_height, at
+    // ... 'timestamp'. It is owned by 'dec' and must not be freed).
+  }
+  WebPAnimDecoderDelete(dec);
+*/
+
 #ifndef WEBP_WEBP_DEMUX_H_
 #define WEBP_WEBP_DEMUX_H_
 
+#include "./decode.h"     // for WEBP_CSP_MODE
 #include "./mux_types.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define WEBP_DEMUX_ABI_VERSION 0x0101    // MAJOR(8b) + MINOR(8b)
+#define WEBP_DEMUX_ABI_VERSION 0x0102    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -63,6 +82,8 @@ extern "C" {
 typedef struct WebPDemuxer WebPDemuxer;
 typedef struct WebPIterator WebPIterator;
 typedef struct WebPChunkIterator WebPChunkIterator;
+typedef struct WebPAnimInfo WebPAnimInfo;
+typedef struct WebPAnimDecoderOptions WebPAnimDecoderOptions;
 
 //------------------------------------------------------------------------------
 
@@ -215,6 +236,98 @@ WEBP_EXTERN(int) WebPDemuxPrevChunk(WebPChunkIterator* iter);
 // WebPDemuxDelete().
 WEBP_EXTERN(void) WebPDemuxReleaseChunkIterator(WebPChunkIterator* iter);
 
+//------------------------------------------------------------------------------
+// Animation decoding.
+//
+// The WebPAnimDecoder composites the frames on the canvas, following their
+// blend and dispose methods, and returns the full canvas for each frame.
+// Areas disposed to the background are made transparent: the background color
+// is only a hint and is left to the application.
+
+typedef struct WebPAnimDecoder WebPAnimDecoder;  // Main opaque object.
+
+// Global options.
+struct WebPAnimDecoderOptions {
+  // Output colorspace. Only the following modes are supported:
+  // MODE_RGBA, MODE_BGRA, MODE_rgbA and MODE_bgrA.
+  WEBP_CSP_MODE color_mode;
+  int use_threads;           // If true, use multi-threaded decoding.
+  // Maximum number of canvases kept in memory to speed up seeking, see
+  // WebPAnimDecoderSeek(). Each one takes canvas_width * canvas_height * 4
+  // bytes. 0 disables the cache.
+  int max_cached_canvases;
+  uint32_t padding[6];       // Padding for later use.
+};
+
+// Internal, version-checked, entry point.
+WEBP_EXTERN(int) WebPAnimDecoderOptionsInitInternal(
+    WebPAnimDecoderOptions*, int);
+
+// Should always be called, to initialize a fresh WebPAnimDecoderOptions
+// structure before modification. Returns false in case of version mismatch.
+// WebPAnimDecoderOptionsInit() must have succeeded before using the
+// 'dec_options' object.
+static WEBP_INLINE int WebPAnimDecoderOptionsInit(
+    WebPAnimDecoderOptions* dec_options) {
+  return WebPAnimDecoderOptionsInitInternal(dec_options,
+                                            WEBP_DEMUX_ABI_VERSION);
+}
+
+// Internal, version-checked, entry point.
+WEBP_EXTERN(WebPAnimDecoder*) WebPAnimDecoderNewInternal(
+    const WebPData*, const WebPAnimDecoderOptions*, int);
+
+// Creates and initializes a WebPAnimDecoder object for the WebP image in
+// 'webp_data', which can be animated or not. 'dec_options' can be NULL, in
+// which case the default options are used.
+// Returns NULL in case of parsing error, invalid option or memory error.
+// NOTE: 'webp_data' must persist for the lifetime of the decoder.
+static WEBP_INLINE WebPAnimDecoder* WebPAnimDecoderNew(
+    const WebPData* webp_data, const WebPAnimDecoderOptions* dec_options) {
+  return WebPAnimDecoderNewInternal(webp_data, dec_options,
+                                    WEBP_DEMUX_ABI_VERSION);
+}
+
+// Global information about the animation.
+struct WebPAnimInfo {
+  uint32_t canvas_width;
+  uint32_t canvas_height;
+  uint32_t loop_count;
+  uint32_t bgcolor;
+  uint32_t frame_count;
+  uint32_t pad[4];   // padding for later use
+};
+
+// Retrieves global information about the animation.
+// Returns false in case of error.
+WEBP_EXTERN(int) WebPAnimDecoderGetInfo(const WebPAnimDecoder* dec,
+                                        WebPAnimInfo* info);
+
+// Decodes the next frame and composites it on the canvas. On return, '*buf'
+// points to the canvas, in the requested colorspace, and '*timestamp' is the
+// time at which the frame ends (in milliseconds, from the start of the
+// animation). The canvas is owned by 'dec' and is valid until the next call
+// to any of the WebPAnimDecoder functions.
+// Returns false in case of error, or if there is no frame left.
+WEBP_EXTERN(int) WebPAnimDecoderGetNext(WebPAnimDecoder* dec,
+                                        uint8_t** buf, int* timestamp);
+
+// Returns true if there are frames left to decode.
+WEBP_EXTERN(int) WebPAnimDecoderHasMoreFrames(const WebPAnimDecoder* dec);
+
+// Makes frame 'frame_num' (starting from 1) the next frame returned by
+// WebPAnimDecoderGetNext(). The frames before it are decoded again from the
+// closest point among: the current position, the last key-frame (a frame that
+// doesn't depend on the previous ones), and the cached canvases.
+// Returns false in case of error.
+WEBP_EXTERN(int) WebPAnimDecoderSeek(WebPAnimDecoder* dec, int frame_num);
+
+// Rewinds to the first frame. Same as WebPAnimDecoderSeek(dec, 1).
+WEBP_EXTERN(void) WebPAnimDecoderReset(WebPAnimDecoder* dec);
+
+// Frees the memory associated with 'dec'.
+WEBP_EXTERN(void) WebPAnimDecoderDelete(WebPAnimDecoder* dec);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -20,7 +20,7 @@
 extern "C" {
 #endif
 
-#define WEBP_ENCODER_ABI_VERSION 0x0202    // MAJOR(8b) + MINOR(8b)
+#define WEBP_ENCODER_ABI_VERSION 0x0203    // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -120,7 +120,9 @@ struct WebPConfig {
   int preprocessing;      // preprocessing filter:
                           // 0=none, 1=segment-smooth, 2=pseudo-random dithering
   int partitions;         // log2(number of token partitions) in [0..3]. Default
-                          // is set to 0 for easier progressive decoding.
+                          // is set to 0 for easier progressive decoding. With
+                          // 'thread_level', the partitions are coded in
+                          // parallel.
   int partition_limit;    // quality degradation allowed to fit the 512k limit
                           // on prediction modes coding (0: no degradation,
                           // 100: maximum possible degradation).
@@ -130,8 +132,11 @@ struct WebPConfig {
                           // be similar but the degradation will be lower.
   int thread_level;       // If non-zero, try and use multi-threaded encoding.
   int low_memory;         // If set, reduce memory usage (but increase CPU use).
+  int lossless_search;    // Effort of the lossless match search, between
+                          // 1 (fastest) and 100 (smallest output). The default
+                          // 0 derives it from 'quality'.
 
-  uint32_t pad[5];        // padding for later use
+  uint32_t pad[4];        // padding for later use
 };
 
 // Enumerate some predefined settings for WebPConfig, depending on the type
@@ -489,6 +494,62 @@ WEBP_EXTERN(void) WebPBlendAlpha(WebPPicture* pic, uint32_t background_rgb);
 // another is provided but they both incur some loss.
 WEBP_EXTERN(int) WebPEncode(const WebPConfig* config, WebPPicture* picture);
 
+//------------------------------------------------------------------------------
+// Incremental encoding
+//
+// This API allows lossy encoding of a picture whose rows are received one
+// chunk at a time, without ever holding the whole picture in memory: each
+// macroblock row is analyzed and coded as soon as its 16 rows of samples are
+// available. Only a small window of YUV rows is kept around, and the full
+// alpha plane only if some transparency is found. The bitstream is emitted
+// through picture->writer when the last rows have been appended.
+// Typical usage is:
+//
+//   WebPPicture pic;    // only width, height and writer fields are needed
+//   ...
+//   WebPIEncoder* const ienc = WebPINewEncoder(&config, &pic);
+//   if (ienc == NULL) return;   // pic.error_code gives the reason.
+//   while (more rows are coming) {
+//     if (!WebPIEncodeRGBA(ienc, rows, stride, num_rows)) break;
+//   }
+//   ok = WebPIEncodeFinish(ienc);
+//   WebPIEncoderDelete(ienc);
+//
+// Compared to WebPEncode(), the segments and the token probabilities are
+// decided from the first rows only, and the target_size / target_PSNR search
+// as well as the 'preprocessing' dithering are not used. 'low_memory' is
+// implied. The segment map smoothing only applies to the first rows.
+
+typedef struct WebPIEncoder WebPIEncoder;
+
+// Creates a new incremental encoder for a lossy 'config'. The 'picture' must
+// have its dimensions set but hold no samples. It must stay alive until
+// WebPIEncoderDelete() is called, and is used for the writer, progress hook,
+// statistics and error reporting, like WebPEncode() does.
+// Returns NULL in case of error, with picture->error_code set accordingly.
+WEBP_EXTERN(WebPIEncoder*) WebPINewEncoder(const WebPConfig* config,
+                                           WebPPicture* picture);
+
+// Appends the next 'num_rows' rows of samples, given in the respective
+// formats. The different formats can be mixed from one call to the next.
+// Returns false in case of error, including when more rows than the picture's
+// height are passed.
+WEBP_EXTERN(int) WebPIEncodeRGB(WebPIEncoder* ienc,
+                                const uint8_t* rgb, int stride, int num_rows);
+WEBP_EXTERN(int) WebPIEncodeBGR(WebPIEncoder* ienc,
+                                const uint8_t* bgr, int stride, int num_rows);
+WEBP_EXTERN(int) WebPIEncodeRGBA(WebPIEncoder* ienc,
+                                 const uint8_t* rgba, int stride, int num_rows);
+WEBP_EXTERN(int) WebPIEncodeBGRA(WebPIEncoder* ienc,
+                                 const uint8_t* bgra, int stride, int num_rows);
+
+// Finishes the encoding and writes the bitstream. All the picture's rows must
+// have been appended. Returns false in case of error.
+WEBP_EXTERN(int) WebPIEncodeFinish(WebPIEncoder* ienc);
+
+// Releases the encoder's memory. The picture is left without samples.
+WEBP_EXTERN(void) WebPIEncoderDelete(WebPIEncoder* ienc);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -55,7 +55,7 @@
 extern "C" {
 #endif
 
-#define WEBP_MUX_ABI_VERSION 0x0101        // MAJOR(8b) + MINOR(8b)
+#define WEBP_MUX_ABI_VERSION 0x0102        // MAJOR(8b) + MINOR(8b)
 
 // Note: forward declaring enumerations is not allowed in (strict) C and C++,
 // the types are left here for reference.
@@ -368,6 +368,32 @@ WEBP_EXTERN(WebPMuxError) WebPMuxNumChunks(const WebPMux* mux,
 WEBP_EXTERN(WebPMuxError) WebPMuxAssemble(WebPMux* mux,
                                           WebPData* assembled_data);
 
+// Signature for the output function of WebPMuxAssembleToWriter(). It receives
+// the assembled data as consecutive segments, and should return true if
+// writing was successful. 'user_data' is the pointer given to
+// WebPMuxAssembleToWriter().
+typedef int (*WebPMuxWriterFunction)(const uint8_t* data, size_t data_size,
+                                     void* user_data);
+
+// Assembles all chunks in WebP RIFF format and streams them through 'writer'.
+// Unlike WebPMuxAssemble(), no buffer holding the whole assembled data is
+// allocated: only the RIFF and chunk headers are generated, and the chunk
+// payloads are handed to 'writer' directly from where the 'mux' object
+// references them, without copy.
+// This function also validates the mux object, before anything is written.
+// Parameters:
+//   mux - (in/out) object whose chunks are to be assembled
+//   writer - (in) output function
+//   user_data - (in) opaque pointer passed to each call of 'writer'
+// Returns:
+//   WEBP_MUX_BAD_DATA - if mux object is invalid.
+//   WEBP_MUX_INVALID_ARGUMENT - if mux or writer is NULL.
+//   WEBP_MUX_MEMORY_ERROR - on memory allocation error, or if 'writer'
+//                           returned false (the output is then incomplete).
+//   WEBP_MUX_OK - on success.
+WEBP_EXTERN(WebPMuxError) WebPMuxAssembleToWriter(
+    WebPMux* mux, WebPMuxWriterFunction writer, void* user_data);
+
 //------------------------------------------------------------------------------
 
 #ifdef __cplusplus